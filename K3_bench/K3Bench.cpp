@@ -0,0 +1,669 @@
+#include "engine.h"
+#include <chrono>
+#include <limits>
+#include <cstring>
+#include <cmath>
+
+/* Benchmarks for the engine hot paths. Every result is written as one JSON object
+** per line so runs can be collected and compared across commits.
+** Runs headless by default (VK_EXT_headless_surface), which works on a software ICD
+** such as lavapipe or SwiftShader.
+** --replay plays a capture (K3_Engine --capture file) back as fast as it can instead of the
+** suite, with the timing of every frame.
+**
+** --dynres scales the scene resolution to hold the GPU frame time under the given ms.
+** --lights scatters point and spot lights over the frames' grid, moving every frame.
+** --vsync presents in FIFO mode, so the frame pacer starts the frames against the vblank.
+** The suite starts with the startup steps of the engine and its time to first frame.
+**
+** usage: K3_bench [--window] [--frames N] [--objects N] [--fps-cap N] [--out file] [--replay file]
+**                 [--msaa N] [--dynres MS] [--lights N] [--vsync]
+*/
+
+struct K3BenchOptions
+{
+	bool			headless = true;
+	uint32_t		frames = 500;
+	uint32_t		objects = 4096;
+	double			fpsCap = 0.0;
+	const char*		outPath = nullptr;
+	const char*		replayPath = nullptr;
+	uint32_t		msaa = K3_MSAA_SAMPLES;
+	double			dynresTarget = 0.0;
+	uint32_t		lights = 0;
+	bool			vsync = false;
+};
+
+class K3Benchmark {
+
+public:
+
+	void				run();
+	void				replay();
+
+	K3Benchmark(VkHandler& handler, K3BenchOptions const& options, std::ostream& out)
+		: handler(handler), options(options), out(out) {}
+
+private:
+
+	typedef std::chrono::steady_clock	Clock;
+
+	struct Timings
+	{
+		double		total = 0.0;
+		double		min = std::numeric_limits<double>::max();
+		double		max = 0.0;
+		uint32_t	count = 0;
+
+		void		add(double ms) {
+			total += ms;
+			min = std::min(min, ms);
+			max = std::max(max, ms);
+			count++;
+		}
+		double		mean() const {
+			return count > 0 ? total / count : 0.0;
+		}
+	};
+
+	static double			elapsedMs(Clock::time_point start);
+	void				emit(char const* name, Timings const& timings, char const* extraKey = nullptr, double extraValue = 0.0, char const* paramKey = nullptr, double paramValue = 0.0);
+	void				emitDevice();
+	void				emitStartup(K3StartupGraph const& graph);
+	void				benchUpload();
+	void				benchCreateBuffer();
+	void				benchCmdRecording();
+	void				benchSwapchainRecreation();
+	void				benchSceneUpdate();
+	void				benchLodSelect();
+	void				benchRenderQueue();
+	void				benchJobs();
+	void				benchFrames();
+	void				benchConcurrentRecording();
+
+	VkHandler&			handler;
+	K3BenchOptions const&		options;
+	std::ostream&			out;
+
+};
+
+double		K3Benchmark::elapsedMs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void		K3Benchmark::emit(char const* name, Timings const& timings, char const* extraKey, double extraValue,
+						char const* paramKey, double paramValue)
+{
+	out << "{\"bench\":\"" << name << "\"";
+	if (paramKey)
+		out << ",\"" << paramKey << "\":" << paramValue;
+	out << ",\"iterations\":" << timings.count
+		<< ",\"mean_ms\":" << timings.mean()
+		<< ",\"min_ms\":" << (timings.count > 0 ? timings.min : 0.0)
+		<< ",\"max_ms\":" << timings.max;
+	if (extraKey)
+		out << ",\"" << extraKey << "\":" << extraValue;
+	out << "}" << std::endl;
+}
+
+// Every step of a startup graph with its start, then the graph's wall time
+void		K3Benchmark::emitStartup(K3StartupGraph const& graph)
+{
+	for (uint32_t step = 0; step < graph.getStepCount(); step++) {
+		out << "{\"bench\":\"startup_step\",\"graph\":\"" << graph.getName() << "\",\"step\":\"" << graph.getStepName(step)
+			<< "\",\"start_ms\":" << graph.getStepStart(step) << ",\"ms\":" << graph.getStepDuration(step) << "}" << std::endl;
+	}
+	out << "{\"bench\":\"startup\",\"graph\":\"" << graph.getName() << "\",\"ms\":" << graph.getElapsed() << "}" << std::endl;
+}
+
+void		K3Benchmark::emitDevice()
+{
+	VkPhysicalDeviceProperties	properties;
+
+	vkGetPhysicalDeviceProperties(handler.gpu->getPhysicalDevice(), &properties);
+	out << "{\"device\":\"" << properties.deviceName << "\",\"deviceType\":" << properties.deviceType
+		<< ",\"headless\":" << (options.headless ? "true" : "false")
+		<< ",\"msaa\":" << handler.sceneTargets.getSamples()
+		<< ",\"directMemory\":" << handler.budget.getDirectMemory() << "}" << std::endl;
+}
+
+// Staged upload through transferBufferToGpuStaged, including the staging buffer lifetime
+void		K3Benchmark::benchUpload()
+{
+	VkDevice const&		gpuDev = handler.gpu->getLogicalDevice();
+	VkDeviceSize const	sizes[] = { 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+
+	for (VkDeviceSize size : sizes) {
+		std::vector<char>	data(static_cast<size_t>(size), 0x5a);
+		Timings			timings;
+
+		for (uint32_t i = 0; i < 20; i++) {
+			VkBuffer		buffer;
+			VkDeviceMemory		memory;
+			Clock::time_point	start = Clock::now();
+
+			handler.transferBufferToGpuStaged(data.data(), size, buffer, memory, 0, 0);
+			timings.add(elapsedMs(start));
+			vkDestroyBuffer(gpuDev, buffer, nullptr);
+			handler.budget.free(memory);
+		}
+		double	throughput = (static_cast<double>(size) / (1024.0 * 1024.0)) / (timings.mean() / 1000.0);
+		emit("upload_staged", timings, "mb_per_s", throughput, "bytes", static_cast<double>(size));
+	}
+}
+
+// Buffer creation and memory allocation rate, each buffer gets its own allocation
+void		K3Benchmark::benchCreateBuffer()
+{
+	VkDevice const&		gpuDev = handler.gpu->getLogicalDevice();
+	uint32_t const		count = 256;
+	Timings			timings;
+
+	std::vector<VkBuffer>		buffers(count);
+	std::vector<VkDeviceMemory>	memories(count);
+	for (uint32_t pass = 0; pass < 10; pass++) {
+		Clock::time_point	start = Clock::now();
+
+		for (uint32_t i = 0; i < count; i++) {
+			handler.createBuffer(4096, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				buffers[i], memories[i]);
+		}
+		timings.add(elapsedMs(start));
+		for (uint32_t i = 0; i < count; i++) {
+			vkDestroyBuffer(gpuDev, buffers[i], nullptr);
+			handler.budget.free(memories[i]);
+		}
+	}
+	emit("create_buffer", timings, "buffers_per_s", count / (timings.mean() / 1000.0), "count", count);
+}
+
+// Allocation and recording of the per-framebuffer command buffers
+void		K3Benchmark::benchCmdRecording()
+{
+	VkDevice const&		gpuDev = handler.gpu->getLogicalDevice();
+	uint32_t const		drawCounts[] = { 1, options.objects };
+	uint32_t const		savedDrawCount = handler.drawCount;
+
+	vkDeviceWaitIdle(gpuDev);
+	for (uint32_t draws : drawCounts) {
+		Timings		timings;
+
+		handler.drawCount = draws;
+		for (uint32_t i = 0; i < 50; i++) {
+			handler.freeCmdBuffers();
+			Clock::time_point	start = Clock::now();
+
+			handler.createCmdBuffers();
+			timings.add(elapsedMs(start));
+		}
+		emit("record_cmd_buffers", timings, "buffers", static_cast<double>(handler.cmdBuffers.size()), "draws", draws);
+	}
+	handler.drawCount = savedDrawCount;
+	handler.freeCmdBuffers();
+	handler.createCmdBuffers();
+}
+
+/* Full swapchain rebuild, alternating between two extents so every rebuild is a real resize.
+** Nothing waits for the device, the old swapchains pile up in the retired queue until the end.
+*/
+void		K3Benchmark::benchSwapchainRecreation()
+{
+	VkDevice const&		gpuDev = handler.gpu->getLogicalDevice();
+	VkExtent2D const	initial = handler.dispHandler->getScExtent();
+	Timings			timings;
+
+	for (uint32_t i = 0; i < 20; i++) {
+		uint32_t	width = (i % 2) ? initial.width : initial.width / 2;
+		uint32_t	height = (i % 2) ? initial.height : initial.height / 2;
+
+		handler.dispHandler->resizeWindow(width, height, false);
+		Clock::time_point	start = Clock::now();
+
+		handler.recreateSwapChain();
+		timings.add(elapsedMs(start));
+	}
+	vkDeviceWaitIdle(gpuDev);
+	handler.retired.flushAll();
+	emit("recreate_swapchain", timings);
+}
+
+/* World matrix update of a 100k node hierarchy (roots with two levels of children),
+** once with every node moving and once with a tenth of the roots moving.
+** Runs on the CPU only, the region is plain memory.
+*/
+void		K3Benchmark::benchSceneUpdate()
+{
+	uint32_t const		nodeCount = 100000;
+	uint32_t const		fanout = 9;
+	K3Scene			scene;
+	std::vector<glm::mat4>	region(nodeCount);
+	uint32_t		regionVersion = 0;
+
+	scene.reserve(nodeCount);
+	while (scene.getNodeCount() < nodeCount) {
+		uint32_t	root = scene.createNode();
+
+		for (uint32_t i = 0; i < fanout && scene.getNodeCount() < nodeCount; i++) {
+			uint32_t	child = scene.createNode(root);
+
+			scene.setTranslation(child, glm::vec3(static_cast<float>(i), 0.0f, 0.0f));
+			for (uint32_t j = 0; j < fanout && scene.getNodeCount() < nodeCount; j++) {
+				scene.setTranslation(scene.createNode(child), glm::vec3(0.0f, static_cast<float>(j), 0.0f));
+			}
+		}
+	}
+	scene.updateTransforms(region.data(), regionVersion, nodeCount);
+
+	uint32_t const		movingRatios[] = { 1, 10 };
+	for (uint32_t ratio : movingRatios) {
+		Timings		timings;
+
+		for (uint32_t pass = 0; pass < 50; pass++) {
+			float const	offset = static_cast<float>(pass) * 0.01f;
+
+			for (uint32_t node = 0, root = 0; node < nodeCount; node++) {
+				if (scene.getParent(node) != K3_NO_PARENT)
+					continue;
+				if (root++ % ratio == 0)
+					scene.setTranslation(node, glm::vec3(offset, 0.0f, 0.0f));
+			}
+			Clock::time_point	start = Clock::now();
+
+			scene.updateTransforms(region.data(), regionVersion, nodeCount);
+			timings.add(elapsedMs(start));
+		}
+		emit("scene_update", timings, "nodes_updated", scene.getUpdatedCount(), "moving_root_ratio", ratio);
+	}
+}
+
+/* LOD selection over 100k nodes spread in depth in front of a perspective view, with the
+** engine's quad levels. The first pass selects everything, the following ones only see the
+** nodes drift, which is the steady state the hysteresis is meant for.
+*/
+void		K3Benchmark::benchLodSelect()
+{
+	uint32_t const		nodeCount = 100000;
+	K3Scene			scene;
+	K3LodSelector		selector;
+	K3SceneSnapshot		snapshot;
+	K3LodView		view;
+	Timings			timings;
+
+	selector.addMesh(handler.lods.getMesh(0));
+	scene.reserve(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		uint32_t	node = scene.createNode();
+
+		scene.setTranslation(node, glm::vec3(static_cast<float>(i % 100) - 50.0f, 0.0f, 1.0f + static_cast<float>(i / 100)));
+	}
+	scene.writeSnapshot(snapshot);
+	view.eye = glm::vec3(0.0f);
+	view.projScale = 720.0f / (2.0f * std::tan(0.5f * 1.0472f));
+	view.perspective = true;
+
+	for (uint32_t pass = 0; pass < 50; pass++) {
+		Clock::time_point	start = Clock::now();
+
+		selector.select(snapshot.worlds.data(), snapshot.nodeCount, view);
+		timings.add(elapsedMs(start));
+		view.eye.z += 0.05f;
+	}
+	emit("lod_select", timings, "triangles", static_cast<double>(selector.getTriangleCount()), "nodes", nodeCount);
+}
+
+// Key sort of a frame's draws, materials and depths scattered like a real scene's
+void		K3Benchmark::benchRenderQueue()
+{
+	uint32_t const		drawCount = 100000;
+	K3RenderQueue		queue;
+	Timings			timings;
+	uint32_t		runs = 0;
+
+	queue.reserve(drawCount);
+	for (uint32_t pass = 0; pass < 50; pass++) {
+		queue.clear();
+		for (uint32_t i = 0; i < drawCount; i++) {
+			uint32_t	hash = (i + pass) * 2654435761u;
+
+			queue.push(K3RenderQueue::makeKey(0, hash % 8, (hash >> 8) % 256, static_cast<float>(hash >> 16) * 0.01f), i);
+		}
+
+		Clock::time_point	start = Clock::now();
+
+		queue.sort();
+		timings.add(elapsedMs(start));
+	}
+	// Draws sharing pipeline and material now follow each other
+	for (uint32_t i = 1; i < queue.getSize(); i++) {
+		if ((queue.getKey(i) >> K3_KEY_DEPTH_BITS) != (queue.getKey(i - 1) >> K3_KEY_DEPTH_BITS))
+			runs++;
+	}
+	emit("render_queue_sort", timings, "state_changes", runs, "draws", drawCount);
+}
+
+/* Scheduler overhead : a batch of empty jobs on one counter, then parallelFor against a
+** serial loop over the same arithmetic.
+*/
+void		K3Benchmark::benchJobs()
+{
+	K3JobSystem&		jobs = K3JobSystem::getInstance();
+	uint32_t const		jobCount = 10000;
+	uint32_t const		elementCount = 1 << 22;
+	std::vector<float>	values(elementCount, 1.0f);
+	Timings			emptyJobs;
+	Timings			serial;
+	Timings			parallel;
+
+	for (uint32_t pass = 0; pass < 20; pass++) {
+		K3JobCounter		counter;
+		Clock::time_point	start = Clock::now();
+
+		for (uint32_t i = 0; i < jobCount; i++) {
+			jobs.run([]() {}, &counter);
+		}
+		jobs.wait(counter);
+		emptyJobs.add(elapsedMs(start));
+	}
+	emit("empty_jobs", emptyJobs, "jobs_per_ms", jobCount / emptyJobs.mean(), "workers", jobs.getWorkerCount());
+
+	auto	kernel = [&values](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) {
+			values[i] = std::sqrt(values[i] * 1.0001f + 0.5f);
+		}
+	};
+	for (uint32_t pass = 0; pass < 20; pass++) {
+		Clock::time_point	start = Clock::now();
+
+		kernel(0, elementCount);
+		serial.add(elapsedMs(start));
+		start = Clock::now();
+		jobs.parallelFor(0, elementCount, 16384, kernel);
+		parallel.add(elapsedMs(start));
+	}
+	emit("parallel_for", parallel, "speedup", serial.mean() / parallel.mean(), "elements", elementCount);
+}
+
+// End to end frames, one draw per object, each object being a scene node
+void		K3Benchmark::benchFrames()
+{
+	VkDevice const&		gpuDev = handler.gpu->getLogicalDevice();
+	K3FrameArena&		frameArena = K3FrameArena::getThreadArena();
+	K3Scene&		scene = handler.scene;
+	uint32_t const		side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(options.objects))));
+	Timings			timings;
+	Timings			latency;
+	Timings			gpuTimes;
+
+	// A grid of small quads covering the viewport
+	while (scene.getNodeCount() < options.objects) {
+		uint32_t	node = scene.createNode();
+		float		x = static_cast<float>(node % side) / side * 2.0f - 1.0f + 1.0f / side;
+		float		y = static_cast<float>(node / side) / side * 2.0f - 1.0f + 1.0f / side;
+
+		scene.setTranslation(node, glm::vec3(x, y, 0.0f));
+		scene.setScale(node, glm::vec3(2.0f / side, 2.0f / side, 1.0f));
+	}
+	// Just in front of the grid, each reaching a few objects around it, half of them spots aimed at it
+	for (uint32_t i = scene.getLightCount(); i < options.lights; i++) {
+		K3Light		light;
+		uint32_t	hash = i * 2654435761u;
+
+		light.position = glm::vec3(static_cast<float>(hash & 0xFFFF) / 32768.0f - 1.0f, static_cast<float>(hash >> 16) / 32768.0f - 1.0f, -0.05f);
+		light.radius = 8.0f / side;
+		light.color = glm::vec3(static_cast<float>(i % 3 == 0), static_cast<float>(i % 3 == 1), static_cast<float>(i % 3 == 2));
+		light.type = (i % 2) ? K3_LIGHT_SPOT : K3_LIGHT_POINT;
+		light.outerCos = 0.8f;
+		light.innerCos = 0.9f;
+		scene.createLight(light);
+	}
+	if (options.lights > 0)
+		scene.setAmbientLight(glm::vec3(0.1f));
+
+	vkDeviceWaitIdle(gpuDev);
+	handler.freeCmdBuffers();
+	handler.drawCount = 1;
+	handler.createCmdBuffers();
+
+	// Warm up, the first frames pay for lazy driver work
+	for (uint32_t i = 0; i < 10; i++) {
+		handler.publishScene();
+		handler.drawFrame();
+	}
+	frameArena.reset();
+	handler.setFrameCap(options.fpsCap);
+	Clock::time_point	runStart = Clock::now();
+	for (uint32_t i = 0; i < options.frames; i++) {
+		Clock::time_point	start = Clock::now();
+
+		// Simulation and rendering run back to back here, the snapshot handoff is part of the frame
+		handler.publishScene();
+		handler.drawFrame();
+		frameArena.reset();
+		timings.add(elapsedMs(start));
+		latency.add(handler.pacer.getLastFrame().inputToPresent);
+		gpuTimes.add(handler.gpuFrameMs);
+		// Keep a fraction of the grid moving so the transform update is part of the frame
+		for (uint32_t node = i % 16; node < options.objects; node += 16) {
+			glm::vec3	translation = scene.getTranslation(node);
+
+			translation.z = (i % 2) ? 0.0f : 0.001f;
+			scene.setTranslation(node, translation);
+		}
+		// The lights circle their place, so they are copied and binned anew every frame
+		for (uint32_t light = 0; light < scene.getLightCount(); light++) {
+			K3Light		value = scene.getLight(light);
+			float const	angle = static_cast<float>(light + i) * 0.1f;
+
+			value.position += glm::vec3(std::cos(angle), std::sin(angle), 0.0f) * (0.1f / side);
+			scene.setLight(light, value);
+		}
+	}
+	double	fps = options.frames / (elapsedMs(runStart) / 1000.0);
+	vkDeviceWaitIdle(gpuDev);
+	emit("frames", timings, "fps", fps, "objects", options.objects);
+	emit("input_latency", latency, "p99", handler.getLatencyStats().inputToPresentP99, "fps_cap", options.fpsCap);
+	// Measured a frame or more late, without timestamps every sample is 0
+	if (handler.gpuTimer.isEnabled())
+		emit("gpu_frame", gpuTimes, "render_scale", handler.dynamicResolution.getScale(), "target_ms", options.dynresTarget);
+	if (options.lights > 0) {
+		emit("clustered_lights", handler.gpuTimer.isEnabled() ? gpuTimes : timings, "clustered", handler.clusteredLighting ? 1.0 : 0.0,
+			"lights", options.lights);
+	}
+	handler.setFrameCap(0.0);
+}
+
+/* Recording while a simulation thread publishes, the way the render and main threads run.
+** The simulation spreads its step over the job system, so each side picks up the other's
+** jobs in its waits : a recording job must still get a command pool of its own, which the
+** validation layers check in debug builds.
+*/
+void		K3Benchmark::benchConcurrentRecording()
+{
+	VkDevice const&		gpuDev = handler.gpu->getLogicalDevice();
+	K3JobSystem&		jobs = K3JobSystem::getInstance();
+	K3Scene&		scene = handler.scene;
+	uint32_t const		nodeCount = scene.getNodeCount();
+	std::atomic<bool>	simulating { true };
+	std::atomic<uint32_t>	publishes { 0 };
+	std::exception_ptr	simError;
+	Timings			timings;
+
+	vkDeviceWaitIdle(gpuDev);
+	std::thread		simThread([&]() {
+		std::vector<glm::vec3>	translations(nodeCount);
+
+		try {
+			jobs.registerThread();
+			for (uint32_t step = 0; simulating; step++) {
+				jobs.parallelFor(0, nodeCount, 256, [&](uint32_t first, uint32_t last) {
+					for (uint32_t node = first; node < last; node++) {
+						translations[node] = scene.getTranslation(node);
+						translations[node].z = (step % 2) ? 0.0f : 0.001f;
+					}
+				});
+				for (uint32_t node = step % 16; node < nodeCount; node += 16)
+					scene.setTranslation(node, translations[node]);
+				handler.publishScene();
+				publishes++;
+			}
+		}
+		catch (...) {
+			simError = std::current_exception();
+		}
+	});
+	// Every bucket is recorded again, over the job system
+	for (uint32_t i = 0; i < 50; i++) {
+		handler.freeCmdBuffers();
+		handler.cmdCache.invalidateAll();
+		Clock::time_point	start = Clock::now();
+
+		handler.createCmdBuffers();
+		timings.add(elapsedMs(start));
+	}
+	simulating = false;
+	simThread.join();
+	if (simError)
+		std::rethrow_exception(simError);
+	vkDeviceWaitIdle(gpuDev);
+	handler.retired.flushAll();
+	emit("concurrent_recording", timings, "publishes", publishes.load(), "buckets", handler.recordedBuckets);
+}
+
+/* The capture starts from an empty scene, so its first frame is applied before the
+** renderer is initialized (which would otherwise add a default node). Textures are not
+** captured, textured materials come back untextured but keep their color.
+*/
+
+void		K3Benchmark::replay()
+{
+	K3CaptureReader		reader;
+	K3FrameArena&		frameArena = K3FrameArena::getThreadArena();
+	Timings			timings;
+	auto const		createMaterial = [this](glm::vec4 const& color, bool const) {
+		return handler.createMaterial(color);
+	};
+
+	reader.open(options.replayPath);
+	if (!reader.readFrame(handler.scene, createMaterial))
+		throw std::runtime_error("Empty capture file !");
+	handler.initVulkan();
+	emitDevice();
+	frameArena.reset();
+	handler.setFrameCap(options.fpsCap);
+	Clock::time_point	runStart = Clock::now();
+	uint32_t		frame = 0;
+	do {
+		Clock::time_point	start = Clock::now();
+
+		handler.publishScene();
+		handler.drawFrame();
+		frameArena.reset();
+		double const		ms = elapsedMs(start);
+
+		timings.add(ms);
+		out << "{\"bench\":\"replay_frame\",\"frame\":" << frame++ << ",\"ms\":" << ms
+			<< ",\"nodes\":" << handler.scene.getNodeCount() << "}" << std::endl;
+	} while (reader.readFrame(handler.scene, createMaterial));
+	double	fps = frame / (elapsedMs(runStart) / 1000.0);
+	vkDeviceWaitIdle(handler.gpu->getLogicalDevice());
+	emit("replay", timings, "fps", fps, "frames", reader.getFrameCount());
+	handler.setFrameCap(0.0);
+}
+
+/* The first frame is drawn right after initialization so that the time to it is the
+** engine's own, the lazy startup steps it starts are reported once the frames ran.
+*/
+
+void		K3Benchmark::run()
+{
+	handler.initVulkan();
+	handler.publishScene();
+	handler.drawFrame();
+	emitDevice();
+	emitStartup(handler.deviceStartup);
+	emitStartup(handler.rendererStartup);
+	out << "{\"bench\":\"time_to_first_frame\",\"ms\":" << handler.firstFrameMs << "}" << std::endl;
+	benchUpload();
+	benchCreateBuffer();
+	benchCmdRecording();
+	benchSwapchainRecreation();
+	benchSceneUpdate();
+	benchLodSelect();
+	benchRenderQueue();
+	benchJobs();
+	benchFrames();
+	benchConcurrentRecording();
+	if (handler.lazyStartup.isDone())
+		emitStartup(handler.lazyStartup);
+	vkDeviceWaitIdle(handler.gpu->getLogicalDevice());
+}
+
+static bool	parseOptions(int argc, char** argv, K3BenchOptions& options)
+{
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--window") == 0)
+			options.headless = false;
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			options.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+			options.objects = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (strcmp(argv[i], "--fps-cap") == 0 && i + 1 < argc)
+			options.fpsCap = std::stod(argv[++i]);
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+			options.outPath = argv[++i];
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			options.replayPath = argv[++i];
+		else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc)
+			options.msaa = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (strcmp(argv[i], "--dynres") == 0 && i + 1 < argc)
+			options.dynresTarget = std::stod(argv[++i]);
+		else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+			options.lights = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (strcmp(argv[i], "--vsync") == 0)
+			options.vsync = true;
+		else {
+			std::cerr << "usage: " << argv[0] << " [--window] [--frames N] [--objects N] [--fps-cap N] [--out file] [--replay file] [--msaa N]"
+				<< " [--dynres MS] [--lights N] [--vsync]" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int			main(int argc, char** argv)
+{
+	K3BenchOptions		options;
+
+	if (!parseOptions(argc, argv, options))
+		return EXIT_FAILURE;
+
+	std::ofstream		outFile;
+	if (options.outPath) {
+		outFile.open(options.outPath);
+		if (!outFile.is_open()) {
+			std::cerr << "Failed to open " << options.outPath << " !" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	try {
+		VkHandler		k3Handler(options.headless);
+		K3Benchmark		bench(k3Handler, options, options.outPath ? outFile : std::cout);
+
+		k3Handler.setMsaaSamples(static_cast<VkSampleCountFlagBits>(options.msaa));
+		k3Handler.setDynamicResolution(options.dynresTarget);
+		k3Handler.setDisplaySync(options.vsync);
+
+		if (options.replayPath)
+			bench.replay();
+		else
+			bench.run();
+		k3Handler.terminate();
+	}
+	catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,59 @@
+#include "K3Archive.h"
+#include "K3JobSystem.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+/* Packs files into a K3Archive. Entries are named after their path, less the root when
+** they are under it : with --root set to the directory the engine loads from, the engine
+** finds every entry under the path it would have opened the loose file at.
+**
+** usage: K3_pack [--root dir] out.k3a files...
+*/
+
+int			main(int argc, char** argv)
+{
+	std::string		root;
+	int			first = 1;
+
+	if (argc > 2 && strcmp(argv[1], "--root") == 0) {
+		root = argv[2];
+		first = 3;
+	}
+	if (argc - first < 2) {
+		std::cerr << "usage: " << argv[0] << " [--root dir] out.k3a files..." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try {
+		K3ArchiveWriter				writer;
+		std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+		uint64_t				inputSize = 0;
+		uint64_t				outputSize;
+
+		K3JobSystem::getInstance().start();
+		for (int i = first + 1; i < argc; i++) {
+			std::string const	path = argv[i];
+			std::ifstream		file(path, std::ios::binary | std::ios::ate);
+			std::vector<char>	data;
+
+			if (!file.is_open())
+				throw std::runtime_error("Failed to open " + path + " !");
+			data.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(data.data(), static_cast<std::streamsize>(data.size()));
+			writer.add(!root.empty() && path.compare(0, root.size(), root) == 0 ? path.substr(root.size()) : path, data.data(), data.size());
+			inputSize += data.size();
+		}
+		outputSize = writer.write(argv[first]);
+		K3JobSystem::getInstance().stop();
+		std::cout << argv[first] << " : " << argc - first - 1 << " files, " << inputSize << " bytes packed in " << outputSize
+			<< " (" << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms)" << std::endl;
+	}
+	catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+#include "K3Allocator.h"
+
+////////////////////////////////////
+// FRAME ARENA
+////////////////////////////////////
+
+K3FrameArena::K3FrameArena(size_t capacity)
+{
+	buffer = static_cast<char*>(::operator new(capacity));
+	stats.capacity = capacity;
+}
+
+K3FrameArena::~K3FrameArena()
+{
+	::operator delete(buffer);
+}
+
+K3FrameArena&		K3FrameArena::getThreadArena()
+{
+	static thread_local K3FrameArena	threadArena;
+
+	return threadArena;
+}
+
+void*		K3FrameArena::allocate(size_t size, size_t alignment)
+{
+	uintptr_t	base = reinterpret_cast<uintptr_t>(buffer);
+	uintptr_t	aligned = (base + offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+	size_t		newOffset = static_cast<size_t>(aligned - base) + size;
+
+	stats.allocCount++;
+	if (newOffset > stats.capacity) {
+		// Out of space for this frame, the arena is resized on the next reset
+		stats.heapFallbacks++;
+		overflowBytes += size;
+		return ::operator new(size);
+	}
+	offset = newOffset;
+	stats.bytesUsed = offset;
+	if (offset > stats.peakBytes)
+		stats.peakBytes = offset;
+	return reinterpret_cast<void*>(aligned);
+}
+
+void		K3FrameArena::deallocate(void* ptr, size_t size)
+{
+	if (!ptr)
+		return;
+	if (!owns(ptr)) {
+		::operator delete(ptr);
+		return;
+	}
+	// Only the last allocation can be given back, this lets a growing vector reuse its space
+	if (static_cast<char*>(ptr) + size == buffer + offset) {
+		offset -= size;
+		stats.bytesUsed = offset;
+	}
+}
+
+void		K3FrameArena::reset()
+{
+	if (overflowBytes > 0) {
+		size_t	newCapacity = (stats.capacity + overflowBytes) * 2;
+
+		::operator delete(buffer);
+		buffer = static_cast<char*>(::operator new(newCapacity));
+		stats.capacity = newCapacity;
+		overflowBytes = 0;
+	}
+	offset = 0;
+	stats.bytesUsed = 0;
+	stats.allocCount = 0;
+	stats.heapFallbacks = 0;
+}
+
+size_t		K3FrameArena::getMarker() const
+{
+	return offset;
+}
+
+void		K3FrameArena::rewind(size_t const marker)
+{
+	// Back to an empty arena, this is a good time to grow if the arena overflowed
+	if (marker == 0) {
+		size_t	allocCount = stats.allocCount;
+
+		reset();
+		stats.allocCount = allocCount;
+		return;
+	}
+	if (marker < offset) {
+		offset = marker;
+		stats.bytesUsed = offset;
+	}
+}
+
+bool		K3FrameArena::owns(void const* ptr) const
+{
+	return ptr >= buffer && ptr < buffer + stats.capacity;
+}
+
+K3AllocatorStats const&		K3FrameArena::getStats() const
+{
+	return stats;
+}
+
+////////////////////////////////////
+// POOL ALLOCATOR
+////////////////////////////////////
+
+K3PoolAllocator::K3PoolAllocator(size_t blockSize, size_t blocksPerChunk)
+	: blocksPerChunk(blocksPerChunk > 0 ? blocksPerChunk : 1)
+{
+	size_t const	alignment = alignof(std::max_align_t);
+
+	if (blockSize < sizeof(FreeBlock))
+		blockSize = sizeof(FreeBlock);
+	this->blockSize = (blockSize + alignment - 1) & ~(alignment - 1);
+}
+
+K3PoolAllocator::~K3PoolAllocator()
+{
+	for (void* chunk : chunks) {
+		::operator delete(chunk);
+	}
+}
+
+void		K3PoolAllocator::grow()
+{
+	char*		chunk = static_cast<char*>(::operator new(blockSize * blocksPerChunk));
+
+	chunks.push_back(chunk);
+	stats.capacity += blockSize * blocksPerChunk;
+	stats.heapFallbacks++;
+	for (size_t i = blocksPerChunk; i > 0; i--) {
+		FreeBlock*	block = reinterpret_cast<FreeBlock*>(chunk + (i - 1) * blockSize);
+		block->next = freeList;
+		freeList = block;
+	}
+}
+
+void*		K3PoolAllocator::allocate()
+{
+	if (!freeList)
+		grow();
+
+	FreeBlock*	block = freeList;
+
+	freeList = block->next;
+	stats.allocCount++;
+	stats.bytesUsed += blockSize;
+	if (stats.bytesUsed > stats.peakBytes)
+		stats.peakBytes = stats.bytesUsed;
+	return block;
+}
+
+void		K3PoolAllocator::deallocate(void* ptr)
+{
+	if (!ptr)
+		return;
+
+	FreeBlock*	block = static_cast<FreeBlock*>(ptr);
+
+	block->next = freeList;
+	freeList = block;
+	stats.bytesUsed -= blockSize;
+}
+
+size_t		K3PoolAllocator::getBlockSize() const
+{
+	return blockSize;
+}
+
+K3AllocatorStats const&		K3PoolAllocator::getStats() const
+{
+	return stats;
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+# include <cstddef>
+# include <cstdint>
+# include <new>
+# include <vector>
+# include <utility>
+
+#define K3_FRAME_ARENA_SIZE	(1024 * 1024)
+#define K3_POOL_CHUNK_BLOCKS	64
+
+struct K3AllocatorStats
+{
+	size_t		capacity = 0;
+	size_t		bytesUsed = 0;
+	size_t		peakBytes = 0;
+	size_t		allocCount = 0;
+	size_t		heapFallbacks = 0;
+};
+
+/* Linear allocator for data that only lives for the duration of a frame (or of a
+** single call). Allocating is a pointer bump and nothing is ever freed individually,
+** the whole arena is rewound by reset(). Anything handed out by the arena must be
+** dead by the time reset() is called.
+** Every thread owns its own arena (see getThreadArena()) so there is no locking and
+** no contention on the global heap. getMarker() / rewind() give back everything allocated
+** since the marker, for scratch memory scoped to a call or a job. When the arena runs out it falls back on the heap
+** and grows on the next reset(), so the steady state settles to zero heap allocations.
+*/
+
+class K3FrameArena {
+
+public:
+
+	void*				allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	void				deallocate(void* ptr, size_t size);
+	void				reset();
+	bool				owns(void const* ptr) const;
+	size_t				getMarker() const;
+	void				rewind(size_t const marker);
+	K3AllocatorStats const&		getStats() const;
+	static K3FrameArena&		getThreadArena();
+
+	explicit K3FrameArena(size_t capacity = K3_FRAME_ARENA_SIZE);
+	~K3FrameArena();
+
+	K3FrameArena(K3FrameArena const&) = delete;
+	K3FrameArena&			operator=(K3FrameArena const&) = delete;
+
+private:
+
+	char*				buffer;
+	size_t				offset = 0;
+	size_t				overflowBytes = 0;
+	K3AllocatorStats		stats;
+
+};
+
+/* Fixed-size block allocator for engine objects that are created and destroyed often.
+** Blocks are carved out of chunks of K3_POOL_CHUNK_BLOCKS and recycled through an
+** intrusive free list, chunks are only released when the pool is destroyed.
+** A pool is not thread safe, it belongs to the system that owns the objects.
+*/
+
+class K3PoolAllocator {
+
+public:
+
+	void*				allocate();
+	void				deallocate(void* ptr);
+	size_t				getBlockSize() const;
+	K3AllocatorStats const&		getStats() const;
+
+	explicit K3PoolAllocator(size_t blockSize, size_t blocksPerChunk = K3_POOL_CHUNK_BLOCKS);
+	~K3PoolAllocator();
+
+	K3PoolAllocator(K3PoolAllocator const&) = delete;
+	K3PoolAllocator&		operator=(K3PoolAllocator const&) = delete;
+
+private:
+
+	struct FreeBlock
+	{
+		FreeBlock*	next;
+	};
+
+	void				grow();
+
+	size_t				blockSize;
+	size_t				blocksPerChunk;
+	FreeBlock*			freeList = nullptr;
+	std::vector<void*>		chunks;
+	K3AllocatorStats		stats;
+
+};
+
+template <typename T>
+class K3ObjectPool {
+
+public:
+
+	template <typename... Args>
+	T*				create(Args&&... args) {
+		return new (pool.allocate()) T(std::forward<Args>(args)...);
+	}
+
+	void				destroy(T* object) {
+		if (!object)
+			return;
+		object->~T();
+		pool.deallocate(object);
+	}
+
+	K3AllocatorStats const&		getStats() const {
+		return pool.getStats();
+	}
+
+	explicit K3ObjectPool(size_t blocksPerChunk = K3_POOL_CHUNK_BLOCKS)
+		: pool(sizeof(T) > sizeof(void*) ? sizeof(T) : sizeof(void*), blocksPerChunk) {}
+
+private:
+
+	K3PoolAllocator			pool;
+
+};
+
+////////////////////////////////////
+// STL ADAPTORS
+////////////////////////////////////
+
+/* Binds a container to a frame arena, the thread's own arena by default.
+** Containers using it must not outlive the current frame.
+*/
+
+template <typename T>
+class K3FrameStlAllocator {
+
+public:
+
+	typedef T	value_type;
+
+	T*				allocate(size_t n) {
+		return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void				deallocate(T* ptr, size_t n) {
+		arena->deallocate(ptr, n * sizeof(T));
+	}
+
+	K3FrameArena*			getArena() const {
+		return arena;
+	}
+
+	K3FrameStlAllocator() : arena(&K3FrameArena::getThreadArena()) {}
+	explicit K3FrameStlAllocator(K3FrameArena& frameArena) : arena(&frameArena) {}
+	template <typename U>
+	K3FrameStlAllocator(K3FrameStlAllocator<U> const& other) : arena(other.getArena()) {}
+
+private:
+
+	K3FrameArena*			arena;
+
+};
+
+template <typename T, typename U>
+bool		operator==(K3FrameStlAllocator<T> const& a, K3FrameStlAllocator<U> const& b)
+{
+	return a.getArena() == b.getArena();
+}
+
+template <typename T, typename U>
+bool		operator!=(K3FrameStlAllocator<T> const& a, K3FrameStlAllocator<U> const& b)
+{
+	return a.getArena() != b.getArena();
+}
+
+/* Serves single element allocations (the nodes of std::list, std::set, std::map...)
+** from a pool, anything that does not fit in a block goes to the heap.
+*/
+
+template <typename T>
+class K3PoolStlAllocator {
+
+public:
+
+	typedef T	value_type;
+
+	T*				allocate(size_t n) {
+		if (n == 1 && sizeof(T) <= pool->getBlockSize() && alignof(T) <= alignof(std::max_align_t))
+			return static_cast<T*>(pool->allocate());
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void				deallocate(T* ptr, size_t n) {
+		if (n == 1 && sizeof(T) <= pool->getBlockSize() && alignof(T) <= alignof(std::max_align_t))
+			pool->deallocate(ptr);
+		else
+			::operator delete(ptr);
+	}
+
+	K3PoolAllocator*		getPool() const {
+		return pool;
+	}
+
+	explicit K3PoolStlAllocator(K3PoolAllocator& blockPool) : pool(&blockPool) {}
+	template <typename U>
+	K3PoolStlAllocator(K3PoolStlAllocator<U> const& other) : pool(other.getPool()) {}
+
+private:
+
+	K3PoolAllocator*		pool;
+
+};
+
+template <typename T, typename U>
+bool		operator==(K3PoolStlAllocator<T> const& a, K3PoolStlAllocator<U> const& b)
+{
+	return a.getPool() == b.getPool();
+}
+
+template <typename T, typename U>
+bool		operator!=(K3PoolStlAllocator<T> const& a, K3PoolStlAllocator<U> const& b)
+{
+	return a.getPool() != b.getPool();
+}
+
+template <typename T>
+using K3FrameVector = std::vector<T, K3FrameStlAllocator<T>>;
@@ -0,0 +1,345 @@
+#include "K3Archive.h"
+#include "K3JobSystem.h"
+#include "K3Lz4.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#define K3_ARCHIVE_HEADER_SIZE	(5 * sizeof(uint32_t))
+
+static uint64_t		alignUp(uint64_t const value)
+{
+	return (value + K3_IO_ALIGNMENT - 1) / K3_IO_ALIGNMENT * K3_IO_ALIGNMENT;
+}
+
+static void		put32(std::vector<uint8_t>& out, uint32_t const value)
+{
+	for (uint32_t i = 0; i < 4; i++)
+		out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+static void		put64(std::vector<uint8_t>& out, uint64_t const value)
+{
+	for (uint32_t i = 0; i < 8; i++)
+		out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+// K3AsyncFile::allocate() memory released on every way out
+struct K3ReadBuffer
+{
+	void*		data = nullptr;
+
+	K3ReadBuffer() {}
+	~K3ReadBuffer() {
+		K3AsyncFile::release(data);
+	}
+
+	K3ReadBuffer(K3ReadBuffer const&) = delete;
+	K3ReadBuffer&	operator=(K3ReadBuffer const&) = delete;
+};
+
+// Bounds checked reads of the table of contents
+struct K3ArchiveCursor
+{
+	uint8_t const*	data;
+	size_t		size;
+	size_t		position;
+
+	bool		has(size_t const bytes) const {
+		return bytes <= size - position;
+	}
+	uint64_t	get(uint32_t const bytes) {
+		uint64_t	value = 0;
+
+		if (!has(bytes))
+			throw std::runtime_error("Truncated archive table of contents !");
+		for (uint32_t i = 0; i < bytes; i++)
+			value |= static_cast<uint64_t>(data[position + i]) << (8 * i);
+		position += bytes;
+		return value;
+	}
+};
+
+void		K3ArchiveWriter::add(std::string const& name, void const* data, size_t const size)
+{
+	uint8_t const* const	bytes = static_cast<uint8_t const*>(data);
+
+	// Reads are 32 bit sized, so is an entry's stored data
+	if (size > 0xFFFFFFFFu - K3_IO_ALIGNMENT)
+		throw std::runtime_error("Archive entry " + name + " is too large !");
+	for (Entry const& entry : entries) {
+		if (entry.name == name)
+			throw std::runtime_error("Archive entry " + name + " added twice !");
+	}
+	entries.push_back({ name, std::vector<uint8_t>(bytes, bytes + size) });
+}
+
+uint64_t	K3ArchiveWriter::write(std::string const& path) const
+{
+	struct Chunk
+	{
+		uint32_t		entry;
+		size_t			offset;
+		size_t			size;
+		std::vector<uint8_t>	stored;
+	};
+
+	std::vector<Chunk>		chunks;
+	std::vector<uint8_t>		table;
+	std::vector<uint64_t>		offsets(entries.size());
+	std::vector<uint64_t>		storedSizes(entries.size(), 0);
+	uint64_t			offset;
+
+	for (uint32_t entry = 0; entry < entries.size(); entry++) {
+		for (size_t start = 0; start < entries[entry].data.size(); start += K3_ARCHIVE_CHUNK_SIZE)
+			chunks.push_back({ entry, start, std::min<size_t>(K3_ARCHIVE_CHUNK_SIZE, entries[entry].data.size() - start), {} });
+	}
+	K3JobSystem::getInstance().parallelFor(0, static_cast<uint32_t>(chunks.size()), 1, [&](uint32_t first, uint32_t last) {
+		std::vector<uint8_t>	compressed(K3Lz4::getBound(K3_ARCHIVE_CHUNK_SIZE));
+
+		for (uint32_t i = first; i < last; i++) {
+			Chunk&			chunk = chunks[i];
+			uint8_t const* const	raw = entries[chunk.entry].data.data() + chunk.offset;
+			size_t const		size = K3Lz4::compress(raw, chunk.size, compressed.data(), compressed.size());
+
+			if (size > 0 && size < chunk.size)
+				chunk.stored.assign(compressed.begin(), compressed.begin() + size);
+			else
+				chunk.stored.assign(raw, raw + chunk.size);
+		}
+	});
+	for (Chunk const& chunk : chunks)
+		storedSizes[chunk.entry] += chunk.stored.size();
+
+	size_t		tableSize = K3_ARCHIVE_HEADER_SIZE + chunks.size() * sizeof(uint32_t);
+
+	for (Entry const& entry : entries)
+		tableSize += 2 * sizeof(uint64_t) + sizeof(uint32_t) + entry.name.size();
+	offset = alignUp(tableSize);
+	for (uint32_t entry = 0; entry < entries.size(); entry++) {
+		offsets[entry] = offset;
+		offset = alignUp(offset + storedSizes[entry]);
+	}
+
+	put32(table, K3_ARCHIVE_MAGIC);
+	put32(table, K3_ARCHIVE_VERSION);
+	put32(table, static_cast<uint32_t>(entries.size()));
+	put32(table, static_cast<uint32_t>(chunks.size()));
+	put32(table, static_cast<uint32_t>(tableSize));
+	for (uint32_t entry = 0; entry < entries.size(); entry++) {
+		put64(table, offsets[entry]);
+		put64(table, entries[entry].data.size());
+		put32(table, static_cast<uint32_t>(entries[entry].name.size()));
+		table.insert(table.end(), entries[entry].name.begin(), entries[entry].name.end());
+	}
+	for (Chunk const& chunk : chunks)
+		put32(table, static_cast<uint32_t>(chunk.stored.size()));
+
+	std::ofstream		out(path, std::ios::binary | std::ios::trunc);
+	std::vector<char> const	padding(K3_IO_ALIGNMENT, 0);
+	uint64_t		written = table.size();
+
+	if (!out.is_open())
+		throw std::runtime_error("Failed to open " + path + " for writing !");
+	out.write(reinterpret_cast<char const*>(table.data()), static_cast<std::streamsize>(table.size()));
+	for (size_t i = 0; i < chunks.size(); i++) {
+		if (i == 0 || chunks[i].entry != chunks[i - 1].entry) {
+			out.write(padding.data(), static_cast<std::streamsize>(offsets[chunks[i].entry] - written));
+			written = offsets[chunks[i].entry];
+		}
+		out.write(reinterpret_cast<char const*>(chunks[i].stored.data()), static_cast<std::streamsize>(chunks[i].stored.size()));
+		written += chunks[i].stored.size();
+	}
+	out.write(padding.data(), static_cast<std::streamsize>(alignUp(written) - written));
+	written = alignUp(written);
+	if (!out.good())
+		throw std::runtime_error("Failed to write " + path + " !");
+	return written;
+}
+
+/* One read for the header and the table in the common case, a second one when the table
+** does not fit in the first K3_IO_ALIGNMENT bytes. Everything the loads rely on is checked
+** here : entry ranges inside the file, chunk sizes consistent with the entry sizes.
+*/
+
+bool		K3Archive::open(std::string const& path, std::string const& rootPath)
+{
+	K3ReadBuffer		buffer;
+	K3ReadRequest		request = { 0, K3_IO_ALIGNMENT, nullptr };
+	uint64_t		tableSize;
+	uint64_t		entryCount;
+	uint64_t		chunkCount;
+	uint64_t		fileSize;
+
+	close();
+	if (!file.open(path, true))
+		return false;
+	root = rootPath;
+	fileSize = file.getSize();
+	if (fileSize < K3_IO_ALIGNMENT || fileSize % K3_IO_ALIGNMENT != 0)
+		throw std::runtime_error("Not an archive : " + path + " !");
+	buffer.data = K3AsyncFile::allocate(K3_IO_ALIGNMENT);
+	request.buffer = buffer.data;
+	file.read(&request, 1, [](uint32_t) {});
+
+	K3ArchiveCursor		cursor = { static_cast<uint8_t const*>(buffer.data), K3_IO_ALIGNMENT, 0 };
+
+	if (cursor.get(4) != K3_ARCHIVE_MAGIC)
+		throw std::runtime_error("Not an archive : " + path + " !");
+	if (cursor.get(4) != K3_ARCHIVE_VERSION)
+		throw std::runtime_error("Unsupported archive version in " + path + " !");
+	entryCount = cursor.get(4);
+	chunkCount = cursor.get(4);
+	tableSize = cursor.get(4);
+	// Counts a corrupted header could inflate are checked against what the table can hold
+	if (tableSize < K3_ARCHIVE_HEADER_SIZE || alignUp(tableSize) > fileSize
+		|| entryCount * (2 * sizeof(uint64_t) + sizeof(uint32_t)) + chunkCount * sizeof(uint32_t) > tableSize)
+		throw std::runtime_error("Corrupted archive " + path + " !");
+	entries.resize(entryCount);
+	if (tableSize > K3_IO_ALIGNMENT) {
+		K3ReadBuffer	table;
+
+		table.data = K3AsyncFile::allocate(alignUp(tableSize));
+		request.size = static_cast<uint32_t>(alignUp(tableSize));
+		request.buffer = table.data;
+		file.read(&request, 1, [](uint32_t) {});
+		std::swap(buffer.data, table.data);
+		cursor.data = static_cast<uint8_t const*>(buffer.data);
+	}
+	cursor.size = tableSize;
+
+	uint32_t	firstChunk = 0;
+
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		Entry&		entry = entries[i];
+		size_t		nameLength;
+
+		entry.offset = cursor.get(8);
+		entry.size = cursor.get(8);
+		nameLength = cursor.get(4);
+		if (!cursor.has(nameLength))
+			throw std::runtime_error("Corrupted archive " + path + " !");
+		entry.name.assign(reinterpret_cast<char const*>(cursor.data + cursor.position), nameLength);
+		cursor.position += nameLength;
+		if (entry.size > (chunkCount - firstChunk) * K3_ARCHIVE_CHUNK_SIZE || !names.emplace(entry.name, i).second)
+			throw std::runtime_error("Corrupted archive " + path + " !");
+		entry.firstChunk = firstChunk;
+		entry.chunkCount = static_cast<uint32_t>((entry.size + K3_ARCHIVE_CHUNK_SIZE - 1) / K3_ARCHIVE_CHUNK_SIZE);
+		firstChunk += entry.chunkCount;
+	}
+	if (firstChunk != chunkCount || !cursor.has(chunkCount * sizeof(uint32_t)))
+		throw std::runtime_error("Corrupted archive " + path + " !");
+	chunkSizes.resize(chunkCount);
+	chunkOffsets.resize(chunkCount);
+	for (Entry& entry : entries) {
+		entry.storedSize = 0;
+		for (uint32_t chunk = 0; chunk < entry.chunkCount; chunk++) {
+			uint64_t const	rawSize = std::min<uint64_t>(K3_ARCHIVE_CHUNK_SIZE, entry.size - uint64_t(chunk) * K3_ARCHIVE_CHUNK_SIZE);
+
+			chunkSizes[entry.firstChunk + chunk] = static_cast<uint32_t>(cursor.get(4));
+			chunkOffsets[entry.firstChunk + chunk] = entry.storedSize;
+			if (chunkSizes[entry.firstChunk + chunk] == 0 || chunkSizes[entry.firstChunk + chunk] > rawSize)
+				throw std::runtime_error("Corrupted archive " + path + " !");
+			entry.storedSize += chunkSizes[entry.firstChunk + chunk];
+		}
+		if (entry.offset % K3_IO_ALIGNMENT != 0 || entry.offset < alignUp(tableSize) || entry.offset > fileSize
+			|| alignUp(entry.storedSize) > fileSize - entry.offset || alignUp(entry.storedSize) > 0xFFFFFFFFu)
+			throw std::runtime_error("Corrupted archive " + path + " !");
+	}
+	return true;
+}
+
+void		K3Archive::close()
+{
+	file.close();
+	entries.clear();
+	names.clear();
+	chunkSizes.clear();
+	chunkOffsets.clear();
+}
+
+bool		K3Archive::isOpen() const
+{
+	return file.isOpen();
+}
+
+uint32_t	K3Archive::find(std::string const& path) const
+{
+	bool const	underRoot = !root.empty() && path.compare(0, root.size(), root) == 0;
+	auto const	found = names.find(underRoot ? path.substr(root.size()) : path);
+
+	return found != names.end() ? found->second : K3_ARCHIVE_NONE;
+}
+
+bool		K3Archive::exists(std::string const& path) const
+{
+	return find(path) != K3_ARCHIVE_NONE || std::ifstream(path).good();
+}
+
+uint32_t	K3Archive::getEntryCount() const
+{
+	return static_cast<uint32_t>(entries.size());
+}
+
+std::string const&	K3Archive::getName(uint32_t const entry) const
+{
+	return entries[entry].name;
+}
+
+uint64_t	K3Archive::getSize(uint32_t const entry) const
+{
+	return entries[entry].size;
+}
+
+K3AsyncFile const&	K3Archive::getFile() const
+{
+	return file;
+}
+
+// Chunks are independent, a large entry is spread over the workers
+void		K3Archive::decompress(Entry const& entry, uint8_t const* stored, uint8_t* destination) const
+{
+	K3JobSystem::getInstance().parallelFor(0, entry.chunkCount, 1, [&](uint32_t first, uint32_t last) {
+		for (uint32_t chunk = first; chunk < last; chunk++) {
+			uint64_t const		start = uint64_t(chunk) * K3_ARCHIVE_CHUNK_SIZE;
+			size_t const		rawSize = static_cast<size_t>(std::min<uint64_t>(K3_ARCHIVE_CHUNK_SIZE, entry.size - start));
+			uint32_t const		storedSize = chunkSizes[entry.firstChunk + chunk];
+			uint8_t const* const	source = stored + chunkOffsets[entry.firstChunk + chunk];
+
+			if (storedSize == rawSize)
+				std::memcpy(destination + start, source, rawSize);
+			else if (!K3Lz4::decompress(source, storedSize, destination + start, rawSize))
+				throw std::runtime_error("Corrupted chunk in archive entry " + entry.name + " !");
+		}
+	});
+}
+
+/* The whole batch's stored data is held at once, in direct I/O buffers the reads land in.
+** Empty entries need no read.
+*/
+
+void		K3Archive::load(K3ArchiveRequest const* requests, uint32_t const count)
+{
+	std::vector<K3ReadRequest>	reads;
+	std::vector<uint32_t>		readRequests;
+	std::vector<K3ReadBuffer>	buffers(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (requests[i].entry >= entries.size())
+			throw std::runtime_error("No such archive entry !");
+
+		Entry const&	entry = entries[requests[i].entry];
+
+		if (entry.storedSize == 0)
+			continue;
+		buffers[i].data = K3AsyncFile::allocate(alignUp(entry.storedSize));
+		reads.push_back({ entry.offset, static_cast<uint32_t>(alignUp(entry.storedSize)), buffers[i].data });
+		readRequests.push_back(i);
+	}
+	file.read(reads.data(), static_cast<uint32_t>(reads.size()), [&](uint32_t const read) {
+		K3ArchiveRequest const&	request = requests[readRequests[read]];
+
+		decompress(entries[request.entry], static_cast<uint8_t const*>(reads[read].buffer), static_cast<uint8_t*>(request.destination));
+	});
+}
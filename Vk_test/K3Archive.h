@@ -0,0 +1,114 @@
+#pragma once
+
+# include <cstdint>
+# include <string>
+# include <unordered_map>
+# include <vector>
+# include "K3AsyncIo.h"
+
+#define K3_ARCHIVE_MAGIC	0x5241334Bu
+#define K3_ARCHIVE_VERSION	1
+// Uncompressed size of a chunk, the unit of compression and of parallel decompression
+#define K3_ARCHIVE_CHUNK_SIZE	(64 * 1024)
+#define K3_ARCHIVE_NONE		0xFFFFFFFFu
+
+/* Packed assets, so that loading them is one file open and a batch of reads instead of an
+** open per file. Little endian, laid out for direct I/O :
+** - header : magic, version, entry count, chunk count and the size of the header and table
+**   of contents together (5 x u32), the table right after it so that both usually come in
+**   with the first aligned read :
+**   per entry its data offset and uncompressed size (u64 each), name length (u32) and name,
+**   then the stored size (u32) of every chunk, entry after entry.
+** - entry data, each entry starting on a K3_IO_ALIGNMENT boundary, its chunks back to back.
+**   A chunk is K3_ARCHIVE_CHUNK_SIZE bytes of the entry (the last one what remains),
+**   LZ4 compressed (K3Lz4) unless that did not make it smaller : a stored size equal to
+**   the chunk size means a raw chunk.
+** The file is padded to K3_IO_ALIGNMENT so no aligned read goes past its end.
+*/
+
+// Where load() writes an entry, getSize() bytes, any memory the caller has mapped (staging)
+struct K3ArchiveRequest
+{
+	uint32_t	entry;
+	void*		destination;
+};
+
+class K3ArchiveWriter {
+
+public:
+
+	void				add(std::string const& name, void const* data, size_t const size);
+	// Compresses the chunks on the job system, returns the file size
+	uint64_t			write(std::string const& path) const;
+
+	K3ArchiveWriter() {}
+	~K3ArchiveWriter() {}
+
+	K3ArchiveWriter(K3ArchiveWriter const&) = delete;
+	K3ArchiveWriter&		operator=(K3ArchiveWriter const&) = delete;
+
+private:
+
+	struct Entry
+	{
+		std::string		name;
+		std::vector<uint8_t>	data;
+	};
+
+	std::vector<Entry>		entries;
+
+};
+
+/* The table of contents is read and checked when the archive is opened, entries are then
+** looked up by the path they would have as loose files : root followed by their name.
+** load() reads every requested entry in one batch (K3AsyncFile), each entry's chunks being
+** decompressed by the job system as soon as its read lands, straight to its destination.
+*/
+
+class K3Archive {
+
+public:
+
+	// False when there is no file at path, throws when it is not a valid archive
+	bool				open(std::string const& path, std::string const& rootPath = std::string());
+	void				close();
+	bool				isOpen() const;
+	// K3_ARCHIVE_NONE when the path is not in the archive
+	uint32_t			find(std::string const& path) const;
+	// In the archive or as a loose file
+	bool				exists(std::string const& path) const;
+	uint32_t			getEntryCount() const;
+	std::string const&		getName(uint32_t const entry) const;
+	uint64_t			getSize(uint32_t const entry) const;
+	void				load(K3ArchiveRequest const* requests, uint32_t const count);
+	K3AsyncFile const&		getFile() const;
+
+	K3Archive() {}
+	~K3Archive() {}
+
+	K3Archive(K3Archive const&) = delete;
+	K3Archive&			operator=(K3Archive const&) = delete;
+
+private:
+
+	struct Entry
+	{
+		std::string	name;
+		uint64_t	offset;
+		uint64_t	size;
+		uint64_t	storedSize;
+		uint32_t	firstChunk;
+		uint32_t	chunkCount;
+	};
+
+	void				decompress(Entry const& entry, uint8_t const* stored, uint8_t* destination) const;
+
+	K3AsyncFile			file;
+	std::string			root;
+	std::vector<Entry>		entries;
+	std::unordered_map<std::string, uint32_t>	names;
+	std::vector<uint32_t>		chunkSizes;
+	// Start of each chunk in its entry's stored data
+	std::vector<uint64_t>		chunkOffsets;
+
+};
@@ -0,0 +1,381 @@
+#include "K3AsyncIo.h"
+#include "K3JobSystem.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+# endif
+# include <windows.h>
+# include <malloc.h>
+#else
+# include <fcntl.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#ifdef K3_IO_URING
+# include <linux/io_uring.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <sys/uio.h>
+// Same numbers on every architecture but alpha, older C libraries do not name them
+# ifndef __NR_io_uring_setup
+#  define __NR_io_uring_setup	425
+# endif
+# ifndef __NR_io_uring_enter
+#  define __NR_io_uring_enter	426
+# endif
+#endif
+
+bool		K3AsyncFile::open(std::string const& filePath, bool const directIo)
+{
+	close();
+	path = filePath;
+	direct = directIo;
+#ifdef _WIN32
+	handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		direct ? FILE_FLAG_NO_BUFFERING : FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE && direct) {
+		direct = false;
+		handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	}
+	if (handle == INVALID_HANDLE_VALUE) {
+		handle = nullptr;
+		if (GetLastError() == ERROR_FILE_NOT_FOUND || GetLastError() == ERROR_PATH_NOT_FOUND)
+			return false;
+		throw std::runtime_error("Failed to open " + path + " !");
+	}
+
+	LARGE_INTEGER	fileSize;
+
+	if (!GetFileSizeEx(handle, &fileSize)) {
+		close();
+		throw std::runtime_error("Failed to read the size of " + path + " !");
+	}
+	size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+# ifdef O_DIRECT
+	fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | (direct ? O_DIRECT : 0));
+# else
+	direct = false;
+	fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+# endif
+	// tmpfs and some network file systems refuse O_DIRECT
+	if (fd < 0 && direct) {
+		direct = false;
+		fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	}
+	if (fd < 0 && errno == ENOENT)
+		return false;
+	if (fd < 0)
+		throw std::runtime_error("Failed to open " + path + " !");
+
+	struct stat	status;
+
+	if (fstat(fd, &status) != 0) {
+		close();
+		throw std::runtime_error("Failed to read the size of " + path + " !");
+	}
+	size = static_cast<uint64_t>(status.st_size);
+#endif
+#ifdef K3_IO_URING
+	if (!setupRing())
+		destroyRing();
+#endif
+	return true;
+}
+
+void		K3AsyncFile::close()
+{
+#ifdef K3_IO_URING
+	destroyRing();
+#endif
+#ifdef _WIN32
+	if (handle)
+		CloseHandle(handle);
+	handle = nullptr;
+#else
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+#endif
+	size = 0;
+}
+
+bool		K3AsyncFile::isOpen() const
+{
+#ifdef _WIN32
+	return handle != nullptr;
+#else
+	return fd >= 0;
+#endif
+}
+
+bool		K3AsyncFile::isDirect() const
+{
+	return direct;
+}
+
+bool		K3AsyncFile::isUsingIoUring() const
+{
+#ifdef K3_IO_URING
+	return ringFd >= 0;
+#else
+	return false;
+#endif
+}
+
+uint64_t	K3AsyncFile::getSize() const
+{
+	return size;
+}
+
+void*		K3AsyncFile::allocate(size_t const bytes)
+{
+	size_t const	rounded = (bytes + K3_IO_ALIGNMENT - 1) / K3_IO_ALIGNMENT * K3_IO_ALIGNMENT;
+#ifdef _WIN32
+	void* const	buffer = _aligned_malloc(rounded, K3_IO_ALIGNMENT);
+#else
+	void* const	buffer = std::aligned_alloc(K3_IO_ALIGNMENT, rounded);
+#endif
+
+	if (!buffer && rounded > 0)
+		throw std::runtime_error("Failed to allocate a read buffer !");
+	return buffer;
+}
+
+void		K3AsyncFile::release(void* const buffer)
+{
+#ifdef _WIN32
+	_aligned_free(buffer);
+#else
+	std::free(buffer);
+#endif
+}
+
+// Blocking positioned read, safe from any number of threads at once
+void		K3AsyncFile::readAt(K3ReadRequest const& request) const
+{
+	uint8_t* const	buffer = static_cast<uint8_t*>(request.buffer);
+	uint32_t	done = 0;
+
+	while (done < request.size) {
+#ifdef _WIN32
+		uint64_t const	offset = request.offset + done;
+		OVERLAPPED	overlapped = {};
+		DWORD		got = 0;
+
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		if (!ReadFile(handle, buffer + done, request.size - done, &got, &overlapped) || got == 0)
+			throw std::runtime_error("Failed to read " + path + " !");
+#else
+		ssize_t const	got = pread(fd, buffer + done, request.size - done, static_cast<off_t>(request.offset + done));
+
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			throw std::runtime_error("Failed to read " + path + " !");
+#endif
+		done += static_cast<uint32_t>(got);
+	}
+}
+
+void		K3AsyncFile::read(K3ReadRequest const* requests, uint32_t const count, std::function<void(uint32_t)> const& completed)
+{
+	K3JobSystem&		jobs = K3JobSystem::getInstance();
+	K3JobCounter		counter;
+
+	if (count == 0)
+		return;
+#ifdef K3_IO_URING
+	if (ringFd >= 0) {
+		readRing(requests, count, completed);
+		return;
+	}
+#endif
+	for (uint32_t i = 0; i < count; i++) {
+		jobs.run([this, requests, &completed, i]() {
+			readAt(requests[i]);
+			completed(i);
+		}, &counter);
+	}
+	jobs.wait(counter);
+}
+
+#ifdef K3_IO_URING
+
+/* Plain interrupt driven ring (no SQPOLL, no registered files or buffers) : a batch is a
+** few submissions, nothing worth a kernel thread. Fails on kernels without io_uring and
+** where it is filtered out (containers), the reads then fall back to the job system.
+*/
+
+bool		K3AsyncFile::setupRing()
+{
+	io_uring_params		params;
+
+	std::memset(&params, 0, sizeof(params));
+	ringFd = static_cast<int>(syscall(__NR_io_uring_setup, K3_IO_QUEUE_DEPTH, &params));
+	if (ringFd < 0)
+		return false;
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+	sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED) {
+		sqRing = nullptr;
+		return false;
+	}
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		cqRing = sqRing;
+	else {
+		cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+		if (cqRing == MAP_FAILED) {
+			cqRing = nullptr;
+			return false;
+		}
+	}
+	sqEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+	sqEntries = mmap(nullptr, sqEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+	if (sqEntries == MAP_FAILED) {
+		sqEntries = nullptr;
+		return false;
+	}
+
+	uint8_t* const	sq = static_cast<uint8_t*>(sqRing);
+	uint8_t* const	cq = static_cast<uint8_t*>(cqRing);
+
+	sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+	sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+	sqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+	cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+	cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+	cqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+	cqEntries = cq + params.cq_off.cqes;
+	return true;
+}
+
+void		K3AsyncFile::destroyRing()
+{
+	if (sqEntries)
+		munmap(sqEntries, sqEntriesSize);
+	if (cqRing && cqRing != sqRing)
+		munmap(cqRing, cqRingSize);
+	if (sqRing)
+		munmap(sqRing, sqRingSize);
+	if (ringFd >= 0)
+		::close(ringFd);
+	ringFd = -1;
+	sqRing = nullptr;
+	cqRing = nullptr;
+	sqEntries = nullptr;
+}
+
+/* Keeps up to K3_IO_QUEUE_DEPTH reads in flight, each completion hands its request to a
+** worker and frees a slot for the next read. Short reads go back in the queue for the rest.
+** After an error nothing more is queued, the reads in flight are still waited for since
+** they write to the caller's buffers.
+*/
+
+void		K3AsyncFile::readRing(K3ReadRequest const* requests, uint32_t const count, std::function<void(uint32_t)> const& completed)
+{
+	K3JobSystem&		jobs = K3JobSystem::getInstance();
+	K3JobCounter		counter;
+	std::vector<iovec>	vectors(count);
+	std::vector<uint32_t>	done(count, 0);
+	std::vector<uint32_t>	queue(count);
+	io_uring_sqe* const	sqes = static_cast<io_uring_sqe*>(sqEntries);
+	io_uring_cqe* const	cqes = static_cast<io_uring_cqe*>(cqEntries);
+	size_t			next = 0;
+	uint32_t		inFlight = 0;
+	uint32_t		unsubmitted = 0;
+	bool			ringBroken = false;
+	std::string		error;
+
+	for (uint32_t i = 0; i < count; i++) {
+		vectors[i].iov_base = requests[i].buffer;
+		vectors[i].iov_len = requests[i].size;
+		queue[i] = i;
+	}
+	while (inFlight > 0 || (error.empty() && next < queue.size())) {
+		uint32_t	tail = *sqTail;
+
+		while (error.empty() && next < queue.size() && inFlight < K3_IO_QUEUE_DEPTH) {
+			uint32_t const		request = queue[next++];
+			io_uring_sqe&		sqe = sqes[tail & sqMask];
+
+			std::memset(&sqe, 0, sizeof(sqe));
+			sqe.opcode = IORING_OP_READV;
+			sqe.fd = fd;
+			sqe.addr = reinterpret_cast<uint64_t>(&vectors[request]);
+			sqe.len = 1;
+			sqe.off = requests[request].offset + done[request];
+			sqe.user_data = request;
+			sqArray[tail & sqMask] = tail & sqMask;
+			tail++;
+			inFlight++;
+			unsubmitted++;
+		}
+		__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+		int const	consumed = static_cast<int>(syscall(__NR_io_uring_enter, ringFd, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+
+		if (consumed >= 0)
+			unsubmitted -= static_cast<uint32_t>(consumed);
+		else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+			// What the kernel did not take never completes, a ring failing twice may not complete anything
+			if (error.empty())
+				error = "Failed to submit reads of " + path + " : " + std::strerror(errno) + " !";
+			inFlight -= unsubmitted;
+			unsubmitted = 0;
+			if (ringBroken || inFlight == 0) {
+				ringBroken = true;
+				break;
+			}
+			ringBroken = true;
+		}
+
+		uint32_t	head = *cqHead;
+		uint32_t const	completedTail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+		for (; head != completedTail; head++) {
+			io_uring_cqe const&	cqe = cqes[head & cqMask];
+			uint32_t const		request = static_cast<uint32_t>(cqe.user_data);
+
+			inFlight--;
+			if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+				queue.push_back(request);
+			else if (cqe.res <= 0) {
+				if (error.empty())
+					error = "Failed to read " + path + (cqe.res < 0 ? std::string(" : ") + std::strerror(-cqe.res) : std::string()) + " !";
+			}
+			else if ((done[request] += static_cast<uint32_t>(cqe.res)) < requests[request].size) {
+				vectors[request].iov_base = static_cast<uint8_t*>(requests[request].buffer) + done[request];
+				vectors[request].iov_len = requests[request].size - done[request];
+				queue.push_back(request);
+			}
+			else {
+				jobs.run([&completed, request]() {
+					completed(request);
+				}, &counter);
+			}
+		}
+		__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+	}
+	if (ringBroken)
+		destroyRing();
+	jobs.wait(counter);
+	if (!error.empty())
+		throw std::runtime_error(error);
+}
+
+#endif
@@ -0,0 +1,100 @@
+#pragma once
+
+# include <cstddef>
+# include <cstdint>
+# include <functional>
+# include <string>
+# include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  define K3_IO_URING
+# endif
+#endif
+
+// Offsets, sizes and buffers of direct reads are multiples of it, the largest common sector size
+#define K3_IO_ALIGNMENT		4096
+// Reads in flight at once in the io_uring submission queue
+#define K3_IO_QUEUE_DEPTH	64
+
+// A read of size bytes at offset, both K3_IO_ALIGNMENT aligned for direct I/O, as is buffer
+struct K3ReadRequest
+{
+	uint64_t	offset;
+	uint32_t	size;
+	void*		buffer;
+};
+
+/* One file read in batches : every read of a batch is queued at once, so a high latency
+** storage (network mounts) pays its round trip once per batch instead of once per read.
+** On Linux the reads go through io_uring (raw syscalls, no liburing), submitted and reaped
+** from the calling thread, each completed read handed to the job system right away. Without
+** io_uring (older kernels, seccomp, other systems) every read is a job of its own doing a
+** positioned read, the queue depth being the number of workers.
+** Direct I/O skips the page cache, assets are read once and copied out anyway.
+*/
+
+class K3AsyncFile {
+
+public:
+
+	// Direct I/O when asked for and the file system has it, buffered otherwise. False when there is no such file
+	bool				open(std::string const& path, bool const direct);
+	void				close();
+	bool				isOpen() const;
+	bool				isDirect() const;
+	bool				isUsingIoUring() const;
+	uint64_t			getSize() const;
+	/* Reads every request, completed(index) runs on a job system worker as soon as its
+	** read is done, and may run jobs of its own. Returns once the reads and the completions
+	** are all done, then throws the first error of either.
+	*/
+	void				read(K3ReadRequest const* requests, uint32_t const count, std::function<void(uint32_t)> const& completed);
+
+	// K3_IO_ALIGNMENT aligned, for the buffers of direct reads
+	static void*			allocate(size_t const size);
+	static void			release(void* const buffer);
+
+	K3AsyncFile() {}
+	~K3AsyncFile() {
+		close();
+	}
+
+	K3AsyncFile(K3AsyncFile const&) = delete;
+	K3AsyncFile&			operator=(K3AsyncFile const&) = delete;
+
+private:
+
+	void				readAt(K3ReadRequest const& request) const;
+#ifdef K3_IO_URING
+	bool				setupRing();
+	void				destroyRing();
+	void				readRing(K3ReadRequest const* requests, uint32_t const count, std::function<void(uint32_t)> const& completed);
+
+	// Mappings shared with the kernel, the ring indices in them are read and written atomically
+	int				ringFd = -1;
+	void*				sqRing = nullptr;
+	void*				cqRing = nullptr;
+	void*				sqEntries = nullptr;
+	size_t				sqRingSize = 0;
+	size_t				cqRingSize = 0;
+	size_t				sqEntriesSize = 0;
+	uint32_t*			sqTail = nullptr;
+	uint32_t*			sqArray = nullptr;
+	uint32_t			sqMask = 0;
+	uint32_t*			cqHead = nullptr;
+	uint32_t*			cqTail = nullptr;
+	uint32_t			cqMask = 0;
+	void*				cqEntries = nullptr;
+#endif
+
+#ifdef _WIN32
+	void*				handle = nullptr;
+#else
+	int				fd = -1;
+#endif
+	std::string			path;
+	uint64_t			size = 0;
+	bool				direct = false;
+
+};
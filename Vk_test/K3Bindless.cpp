@@ -0,0 +1,189 @@
+#include "K3Bindless.h"
+
+// What VkGPU enabled, it only enables these all together
+bool		K3Bindless::isSupported(VkPhysicalDeviceDescriptorIndexingFeaturesEXT const& features)
+{
+	return features.runtimeDescriptorArray && features.descriptorBindingPartiallyBound
+		&& features.descriptorBindingSampledImageUpdateAfterBind && features.descriptorBindingStorageBufferUpdateAfterBind
+		&& features.shaderSampledImageArrayNonUniformIndexing;
+}
+
+void		K3Bindless::init(VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuDevice)
+{
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT	indexingProperties = {};
+	VkPhysicalDeviceProperties2			properties2 = {};
+
+	device = gpuDevice;
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(gpuPDevice, &properties2);
+	// Combined image samplers count against both the sampler and the sampled image limits
+	slots[K3_BINDLESS_TEXTURE].capacity = std::min({ static_cast<uint32_t>(K3_BINDLESS_TEXTURES),
+		indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		indexingProperties.maxDescriptorSetUpdateAfterBindSamplers, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages });
+	slots[K3_BINDLESS_BUFFER].capacity = std::min({ static_cast<uint32_t>(K3_BINDLESS_BUFFERS),
+		indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers, indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+
+	VkDescriptorSetLayoutBinding	bindings[K3_BINDLESS_KIND_COUNT] = {};
+	bindings[K3_BINDLESS_TEXTURE].binding = K3_BINDLESS_TEXTURE;
+	bindings[K3_BINDLESS_TEXTURE].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[K3_BINDLESS_TEXTURE].descriptorCount = slots[K3_BINDLESS_TEXTURE].capacity;
+	bindings[K3_BINDLESS_TEXTURE].stageFlags = VK_SHADER_STAGE_ALL;
+	bindings[K3_BINDLESS_BUFFER].binding = K3_BINDLESS_BUFFER;
+	bindings[K3_BINDLESS_BUFFER].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[K3_BINDLESS_BUFFER].descriptorCount = slots[K3_BINDLESS_BUFFER].capacity;
+	bindings[K3_BINDLESS_BUFFER].stageFlags = VK_SHADER_STAGE_ALL;
+
+	VkDescriptorBindingFlagsEXT		bindingFlags[K3_BINDLESS_KIND_COUNT] = {
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT,
+		VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+	};
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT	bindingFlagsInfo = {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = K3_BINDLESS_KIND_COUNT;
+	bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo	layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = K3_BINDLESS_KIND_COUNT;
+	layoutInfo.pBindings = bindings;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create bindless descriptor set layout !");
+
+	VkDescriptorPoolSize		poolSizes[K3_BINDLESS_KIND_COUNT] = {};
+	poolSizes[K3_BINDLESS_TEXTURE].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[K3_BINDLESS_TEXTURE].descriptorCount = slots[K3_BINDLESS_TEXTURE].capacity;
+	poolSizes[K3_BINDLESS_BUFFER].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[K3_BINDLESS_BUFFER].descriptorCount = slots[K3_BINDLESS_BUFFER].capacity;
+
+	VkDescriptorPoolCreateInfo	poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = K3_BINDLESS_KIND_COUNT;
+	poolInfo.pPoolSizes = poolSizes;
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create bindless descriptor pool !");
+
+	VkDescriptorSetAllocateInfo	allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+	if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate bindless descriptor set !");
+}
+
+uint32_t	K3Bindless::allocateSlot(K3BindlessKind const kind)
+{
+	SlotList&	list = slots[kind];
+	uint32_t	slot;
+
+	if (!list.freeSlots.empty()) {
+		slot = list.freeSlots.back();
+		list.freeSlots.pop_back();
+	}
+	else if (list.next < list.capacity)
+		slot = list.next++;
+	else
+		throw std::runtime_error(kind == K3_BINDLESS_TEXTURE ? "Out of bindless texture slots !" : "Out of bindless buffer slots !");
+	list.used++;
+	return slot;
+}
+
+void		K3Bindless::freeSlot(K3BindlessKind const kind, uint32_t const slot)
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	slots[kind].freeSlots.push_back(slot);
+	slots[kind].used--;
+}
+
+// The slot is written right away, pending command buffers may have the set bound
+uint32_t	K3Bindless::addTexture(VkImageView const view, VkSampler const sampler, VkImageLayout const layout)
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+	uint32_t const			slot = allocateSlot(K3_BINDLESS_TEXTURE);
+
+	VkDescriptorImageInfo		imageInfo = {};
+	imageInfo.sampler = sampler;
+	imageInfo.imageView = view;
+	imageInfo.imageLayout = layout;
+
+	VkWriteDescriptorSet		write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = K3_BINDLESS_TEXTURE;
+	write.dstArrayElement = slot;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	return slot;
+}
+
+uint32_t	K3Bindless::addBuffer(VkBuffer const buffer, VkDeviceSize const offset, VkDeviceSize const range)
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+	uint32_t const			slot = allocateSlot(K3_BINDLESS_BUFFER);
+
+	VkDescriptorBufferInfo		bufferInfo = {};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = range;
+
+	VkWriteDescriptorSet		write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = K3_BINDLESS_BUFFER;
+	write.dstArrayElement = slot;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &bufferInfo;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	return slot;
+}
+
+/* The descriptor stays as it is until the slot is reused, partially bound lets it dangle
+** once the resource is destroyed. The frames submitted up to now may still read it.
+*/
+
+void		K3Bindless::release(K3BindlessKind const kind, uint32_t const slot, K3DeletionQueue& retired, uint64_t const frame)
+{
+	if (slot == K3_BINDLESS_NONE)
+		return;
+	retired.push(frame, [this, kind, slot]() { freeSlot(kind, slot); });
+}
+
+// Only once the device is idle, the retired queue must have been flushed first
+void		K3Bindless::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+	vkDestroyDescriptorPool(device, pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	pool = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+	set = VK_NULL_HANDLE;
+	device = VK_NULL_HANDLE;
+}
+
+VkDescriptorSetLayout const&	K3Bindless::getSetLayout() const
+{
+	return setLayout;
+}
+
+VkDescriptorSet const&		K3Bindless::getSet() const
+{
+	return set;
+}
+
+uint32_t	K3Bindless::getUsedCount(K3BindlessKind const kind) const
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	return slots[kind].used;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+# include "K3Vk.h"
+# include "K3DeletionQueue.h"
+# include <mutex>
+
+// Slots of the global set, lowered to the device limits
+#define K3_BINDLESS_TEXTURES	4096
+#define K3_BINDLESS_BUFFERS	1024
+// Slot index meaning "no resource", what a material without texture holds
+#define K3_BINDLESS_NONE	0xFFFFFFFFu
+
+enum K3BindlessKind
+{
+	K3_BINDLESS_TEXTURE = 0,
+	K3_BINDLESS_BUFFER = 1,
+	K3_BINDLESS_KIND_COUNT = 2
+};
+
+/* One global descriptor set (VK_EXT_descriptor_indexing) holding every texture (binding 0,
+** combined image samplers) and storage buffer (binding 1) of the renderer. Shaders index
+** them with the slot numbers handed out here, found in push constants or buffers, so the
+** set is bound once per command buffer whatever the draws use.
+** The bindings are update after bind and partially bound : slots are written and released
+** while recorded command buffers still use the set, as long as the pending frames do not
+** read them. A released slot only goes back to its free list once the frames that may
+** still read it are done. Slots can be taken from any thread.
+*/
+
+class K3Bindless {
+
+public:
+
+	static bool			isSupported(VkPhysicalDeviceDescriptorIndexingFeaturesEXT const& features);
+	void				init(VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuDevice);
+	uint32_t			addTexture(VkImageView const view, VkSampler const sampler, VkImageLayout const layout);
+	uint32_t			addBuffer(VkBuffer const buffer, VkDeviceSize const offset = 0, VkDeviceSize const range = VK_WHOLE_SIZE);
+	void				release(K3BindlessKind const kind, uint32_t const slot, K3DeletionQueue& retired, uint64_t const frame);
+	void				destroy();
+	VkDescriptorSetLayout const&	getSetLayout() const;
+	VkDescriptorSet const&		getSet() const;
+	uint32_t			getUsedCount(K3BindlessKind const kind) const;
+
+	K3Bindless() {}
+	~K3Bindless() {}
+
+	K3Bindless(K3Bindless const&) = delete;
+	K3Bindless&			operator=(K3Bindless const&) = delete;
+
+private:
+
+	// Never used slots start at next, released ones are reused first
+	struct SlotList
+	{
+		std::vector<uint32_t>	freeSlots;
+		uint32_t		next = 0;
+		uint32_t		capacity = 0;
+		uint32_t		used = 0;
+	};
+
+	uint32_t			allocateSlot(K3BindlessKind const kind);
+	void				freeSlot(K3BindlessKind const kind, uint32_t const slot);
+
+	VkDevice			device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout		setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool		pool = VK_NULL_HANDLE;
+	VkDescriptorSet			set = VK_NULL_HANDLE;
+	SlotList			slots[K3_BINDLESS_KIND_COUNT];
+	mutable std::mutex		mutex;
+
+};
@@ -0,0 +1,302 @@
+#include "K3Capture.h"
+#include "K3Scene.h"
+
+void		K3CaptureWriter::open(std::string const& path)
+{
+	uint32_t const	header[2] = { K3_CAPTURE_MAGIC, K3_CAPTURE_VERSION };
+
+	close();
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error("Failed to open capture file " + path + " !");
+	buffer.clear();
+	buffer.insert(buffer.end(), reinterpret_cast<uint8_t const*>(header), reinterpret_cast<uint8_t const*>(header + 2));
+	frameEnd = buffer.size();
+	frameCount = 0;
+}
+
+// Commands after the last frame are dropped, replay only sees whole frames
+void		K3CaptureWriter::close()
+{
+	if (!file.is_open())
+		return;
+	flush();
+	file.close();
+	buffer.clear();
+}
+
+bool		K3CaptureWriter::isOpen() const
+{
+	return file.is_open();
+}
+
+void		K3CaptureWriter::writeVarint(uint32_t value)
+{
+	while (value >= 0x80) {
+		buffer.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back(static_cast<uint8_t>(value));
+}
+
+void		K3CaptureWriter::writeFloats(float const* values, uint32_t const count)
+{
+	uint8_t const*	bytes = reinterpret_cast<uint8_t const*>(values);
+
+	buffer.insert(buffer.end(), bytes, bytes + count * sizeof(float));
+}
+
+// Up to the last frame boundary, what follows stays in the buffer
+void		K3CaptureWriter::flush()
+{
+	if (frameEnd == 0)
+		return;
+	file.write(reinterpret_cast<char const*>(buffer.data()), static_cast<std::streamsize>(frameEnd));
+	buffer.erase(buffer.begin(), buffer.begin() + frameEnd);
+	frameEnd = 0;
+}
+
+// Parent K3_NO_PARENT is written as 0, any other as its index plus one
+void		K3CaptureWriter::createNode(uint32_t const parent)
+{
+	buffer.push_back(K3_CAPTURE_CREATE_NODE);
+	writeVarint(parent == K3_NO_PARENT ? 0 : parent + 1);
+}
+
+void		K3CaptureWriter::setTranslation(uint32_t const node, glm::vec3 const& translation)
+{
+	buffer.push_back(K3_CAPTURE_TRANSLATION);
+	writeVarint(node);
+	writeFloats(&translation.x, 3);
+}
+
+void		K3CaptureWriter::setRotation(uint32_t const node, glm::quat const& rotation)
+{
+	float const	values[4] = { rotation.w, rotation.x, rotation.y, rotation.z };
+
+	buffer.push_back(K3_CAPTURE_ROTATION);
+	writeVarint(node);
+	writeFloats(values, 4);
+}
+
+void		K3CaptureWriter::setScale(uint32_t const node, glm::vec3 const& scale)
+{
+	buffer.push_back(K3_CAPTURE_SCALE);
+	writeVarint(node);
+	writeFloats(&scale.x, 3);
+}
+
+void		K3CaptureWriter::setMaterial(uint32_t const node, uint32_t const material)
+{
+	buffer.push_back(K3_CAPTURE_MATERIAL);
+	writeVarint(node);
+	writeVarint(material);
+}
+
+void		K3CaptureWriter::createMaterial(glm::vec4 const& color, bool const textured)
+{
+	buffer.push_back(K3_CAPTURE_CREATE_MATERIAL);
+	writeFloats(&color.x, 4);
+	buffer.push_back(textured ? 1 : 0);
+}
+
+// Type byte, then the floats in the order of K3Light
+void		K3CaptureWriter::setLight(uint32_t const light, K3Light const& value)
+{
+	buffer.push_back(K3_CAPTURE_LIGHT);
+	writeVarint(light);
+	buffer.push_back(static_cast<uint8_t>(value.type));
+	writeFloats(&value.position.x, 3);
+	writeFloats(&value.radius, 1);
+	writeFloats(&value.color.x, 3);
+	writeFloats(&value.intensity, 1);
+	writeFloats(&value.direction.x, 3);
+	writeFloats(&value.outerCos, 1);
+	writeFloats(&value.innerCos, 1);
+}
+
+void		K3CaptureWriter::setAmbientLight(glm::vec3 const& color)
+{
+	buffer.push_back(K3_CAPTURE_AMBIENT_LIGHT);
+	writeFloats(&color.x, 3);
+}
+
+void		K3CaptureWriter::frame()
+{
+	buffer.push_back(K3_CAPTURE_FRAME);
+	frameEnd = buffer.size();
+	frameCount++;
+	if (buffer.size() >= K3_CAPTURE_FLUSH_SIZE)
+		flush();
+}
+
+uint32_t	K3CaptureWriter::getFrameCount() const
+{
+	return frameCount;
+}
+
+/* The file is checked whole when opened : every command complete and known, so replay
+** can not fail half way through a benchmark.
+*/
+
+void		K3CaptureReader::open(std::string const& path)
+{
+	std::ifstream	file(path, std::ios::binary | std::ios::ate);
+	uint32_t	header[2];
+
+	if (!file.is_open())
+		throw std::runtime_error("Failed to open capture file " + path + " !");
+	data.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	if (data.size() < sizeof(header))
+		throw std::runtime_error("Not a capture file : " + path + " !");
+	std::memcpy(header, data.data(), sizeof(header));
+	if (header[0] != K3_CAPTURE_MAGIC)
+		throw std::runtime_error("Not a capture file : " + path + " !");
+	if (header[1] == 0 || header[1] > K3_CAPTURE_VERSION)
+		throw std::runtime_error("Unsupported capture version in " + path + " !");
+
+	frameCount = 0;
+	position = sizeof(header);
+	while (position < data.size()) {
+		uint8_t const	op = data[position++];
+
+		if (op == K3_CAPTURE_CREATE_NODE)
+			readVarint();
+		else if (op == K3_CAPTURE_TRANSLATION || op == K3_CAPTURE_SCALE || op == K3_CAPTURE_ROTATION) {
+			readVarint();
+			position += (op == K3_CAPTURE_ROTATION ? 4 : 3) * sizeof(float);
+		}
+		else if (op == K3_CAPTURE_MATERIAL) {
+			readVarint();
+			readVarint();
+		}
+		else if (op == K3_CAPTURE_CREATE_MATERIAL)
+			position += 4 * sizeof(float) + 1;
+		else if (op == K3_CAPTURE_LIGHT) {
+			readVarint();
+			position += 1 + K3_CAPTURE_LIGHT_FLOATS * sizeof(float);
+		}
+		else if (op == K3_CAPTURE_AMBIENT_LIGHT)
+			position += 3 * sizeof(float);
+		else if (op == K3_CAPTURE_FRAME)
+			frameCount++;
+		else
+			throw std::runtime_error("Corrupted capture file " + path + " !");
+		if (position > data.size())
+			throw std::runtime_error("Truncated capture file " + path + " !");
+	}
+	rewind();
+}
+
+// The scene has to be emptied by the caller, the material mapping starts over
+void		K3CaptureReader::rewind()
+{
+	position = 2 * sizeof(uint32_t);
+	materials.assign(1, 0);
+}
+
+uint32_t	K3CaptureReader::readVarint()
+{
+	uint32_t	value = 0;
+
+	for (uint32_t shift = 0; shift < 35; shift += 7) {
+		if (position >= data.size())
+			throw std::runtime_error("Truncated capture file !");
+
+		uint8_t const	byte = data[position++];
+
+		value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+	throw std::runtime_error("Corrupted capture file !");
+}
+
+void		K3CaptureReader::readFloats(float* values, uint32_t const count)
+{
+	std::memcpy(values, data.data() + position, count * sizeof(float));
+	position += count * sizeof(float);
+}
+
+bool		K3CaptureReader::readFrame(K3Scene& scene, MaterialFactory const& createMaterial)
+{
+	float		values[K3_CAPTURE_LIGHT_FLOATS];
+	uint32_t	node = 0;
+	uint32_t	material;
+	K3Light		light;
+
+	while (position < data.size()) {
+		uint8_t const	op = data[position++];
+
+		// The commands on a node are the first ones of K3CaptureOp
+		if (op < K3_CAPTURE_CREATE_MATERIAL) {
+			node = readVarint();
+			if (op != K3_CAPTURE_CREATE_NODE && node >= scene.getNodeCount())
+				throw std::runtime_error("Capture uses a node it never created !");
+		}
+		switch (op) {
+			// The parent is stored plus one, 0 for none
+			case K3_CAPTURE_CREATE_NODE:
+				if (node > scene.getNodeCount())
+					throw std::runtime_error("Capture parents a node to one it never created !");
+				scene.createNode(node == 0 ? K3_NO_PARENT : node - 1);
+				break;
+			case K3_CAPTURE_TRANSLATION:
+				readFloats(values, 3);
+				scene.setTranslation(node, glm::vec3(values[0], values[1], values[2]));
+				break;
+			case K3_CAPTURE_ROTATION:
+				readFloats(values, 4);
+				scene.setRotation(node, glm::quat(values[0], values[1], values[2], values[3]));
+				break;
+			case K3_CAPTURE_SCALE:
+				readFloats(values, 3);
+				scene.setScale(node, glm::vec3(values[0], values[1], values[2]));
+				break;
+			case K3_CAPTURE_MATERIAL:
+				material = readVarint();
+				if (material >= materials.size())
+					throw std::runtime_error("Capture uses a material it never created !");
+				scene.setMaterial(node, materials[material]);
+				break;
+			case K3_CAPTURE_CREATE_MATERIAL:
+				readFloats(values, 4);
+				materials.push_back(createMaterial(glm::vec4(values[0], values[1], values[2], values[3]), data[position++] != 0));
+				break;
+			case K3_CAPTURE_LIGHT:
+				node = readVarint();
+				if (node > scene.getLightCount())
+					throw std::runtime_error("Capture sets a light it never created !");
+				if (data[position] != K3_LIGHT_POINT && data[position] != K3_LIGHT_SPOT)
+					throw std::runtime_error("Capture uses an unknown light type !");
+				light.type = static_cast<K3LightType>(data[position++]);
+				readFloats(values, K3_CAPTURE_LIGHT_FLOATS);
+				light.position = glm::vec3(values[0], values[1], values[2]);
+				light.radius = values[3];
+				light.color = glm::vec3(values[4], values[5], values[6]);
+				light.intensity = values[7];
+				light.direction = glm::vec3(values[8], values[9], values[10]);
+				light.outerCos = values[11];
+				light.innerCos = values[12];
+				if (node == scene.getLightCount())
+					scene.createLight(light);
+				else
+					scene.setLight(node, light);
+				break;
+			case K3_CAPTURE_AMBIENT_LIGHT:
+				readFloats(values, 3);
+				scene.setAmbientLight(glm::vec3(values[0], values[1], values[2]));
+				break;
+			case K3_CAPTURE_FRAME:
+				return true;
+		}
+	}
+	return false;
+}
+
+uint32_t	K3CaptureReader::getFrameCount() const
+{
+	return frameCount;
+}
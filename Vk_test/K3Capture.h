@@ -0,0 +1,122 @@
+#pragma once
+
+# include <glm/glm.hpp>
+# include <glm/gtc/quaternion.hpp>
+# include <cstdint>
+# include <cstring>
+# include <fstream>
+# include <functional>
+# include <stdexcept>
+# include <string>
+# include <vector>
+
+#define K3_CAPTURE_MAGIC	0x5043334Bu
+// Version 2 added the lights, earlier captures are still read
+#define K3_CAPTURE_VERSION	2
+// Buffered commands written out at the next frame past this size
+#define K3_CAPTURE_FLUSH_SIZE	(1 << 20)
+// Floats of a light command, every member of K3Light but its type
+#define K3_CAPTURE_LIGHT_FLOATS	13
+
+class K3Scene;
+struct K3Light;
+
+/* Engine level command stream : what the simulation did to the scene and the material
+** table, cut in frames at every publication to the renderer. Replaying it rebuilds the
+** same scene states frame after frame without the application, its assets or its input.
+** The renderer derives everything else (uploads, draws, state) from those states.
+** Commands are one opcode byte, node, material and light indices as LEB128 varints, floats as
+** they are in memory (little endian). Texture contents are not captured, a textured
+** material only keeps the fact that it was.
+*/
+
+enum K3CaptureOp : uint8_t
+{
+	K3_CAPTURE_CREATE_NODE = 1,
+	K3_CAPTURE_TRANSLATION,
+	K3_CAPTURE_ROTATION,
+	K3_CAPTURE_SCALE,
+	K3_CAPTURE_MATERIAL,
+	K3_CAPTURE_CREATE_MATERIAL,
+	K3_CAPTURE_FRAME,
+	K3_CAPTURE_LIGHT,
+	K3_CAPTURE_AMBIENT_LIGHT
+};
+
+class K3CaptureWriter {
+
+public:
+
+	void				open(std::string const& path);
+	void				close();
+	bool				isOpen() const;
+	void				createNode(uint32_t const parent);
+	void				setTranslation(uint32_t const node, glm::vec3 const& translation);
+	void				setRotation(uint32_t const node, glm::quat const& rotation);
+	void				setScale(uint32_t const node, glm::vec3 const& scale);
+	void				setMaterial(uint32_t const node, uint32_t const material);
+	void				createMaterial(glm::vec4 const& color, bool const textured);
+	// A light index past the last one creates it
+	void				setLight(uint32_t const light, K3Light const& value);
+	void				setAmbientLight(glm::vec3 const& color);
+	void				frame();
+	uint32_t			getFrameCount() const;
+
+	K3CaptureWriter() {}
+	~K3CaptureWriter() {
+		close();
+	}
+
+	K3CaptureWriter(K3CaptureWriter const&) = delete;
+	K3CaptureWriter&		operator=(K3CaptureWriter const&) = delete;
+
+private:
+
+	void				writeVarint(uint32_t value);
+	void				writeFloats(float const* values, uint32_t const count);
+	void				flush();
+
+	std::ofstream			file;
+	std::vector<uint8_t>		buffer;
+	// Buffer size at the end of the last frame, only that much is ever written out
+	size_t				frameEnd = 0;
+	uint32_t			frameCount = 0;
+
+};
+
+/* Reads a whole capture up front, replay does no file access. Material indices are
+** remapped to those the replaying renderer hands out, node indices come out the same
+** as long as the replay starts from an empty scene.
+*/
+
+class K3CaptureReader {
+
+public:
+
+	// Creates a material in the replaying renderer, returns its index
+	typedef std::function<uint32_t(glm::vec4 const&, bool const textured)>	MaterialFactory;
+
+	void				open(std::string const& path);
+	// Applies the commands of the next frame, false once the capture is over
+	bool				readFrame(K3Scene& scene, MaterialFactory const& createMaterial);
+	void				rewind();
+	uint32_t			getFrameCount() const;
+
+	K3CaptureReader() {}
+	~K3CaptureReader() {}
+
+	K3CaptureReader(K3CaptureReader const&) = delete;
+	K3CaptureReader&		operator=(K3CaptureReader const&) = delete;
+
+private:
+
+	uint32_t			readVarint();
+	void				readFloats(float* values, uint32_t const count);
+
+	std::vector<uint8_t>		data;
+	size_t				position = 0;
+	uint32_t			frameCount = 0;
+	// Captured material index to replayed one, material 0 being everyone's default
+	std::vector<uint32_t>		materials;
+
+};
@@ -0,0 +1,216 @@
+#include "K3CommandCache.h"
+#include "K3JobSystem.h"
+
+void		K3CommandCache::init(VkDevice const& gpuDevice)
+{
+	device = gpuDevice;
+}
+
+// Created on first use, stale and empty until given draws
+uint32_t	K3CommandCache::getBucket(uint64_t const key)
+{
+	auto		found = bucketKeys.find(key);
+
+	if (found != bucketKeys.end())
+		return found->second;
+	buckets.emplace_back();
+	bucketKeys.emplace(key, static_cast<uint32_t>(buckets.size() - 1));
+	return static_cast<uint32_t>(buckets.size() - 1);
+}
+
+void		K3CommandCache::invalidate(uint32_t const bucket)
+{
+	if (bucket != K3_BUCKET_NONE)
+		buckets[bucket].generation++;
+}
+
+void		K3CommandCache::invalidateAll()
+{
+	for (Bucket& bucket : buckets)
+		bucket.generation++;
+}
+
+// Of a stale bucket, before record(). A bucket without draws has no buffers
+void		K3CommandCache::setDrawCount(uint32_t const bucket, uint32_t const drawCount)
+{
+	buckets[bucket].drawCount = drawCount;
+}
+
+uint32_t	K3CommandCache::getDrawCount(uint32_t const bucket) const
+{
+	return buckets[bucket].drawCount;
+}
+
+bool		K3CommandCache::isStale() const
+{
+	for (Bucket const& bucket : buckets) {
+		if (bucket.generation != bucket.recordedGeneration)
+			return true;
+	}
+	return false;
+}
+
+bool		K3CommandCache::isStale(uint32_t const bucket) const
+{
+	return bucket != K3_BUCKET_NONE && buckets[bucket].generation != buckets[bucket].recordedGeneration;
+}
+
+/* Records the stale buckets for every framebuffer, one job per bucket and image. Returns
+** how many buckets were recorded. The buffers continue the render pass, viewport, scissor
+** and descriptor sets are not inherited and are up to the recorder.
+*/
+
+uint32_t	K3CommandCache::record(VkRenderPass const renderPass, std::vector<VkFramebuffer> const& framebuffers,
+				std::vector<VkCommandPool> const& threadPools, Recorder const& recorder,
+				K3DeletionQueue& retired, uint64_t const frame)
+{
+	uint32_t const			imageCount = static_cast<uint32_t>(framebuffers.size());
+	std::vector<uint32_t>		stale;
+	std::vector<VkCommandBuffer>	oldBuffers;
+	std::vector<VkCommandPool>	oldPools;
+
+	for (uint32_t i = 0; i < buckets.size(); i++) {
+		Bucket&		bucket = buckets[i];
+
+		if (bucket.generation == bucket.recordedGeneration && bucket.buffers.size() == imageCount)
+			continue;
+		for (size_t image = 0; image < bucket.buffers.size(); image++) {
+			if (bucket.buffers[image] == VK_NULL_HANDLE)
+				continue;
+			oldBuffers.push_back(bucket.buffers[image]);
+			oldPools.push_back(bucket.pools[image]);
+		}
+		bucket.buffers.assign(imageCount, VK_NULL_HANDLE);
+		bucket.pools.assign(imageCount, VK_NULL_HANDLE);
+		bucket.stats = {};
+		bucket.recordedGeneration = bucket.generation;
+		if (bucket.drawCount > 0)
+			stale.push_back(i);
+	}
+	if (!oldBuffers.empty()) {
+		VkDevice const	gpuDevice = device;
+
+		retired.push(frame, [gpuDevice, oldBuffers, oldPools]() {
+			for (size_t i = 0; i < oldBuffers.size(); i++)
+				vkFreeCommandBuffers(gpuDevice, oldPools[i], 1, &oldBuffers[i]);
+		});
+	}
+
+	K3JobSystem::getInstance().parallelFor(0, static_cast<uint32_t>(stale.size()) * imageCount, 1, [&](uint32_t first, uint32_t last) {
+		uint32_t const	threadIndex = K3JobSystem::getThreadIndex();
+
+		if (threadIndex >= threadPools.size())
+			throw std::runtime_error("Recording from a thread without a command pool !");
+		for (uint32_t job = first; job < last; job++) {
+			Bucket&		bucket = buckets[stale[job / imageCount]];
+			uint32_t const	image = job % imageCount;
+
+			VkCommandBufferAllocateInfo		cmdBuffInfo = {};
+			cmdBuffInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			cmdBuffInfo.commandPool = threadPools[threadIndex];
+			cmdBuffInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			cmdBuffInfo.commandBufferCount = 1;
+			if (vkAllocateCommandBuffers(device, &cmdBuffInfo, &bucket.buffers[image]) != VK_SUCCESS)
+				throw std::runtime_error("failed to allocate secondary command buffers");
+			bucket.pools[image] = cmdBuffInfo.commandPool;
+
+			VkCommandBufferInheritanceInfo		inheritanceInfo = {};
+			inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			inheritanceInfo.renderPass = renderPass;
+			inheritanceInfo.subpass = 0;
+			inheritanceInfo.framebuffer = framebuffers[image];
+
+			VkCommandBufferBeginInfo		beginInfo = {};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+			beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+			vkBeginCommandBuffer(bucket.buffers[image], &beginInfo);
+			K3BindStats const	stats = recorder(bucket.buffers[image], image, stale[job / imageCount]);
+			if (vkEndCommandBuffer(bucket.buffers[image]) != VK_SUCCESS)
+				throw std::runtime_error("failed to record secondary command buffer !");
+			// Every image records the same draws
+			if (image == 0)
+				bucket.stats = stats;
+		}
+	});
+	updateExecuted(imageCount);
+	return static_cast<uint32_t>(stale.size());
+}
+
+void		K3CommandCache::updateExecuted(uint32_t const imageCount)
+{
+	executed.resize(imageCount);
+	for (uint32_t image = 0; image < imageCount; image++) {
+		executed[image].clear();
+		for (Bucket const& bucket : buckets) {
+			if (image < bucket.buffers.size() && bucket.buffers[image] != VK_NULL_HANDLE)
+				executed[image].push_back(bucket.buffers[image]);
+		}
+	}
+}
+
+// Inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+void		K3CommandCache::execute(VkCommandBuffer const primary, uint32_t const image) const
+{
+	if (image < executed.size() && !executed[image].empty())
+		vkCmdExecuteCommands(primary, static_cast<uint32_t>(executed[image].size()), executed[image].data());
+}
+
+// When the render pass or framebuffers the buffers were recorded against go away
+void		K3CommandCache::retire(K3DeletionQueue& retired, uint64_t const frame)
+{
+	VkDevice const			gpuDevice = device;
+	std::vector<VkCommandBuffer>	oldBuffers;
+	std::vector<VkCommandPool>	oldPools;
+
+	for (Bucket& bucket : buckets) {
+		for (size_t image = 0; image < bucket.buffers.size(); image++) {
+			if (bucket.buffers[image] == VK_NULL_HANDLE)
+				continue;
+			oldBuffers.push_back(bucket.buffers[image]);
+			oldPools.push_back(bucket.pools[image]);
+		}
+		bucket.buffers.clear();
+		bucket.pools.clear();
+		bucket.generation++;
+	}
+	executed.clear();
+	retired.push(frame, [gpuDevice, oldBuffers, oldPools]() {
+		for (size_t i = 0; i < oldBuffers.size(); i++)
+			vkFreeCommandBuffers(gpuDevice, oldPools[i], 1, &oldBuffers[i]);
+	});
+}
+
+// Only once the device is idle, the buckets stay and are recorded again on the next record()
+void		K3CommandCache::destroy()
+{
+	for (Bucket& bucket : buckets) {
+		for (size_t image = 0; image < bucket.buffers.size(); image++) {
+			if (bucket.buffers[image] != VK_NULL_HANDLE)
+				vkFreeCommandBuffers(device, bucket.pools[image], 1, &bucket.buffers[image]);
+		}
+		bucket.buffers.clear();
+		bucket.pools.clear();
+		bucket.generation++;
+	}
+	executed.clear();
+}
+
+uint32_t	K3CommandCache::getBucketCount() const
+{
+	return static_cast<uint32_t>(buckets.size());
+}
+
+// Binds of one image's buckets, each bucket starts from nothing bound
+K3BindStats	K3CommandCache::getBindStats() const
+{
+	K3BindStats	total;
+
+	for (Bucket const& bucket : buckets) {
+		total.pipelineBinds += bucket.stats.pipelineBinds;
+		total.vertexBinds += bucket.stats.vertexBinds;
+		total.indexBinds += bucket.stats.indexBinds;
+	}
+	return total;
+}
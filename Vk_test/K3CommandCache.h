@@ -0,0 +1,71 @@
+#pragma once
+
+# include "K3Vk.h"
+# include "K3DeletionQueue.h"
+# include "K3RenderQueue.h"
+# include <unordered_map>
+
+// Bucket of a draw that was never assigned one
+#define K3_BUCKET_NONE		0xFFFFFFFFu
+
+/* Secondary command buffers cached per render bucket and swapchain image. A bucket is a
+** group of draws sharing their state (K3RenderQueue::getBucketKey), its buffers are only
+** recorded again once invalidated : its draws changed, or something they baked in did.
+** Buckets keep their index for the lifetime of the cache, the owner maps its draws to them.
+** A bucket recorded again gets new buffers, the old ones are retired, so the primary command
+** buffers executing them must be recorded again as well. Stale buckets are recorded over the
+** job system, every thread allocating from its own pool.
+*/
+
+class K3CommandCache {
+
+public:
+
+	// Records one image's draws of a bucket inside the render pass, returns what it bound
+	typedef std::function<K3BindStats(VkCommandBuffer const, uint32_t const image, uint32_t const bucket)>	Recorder;
+
+	void				init(VkDevice const& gpuDevice);
+	uint32_t			getBucket(uint64_t const key);
+	void				invalidate(uint32_t const bucket);
+	void				invalidateAll();
+	void				setDrawCount(uint32_t const bucket, uint32_t const drawCount);
+	uint32_t			getDrawCount(uint32_t const bucket) const;
+	bool				isStale() const;
+	bool				isStale(uint32_t const bucket) const;
+	uint32_t			record(VkRenderPass const renderPass, std::vector<VkFramebuffer> const& framebuffers,
+						std::vector<VkCommandPool> const& threadPools, Recorder const& recorder,
+						K3DeletionQueue& retired, uint64_t const frame);
+	void				execute(VkCommandBuffer const primary, uint32_t const image) const;
+	void				retire(K3DeletionQueue& retired, uint64_t const frame);
+	void				destroy();
+	uint32_t			getBucketCount() const;
+	K3BindStats			getBindStats() const;
+
+	K3CommandCache() {}
+	~K3CommandCache() {}
+
+	K3CommandCache(K3CommandCache const&) = delete;
+	K3CommandCache&			operator=(K3CommandCache const&) = delete;
+
+private:
+
+	// One buffer per swapchain image, recorded at generation recordedGeneration
+	struct Bucket
+	{
+		uint32_t			generation = 1;
+		uint32_t			recordedGeneration = 0;
+		uint32_t			drawCount = 0;
+		std::vector<VkCommandBuffer>	buffers;
+		std::vector<VkCommandPool>	pools;
+		K3BindStats			stats;
+	};
+
+	void				updateExecuted(uint32_t const imageCount);
+
+	VkDevice			device = VK_NULL_HANDLE;
+	std::vector<Bucket>		buckets;
+	std::unordered_map<uint64_t, uint32_t>	bucketKeys;
+	// What each image's primary command buffer executes, in bucket order
+	std::vector<std::vector<VkCommandBuffer>>	executed;
+
+};
@@ -0,0 +1,40 @@
+#include "K3DeletionQueue.h"
+
+void		K3DeletionQueue::push(uint64_t const frame, std::function<void()> const& destroy,
+						std::function<bool()> const& ready)
+{
+	entries.push_back({ frame, destroy, ready });
+}
+
+// Entries are destroyed in the order they were pushed, a swapchain goes after its framebuffers
+void		K3DeletionQueue::flush(uint64_t const completedFrames)
+{
+	size_t		kept = 0;
+
+	for (size_t i = 0; i < entries.size(); i++) {
+		Entry&		entry = entries[i];
+
+		if (entry.frame <= completedFrames && (!entry.ready || entry.ready()))
+			entry.destroy();
+		else {
+			if (kept != i)
+				entries[kept] = std::move(entry);
+			kept++;
+		}
+	}
+	entries.resize(kept);
+}
+
+// Only once the device is idle
+void		K3DeletionQueue::flushAll()
+{
+	for (Entry& entry : entries) {
+		entry.destroy();
+	}
+	entries.clear();
+}
+
+size_t		K3DeletionQueue::getPendingCount() const
+{
+	return entries.size();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+# include <cstdint>
+# include <functional>
+# include <vector>
+
+/* Defers the destruction of GPU objects until the frames that may still use them are done.
+** An object is pushed with the number of the first frame that can no longer reference it,
+** and destroyed by the first flush() whose completed frame count reaches that number.
+** An optional ready check can hold an entry back further (a present that has not reached
+** the screen yet), entries behind it are still destroyed.
+*/
+
+class K3DeletionQueue {
+
+public:
+
+	void				push(uint64_t const frame, std::function<void()> const& destroy,
+							std::function<bool()> const& ready = nullptr);
+	void				flush(uint64_t const completedFrames);
+	void				flushAll();
+	size_t				getPendingCount() const;
+
+	K3DeletionQueue() {}
+	~K3DeletionQueue() {}
+
+	K3DeletionQueue(K3DeletionQueue const&) = delete;
+	K3DeletionQueue&		operator=(K3DeletionQueue const&) = delete;
+
+private:
+
+	struct Entry
+	{
+		uint64_t		frame;
+		std::function<void()>	destroy;
+		std::function<bool()>	ready;
+	};
+
+	std::vector<Entry>		entries;
+
+};
@@ -0,0 +1,67 @@
+#include "K3DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+// 0 turns the scaling off, the scale goes back to K3_DYNRES_MAX_SCALE
+void		K3DynamicResolution::setTarget(double const ms)
+{
+	target = ms;
+	reset();
+}
+
+double		K3DynamicResolution::getTarget() const
+{
+	return target;
+}
+
+void		K3DynamicResolution::reset()
+{
+	scale = K3_DYNRES_MAX_SCALE;
+	scaledAverage = 0.0;
+	fixedAverage = 0.0;
+	sinceChange = 0;
+	underBudget = 0;
+}
+
+bool		K3DynamicResolution::update(double const scaledMs, double const fixedMs)
+{
+	if (target <= 0.0)
+		return false;
+	// The averages restart with every scale, measurements of another scale say nothing of this one
+	if (sinceChange++ == 0) {
+		scaledAverage = scaledMs;
+		fixedAverage = fixedMs;
+	}
+	else {
+		scaledAverage += (scaledMs - scaledAverage) * K3_DYNRES_SMOOTHING;
+		fixedAverage += (fixedMs - fixedAverage) * K3_DYNRES_SMOOTHING;
+	}
+	if (scaledAverage + fixedAverage < target * K3_DYNRES_HEADROOM)
+		underBudget++;
+	else
+		underBudget = 0;
+	if (sinceChange < K3_DYNRES_SETTLE_FRAMES)
+		return false;
+
+	bool const	over = scaledMs + fixedMs > target;
+	double const	room = std::max(target * K3_DYNRES_HEADROOM - fixedAverage, 0.0);
+	double		wanted = scaledAverage > 0.0 ? scale * std::sqrt(room / scaledAverage) : K3_DYNRES_MAX_SCALE;
+
+	wanted = std::floor(wanted / K3_DYNRES_STEP) * K3_DYNRES_STEP;
+	wanted = std::min(std::max(wanted, K3_DYNRES_MIN_SCALE), K3_DYNRES_MAX_SCALE);
+	if (wanted < scale && !over && scaledAverage + fixedAverage <= target)
+		return false;
+	if (wanted > scale && underBudget < K3_DYNRES_RAISE_FRAMES)
+		return false;
+	if (wanted == scale)
+		return false;
+	scale = wanted;
+	sinceChange = 0;
+	underBudget = 0;
+	return true;
+}
+
+double		K3DynamicResolution::getScale() const
+{
+	return scale;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+# include <cstdint>
+
+// Render scale bounds, the scale applies to both axes
+#define K3_DYNRES_MIN_SCALE		0.5
+#define K3_DYNRES_MAX_SCALE		1.0
+// Scales are multiples of this, so small variations of the GPU time do not change it
+#define K3_DYNRES_STEP			(1.0 / 16.0)
+// Share of the target the GPU time is brought to, room for frames heavier than the average
+#define K3_DYNRES_HEADROOM		0.85
+// Frames without a change after any change, the measurements lag by the frames in flight
+#define K3_DYNRES_SETTLE_FRAMES		8
+// Frames under budget before the scale goes up again
+#define K3_DYNRES_RAISE_FRAMES		60
+// Weight of a new measurement in the running averages
+#define K3_DYNRES_SMOOTHING		0.2
+
+/* Render scale that holds the GPU frame time under a target. The GPU time is split in the
+** part that follows the number of pixels rendered (the scene, at the render scale) and the
+** fixed part (the post processing chain, at the output size), so the scale is solved for
+** instead of searched : pixels, and with them the scaled time, go with the scale squared.
+** Going down is quick, any frame over the target after the settling frames lowers the scale,
+** going up waits for a long run of frames with room to spare. A scale change costs the
+** renderer a new recording of its command buffers, so it only moves by whole steps.
+*/
+
+class K3DynamicResolution {
+
+public:
+
+	void				setTarget(double const ms);
+	double				getTarget() const;
+	// Measured GPU times of one frame rendered at the current scale, true when the scale changed
+	bool				update(double const scaledMs, double const fixedMs);
+	double				getScale() const;
+	void				reset();
+
+	K3DynamicResolution() {}
+	~K3DynamicResolution() {}
+
+private:
+
+	double				target = 0.0;
+	double				scale = K3_DYNRES_MAX_SCALE;
+	double				scaledAverage = 0.0;
+	double				fixedAverage = 0.0;
+	uint32_t			sinceChange = 0;
+	uint32_t			underBudget = 0;
+
+};
@@ -0,0 +1,160 @@
+#include "K3FramePacer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+typedef std::chrono::duration<double>			Seconds;
+typedef std::chrono::duration<double, std::milli>	Milliseconds;
+
+static K3FramePacer::Clock::duration	toDuration(double const seconds)
+{
+	return std::chrono::duration_cast<K3FramePacer::Clock::duration>(Seconds(seconds));
+}
+
+void		K3FramePacer::setFrameCap(double const fps)
+{
+	capInterval.store(fps > 0.0 ? 1.0 / fps : 0.0, std::memory_order_relaxed);
+}
+
+// 0 when presents are not synced to the display (immediate mode, unknown monitor)
+void		K3FramePacer::setRefreshRate(double const hz)
+{
+	displayPeriod = hz > 0.0 ? 1.0 / hz : 0.0;
+}
+
+bool		K3FramePacer::isPacing() const
+{
+	return displayPeriod > 0.0 || capInterval.load(std::memory_order_relaxed) > 0.0;
+}
+
+K3FramePacer::Clock::time_point	K3FramePacer::getTargetStart(Clock::time_point const now) const
+{
+	Clock::time_point	target = now;
+	double const		cap = capInterval.load(std::memory_order_relaxed);
+
+	if (cap > 0.0 && lastFrameStart != Clock::time_point())
+		target = std::max(target, lastFrameStart + toDuration(cap));
+	if (displayPeriod > 0.0 && presentKnown) {
+		// The earliest vblank this frame can still make, started as late as the prediction allows
+		double const		lead = predictedWork + K3_PACER_MARGIN_MS / 1000.0;
+		double const		sinceVblank = Seconds(target - lastPresent).count();
+		double const		periods = std::max(std::ceil((sinceVblank + lead) / displayPeriod), 1.0);
+		Clock::time_point	vblank = lastPresent + toDuration(periods * displayPeriod);
+
+		target = std::max(target, vblank - toDuration(lead));
+	}
+	return target;
+}
+
+// OS sleeps overshoot by up to a scheduler tick, the last stretch is spent yielding
+void		K3FramePacer::sleepUntil(Clock::time_point const target)
+{
+	Clock::duration const	spin = toDuration(K3_PACER_SPIN_MS / 1000.0);
+	Clock::time_point	now = Clock::now();
+
+	if (target - now > spin)
+		std::this_thread::sleep_until(target - spin);
+	while (Clock::now() < target)
+		std::this_thread::yield();
+}
+
+void		K3FramePacer::beginFrame()
+{
+	Clock::time_point	now = Clock::now();
+	Clock::time_point	target = getTargetStart(now);
+
+	if (target > now)
+		sleepUntil(target);
+	frameStart = Clock::now();
+	lastSleep = Milliseconds(frameStart - now).count();
+	lastFrameStart = frameStart;
+}
+
+void		K3FramePacer::frameSubmitted(uint64_t const presentId, Clock::time_point const inputTime)
+{
+	FrameRecord&	record = history[presentId % K3_PACER_HISTORY];
+
+	record.presentId = presentId;
+	record.start = frameStart;
+	record.input = inputTime;
+	record.workDone = frameStart;
+	record.sleep = lastSleep;
+}
+
+void		K3FramePacer::frameWorkDone(uint64_t const presentId, Clock::time_point const when)
+{
+	FrameRecord&	record = history[presentId % K3_PACER_HISTORY];
+	double		work;
+
+	if (record.presentId != presentId)
+		return;
+	record.workDone = when;
+	work = Seconds(when - record.start).count();
+	if (work > predictedWork)
+		predictedWork += (work - predictedWork) * 0.5;
+	else
+		predictedWork += (work - predictedWork) * 0.02;
+}
+
+void		K3FramePacer::framePresented(uint64_t const presentId, Clock::time_point const when, bool const measured)
+{
+	FrameRecord const&	record = history[presentId % K3_PACER_HISTORY];
+	K3FrameTiming		timing;
+
+	if (record.presentId != presentId)
+		return;
+	timing.sleep = record.sleep;
+	timing.work = Milliseconds(record.workDone - record.start).count();
+	timing.inputToPresent = Milliseconds(when - record.input).count();
+	timing.startToPresent = Milliseconds(when - record.start).count();
+	if (lastPresent != Clock::time_point())
+		timing.presentInterval = Milliseconds(when - lastPresent).count();
+	timing.presentMeasured = measured;
+	lastPresent = when;
+	presentKnown = measured;
+	lastFrame = timing;
+
+	std::lock_guard<std::mutex>	lock(statsMutex);
+
+	window[windowNext] = timing;
+	windowNext = (windowNext + 1) % K3_PACER_WINDOW;
+	windowCount = std::min(windowCount + 1, static_cast<uint32_t>(K3_PACER_WINDOW));
+	windowPredicted = Milliseconds(Seconds(predictedWork)).count();
+}
+
+K3FrameTiming const&	K3FramePacer::getLastFrame() const
+{
+	return lastFrame;
+}
+
+K3LatencyStats	K3FramePacer::getStats() const
+{
+	K3LatencyStats				stats;
+	std::array<double, K3_PACER_WINDOW>	inputLatencies;
+	std::lock_guard<std::mutex>		lock(statsMutex);
+
+	if (windowCount == 0)
+		return stats;
+	for (uint32_t i = 0; i < windowCount; i++) {
+		K3FrameTiming const&	timing = window[i];
+
+		inputLatencies[i] = timing.inputToPresent;
+		stats.inputToPresentMean += timing.inputToPresent;
+		stats.startToPresentMean += timing.startToPresent;
+		stats.presentIntervalMean += timing.presentInterval;
+		stats.sleepMean += timing.sleep;
+	}
+	stats.frames = windowCount;
+	stats.inputToPresentMean /= windowCount;
+	stats.startToPresentMean /= windowCount;
+	stats.presentIntervalMean /= windowCount;
+	stats.sleepMean /= windowCount;
+	stats.predictedWork = windowPredicted;
+	stats.presentMeasured = window[(windowNext + K3_PACER_WINDOW - 1) % K3_PACER_WINDOW].presentMeasured;
+
+	uint32_t const	p99 = static_cast<uint32_t>(std::ceil(windowCount * 0.99)) - 1;
+
+	std::nth_element(inputLatencies.begin(), inputLatencies.begin() + p99, inputLatencies.begin() + windowCount);
+	stats.inputToPresentP99 = inputLatencies[p99];
+	return stats;
+}
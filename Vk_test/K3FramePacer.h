@@ -0,0 +1,108 @@
+#pragma once
+
+# include <array>
+# include <atomic>
+# include <chrono>
+# include <cstdint>
+# include <mutex>
+
+// Frames kept in the latency statistics window
+#define K3_PACER_WINDOW		120
+// Frames whose timings are tracked between submission and present completion
+#define K3_PACER_HISTORY	8
+// Slack kept between the predicted end of a frame and the vblank it targets
+#define K3_PACER_MARGIN_MS	1.0
+// Below this the pacer spins instead of trusting the OS sleep granularity
+#define K3_PACER_SPIN_MS	1.5
+
+// Timings of one frame in milliseconds, presentMeasured tells whether present comes from the display
+struct K3FrameTiming
+{
+	double		sleep = 0.0;
+	double		work = 0.0;
+	double		inputToPresent = 0.0;
+	double		startToPresent = 0.0;
+	double		presentInterval = 0.0;
+	bool		presentMeasured = false;
+};
+
+struct K3LatencyStats
+{
+	double		inputToPresentMean = 0.0;
+	double		inputToPresentP99 = 0.0;
+	double		startToPresentMean = 0.0;
+	double		presentIntervalMean = 0.0;
+	double		sleepMean = 0.0;
+	double		predictedWork = 0.0;
+	uint32_t	frames = 0;
+	bool		presentMeasured = false;
+};
+
+/* Decides when the CPU starts a frame. With a frame cap, frames start at most once per
+** interval. When present completion is known (VK_KHR_present_wait) and the present mode
+** is synced to the display, a frame starts as late as possible while still making the
+** next vblank : the predicted CPU + GPU time (plus a margin) before it. The input is
+** sampled just before that, so it is as fresh as possible when the frame reaches the screen.
+** The prediction follows slower frames right away and faster ones slowly, a missed vblank
+** costs a whole period while starting a bit early only costs a fraction of one.
+** Without present timing the pacer only caps the rate and reports the GPU completion as
+** an approximation of the present. The swapchain only syncs to the display when asked to
+** (VkHandler::setDisplaySync), presenting immediately otherwise.
+** Everything but setFrameCap() and getStats() belongs to the render thread.
+*/
+
+class K3FramePacer {
+
+public:
+
+	typedef std::chrono::steady_clock	Clock;
+
+	void				setFrameCap(double const fps);
+	void				setRefreshRate(double const hz);
+	// A frame cap or a display period to start the frames against, otherwise frames run freely
+	bool				isPacing() const;
+	void				beginFrame();
+	void				frameSubmitted(uint64_t const presentId, Clock::time_point const inputTime);
+	void				frameWorkDone(uint64_t const presentId, Clock::time_point const when);
+	void				framePresented(uint64_t const presentId, Clock::time_point const when, bool const measured);
+	K3FrameTiming const&		getLastFrame() const;
+	K3LatencyStats			getStats() const;
+
+	K3FramePacer() {}
+	~K3FramePacer() {}
+
+	K3FramePacer(K3FramePacer const&) = delete;
+	K3FramePacer&			operator=(K3FramePacer const&) = delete;
+
+private:
+
+	struct FrameRecord
+	{
+		uint64_t		presentId = 0;
+		Clock::time_point	start;
+		Clock::time_point	input;
+		Clock::time_point	workDone;
+		double			sleep = 0.0;
+	};
+
+	Clock::time_point		getTargetStart(Clock::time_point const now) const;
+	static void			sleepUntil(Clock::time_point const target);
+
+	std::atomic<double>		capInterval { 0.0 };
+	double				displayPeriod = 0.0;
+	double				predictedWork = 0.0;
+	Clock::time_point		frameStart;
+	Clock::time_point		lastFrameStart;
+	Clock::time_point		lastPresent;
+	bool				presentKnown = false;
+	double				lastSleep = 0.0;
+	FrameRecord			history[K3_PACER_HISTORY];
+	K3FrameTiming			lastFrame;
+
+	mutable std::mutex		statsMutex;
+	K3FrameTiming			window[K3_PACER_WINDOW];
+	uint32_t			windowNext = 0;
+	uint32_t			windowCount = 0;
+	double				windowPredicted = 0.0;
+
+};
@@ -0,0 +1,84 @@
+#include "K3GpuTimer.h"
+
+bool		K3GpuTimer::isSupported(VkPhysicalDevice const& gpuPDevice)
+{
+	VkPhysicalDeviceProperties	properties;
+
+	vkGetPhysicalDeviceProperties(gpuPDevice, &properties);
+	return properties.limits.timestampComputeAndGraphics && properties.limits.timestampPeriod > 0.0f;
+}
+
+void		K3GpuTimer::init(VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuDevice)
+{
+	VkPhysicalDeviceProperties	properties;
+
+	vkGetPhysicalDeviceProperties(gpuPDevice, &properties);
+	device = gpuDevice;
+	period = properties.limits.timestampPeriod;
+}
+
+void		K3GpuTimer::create(uint32_t const imageCount)
+{
+	VkQueryPoolCreateInfo	poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = imageCount * K3_GPU_SPAN_COUNT * 2;
+	if (vkCreateQueryPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create timestamp query pool !");
+}
+
+void		K3GpuTimer::retire(K3DeletionQueue& retired, uint64_t const frame)
+{
+	VkDevice const		gpuDevice = device;
+	VkQueryPool const	oldPool = pool;
+
+	if (pool == VK_NULL_HANDLE)
+		return;
+	retired.push(frame, [gpuDevice, oldPool]() {
+		vkDestroyQueryPool(gpuDevice, oldPool, nullptr);
+	});
+	pool = VK_NULL_HANDLE;
+}
+
+// Only once the device is idle
+void		K3GpuTimer::destroy()
+{
+	if (pool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, pool, nullptr);
+	pool = VK_NULL_HANDLE;
+}
+
+void		K3GpuTimer::begin(VkCommandBuffer const cmdBuffer, uint32_t const image, K3GpuSpan const span) const
+{
+	uint32_t const		first = (image * K3_GPU_SPAN_COUNT + span) * 2;
+
+	if (pool == VK_NULL_HANDLE)
+		return;
+	vkCmdResetQueryPool(cmdBuffer, pool, first, 2);
+	vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, first);
+}
+
+void		K3GpuTimer::end(VkCommandBuffer const cmdBuffer, uint32_t const image, K3GpuSpan const span) const
+{
+	if (pool == VK_NULL_HANDLE)
+		return;
+	vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool, (image * K3_GPU_SPAN_COUNT + span) * 2 + 1);
+}
+
+bool		K3GpuTimer::read(uint32_t const image, K3GpuSpan const span, double& ms) const
+{
+	uint64_t	ticks[2];
+
+	if (pool == VK_NULL_HANDLE)
+		return false;
+	if (vkGetQueryPoolResults(device, pool, (image * K3_GPU_SPAN_COUNT + span) * 2, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return false;
+	ms = ticks[1] > ticks[0] ? static_cast<double>(ticks[1] - ticks[0]) * period / 1000000.0 : 0.0;
+	return true;
+}
+
+bool		K3GpuTimer::isEnabled() const
+{
+	return pool != VK_NULL_HANDLE;
+}
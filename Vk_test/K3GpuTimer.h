@@ -0,0 +1,52 @@
+#pragma once
+
+# include "K3Vk.h"
+# include "K3DeletionQueue.h"
+
+// What is timed in every swapchain image's command buffers
+enum K3GpuSpan
+{
+	K3_GPU_SPAN_SCENE = 0,
+	K3_GPU_SPAN_POST = 1,
+	K3_GPU_SPAN_COUNT
+};
+
+/* GPU time of the pre-recorded command buffers, one timestamp pair per span and swapchain
+** image. A span resets its own queries when it begins, so the command buffers stay valid
+** for as long as they are reused. Results are read back without waiting, once the frame
+** that wrote them is known to be done : a read that finds the image in flight again
+** (submitted by another frame since) only misses one sample.
+*/
+
+class K3GpuTimer {
+
+public:
+
+	// Timestamps on every graphics and compute queue, the ones the spans are recorded for
+	static bool			isSupported(VkPhysicalDevice const& gpuPDevice);
+	void				init(VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuDevice);
+	// One set of queries per image, the previous ones must have been retired
+	void				create(uint32_t const imageCount);
+	void				retire(K3DeletionQueue& retired, uint64_t const frame);
+	void				destroy();
+	// Outside of a render pass
+	void				begin(VkCommandBuffer const cmdBuffer, uint32_t const image, K3GpuSpan const span) const;
+	void				end(VkCommandBuffer const cmdBuffer, uint32_t const image, K3GpuSpan const span) const;
+	// False until the image's last submission of the span is done
+	bool				read(uint32_t const image, K3GpuSpan const span, double& ms) const;
+	bool				isEnabled() const;
+
+	K3GpuTimer() {}
+	~K3GpuTimer() {}
+
+	K3GpuTimer(K3GpuTimer const&) = delete;
+	K3GpuTimer&			operator=(K3GpuTimer const&) = delete;
+
+private:
+
+	VkDevice			device = VK_NULL_HANDLE;
+	VkQueryPool			pool = VK_NULL_HANDLE;
+	// Nanoseconds per tick
+	double				period = 0.0;
+
+};
@@ -0,0 +1,400 @@
+#include "K3JobSystem.h"
+#include <iostream>
+#include <stdexcept>
+
+static thread_local uint32_t	jobThreadIndex = K3_JOB_NO_THREAD;
+
+////////////////////////////////////
+// DEQUE
+////////////////////////////////////
+
+bool		K3JobDeque::push(K3Job* job)
+{
+	int64_t		b = bottom.load(std::memory_order_relaxed);
+	int64_t		t = top.load(std::memory_order_acquire);
+
+	if (b - t >= K3_JOB_DEQUE_SIZE)
+		return false;
+	buffer[b & (K3_JOB_DEQUE_SIZE - 1)].store(job, std::memory_order_release);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+K3Job*		K3JobDeque::pop()
+{
+	int64_t		b = bottom.load(std::memory_order_relaxed) - 1;
+	int64_t		t;
+	K3Job*		job = nullptr;
+
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	t = top.load(std::memory_order_relaxed);
+	if (t <= b) {
+		job = buffer[b & (K3_JOB_DEQUE_SIZE - 1)].load(std::memory_order_acquire);
+		if (t == b) {
+			// Last job left, race the thieves for it
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = nullptr;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+	}
+	else
+		bottom.store(b + 1, std::memory_order_relaxed);
+	return job;
+}
+
+K3Job*		K3JobDeque::steal()
+{
+	int64_t		t = top.load(std::memory_order_acquire);
+	int64_t		b;
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+		return nullptr;
+
+	K3Job*		job = buffer[t & (K3_JOB_DEQUE_SIZE - 1)].load(std::memory_order_acquire);
+
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+////////////////////////////////////
+// JOB SYSTEM
+////////////////////////////////////
+
+K3JobSystem&		K3JobSystem::getInstance()
+{
+	static K3JobSystem	instance;
+
+	return instance;
+}
+
+K3JobSystem::~K3JobSystem()
+{
+	stop();
+}
+
+uint32_t		K3JobSystem::getThreadIndex()
+{
+	return jobThreadIndex;
+}
+
+K3FrameArena&		K3JobSystem::getScratch()
+{
+	return K3FrameArena::getThreadArena();
+}
+
+uint32_t		K3JobSystem::getWorkerCount() const
+{
+	return static_cast<uint32_t>(workers.size());
+}
+
+uint32_t		K3JobSystem::getThreadCount() const
+{
+	return getWorkerCount() + 1 + K3_JOB_MAX_REGISTERED;
+}
+
+bool			K3JobSystem::isWorker(uint32_t const threadIndex) const
+{
+	return threadIndex >= 1 && threadIndex <= workers.size();
+}
+
+uint32_t		K3JobSystem::registerThread()
+{
+	if (!running)
+		throw std::runtime_error("Thread registered before the job system started !");
+	if (jobThreadIndex != K3_JOB_NO_THREAD)
+		return jobThreadIndex;
+
+	uint32_t const	registered = registeredCount.fetch_add(1);
+
+	if (registered >= K3_JOB_MAX_REGISTERED)
+		throw std::runtime_error("Too many threads registered with the job system !");
+	jobThreadIndex = getWorkerCount() + 1 + registered;
+	return jobThreadIndex;
+}
+
+// The main and render threads already keep two cores busy
+void			K3JobSystem::start(uint32_t workerCount)
+{
+	if (running)
+		return;
+	if (workerCount == 0) {
+		uint32_t	cores = std::thread::hardware_concurrency();
+
+		workerCount = cores > 3 ? cores - 2 : 1;
+	}
+	running = true;
+	jobThreadIndex = 0;
+	registeredCount = 0;
+	workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; i++) {
+		workers.push_back(new Worker());
+		workers.back()->inbox.reserve(64);
+	}
+	sharedQueue.reserve(K3_JOB_DEQUE_SIZE);
+	for (uint32_t i = 0; i < workerCount; i++) {
+		workers[i]->thread = std::thread(&K3JobSystem::workerLoop, this, i + 1);
+	}
+}
+
+void			K3JobSystem::stop()
+{
+	if (!running)
+		return;
+	{
+		std::lock_guard<std::mutex>	lock(sleepMutex);
+
+		running = false;
+	}
+	sleepCondition.notify_all();
+	for (Worker* worker : workers) {
+		worker->thread.join();
+		delete worker;
+	}
+	workers.clear();
+}
+
+/* Jobs come from a ring owned by the submitting thread, a slot is reused once its previous
+** job has finished, which in the steady state is always the case. Jobs must be done before
+** the thread that submitted them exits.
+*/
+
+K3Job*			K3JobSystem::allocateJob()
+{
+	struct JobRing
+	{
+		K3Job*		jobs = new K3Job[K3_JOB_RING_SIZE];
+		uint32_t	next = 0;
+
+		~JobRing() {
+			delete[] jobs;
+		}
+	};
+	static thread_local JobRing	ring;
+	K3Job*				job = &ring.jobs[ring.next++ & (K3_JOB_RING_SIZE - 1)];
+
+	if (!job->finished.load(std::memory_order_acquire)) {
+		job = new K3Job();
+		job->heapAllocated = true;
+	}
+	job->finished.store(false, std::memory_order_relaxed);
+	job->next = nullptr;
+	return job;
+}
+
+void			K3JobSystem::wakeWorkers(uint32_t const count)
+{
+	if (sleepingCount.load() == 0)
+		return;
+	{
+		std::lock_guard<std::mutex>	lock(sleepMutex);
+	}
+	if (count == 1)
+		sleepCondition.notify_one();
+	else
+		sleepCondition.notify_all();
+}
+
+void			K3JobSystem::submit(K3Job* job)
+{
+	uint32_t const	threadIndex = jobThreadIndex;
+
+	if (!running || workers.empty()) {
+		execute(job);
+		return;
+	}
+	if (job->affinity != K3_ANY_THREAD && job->affinity >= 1 && job->affinity <= workers.size()) {
+		Worker*		worker = workers[job->affinity - 1];
+
+		{
+			std::lock_guard<std::mutex>	lock(worker->inboxMutex);
+
+			worker->inbox.push_back(job);
+		}
+		worker->inboxCount.fetch_add(1);
+		wakeWorkers(static_cast<uint32_t>(workers.size()));
+		return;
+	}
+	if (!isWorker(threadIndex) || !workers[threadIndex - 1]->deque.push(job)) {
+		std::lock_guard<std::mutex>	lock(sharedMutex);
+
+		sharedQueue.push_back(job);
+	}
+	queuedCount.fetch_add(1);
+	wakeWorkers(1);
+}
+
+bool			K3JobSystem::deferJob(K3JobCounter& dependency, K3Job* job)
+{
+	bool		deferred = false;
+
+	while (dependency.lock.exchange(true, std::memory_order_acquire))
+		std::this_thread::yield();
+	if (dependency.pending.load(std::memory_order_acquire) > 0) {
+		job->next = dependency.continuations;
+		dependency.continuations = job;
+		deferred = true;
+	}
+	dependency.lock.store(false, std::memory_order_release);
+	return deferred;
+}
+
+void			K3JobSystem::execute(K3Job* job)
+{
+	K3FrameArena&		scratch = getScratch();
+	size_t const		marker = scratch.getMarker();
+	std::exception_ptr	error;
+
+	try {
+		job->function(*job);
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+	scratch.rewind(marker);
+	finish(job, error);
+}
+
+/* The counter is only released under its lock, and K3JobCounter's destructor takes that
+** lock, so a waiter can drop the counter as soon as it sees it reach zero.
+*/
+
+void			K3JobSystem::finish(K3Job* job, std::exception_ptr const& error)
+{
+	K3JobCounter*	counter = job->counter;
+	K3Job*		ready = nullptr;
+
+	job->destroy(*job);
+	if (job->heapAllocated)
+		delete job;
+	else
+		job->finished.store(true, std::memory_order_release);
+	if (!counter) {
+		if (error) {
+			try {
+				std::rethrow_exception(error);
+			}
+			catch (std::exception const& e) {
+				std::cerr << "Job without counter failed : " << e.what() << std::endl;
+			}
+			catch (...) {
+				std::cerr << "Job without counter failed !" << std::endl;
+			}
+		}
+		return;
+	}
+
+	while (counter->lock.exchange(true, std::memory_order_acquire))
+		std::this_thread::yield();
+	if (error && !counter->error)
+		counter->error = error;
+	if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		ready = counter->continuations;
+		counter->continuations = nullptr;
+	}
+	counter->lock.store(false, std::memory_order_release);
+	while (ready) {
+		K3Job*	next = ready->next;
+
+		submit(ready);
+		ready = next;
+	}
+}
+
+K3Job*			K3JobSystem::findJob(uint32_t const threadIndex)
+{
+	K3Job*		job = nullptr;
+	uint32_t const	workerCount = static_cast<uint32_t>(workers.size());
+
+	if (isWorker(threadIndex)) {
+		Worker*		self = workers[threadIndex - 1];
+
+		if ((job = self->deque.pop())) {
+			queuedCount.fetch_sub(1);
+			return job;
+		}
+		if (self->inboxCount.load() > 0) {
+			std::lock_guard<std::mutex>	lock(self->inboxMutex);
+
+			if (!self->inbox.empty()) {
+				job = self->inbox.back();
+				self->inbox.pop_back();
+				self->inboxCount.fetch_sub(1);
+				return job;
+			}
+		}
+	}
+	if (queuedCount.load() == 0)
+		return nullptr;
+	{
+		std::lock_guard<std::mutex>	lock(sharedMutex);
+
+		if (!sharedQueue.empty()) {
+			job = sharedQueue.back();
+			sharedQueue.pop_back();
+			queuedCount.fetch_sub(1);
+			return job;
+		}
+	}
+	for (uint32_t i = 1; i <= workerCount; i++) {
+		uint32_t	victim = (threadIndex + i) % workerCount;
+
+		if (victim + 1 == threadIndex)
+			continue;
+		if ((job = workers[victim]->deque.steal())) {
+			queuedCount.fetch_sub(1);
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+void			K3JobSystem::workerLoop(uint32_t const threadIndex)
+{
+	Worker*		self = workers[threadIndex - 1];
+
+	jobThreadIndex = threadIndex;
+	while (running) {
+		K3Job*	job = findJob(threadIndex);
+
+		if (job) {
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex>	lock(sleepMutex);
+
+		sleepingCount.fetch_add(1);
+		sleepCondition.wait(lock, [this, self]() {
+			return queuedCount.load() > 0 || self->inboxCount.load() > 0 || !running;
+		});
+		sleepingCount.fetch_sub(1);
+	}
+}
+
+void			K3JobSystem::wait(K3JobCounter& counter)
+{
+	uint32_t const	threadIndex = jobThreadIndex;
+
+	while (!counter.isDone()) {
+		K3Job*	job = running && threadIndex != K3_JOB_NO_THREAD ? findJob(threadIndex) : nullptr;
+
+		if (job)
+			execute(job);
+		else
+			std::this_thread::yield();
+	}
+
+	std::exception_ptr	error;
+
+	while (counter.lock.exchange(true, std::memory_order_acquire))
+		std::this_thread::yield();
+	std::swap(error, counter.error);
+	counter.lock.store(false, std::memory_order_release);
+	if (error)
+		std::rethrow_exception(error);
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+# include <algorithm>
+# include <atomic>
+# include <condition_variable>
+# include <cstdint>
+# include <exception>
+# include <mutex>
+# include <new>
+# include <thread>
+# include <type_traits>
+# include <utility>
+# include <vector>
+# include "K3Allocator.h"
+
+#define K3_JOB_DEQUE_SIZE	4096
+#define K3_JOB_RING_SIZE	4096
+#define K3_JOB_PAYLOAD_SIZE	64
+#define K3_ANY_THREAD		0xFFFFFFFFu
+// Non worker threads that can register besides the one that started the job system
+#define K3_JOB_MAX_REGISTERED	4
+// Thread index of the threads unknown to the job system
+#define K3_JOB_NO_THREAD	0xFFFFFFFFu
+
+class K3Job;
+
+/* Counts the jobs still running in a group. Jobs started with runAfter() on a counter
+** are queued as soon as it drops to zero, wait() executes other jobs until it does.
+** The first exception thrown by a job of the group is rethrown by wait().
+*/
+
+class K3JobCounter {
+
+	friend class K3JobSystem;
+
+public:
+
+	bool				isDone() const {
+		return pending.load(std::memory_order_acquire) == 0;
+	}
+
+	K3JobCounter() {}
+	// Waits for the last finishing job to let go of the counter
+	~K3JobCounter() {
+		while (lock.exchange(true, std::memory_order_acquire))
+			std::this_thread::yield();
+	}
+
+	K3JobCounter(K3JobCounter const&) = delete;
+	K3JobCounter&			operator=(K3JobCounter const&) = delete;
+
+private:
+
+	std::atomic<uint32_t>		pending { 0 };
+	std::atomic<bool>		lock { false };
+	K3Job*				continuations = nullptr;
+	std::exception_ptr		error;
+
+};
+
+class K3Job {
+
+	friend class K3JobSystem;
+	friend class K3JobDeque;
+
+private:
+
+	void				(*function)(K3Job&) = nullptr;
+	void				(*destroy)(K3Job&) = nullptr;
+	K3JobCounter*			counter = nullptr;
+	K3Job*				next = nullptr;
+	uint32_t			affinity = K3_ANY_THREAD;
+	bool				heapAllocated = false;
+	std::atomic<bool>		finished { true };
+	alignas(std::max_align_t) unsigned char	payload[K3_JOB_PAYLOAD_SIZE];
+
+};
+
+/* Chase-Lev work stealing deque. The owner thread pushes and pops at the bottom without
+** any lock, other threads steal from the top with a single compare and swap.
+*/
+
+class K3JobDeque {
+
+public:
+
+	bool				push(K3Job* job);
+	K3Job*				pop();
+	K3Job*				steal();
+
+	K3JobDeque() {}
+	~K3JobDeque() {}
+
+private:
+
+	alignas(64) std::atomic<int64_t>	top { 0 };
+	alignas(64) std::atomic<int64_t>	bottom { 0 };
+	std::atomic<K3Job*>		buffer[K3_JOB_DEQUE_SIZE];
+
+};
+
+/* The engine's task scheduler, one worker per spare core.
+** Workers run their own deque first, then the jobs pinned to them, then the shared queue
+** fed by non worker threads, and finally steal from the other workers before sleeping.
+** A thread waiting on a counter executes jobs in the meantime, so waiting from inside a
+** job never blocks a worker.
+** Every job runs with the thread's K3FrameArena as scratch space, rewound once it returns.
+** Without start() (or with no spare core) everything runs inline on the calling thread.
+** Every thread that runs jobs has an index of its own, for the per thread state such as
+** command pools : 0 for the thread that called start(), then the workers, then the non
+** worker threads that called registerThread(). A thread unknown to the job system only
+** yields in wait(), the jobs it picked up would run without an index.
+*/
+
+class K3JobSystem {
+
+public:
+
+	void				start(uint32_t workerCount = 0);
+	void				stop();
+	void				wait(K3JobCounter& counter);
+	uint32_t			getWorkerCount() const;
+	// Size of the tables indexed by getThreadIndex()
+	uint32_t			getThreadCount() const;
+	// After start(), the index lasts until stop(). Registering again returns the same index
+	uint32_t			registerThread();
+	// 0 for the thread that called start(), 1 to getWorkerCount() for the workers, K3_JOB_NO_THREAD for the unregistered
+	static uint32_t			getThreadIndex();
+	static K3FrameArena&		getScratch();
+	static K3JobSystem&		getInstance();
+
+	template <typename F>
+	void				run(F&& function, K3JobCounter* counter = nullptr, uint32_t const affinity = K3_ANY_THREAD) {
+		submit(makeJob(std::forward<F>(function), counter, affinity));
+	}
+
+	// Queued once dependency is done, counter (if any) is incremented right away
+	template <typename F>
+	void				runAfter(K3JobCounter& dependency, F&& function, K3JobCounter* counter = nullptr,
+						uint32_t const affinity = K3_ANY_THREAD) {
+		K3Job*		job = makeJob(std::forward<F>(function), counter, affinity);
+
+		if (!deferJob(dependency, job))
+			submit(job);
+	}
+
+	// function(first, last) over [begin, end) cut in slices of at least grain elements
+	template <typename F>
+	void				parallelFor(uint32_t const begin, uint32_t const end, uint32_t const grain, F const& function) {
+		uint32_t const	count = end > begin ? end - begin : 0;
+		uint32_t	slices = grain > 0 ? (count + grain - 1) / grain : 1;
+
+		slices = std::min(slices, (getWorkerCount() + 1) * 4);
+		if (slices <= 1 || getWorkerCount() == 0) {
+			if (count > 0)
+				function(begin, end);
+			return;
+		}
+
+		K3JobCounter	counter;
+		uint32_t const	sliceSize = (count + slices - 1) / slices;
+
+		for (uint32_t first = begin + sliceSize; first < end; first += sliceSize) {
+			uint32_t	last = std::min(first + sliceSize, end);
+
+			run([&function, first, last]() { function(first, last); }, &counter);
+		}
+		// The slices reference this frame, they must be done before an exception leaves it
+		try {
+			function(begin, std::min(begin + sliceSize, end));
+		}
+		catch (...) {
+			wait(counter);
+			throw;
+		}
+		wait(counter);
+	}
+
+	K3JobSystem() {}
+	~K3JobSystem();
+
+	K3JobSystem(K3JobSystem const&) = delete;
+	K3JobSystem&			operator=(K3JobSystem const&) = delete;
+
+private:
+
+	struct Worker
+	{
+		K3JobDeque		deque;
+		std::mutex		inboxMutex;
+		std::vector<K3Job*>	inbox;
+		std::atomic<uint32_t>	inboxCount { 0 };
+		std::thread		thread;
+	};
+
+	template <typename F>
+	K3Job*				makeJob(F&& function, K3JobCounter* counter, uint32_t const affinity) {
+		typedef typename std::decay<F>::type	Function;
+		static_assert(sizeof(Function) <= K3_JOB_PAYLOAD_SIZE, "Job capture too large, capture by reference");
+		static_assert(alignof(Function) <= alignof(std::max_align_t), "Job capture over-aligned");
+
+		K3Job*		job = allocateJob();
+
+		new (job->payload) Function(std::forward<F>(function));
+		job->function = [](K3Job& self) { (*reinterpret_cast<Function*>(self.payload))(); };
+		job->destroy = [](K3Job& self) { reinterpret_cast<Function*>(self.payload)->~Function(); };
+		job->counter = counter;
+		job->affinity = affinity;
+		if (counter)
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		return job;
+	}
+
+	K3Job*				allocateJob();
+	void				submit(K3Job* job);
+	bool				deferJob(K3JobCounter& dependency, K3Job* job);
+	void				execute(K3Job* job);
+	void				finish(K3Job* job, std::exception_ptr const& error);
+	K3Job*				findJob(uint32_t const threadIndex);
+	bool				isWorker(uint32_t const threadIndex) const;
+	void				workerLoop(uint32_t const threadIndex);
+	void				wakeWorkers(uint32_t const count);
+
+	std::vector<Worker*>		workers;
+	std::mutex			sharedMutex;
+	std::vector<K3Job*>		sharedQueue;
+	std::mutex			sleepMutex;
+	std::condition_variable		sleepCondition;
+	std::atomic<uint32_t>		sleepingCount { 0 };
+	std::atomic<uint32_t>		queuedCount { 0 };
+	std::atomic<uint32_t>		registeredCount { 0 };
+	std::atomic<bool>		running { false };
+
+};
@@ -0,0 +1,310 @@
+#include "K3LightClusters.h"
+#include "K3StreamWrite.h"
+#include <cmath>
+
+// Room for the index counters ahead of the clusters, keeps them at the largest storage offset alignment
+static VkDeviceSize const	countsSize = 256;
+
+enum Binding
+{
+	BINDING_PARAMS,
+	BINDING_LIGHTS,
+	BINDING_COUNTS,
+	BINDING_GRID,
+	BINDING_INDICES,
+	BINDING_COUNT
+};
+
+static_assert(sizeof(K3Light) == 64, "K3Light does not match the std430 layout of the lighting shaders");
+
+bool		K3LightClusters::isSupported(K3Archive const& assets)
+{
+	return assets.exists(K3_SHADER_DIR "light_cluster.comp.spv");
+}
+
+void		K3LightClusters::init(VkDevice const& gpuDevice, K3MemoryBudget& memoryBudget, K3Bindless& bindlessSet, ShaderLoader const& loadShader)
+{
+	device = gpuDevice;
+	budget = &memoryBudget;
+	bindless = &bindlessSet;
+
+	VkDescriptorSetLayoutBinding	bindings[BINDING_COUNT] = {};
+	for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo	setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = BINDING_COUNT;
+	setLayoutInfo.pBindings = bindings;
+	if (vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create light cluster descriptor set layout !");
+
+	// Only the region, the rest changes every frame and is read from its parameters
+	VkPushConstantRange		pushRange = {};
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(uint32_t);
+
+	VkPipelineLayoutCreateInfo	pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create light cluster pipeline layout !");
+
+	VkComputePipelineCreateInfo	pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = loadShader(K3_SHADER_DIR "light_cluster.comp.spv");
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+	VkResult const	result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &binPipeline);
+	vkDestroyShaderModule(device, pipelineInfo.stage.module, nullptr);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create light binning pipeline !");
+
+	// Sets are replaced along with the buffers they point to, the old ones are freed once retired
+	VkDescriptorPoolSize		poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = BINDING_COUNT * 8;
+
+	VkDescriptorPoolCreateInfo	poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolInfo.maxSets = 8;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create light cluster descriptor pool !");
+}
+
+// What the CPU writes goes to device memory directly when it can, to host memory otherwise
+void		K3LightClusters::createBuffer(VkDeviceSize const size, VkBufferUsageFlags const usage, bool const mapped,
+				VkBuffer& buffer, VkDeviceMemory& memory, void** data)
+{
+	VkBufferCreateInfo		bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create light cluster buffer !");
+
+	VkMemoryRequirements	memRequirements;
+	vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+	if (mapped) {
+		memory = budget->tryAllocate(memRequirements, K3_MEMORY_DIRECT, K3_MEMORY_NORMAL);
+		if (memory == VK_NULL_HANDLE) {
+			memory = budget->allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				K3_MEMORY_NORMAL);
+		}
+	}
+	else
+		memory = budget->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, K3_MEMORY_NORMAL);
+	vkBindBufferMemory(device, buffer, memory, 0);
+	if (mapped && vkMapMemory(device, memory, 0, size, 0, data) != VK_SUCCESS)
+		throw std::runtime_error("Failed to map light cluster buffer memory !");
+}
+
+void		K3LightClusters::createRegions(uint32_t const count)
+{
+	void*		data;
+
+	createBuffer(count * sizeof(Params), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true, paramsBuffer, paramsMemory, &data);
+	paramsData = static_cast<Params*>(data);
+	createBuffer(static_cast<VkDeviceSize>(count) * K3_MAX_LIGHTS * sizeof(K3Light), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true,
+		lightBuffer, lightMemory, &data);
+	lightData = static_cast<K3Light*>(data);
+	createBuffer(countsSize + static_cast<VkDeviceSize>(count) * K3_LIGHT_CLUSTERS * 2 * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false, clusterBuffer, clusterMemory, nullptr);
+	createBuffer(static_cast<VkDeviceSize>(count) * K3_LIGHT_INDICES * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false,
+		indexBuffer, indexMemory, nullptr);
+	slots.lights = bindless->addBuffer(lightBuffer);
+	slots.params = bindless->addBuffer(paramsBuffer);
+	slots.grid = bindless->addBuffer(clusterBuffer, countsSize);
+	slots.indices = bindless->addBuffer(indexBuffer);
+	lightRegionVersions.assign(count, 0);
+	regionCount = count;
+}
+
+/* A smaller swapchain keeps the regions it has. The slots change along with the buffers,
+** the command buffers drawing with the old ones have to be recorded again.
+*/
+
+void		K3LightClusters::setRegionCount(uint32_t const count, K3DeletionQueue& retired, uint64_t const frame)
+{
+	VkDevice const		gpuDevice = device;
+	K3MemoryBudget* const	memoryBudget = budget;
+	VkDescriptorPool const	pool = descriptorPool;
+	VkDescriptorSet const	oldSet = set;
+
+	if (count <= regionCount)
+		return;
+	if (count * sizeof(uint32_t) > countsSize)
+		throw std::runtime_error("Too many swapchain images for the light index counters !");
+	if (oldSet != VK_NULL_HANDLE) {
+		retired.push(frame, [gpuDevice, pool, oldSet]() {
+			vkFreeDescriptorSets(gpuDevice, pool, 1, &oldSet);
+		});
+	}
+	if (regionCount > 0) {
+		VkBuffer const		buffers[] = { paramsBuffer, lightBuffer, clusterBuffer, indexBuffer };
+		VkDeviceMemory const	memories[] = { paramsMemory, lightMemory, clusterMemory, indexMemory };
+
+		bindless->release(K3_BINDLESS_BUFFER, slots.lights, retired, frame);
+		bindless->release(K3_BINDLESS_BUFFER, slots.params, retired, frame);
+		bindless->release(K3_BINDLESS_BUFFER, slots.grid, retired, frame);
+		bindless->release(K3_BINDLESS_BUFFER, slots.indices, retired, frame);
+		// Unmapped along with the memory
+		retired.push(frame, [gpuDevice, memoryBudget, buffers, memories]() {
+			for (uint32_t i = 0; i < 4; i++) {
+				vkDestroyBuffer(gpuDevice, buffers[i], nullptr);
+				memoryBudget->free(memories[i]);
+			}
+		});
+	}
+	createRegions(count);
+
+	VkDescriptorSetAllocateInfo	allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+	if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate light cluster descriptor set !");
+
+	VkDescriptorBufferInfo		infos[BINDING_COUNT] = {};
+	infos[BINDING_PARAMS] = { paramsBuffer, 0, VK_WHOLE_SIZE };
+	infos[BINDING_LIGHTS] = { lightBuffer, 0, VK_WHOLE_SIZE };
+	infos[BINDING_COUNTS] = { clusterBuffer, 0, countsSize };
+	infos[BINDING_GRID] = { clusterBuffer, countsSize, VK_WHOLE_SIZE };
+	infos[BINDING_INDICES] = { indexBuffer, 0, VK_WHOLE_SIZE };
+
+	VkWriteDescriptorSet		writes[BINDING_COUNT] = {};
+	for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &infos[i];
+	}
+	vkUpdateDescriptorSets(device, BINDING_COUNT, writes, 0, nullptr);
+}
+
+/* The lights are only copied when they changed since the region last got them, the
+** parameters every frame : the render extent follows the dynamic resolution.
+*/
+
+void		K3LightClusters::update(uint32_t const imgIndex, K3SceneSnapshot const& snapshot, K3LightView const& view, VkExtent2D const& extent)
+{
+	Params		params = {};
+
+	snapshot.copyLightsToRegion(lightData + static_cast<size_t>(imgIndex) * K3_MAX_LIGHTS, lightRegionVersions[imgIndex], K3_MAX_LIGHTS);
+	lightCount = static_cast<uint32_t>(std::min(snapshot.lights.size(), static_cast<size_t>(K3_MAX_LIGHTS)));
+	params.view = view.view;
+	params.invProj = glm::inverse(view.proj);
+	params.ambient = glm::vec4(snapshot.ambientLight, 0.0f);
+	params.invExtent = glm::vec2(1.0f / std::max(extent.width, 1u), 1.0f / std::max(extent.height, 1u));
+	// The slice of a depth is depth * scale + bias, of its logarithm with perspective
+	if (view.perspective) {
+		params.sliceScale = K3_LIGHT_GRID_Z / std::log(view.zFar / view.zNear);
+		params.sliceBias = -std::log(view.zNear) * params.sliceScale;
+	}
+	else {
+		params.sliceScale = K3_LIGHT_GRID_Z / (view.zFar - view.zNear);
+		params.sliceBias = -view.zNear * params.sliceScale;
+	}
+	params.zNear = view.zNear;
+	params.zFar = view.zFar;
+	params.lightCount = lightCount;
+	params.perspective = view.perspective ? 1 : 0;
+	params.lightBase = imgIndex * K3_MAX_LIGHTS;
+	params.clusterBase = imgIndex * K3_LIGHT_CLUSTERS;
+	params.indexBase = imgIndex * K3_LIGHT_INDICES;
+	params.indexCapacity = K3_LIGHT_INDICES;
+	K3StreamWrite::store(paramsData + imgIndex, params);
+	K3StreamWrite::fence();
+}
+
+// Outside of the render pass, the lists are ready for the fragment shaders once it is done
+void		K3LightClusters::recordBinning(VkCommandBuffer const cmdBuffer, uint32_t const imgIndex) const
+{
+	// The counter is what the clusters take their place in the index region from
+	vkCmdFillBuffer(cmdBuffer, clusterBuffer, imgIndex * sizeof(uint32_t), sizeof(uint32_t), 0);
+
+	VkMemoryBarrier		barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, binPipeline);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &imgIndex);
+	vkCmdDispatch(cmdBuffer, (K3_LIGHT_CLUSTERS + K3_LIGHT_CLUSTER_GROUP - 1) / K3_LIGHT_CLUSTER_GROUP, 1, 1);
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void		K3LightClusters::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+	if (regionCount > 0) {
+		vkDestroyBuffer(device, paramsBuffer, nullptr);
+		budget->free(paramsMemory);
+		vkDestroyBuffer(device, lightBuffer, nullptr);
+		budget->free(lightMemory);
+		vkDestroyBuffer(device, clusterBuffer, nullptr);
+		budget->free(clusterMemory);
+		vkDestroyBuffer(device, indexBuffer, nullptr);
+		budget->free(indexMemory);
+	}
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyPipeline(device, binPipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	paramsBuffer = VK_NULL_HANDLE;
+	paramsMemory = VK_NULL_HANDLE;
+	paramsData = nullptr;
+	lightBuffer = VK_NULL_HANDLE;
+	lightMemory = VK_NULL_HANDLE;
+	lightData = nullptr;
+	clusterBuffer = VK_NULL_HANDLE;
+	clusterMemory = VK_NULL_HANDLE;
+	indexBuffer = VK_NULL_HANDLE;
+	indexMemory = VK_NULL_HANDLE;
+	regionCount = 0;
+	lightRegionVersions.clear();
+	slots = K3LightSlots();
+	descriptorPool = VK_NULL_HANDLE;
+	set = VK_NULL_HANDLE;
+	binPipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+	device = VK_NULL_HANDLE;
+}
+
+K3LightSlots const&	K3LightClusters::getSlots() const
+{
+	return slots;
+}
+
+// Of the last update, what the binning goes through
+uint32_t	K3LightClusters::getLightCount() const
+{
+	return lightCount;
+}
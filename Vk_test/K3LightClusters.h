@@ -0,0 +1,133 @@
+#pragma once
+
+# include "K3Vk.h"
+# include "K3DeletionQueue.h"
+# include "K3MemoryBudget.h"
+# include "K3Bindless.h"
+# include "K3Scene.h"
+# include "K3Archive.h"
+
+// Froxel grid : tiles of the render area on x and y, depth slices on z, the same in light_cluster.comp and shader_bindless.frag
+#define K3_LIGHT_GRID_X		16
+#define K3_LIGHT_GRID_Y		9
+#define K3_LIGHT_GRID_Z		24
+#define K3_LIGHT_CLUSTERS	(K3_LIGHT_GRID_X * K3_LIGHT_GRID_Y * K3_LIGHT_GRID_Z)
+// Clusters one binning workgroup handles, one thread per cluster
+#define K3_LIGHT_CLUSTER_GROUP	64
+// Lights a region holds, those of the scene past it are not drawn
+#define K3_MAX_LIGHTS		8192
+// Lights one cluster keeps, the list light_cluster.comp builds in registers
+#define K3_MAX_CLUSTER_LIGHTS	128
+// Light indices a region holds, what every cluster shares. A cluster that does not fit is left unlit
+#define K3_LIGHT_INDICES	(K3_LIGHT_CLUSTERS * 32)
+
+/* View space looks down +z. Slices go linearly from zNear to zFar, or exponentially with
+** perspective, where zNear must be above 0.
+*/
+
+struct K3LightView
+{
+	glm::mat4	view;
+	glm::mat4	proj;
+	float		zNear;
+	float		zFar;
+	bool		perspective;
+};
+
+// Bindless slots of the buffers the fragment shader reads, all K3_BINDLESS_NONE before setRegionCount()
+struct K3LightSlots
+{
+	uint32_t	lights = K3_BINDLESS_NONE;
+	uint32_t	params = K3_BINDLESS_NONE;
+	uint32_t	grid = K3_BINDLESS_NONE;
+	uint32_t	indices = K3_BINDLESS_NONE;
+};
+
+/* Clustered forward lighting. Every frame a compute pass bins the scene's point and spot
+** lights into a froxel grid : one thread per cluster tests the lights, loaded a workgroup's
+** worth at a time into shared memory, against the cluster's view space box, and writes
+** their indices as one compact list, its place in the region's index buffer taken with an
+** atomic counter. The fragment shader then finds its cluster from its position on screen
+** and its depth, and only goes through that cluster's lights : the cost follows the number
+** of lights around a fragment rather than in the scene.
+** Like the draws, every swapchain image has its own region of each buffer. The lights and
+** the parameters of the pass are written by the CPU in the frame's region, the binning is
+** recorded once in the image's command buffer and reads them when it runs.
+*/
+
+class K3LightClusters {
+
+public:
+
+	typedef std::function<VkShaderModule(std::string const&)>	ShaderLoader;
+
+	// The shader is looked for in the asset archive first
+	static bool			isSupported(K3Archive const& assets);
+	void				init(VkDevice const& gpuDevice, K3MemoryBudget& memoryBudget, K3Bindless& bindlessSet, ShaderLoader const& loadShader);
+	// Grows the regions to regionCount, the old buffers and slots go once the frames in flight are done
+	void				setRegionCount(uint32_t const regionCount, K3DeletionQueue& retired, uint64_t const frame);
+	// Into the image's region, once the frames that read it are done
+	void				update(uint32_t const imgIndex, K3SceneSnapshot const& snapshot, K3LightView const& view, VkExtent2D const& extent);
+	void				recordBinning(VkCommandBuffer const cmdBuffer, uint32_t const imgIndex) const;
+	// Only once the device is idle, the retired queue must have been flushed first
+	void				destroy();
+	K3LightSlots const&		getSlots() const;
+	uint32_t			getLightCount() const;
+
+	K3LightClusters() {}
+	~K3LightClusters() {}
+
+	K3LightClusters(K3LightClusters const&) = delete;
+	K3LightClusters&		operator=(K3LightClusters const&) = delete;
+
+private:
+
+	// One per region, std430 layout of light_cluster.comp and shader_bindless.frag. The bases are the region's
+	struct Params
+	{
+		glm::mat4	view;
+		glm::mat4	invProj;
+		glm::vec4	ambient;
+		glm::vec2	invExtent;
+		float		sliceScale;
+		float		sliceBias;
+		float		zNear;
+		float		zFar;
+		uint32_t	lightCount;
+		uint32_t	perspective;
+		uint32_t	lightBase;
+		uint32_t	clusterBase;
+		uint32_t	indexBase;
+		uint32_t	indexCapacity;
+	};
+
+	void				createBuffer(VkDeviceSize const size, VkBufferUsageFlags const usage, bool const mapped,
+						VkBuffer& buffer, VkDeviceMemory& memory, void** data);
+	void				createRegions(uint32_t const regionCount);
+
+	K3MemoryBudget*			budget = nullptr;
+	K3Bindless*			bindless = nullptr;
+	VkDevice			device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout		setLayout = VK_NULL_HANDLE;
+	VkPipelineLayout		pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline			binPipeline = VK_NULL_HANDLE;
+	VkDescriptorPool		descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet			set = VK_NULL_HANDLE;
+	// Written by the CPU : the parameters and the lights of every region
+	VkBuffer			paramsBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory			paramsMemory = VK_NULL_HANDLE;
+	Params*				paramsData = nullptr;
+	VkBuffer			lightBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory			lightMemory = VK_NULL_HANDLE;
+	K3Light*			lightData = nullptr;
+	// Written by the binning : index counters (one uint per region) then the (offset, count) of every cluster
+	VkBuffer			clusterBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory			clusterMemory = VK_NULL_HANDLE;
+	VkBuffer			indexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory			indexMemory = VK_NULL_HANDLE;
+	uint32_t			regionCount = 0;
+	std::vector<uint32_t>		lightRegionVersions;
+	K3LightSlots			slots;
+	uint32_t			lightCount = 0;
+
+};
@@ -0,0 +1,193 @@
+#include "K3Lod.h"
+#include "K3JobSystem.h"
+#include "K3StreamWrite.h"
+
+uint32_t		K3LodSelector::addMesh(K3LodMesh const& mesh)
+{
+	if (mesh.levelCount == 0 || mesh.levelCount > K3_MAX_LODS)
+		throw std::runtime_error("LOD mesh level count out of range !");
+	meshes.push_back(mesh);
+	return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+K3LodMesh const&	K3LodSelector::getMesh(uint32_t const mesh) const
+{
+	return meshes[mesh];
+}
+
+void			K3LodSelector::setNodeMesh(uint32_t const node, uint32_t const mesh)
+{
+	if (node >= nodeMeshes.size()) {
+		nodeMeshes.resize(node + 1, 0);
+		nodeLods.resize(node + 1, K3_LOD_NONE);
+		versions.resize(node + 1, 0);
+	}
+	nodeMeshes[node] = mesh;
+	// The level index means nothing for another mesh, the next selection starts over
+	nodeLods[node] = K3_LOD_NONE;
+}
+
+void			K3LodSelector::setThreshold(float const pixels)
+{
+	threshold = pixels;
+}
+
+void			K3LodSelector::setHysteresis(float const ratio)
+{
+	hysteresis = std::min(std::max(ratio, 0.0f), 0.9f);
+}
+
+/* Screen-space error of a level = error * scale * projScale / distance.
+** Errors grow with the level so the coarsest acceptable level is found by walking up
+** from the finest one, level 0 is always acceptable.
+*/
+
+K3LodSelector::RangeResult	K3LodSelector::selectRange(glm::mat4 const* worlds, K3LodView const& view,
+										uint32_t const first, uint32_t const last)
+{
+	RangeResult		result;
+	float const		coarserThreshold = threshold * (1.0f - hysteresis);
+
+	for (uint32_t node = first; node < last; node++) {
+		K3LodMesh const&	mesh = meshes[nodeMeshes[node]];
+		glm::mat4 const&	world = worlds[node];
+		float			scale2 = std::max(std::max(glm::dot(glm::vec3(world[0]), glm::vec3(world[0])),
+							glm::dot(glm::vec3(world[1]), glm::vec3(world[1]))),
+							glm::dot(glm::vec3(world[2]), glm::vec3(world[2])));
+		float			pixelScale = std::sqrt(scale2) * view.projScale;
+		uint8_t const		current = nodeLods[node];
+		uint8_t			lod = 0;
+		uint8_t			coarserLod = 0;
+
+		if (view.perspective) {
+			glm::vec3	toEye = glm::vec3(world[3]) - view.eye;
+			float		distance = std::sqrt(glm::dot(toEye, toEye)) - mesh.boundingRadius * std::sqrt(scale2);
+
+			pixelScale /= std::max(distance, 1e-3f);
+		}
+		for (uint32_t level = 1; level < mesh.levelCount; level++) {
+			float	pixelError = mesh.levels[level].error * pixelScale;
+
+			if (pixelError <= threshold)
+				lod = static_cast<uint8_t>(level);
+			if (pixelError <= coarserThreshold)
+				coarserLod = static_cast<uint8_t>(level);
+		}
+		// Refine as soon as the current level is too coarse, coarsen only with some margin
+		if (current != K3_LOD_NONE && current < mesh.levelCount) {
+			if (mesh.levels[current].error * pixelScale <= threshold)
+				lod = std::max(current, coarserLod);
+		}
+		if (lod != current) {
+			nodeLods[node] = lod;
+			versions[node] = currentVersion + 1;
+			result.changed++;
+		}
+		result.triangles += mesh.levels[lod].indexCount / 3;
+	}
+	return result;
+}
+
+void			K3LodSelector::select(glm::mat4 const* worlds, uint32_t const nodeCount, K3LodView const& view)
+{
+	std::atomic<uint32_t>	changed { 0 };
+	std::atomic<uint64_t>	triangles { 0 };
+
+	if (meshes.empty())
+		throw std::runtime_error("No LOD mesh registered !");
+	if (nodeMeshes.size() < nodeCount) {
+		nodeMeshes.resize(nodeCount, 0);
+		nodeLods.resize(nodeCount, K3_LOD_NONE);
+		versions.resize(nodeCount, 0);
+	}
+
+	// Nodes are independent, each job owns a contiguous slice of the arrays
+	K3JobSystem::getInstance().parallelFor(0, nodeCount, K3_LOD_PARALLEL_MIN, [&](uint32_t first, uint32_t last) {
+		RangeResult	result = selectRange(worlds, view, first, last);
+
+		changed.fetch_add(result.changed, std::memory_order_relaxed);
+		triangles.fetch_add(result.triangles, std::memory_order_relaxed);
+	});
+	changedCount = changed.load();
+	triangleCount = triangles.load();
+	if (changedCount > 0)
+		currentVersion++;
+}
+
+VkDrawIndexedIndirectCommand	K3LodSelector::getCommand(uint32_t const node) const
+{
+	K3LodMesh const&		mesh = meshes[nodeMeshes[node]];
+	K3LodLevel const&		level = mesh.levels[nodeLods[node] < mesh.levelCount ? nodeLods[node] : 0];
+	VkDrawIndexedIndirectCommand	command;
+
+	command.indexCount = level.indexCount;
+	command.instanceCount = 1;
+	command.firstIndex = level.firstIndex;
+	command.vertexOffset = mesh.vertexOffset;
+	command.firstInstance = node;
+	return command;
+}
+
+/* Same contract as K3Scene::updateTransforms, a region at version 0 receives every command.
+** Commands are 20 bytes, one store each would leave most write combining lines partial :
+** runs of changed nodes are built on the stack and copied as one span. Short gaps of
+** unchanged nodes are written again to keep a run going, their commands are the same.
+*/
+
+void			K3LodSelector::writeCommands(VkDrawIndexedIndirectCommand* region, uint32_t& regionVersion,
+										uint32_t const regionCapacity) const
+{
+	uint32_t const			count = std::min(static_cast<uint32_t>(nodeLods.size()), regionCapacity);
+	VkDrawIndexedIndirectCommand	run[K3_LOD_WRITE_RUN];
+	uint32_t			node = 0;
+
+	if (regionVersion == currentVersion)
+		return;
+	while (node < count) {
+		if (versions[node] <= regionVersion) {
+			node++;
+			continue;
+		}
+
+		uint32_t const	first = node;
+		uint32_t	runCount = 0;
+		uint32_t	end = first;
+
+		// end is one past the last changed node of the run, the gap after it is only taken when another follows
+		while (node < count && runCount < K3_LOD_WRITE_RUN && node - end < K3_LOD_WRITE_GAP) {
+			if (versions[node] > regionVersion)
+				end = node + 1;
+			run[runCount++] = getCommand(node++);
+		}
+		K3StreamWrite::copy(&region[first], run, (end - first) * sizeof(VkDrawIndexedIndirectCommand));
+		node = end;
+	}
+	K3StreamWrite::fence();
+	regionVersion = currentVersion;
+}
+
+uint8_t			K3LodSelector::getNodeLod(uint32_t const node) const
+{
+	return nodeLods[node];
+}
+
+uint32_t		K3LodSelector::getChangedCount() const
+{
+	return changedCount;
+}
+
+// Bumped by every select() that changed a level, a node's version is the one it last changed at
+uint32_t		K3LodSelector::getVersion() const
+{
+	return currentVersion;
+}
+
+uint32_t		K3LodSelector::getNodeVersion(uint32_t const node) const
+{
+	return versions[node];
+}
+
+uint64_t		K3LodSelector::getTriangleCount() const
+{
+	return triangleCount;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "K3Vk.h"
+#include "K3Scene.h"
+
+#define K3_MAX_LODS		4
+#define K3_LOD_NONE		0xFF
+#define K3_LOD_PIXEL_ERROR	1.0f
+#define K3_LOD_HYSTERESIS	0.25f
+#define K3_LOD_PARALLEL_MIN	8192
+// Commands writeCommands() copies at once, and unchanged ones it writes again rather than break a run
+#define K3_LOD_WRITE_RUN	64
+#define K3_LOD_WRITE_GAP	3
+
+/* One level of detail is a range of the shared index buffer. error is the geometric
+** deviation from the full detail mesh, in mesh units, and grows with the level.
+** The layout is kept std430 compatible so the same tables can be read by a compute pass.
+*/
+
+struct K3LodLevel
+{
+	uint32_t	firstIndex;
+	uint32_t	indexCount;
+	float		error;
+	uint32_t	padding;
+};
+
+struct K3LodMesh
+{
+	K3LodLevel	levels[K3_MAX_LODS];
+	uint32_t	levelCount;
+	int32_t		vertexOffset;
+	float		boundingRadius;
+};
+
+// projScale converts a mesh space error at distance 1 (or at any distance without perspective) to pixels
+struct K3LodView
+{
+	glm::vec3	eye;
+	float		projScale;
+	bool		perspective;
+};
+
+/* Picks a level per scene node from its projected screen-space error : the coarsest level
+** whose error stays under the pixel threshold. Going coarser needs the error to drop
+** below threshold * (1 - hysteresis), so a node sitting on the boundary does not pop.
+** Selection runs over independent node ranges, split across the job system for large
+** scenes. The result is a VkDrawIndexedIndirectCommand per node (firstInstance = node),
+** streamed into mapped indirect buffer regions with the same versioning as K3Scene.
+*/
+
+class K3LodSelector {
+
+public:
+
+	uint32_t			addMesh(K3LodMesh const& mesh);
+	K3LodMesh const&		getMesh(uint32_t const mesh) const;
+	void				setNodeMesh(uint32_t const node, uint32_t const mesh);
+	void				setThreshold(float const pixels);
+	void				setHysteresis(float const ratio);
+	void				select(glm::mat4 const* worlds, uint32_t const nodeCount, K3LodView const& view);
+	void				writeCommands(VkDrawIndexedIndirectCommand* region, uint32_t& regionVersion, uint32_t const regionCapacity) const;
+	VkDrawIndexedIndirectCommand	getCommand(uint32_t const node) const;
+	uint8_t				getNodeLod(uint32_t const node) const;
+	uint32_t			getChangedCount() const;
+	uint32_t			getVersion() const;
+	uint32_t			getNodeVersion(uint32_t const node) const;
+	uint64_t			getTriangleCount() const;
+
+	K3LodSelector() {}
+	~K3LodSelector() {}
+
+private:
+
+	struct RangeResult
+	{
+		uint32_t	changed = 0;
+		uint64_t	triangles = 0;
+	};
+
+	RangeResult			selectRange(glm::mat4 const* worlds, K3LodView const& view, uint32_t const first, uint32_t const last);
+
+	std::vector<K3LodMesh>		meshes;
+	std::vector<uint32_t>		nodeMeshes;
+	std::vector<uint8_t>		nodeLods;
+	std::vector<uint32_t>		versions;
+	uint32_t			currentVersion = 1;
+	uint32_t			changedCount = 0;
+	uint64_t			triangleCount = 0;
+	float				threshold = K3_LOD_PIXEL_ERROR;
+	float				hysteresis = K3_LOD_HYSTERESIS;
+
+};
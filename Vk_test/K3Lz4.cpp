@@ -0,0 +1,162 @@
+#include "K3Lz4.h"
+#include <cstring>
+
+#define K3_LZ4_NO_POSITION	0xFFFFFFFFu
+
+static uint32_t		read32(uint8_t const* bytes)
+{
+	uint32_t	value;
+
+	std::memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+static uint32_t		hash32(uint32_t const sequence)
+{
+	return (sequence * 2654435761u) >> (32 - K3_LZ4_HASH_BITS);
+}
+
+// Token nibble, then 255 per full byte of the rest
+static uint8_t*		writeLength(uint8_t* out, size_t length)
+{
+	for (length -= 15; length >= 255; length -= 255)
+		*out++ = 255;
+	*out++ = static_cast<uint8_t>(length);
+	return out;
+}
+
+// False when the lengths run past the end of the input or past limit
+static bool		readLength(uint8_t const* src, size_t const srcSize, size_t& position, size_t& length, size_t const limit)
+{
+	uint8_t		byte;
+
+	do {
+		if (position >= srcSize)
+			return false;
+		byte = src[position++];
+		length += byte;
+		if (length > limit)
+			return false;
+	} while (byte == 255);
+	return true;
+}
+
+size_t		K3Lz4::getBound(size_t const size)
+{
+	return size + size / 255 + 16;
+}
+
+/* The format wants the last K3_LZ4_LAST_LITERALS bytes as literals, and no match starting
+** in the last K3_LZ4_MATCH_LIMIT : inputs shorter than that are all literals.
+*/
+
+size_t		K3Lz4::compress(uint8_t const* src, size_t const size, uint8_t* dst, size_t const capacity)
+{
+	uint32_t	table[1 << K3_LZ4_HASH_BITS];
+	uint8_t*	out = dst;
+	uint8_t* const	outEnd = dst + capacity;
+	size_t		anchor = 0;
+	size_t		position = 0;
+
+	if (size > 0xFFFFFFFFu)
+		return 0;
+	std::memset(table, 0xFF, sizeof(table));
+	while (size >= K3_LZ4_MATCH_LIMIT && position + K3_LZ4_MATCH_LIMIT <= size) {
+		uint32_t const	sequence = read32(src + position);
+		uint32_t const	slot = hash32(sequence);
+		size_t		candidate = table[slot];
+
+		table[slot] = static_cast<uint32_t>(position);
+		if (candidate == K3_LZ4_NO_POSITION || position - candidate > K3_LZ4_MAX_OFFSET || read32(src + candidate) != sequence) {
+			position++;
+			continue;
+		}
+		// Literals that also match are better off in the match
+		while (position > anchor && candidate > 0 && src[position - 1] == src[candidate - 1]) {
+			position--;
+			candidate--;
+		}
+
+		size_t		length = K3_LZ4_MIN_MATCH;
+		size_t const	literals = position - anchor;
+		size_t const	offset = position - candidate;
+
+		while (position + length < size - K3_LZ4_LAST_LITERALS && src[candidate + length] == src[position + length])
+			length++;
+		if (static_cast<size_t>(outEnd - out) < 1 + literals + literals / 255 + 1 + 2 + (length - K3_LZ4_MIN_MATCH) / 255 + 1)
+			return 0;
+
+		uint8_t* const	token = out++;
+		size_t const	matchLength = length - K3_LZ4_MIN_MATCH;
+
+		*token = static_cast<uint8_t>((literals < 15 ? literals : 15) << 4 | (matchLength < 15 ? matchLength : 15));
+		if (literals >= 15)
+			out = writeLength(out, literals);
+		std::memcpy(out, src + anchor, literals);
+		out += literals;
+		*out++ = static_cast<uint8_t>(offset);
+		*out++ = static_cast<uint8_t>(offset >> 8);
+		if (matchLength >= 15)
+			out = writeLength(out, matchLength);
+		position += length;
+		anchor = position;
+	}
+
+	size_t const	literals = size - anchor;
+
+	if (static_cast<size_t>(outEnd - out) < 1 + literals + literals / 255 + 1)
+		return 0;
+	*out++ = static_cast<uint8_t>((literals < 15 ? literals : 15) << 4);
+	if (literals >= 15)
+		out = writeLength(out, literals);
+	if (literals > 0)
+		std::memcpy(out, src + anchor, literals);
+	out += literals;
+	return static_cast<size_t>(out - dst);
+}
+
+bool		K3Lz4::decompress(uint8_t const* src, size_t const srcSize, uint8_t* dst, size_t const size)
+{
+	size_t		in = 0;
+	size_t		out = 0;
+
+	while (in < srcSize) {
+		uint8_t const	token = src[in++];
+		size_t		literals = token >> 4;
+
+		if (literals == 15 && !readLength(src, srcSize, in, literals, size))
+			return false;
+		if (literals > srcSize - in || literals > size - out)
+			return false;
+		if (literals > 0)
+			std::memcpy(dst + out, src + in, literals);
+		in += literals;
+		out += literals;
+		// The last sequence ends with its literals
+		if (in == srcSize)
+			return out == size;
+		if (srcSize - in < 2)
+			return false;
+
+		size_t const	offset = src[in] | static_cast<size_t>(src[in + 1]) << 8;
+		size_t		length = token & 15;
+
+		in += 2;
+		if (offset == 0 || offset > out)
+			return false;
+		if (length == 15 && !readLength(src, srcSize, in, length, size))
+			return false;
+		length += K3_LZ4_MIN_MATCH;
+		if (length > size - out)
+			return false;
+		// Overlapping matches repeat the last offset bytes, copied forward one at a time
+		if (offset >= length)
+			std::memcpy(dst + out, dst + out - offset, length);
+		else {
+			for (size_t i = 0; i < length; i++)
+				dst[out + i] = dst[out + i - offset];
+		}
+		out += length;
+	}
+	return false;
+}
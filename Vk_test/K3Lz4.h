@@ -0,0 +1,33 @@
+#pragma once
+
+# include <cstddef>
+# include <cstdint>
+
+// Matches are searched through a hash of the next 4 bytes, 2^bits entries
+#define K3_LZ4_HASH_BITS	12
+// Offsets are 16 bit, and the format wants the last literals uncompressed
+#define K3_LZ4_MAX_OFFSET	0xFFFF
+#define K3_LZ4_MIN_MATCH	4
+#define K3_LZ4_LAST_LITERALS	5
+#define K3_LZ4_MATCH_LIMIT	12
+
+/* LZ4 block format, the archive's chunk compression : a sequence is a token (literal
+** count, match length - 4, a nibble each, 15 meaning more length bytes follow), the
+** literals, then a 16 bit little endian offset back into the output. The last sequence
+** only has literals. Any LZ4 block decoder reads the output of compress().
+** Compression is the greedy single hash variant, fast rather than small, decompression
+** checks every length and offset against both buffers.
+*/
+
+class K3Lz4 {
+
+public:
+
+	// Worst case compressed size, incompressible input grows slightly
+	static size_t			getBound(size_t const size);
+	// Compressed size, 0 when it does not fit in capacity
+	static size_t			compress(uint8_t const* src, size_t const size, uint8_t* dst, size_t const capacity);
+	// False unless src decodes to exactly size bytes
+	static bool			decompress(uint8_t const* src, size_t const srcSize, uint8_t* dst, size_t const size);
+
+};
@@ -0,0 +1,313 @@
+#include "K3MemoryBudget.h"
+
+void		K3MemoryBudget::init(VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuDevice, bool const budgetExtension)
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	physicalDevice = gpuPDevice;
+	device = gpuDevice;
+	budgetQueries = budgetExtension;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+	heaps.resize(memProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+		Heap&		heap = heaps[i];
+
+		heap.stats.size = memProperties.memoryHeaps[i].size;
+		heap.stats.deviceLocal = (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		heap.stats.budget = static_cast<VkDeviceSize>(heap.stats.size
+			* (heap.stats.deviceLocal ? K3_MEMORY_BUDGET_DEVICE_FRACTION : K3_MEMORY_BUDGET_HOST_FRACTION));
+		heap.stats.usage = 0;
+		heap.stats.allocated = 0;
+		heap.evicting = 0;
+		heap.usageCounter = "heap " + std::to_string(i) + " usage MB";
+		heap.budgetCounter = "heap " + std::to_string(i) + " budget MB";
+	}
+
+	// UMA when every device local type is host visible, otherwise the host visible heap size tells ReBAR from the window
+	bool		deviceLocalOnly = false;
+
+	directMemory = K3_DIRECT_NONE;
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		VkMemoryPropertyFlags const	flags = memProperties.memoryTypes[i].propertyFlags;
+
+		if (!(flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+			continue;
+		if ((flags & K3_MEMORY_DIRECT) != K3_MEMORY_DIRECT) {
+			deviceLocalOnly = true;
+			continue;
+		}
+		if (memProperties.memoryHeaps[memProperties.memoryTypes[i].heapIndex].size > K3_MEMORY_BAR_WINDOW)
+			directMemory = K3_DIRECT_REBAR;
+		else if (directMemory == K3_DIRECT_NONE)
+			directMemory = K3_DIRECT_BAR;
+	}
+	if (directMemory != K3_DIRECT_NONE && !deviceLocalOnly)
+		directMemory = K3_DIRECT_UMA;
+	queryBudget();
+}
+
+// With the lock held. Without the extension the budget stays what init() made it
+void		K3MemoryBudget::queryBudget()
+{
+	if (!budgetQueries)
+		return;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT	budgetProperties = {};
+	VkPhysicalDeviceMemoryProperties2		properties2 = {};
+
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	properties2.pNext = &budgetProperties;
+	vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
+	for (uint32_t i = 0; i < heaps.size(); i++) {
+		heaps[i].stats.budget = budgetProperties.heapBudget[i];
+		heaps[i].stats.usage = budgetProperties.heapUsage[i];
+	}
+}
+
+// With the lock held. Memory already being evicted counts as free
+VkDeviceSize	K3MemoryBudget::getHeadroom(uint32_t const heap) const
+{
+	Heap const&		entry = heaps[heap];
+	VkDeviceSize const	usage = entry.stats.usage > entry.evicting ? entry.stats.usage - entry.evicting : 0;
+
+	return entry.stats.budget > usage ? entry.stats.budget - usage : 0;
+}
+
+/* The first matching type whose heap has the room, or the first matching one when none
+** has : over budget is still better than failing, eviction may catch up.
+*/
+
+uint32_t	K3MemoryBudget::findMemoryType(uint32_t const typeFilter, VkMemoryPropertyFlags const properties, VkDeviceSize const size) const
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+	uint32_t			fallback = UINT32_MAX;
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if (!(typeFilter & (1 << i)) || (memProperties.memoryTypes[i].propertyFlags & properties) != properties)
+			continue;
+		if (getHeadroom(memProperties.memoryTypes[i].heapIndex) >= size)
+			return i;
+		if (fallback == UINT32_MAX)
+			fallback = i;
+	}
+	if (fallback == UINT32_MAX)
+		throw std::runtime_error("Failed to find a suitable memory type for buffer memory allocation !");
+	return fallback;
+}
+
+/* With the lock held. Evictable allocations of the heap under the given priority, lowest
+** priority then oldest use first, until needed bytes are on their way out.
+*/
+
+void		K3MemoryBudget::pickVictims(uint32_t const heap, VkDeviceSize const needed, K3MemoryPriority const below,
+				std::vector<Evictor>& victims)
+{
+	std::vector<std::pair<VkDeviceMemory, Allocation*>>	candidates;
+	VkDeviceSize						freed = 0;
+
+	for (auto& allocation : allocations) {
+		if (allocation.second.heap == heap && allocation.second.evict && !allocation.second.evicting
+			&& allocation.second.priority < below && allocation.second.priority != K3_MEMORY_CRITICAL)
+			candidates.push_back({ allocation.first, &allocation.second });
+	}
+	std::sort(candidates.begin(), candidates.end(), [](std::pair<VkDeviceMemory, Allocation*> const& a, std::pair<VkDeviceMemory, Allocation*> const& b) {
+		if (a.second->priority != b.second->priority)
+			return a.second->priority < b.second->priority;
+		return a.second->lastUse < b.second->lastUse;
+	});
+	for (auto& candidate : candidates) {
+		if (freed >= needed)
+			break;
+		candidate.second->evicting = true;
+		heaps[heap].evicting += candidate.second->size;
+		freed += candidate.second->size;
+		victims.push_back(candidate.second->evict);
+		evictedCount++;
+	}
+}
+
+/* Makes room first when the chosen heap is short of it, with lower priority allocations
+** only. The evictor is kept for as long as the memory is allocated.
+*/
+
+VkDeviceMemory	K3MemoryBudget::allocate(VkMemoryRequirements const& requirements, VkMemoryPropertyFlags const properties,
+				K3MemoryPriority const priority, Evictor const& evict)
+{
+	uint32_t const		type = findMemoryType(requirements.memoryTypeBits, properties, requirements.size);
+	uint32_t const		heap = memProperties.memoryTypes[type].heapIndex;
+	std::vector<Evictor>	victims;
+	VkDeviceMemory		memory;
+
+	{
+		std::lock_guard<std::mutex>	lock(mutex);
+		VkDeviceSize const		headroom = getHeadroom(heap);
+
+		if (headroom < requirements.size)
+			pickVictims(heap, requirements.size - headroom, priority, victims);
+	}
+	for (Evictor const& victim : victims)
+		victim();
+
+	VkMemoryAllocateInfo	allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = type;
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate device memory !");
+	track(memory, requirements.size, heap, priority, evict);
+	return memory;
+}
+
+/* Only from a matching type whose heap has the room, and without evicting anything.
+** VK_NULL_HANDLE, also when the driver is out of memory, tells the caller to fall back.
+*/
+
+VkDeviceMemory	K3MemoryBudget::tryAllocate(VkMemoryRequirements const& requirements, VkMemoryPropertyFlags const properties,
+				K3MemoryPriority const priority, Evictor const& evict)
+{
+	uint32_t		type = UINT32_MAX;
+	VkDeviceMemory		memory;
+
+	{
+		std::lock_guard<std::mutex>	lock(mutex);
+
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount && type == UINT32_MAX; i++) {
+			if ((requirements.memoryTypeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties
+				&& getHeadroom(memProperties.memoryTypes[i].heapIndex) >= requirements.size)
+				type = i;
+		}
+	}
+	if (type == UINT32_MAX)
+		return VK_NULL_HANDLE;
+
+	VkMemoryAllocateInfo	allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = type;
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	track(memory, requirements.size, memProperties.memoryTypes[type].heapIndex, priority, evict);
+	return memory;
+}
+
+void		K3MemoryBudget::track(VkDeviceMemory const memory, VkDeviceSize const size, uint32_t const heap,
+				K3MemoryPriority const priority, Evictor const& evict)
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	allocations[memory] = { size, heap, priority, currentFrame, evict, false };
+	heaps[heap].stats.allocated += size;
+	heaps[heap].stats.usage += size;
+}
+
+// The memory must no longer be in use, like vkFreeMemory
+void		K3MemoryBudget::free(VkDeviceMemory const memory)
+{
+	if (memory == VK_NULL_HANDLE)
+		return;
+	vkFreeMemory(device, memory, nullptr);
+
+	std::lock_guard<std::mutex>	lock(mutex);
+	auto				found = allocations.find(memory);
+
+	if (found == allocations.end())
+		return;
+	Heap&		heap = heaps[found->second.heap];
+
+	heap.stats.allocated -= found->second.size;
+	heap.stats.usage -= std::min(heap.stats.usage, found->second.size);
+	if (found->second.evicting)
+		heap.evicting -= std::min(heap.evicting, found->second.size);
+	allocations.erase(found);
+}
+
+// Marks the allocation used this frame, the least recently used go first within a priority
+void		K3MemoryBudget::touch(VkDeviceMemory const memory)
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+	auto				found = allocations.find(memory);
+
+	if (found != allocations.end())
+		found->second.lastUse = currentFrame;
+}
+
+/* Whether a matching type's heap takes size more bytes and stays under the eviction target,
+** which keeps what comes back from being evicted again by the next update().
+*/
+
+bool		K3MemoryBudget::hasRoom(VkDeviceSize const size, VkMemoryPropertyFlags const properties) const
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		Heap const&		heap = heaps[memProperties.memoryTypes[i].heapIndex];
+		VkDeviceSize const	target = static_cast<VkDeviceSize>(heap.stats.budget * K3_MEMORY_EVICT_TARGET);
+		VkDeviceSize const	usage = heap.stats.usage > heap.evicting ? heap.stats.usage - heap.evicting : 0;
+
+		if ((memProperties.memoryTypes[i].propertyFlags & properties) == properties && usage + size <= target)
+			return true;
+	}
+	return false;
+}
+
+// Once per frame : refreshes the budget and evicts whatever a heap is over it by, and a margin
+void		K3MemoryBudget::update(uint64_t const frame)
+{
+	std::vector<Evictor>	victims;
+
+	{
+		std::lock_guard<std::mutex>	lock(mutex);
+
+		currentFrame = frame;
+		queryBudget();
+		for (uint32_t i = 0; i < heaps.size(); i++) {
+			VkDeviceSize const	usage = heaps[i].stats.usage > heaps[i].evicting ? heaps[i].stats.usage - heaps[i].evicting : 0;
+			VkDeviceSize const	target = static_cast<VkDeviceSize>(heaps[i].stats.budget * K3_MEMORY_EVICT_TARGET);
+
+			if (usage > heaps[i].stats.budget)
+				pickVictims(i, usage - target, K3_MEMORY_CRITICAL, victims);
+		}
+	}
+	for (Evictor const& victim : victims)
+		victim();
+}
+
+// Heaps without anything allocated from this process are left out
+void		K3MemoryBudget::report(K3Profiler& profiler) const
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	for (Heap const& heap : heaps) {
+		if (heap.stats.usage == 0 && heap.stats.allocated == 0)
+			continue;
+		profiler.setCounter(heap.usageCounter.c_str(), heap.stats.usage / (1024.0 * 1024.0));
+		profiler.setCounter(heap.budgetCounter.c_str(), heap.stats.budget / (1024.0 * 1024.0));
+	}
+}
+
+uint32_t	K3MemoryBudget::getHeapCount() const
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	return static_cast<uint32_t>(heaps.size());
+}
+
+K3HeapBudget	K3MemoryBudget::getHeap(uint32_t const heap) const
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	return heaps[heap].stats;
+}
+
+uint32_t	K3MemoryBudget::getEvictedCount() const
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	return evictedCount;
+}
+
+K3DirectMemory	K3MemoryBudget::getDirectMemory() const
+{
+	return directMemory;
+}
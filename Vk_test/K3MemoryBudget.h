@@ -0,0 +1,128 @@
+#pragma once
+
+# include "K3Vk.h"
+# include <mutex>
+# include <unordered_map>
+
+// Share of a heap taken as the budget without VK_EXT_memory_budget, the rest is left to the driver and other processes
+#define K3_MEMORY_BUDGET_DEVICE_FRACTION	0.8
+#define K3_MEMORY_BUDGET_HOST_FRACTION		0.5
+// Eviction brings a heap down to this share of its budget, so the next allocations do not evict again right away
+#define K3_MEMORY_EVICT_TARGET			0.9
+// Device memory the CPU writes in place, mapped
+#define K3_MEMORY_DIRECT			(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+// Size of the PCI BAR window without resizable BAR, a larger host visible device local heap means ReBAR
+#define K3_MEMORY_BAR_WINDOW			(256ull * 1024 * 1024)
+
+// Eviction order, lowest first. Critical allocations are never evicted
+enum K3MemoryPriority
+{
+	K3_MEMORY_STREAMING = 0,
+	K3_MEMORY_NORMAL = 1,
+	K3_MEMORY_CRITICAL = 2
+};
+
+// How much of the device memory the CPU can write directly (K3_MEMORY_DIRECT)
+enum K3DirectMemory
+{
+	K3_DIRECT_NONE = 0,
+	// The 256 MB window only, kept for the per frame data
+	K3_DIRECT_BAR = 1,
+	// Resizable BAR, the whole device memory
+	K3_DIRECT_REBAR = 2,
+	// Integrated devices, all memory is both
+	K3_DIRECT_UMA = 3
+};
+
+struct K3HeapBudget
+{
+	VkDeviceSize	size;
+	VkDeviceSize	budget;
+	// The driver's figure for the whole process with the extension, the tracked allocations otherwise
+	VkDeviceSize	usage;
+	// What went through allocate() and is not freed yet
+	VkDeviceSize	allocated;
+	bool		deviceLocal;
+};
+
+/* Device memory allocations with a budget per heap. The budget and usage come from
+** VK_EXT_memory_budget when the device has it, refreshed every update(), otherwise from a
+** fixed share of the heap size and the allocations made here.
+** Memory types are picked among the matching ones by heap room, the first matching type
+** is only a fallback. tryAllocate() never goes over budget nor evicts, it is for memory the
+** caller has a fallback for, like K3_MEMORY_DIRECT. An allocation given an evictor can be
+** evicted : when a heap goes over budget, or an allocation of a higher priority needs the
+** room, evictors are called by priority then least recent use (touch()). An evictor
+** releases its resource the way its owner sees fit, the memory only counts as gone once
+** free() is called. hasRoom() tells the owner when it can load the resource again without
+** going past the eviction target. Thread safe, evictors are called without the lock held.
+*/
+
+class K3MemoryBudget {
+
+public:
+
+	typedef std::function<void()>	Evictor;
+
+	void				init(VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuDevice, bool const budgetExtension);
+	uint32_t			findMemoryType(uint32_t const typeFilter, VkMemoryPropertyFlags const properties, VkDeviceSize const size) const;
+	VkDeviceMemory			allocate(VkMemoryRequirements const& requirements, VkMemoryPropertyFlags const properties,
+						K3MemoryPriority const priority, Evictor const& evict = nullptr);
+	VkDeviceMemory			tryAllocate(VkMemoryRequirements const& requirements, VkMemoryPropertyFlags const properties,
+						K3MemoryPriority const priority, Evictor const& evict = nullptr);
+	void				free(VkDeviceMemory const memory);
+	void				touch(VkDeviceMemory const memory);
+	bool				hasRoom(VkDeviceSize const size, VkMemoryPropertyFlags const properties) const;
+	void				update(uint64_t const frame);
+	void				report(K3Profiler& profiler) const;
+	uint32_t			getHeapCount() const;
+	K3HeapBudget			getHeap(uint32_t const heap) const;
+	uint32_t			getEvictedCount() const;
+	K3DirectMemory			getDirectMemory() const;
+
+	K3MemoryBudget() {}
+	~K3MemoryBudget() {}
+
+	K3MemoryBudget(K3MemoryBudget const&) = delete;
+	K3MemoryBudget&			operator=(K3MemoryBudget const&) = delete;
+
+private:
+
+	struct Allocation
+	{
+		VkDeviceSize		size;
+		uint32_t		heap;
+		K3MemoryPriority	priority;
+		uint64_t		lastUse;
+		Evictor			evict;
+		bool			evicting;
+	};
+
+	// The counter names live as long as the budget, the profiler keys counters by address
+	struct Heap
+	{
+		K3HeapBudget		stats;
+		VkDeviceSize		evicting;
+		std::string		usageCounter;
+		std::string		budgetCounter;
+	};
+
+	void				queryBudget();
+	void				track(VkDeviceMemory const memory, VkDeviceSize const size, uint32_t const heap,
+						K3MemoryPriority const priority, Evictor const& evict);
+	VkDeviceSize			getHeadroom(uint32_t const heap) const;
+	void				pickVictims(uint32_t const heap, VkDeviceSize const needed, K3MemoryPriority const below,
+						std::vector<Evictor>& victims);
+
+	VkPhysicalDevice		physicalDevice = VK_NULL_HANDLE;
+	VkDevice			device = VK_NULL_HANDLE;
+	bool				budgetQueries = false;
+	K3DirectMemory			directMemory = K3_DIRECT_NONE;
+	VkPhysicalDeviceMemoryProperties	memProperties = {};
+	std::vector<Heap>		heaps;
+	std::unordered_map<VkDeviceMemory, Allocation>	allocations;
+	uint64_t			currentFrame = 0;
+	uint32_t			evictedCount = 0;
+	mutable std::mutex		mutex;
+
+};
@@ -0,0 +1,274 @@
+#include "K3MeshOptimizer.h"
+#include <cmath>
+
+// Scoring of Forsyth's "Linear-Speed Vertex Cache Optimisation"
+#define K3_CACHE_DECAY_POWER	1.5f
+#define K3_LAST_TRIANGLE_SCORE	0.75f
+#define K3_VALENCE_BOOST_SCALE	2.0f
+#define K3_VALENCE_BOOST_POWER	0.5f
+#define K3_NO_TRIANGLE		0xFFFFFFFFu
+#define K3_NO_VERTEX		0xFFFFFFFFu
+
+static float	vertexScore(int32_t const cachePosition, uint32_t const liveTriangles)
+{
+	float		score = 0.0f;
+
+	if (liveTriangles == 0)
+		return -1.0f;
+	if (cachePosition >= 0) {
+		// The triangle just emitted, a fixed score so its own vertices are not favoured
+		if (cachePosition < 3)
+			score = K3_LAST_TRIANGLE_SCORE;
+		else
+			score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / (K3_VERTEX_CACHE_SCORE_SIZE - 3), K3_CACHE_DECAY_POWER);
+	}
+	// Vertices with few triangles left are worth finishing off
+	return score + K3_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(liveTriangles), -K3_VALENCE_BOOST_POWER);
+}
+
+// A vertex is in the FIFO while fewer than cacheSize misses happened since its own
+K3VertexCacheStats	K3MeshOptimizer::analyzeVertexCache(uint32_t const* indices, size_t const indexCount, uint32_t const vertexCount,
+				uint32_t const cacheSize)
+{
+	K3VertexCacheStats	stats;
+	std::vector<uint32_t>	timestamps(vertexCount, 0);
+	uint32_t		time = cacheSize + 1;
+	uint32_t		referenced = 0;
+
+	for (size_t i = 0; i < indexCount; i++) {
+		uint32_t const	vertex = indices[i];
+
+		if (timestamps[vertex] == 0)
+			referenced++;
+		if (time - timestamps[vertex] > cacheSize) {
+			timestamps[vertex] = time++;
+			stats.transformed++;
+		}
+	}
+	if (indexCount >= 3)
+		stats.acmr = static_cast<float>(stats.transformed) / static_cast<float>(indexCount / 3);
+	if (referenced > 0)
+		stats.atvr = static_cast<float>(stats.transformed) / static_cast<float>(referenced);
+	return stats;
+}
+
+/* Each vertex keeps the list of its triangles still to emit. After a triangle is emitted
+** only the vertices of the simulated cache change score, so the next triangle is searched
+** among theirs. When none is left (a dead end), the next one in input order is taken.
+*/
+
+void		K3MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t const indexCount, uint32_t const vertexCount)
+{
+	uint32_t const		triangleCount = static_cast<uint32_t>(indexCount / 3);
+	std::vector<uint32_t>	liveTriangles(vertexCount, 0);
+	std::vector<uint32_t>	offsets(vertexCount + 1, 0);
+	std::vector<uint32_t>	adjacency(triangleCount * 3);
+	std::vector<float>	vertexScores(vertexCount);
+	std::vector<float>	triangleScores(triangleCount, 0.0f);
+	std::vector<bool>	emitted(triangleCount, false);
+	std::vector<int32_t>	cachePositions(vertexCount, -1);
+	std::vector<uint32_t>	output;
+	uint32_t		cache[K3_VERTEX_CACHE_SCORE_SIZE + 3];
+	uint32_t		cacheCount = 0;
+	uint32_t		deadEndCursor = 0;
+	uint32_t		best = K3_NO_TRIANGLE;
+
+	if (triangleCount == 0)
+		return;
+	for (uint32_t i = 0; i < triangleCount * 3; i++) {
+		liveTriangles[indices[i]]++;
+	}
+	for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+		offsets[vertex + 1] = offsets[vertex] + liveTriangles[vertex];
+		vertexScores[vertex] = vertexScore(-1, liveTriangles[vertex]);
+	}
+	std::vector<uint32_t>	fill(offsets.begin(), offsets.end() - 1);
+	for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			uint32_t const	vertex = indices[triangle * 3 + corner];
+
+			adjacency[fill[vertex]++] = triangle;
+			triangleScores[triangle] += vertexScores[vertex];
+		}
+		if (best == K3_NO_TRIANGLE || triangleScores[triangle] > triangleScores[best])
+			best = triangle;
+	}
+
+	output.reserve(triangleCount * 3);
+	for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+		if (best == K3_NO_TRIANGLE) {
+			while (emitted[deadEndCursor])
+				deadEndCursor++;
+			best = deadEndCursor;
+		}
+
+		uint32_t const*	corners = indices + best * 3;
+		uint32_t	newCache[K3_VERTEX_CACHE_SCORE_SIZE + 3];
+		uint32_t	newCount = 0;
+
+		emitted[best] = true;
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			uint32_t const	vertex = corners[corner];
+			uint32_t* const	triangles = adjacency.data() + offsets[vertex];
+
+			output.push_back(vertex);
+			// Swap removal, the order of a vertex's triangles does not matter
+			for (uint32_t i = 0; i < liveTriangles[vertex]; i++) {
+				if (triangles[i] == best) {
+					triangles[i] = triangles[--liveTriangles[vertex]];
+					break;
+				}
+			}
+			if (std::find(newCache, newCache + newCount, vertex) == newCache + newCount)
+				newCache[newCount++] = vertex;
+		}
+		for (uint32_t i = 0; i < cacheCount; i++) {
+			if (std::find(newCache, newCache + newCount, cache[i]) == newCache + newCount)
+				newCache[newCount++] = cache[i];
+		}
+
+		// Vertices pushed out of the cache are rescored too, with no cache bonus
+		for (uint32_t i = 0; i < newCount; i++) {
+			uint32_t const	vertex = newCache[i];
+			uint32_t const*	triangles = adjacency.data() + offsets[vertex];
+
+			cachePositions[vertex] = i < K3_VERTEX_CACHE_SCORE_SIZE ? static_cast<int32_t>(i) : -1;
+
+			float const	score = vertexScore(cachePositions[vertex], liveTriangles[vertex]);
+			float const	delta = score - vertexScores[vertex];
+
+			vertexScores[vertex] = score;
+			for (uint32_t t = 0; t < liveTriangles[vertex]; t++) {
+				triangleScores[triangles[t]] += delta;
+			}
+		}
+		cacheCount = std::min(newCount, static_cast<uint32_t>(K3_VERTEX_CACHE_SCORE_SIZE));
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		best = K3_NO_TRIANGLE;
+		for (uint32_t i = 0; i < cacheCount; i++) {
+			uint32_t const*	triangles = adjacency.data() + offsets[cache[i]];
+
+			for (uint32_t t = 0; t < liveTriangles[cache[i]]; t++) {
+				if (best == K3_NO_TRIANGLE || triangleScores[triangles[t]] > triangleScores[best])
+					best = triangles[t];
+			}
+		}
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+/* A cluster starts on a triangle missing all its vertices in the FIFO cache, where the
+** order restarts anyway, so moving clusters around costs close to nothing in cache misses.
+** Clusters far out along their own facing direction are the likely occluders, they go first.
+*/
+
+void		K3MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t const indexCount, glm::vec3 const* positions, uint32_t const vertexCount)
+{
+	struct Cluster
+	{
+		uint32_t	first;
+		uint32_t	count;
+		float		sortKey;
+	};
+
+	uint32_t const		triangleCount = static_cast<uint32_t>(indexCount / 3);
+	std::vector<uint32_t>	timestamps(vertexCount, 0);
+	uint32_t		time = K3_VERTEX_CACHE_SIZE + 1;
+	std::vector<Cluster>	clusters;
+	glm::vec3		meshCentroid(0.0f);
+	float			meshArea = 0.0f;
+
+	if (triangleCount < 2 * K3_OVERDRAW_CLUSTER_MIN)
+		return;
+	clusters.push_back({ 0, 0, 0.0f });
+	for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+		uint32_t	misses = 0;
+
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			uint32_t const	vertex = indices[triangle * 3 + corner];
+
+			if (time - timestamps[vertex] > K3_VERTEX_CACHE_SIZE) {
+				timestamps[vertex] = time++;
+				misses++;
+			}
+		}
+		if (misses == 3 && triangle - clusters.back().first >= K3_OVERDRAW_CLUSTER_MIN)
+			clusters.push_back({ triangle, 0, 0.0f });
+	}
+	if (clusters.size() < 2)
+		return;
+
+	std::vector<glm::vec3>	centroids(clusters.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3>	normals(clusters.size(), glm::vec3(0.0f));
+	std::vector<float>	areas(clusters.size(), 0.0f);
+	for (size_t c = 0; c < clusters.size(); c++) {
+		uint32_t const	end = c + 1 < clusters.size() ? clusters[c + 1].first : triangleCount;
+
+		clusters[c].count = end - clusters[c].first;
+		for (uint32_t triangle = clusters[c].first; triangle < end; triangle++) {
+			glm::vec3 const&	p0 = positions[indices[triangle * 3]];
+			glm::vec3 const&	p1 = positions[indices[triangle * 3 + 1]];
+			glm::vec3 const&	p2 = positions[indices[triangle * 3 + 2]];
+			glm::vec3 const		normal = glm::cross(p1 - p0, p2 - p0);
+			float const		area = glm::length(normal);
+
+			centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+			normals[c] += normal;
+			areas[c] += area;
+		}
+		meshCentroid += centroids[c];
+		meshArea += areas[c];
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+	for (size_t c = 0; c < clusters.size(); c++) {
+		float const	normalLength = glm::length(normals[c]);
+
+		if (areas[c] > 0.0f && normalLength > 0.0f)
+			clusters[c].sortKey = glm::dot(centroids[c] / areas[c] - meshCentroid, normals[c] / normalLength);
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [](Cluster const& a, Cluster const& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t>	output;
+	output.reserve(triangleCount * 3);
+	for (Cluster const& cluster : clusters) {
+		output.insert(output.end(), indices + cluster.first * 3, indices + (cluster.first + cluster.count) * 3);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+// Unreferenced vertices keep their relative order after the referenced ones
+void		K3MeshOptimizer::optimizeVertexFetch(std::vector<uint32_t>& remap, uint32_t* indices, size_t const indexCount, uint32_t const vertexCount)
+{
+	uint32_t	next = 0;
+
+	remap.assign(vertexCount, K3_NO_VERTEX);
+	for (size_t i = 0; i < indexCount; i++) {
+		uint32_t&	vertex = indices[i];
+
+		if (remap[vertex] == K3_NO_VERTEX)
+			remap[vertex] = next++;
+		vertex = remap[vertex];
+	}
+	for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+		if (remap[vertex] == K3_NO_VERTEX)
+			remap[vertex] = next++;
+	}
+}
+
+VkIndexType	K3MeshOptimizer::packIndices(std::vector<uint8_t>& packed, uint32_t const* indices, size_t const indexCount, uint32_t const vertexCount)
+{
+	if (vertexCount > K3_INDEX16_MAX_VERTICES) {
+		packed.resize(indexCount * sizeof(uint32_t));
+		memcpy(packed.data(), indices, packed.size());
+		return VK_INDEX_TYPE_UINT32;
+	}
+	packed.resize(indexCount * sizeof(uint16_t));
+	for (size_t i = 0; i < indexCount; i++) {
+		uint16_t const	index = static_cast<uint16_t>(indices[i]);
+
+		memcpy(packed.data() + i * sizeof(uint16_t), &index, sizeof(uint16_t));
+	}
+	return VK_INDEX_TYPE_UINT16;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+# include "K3Vk.h"
+
+// FIFO post-transform cache the statistics are simulated with, a common hardware size
+#define K3_VERTEX_CACHE_SIZE	16
+// LRU cache the vertex cache optimization scores against, larger than any real one
+#define K3_VERTEX_CACHE_SCORE_SIZE	32
+// Overdraw ordering splits the triangles where the cache order already restarts
+#define K3_OVERDRAW_CLUSTER_MIN	16
+// Largest vertex count still indexed with 16 bits, 0xFFFF is the primitive restart value
+#define K3_INDEX16_MAX_VERTICES	0xFFFF
+
+// ACMR is transformed vertices per triangle (0.5 to 3), ATVR per referenced vertex (1 at best)
+struct K3VertexCacheStats
+{
+	uint32_t	transformed = 0;
+	float		acmr = 0.0f;
+	float		atvr = 0.0f;
+};
+
+/* Triangle list optimizations, run at load time on the engine meshes and usable as is by
+** offline tools. The usual order is optimizeVertexCache() then optimizeOverdraw() on each
+** index range drawn on its own, then optimizeVertexFetch() over the whole index buffer.
+** - optimizeVertexCache() : Forsyth's linear speed reordering, greedily emits the triangle
+**   whose vertices score best in a simulated LRU cache.
+** - optimizeOverdraw() : splits the cache ordered triangles in clusters where the cache
+**   restarts anyway, then sorts the clusters so the ones facing out of the mesh go first.
+** - optimizeVertexFetch() : renumbers vertices in order of first use, the remap applies to
+**   every vertex stream with remapVertices().
+** packIndices() picks 16 bit indices whenever the vertex count allows it.
+*/
+
+class K3MeshOptimizer {
+
+public:
+
+	static K3VertexCacheStats	analyzeVertexCache(uint32_t const* indices, size_t const indexCount, uint32_t const vertexCount,
+						uint32_t const cacheSize = K3_VERTEX_CACHE_SIZE);
+	static void			optimizeVertexCache(uint32_t* indices, size_t const indexCount, uint32_t const vertexCount);
+	static void			optimizeOverdraw(uint32_t* indices, size_t const indexCount, glm::vec3 const* positions, uint32_t const vertexCount);
+	static void			optimizeVertexFetch(std::vector<uint32_t>& remap, uint32_t* indices, size_t const indexCount, uint32_t const vertexCount);
+	static VkIndexType		packIndices(std::vector<uint8_t>& packed, uint32_t const* indices, size_t const indexCount, uint32_t const vertexCount);
+
+	// remap[old] is the new position of each vertex, as given by optimizeVertexFetch()
+	template <typename T>
+	static void			remapVertices(std::vector<T>& vertexData, std::vector<uint32_t> const& remap) {
+		std::vector<T>	remapped(vertexData.size());
+
+		for (size_t i = 0; i < vertexData.size(); i++) {
+			remapped[remap[i]] = vertexData[i];
+		}
+		vertexData.swap(remapped);
+	}
+
+};
@@ -0,0 +1,182 @@
+#include "K3Meshlet.h"
+#include <cmath>
+
+/* Greedy in index order : a meshlet takes triangles until one would overflow its vertex or
+** triangle budget. Cache ordered indices (K3MeshOptimizer) keep the meshlets compact.
+** Returns the number of meshlets added, flipNormals for clockwise front faces.
+*/
+
+uint32_t	K3MeshletMesh::append(uint32_t const* indices, uint32_t const firstIndex, uint32_t const indexCount,
+				glm::vec3 const* positions, bool const flipNormals)
+{
+	size_t const		firstMeshlet = meshlets.size();
+	K3Meshlet		meshlet = {};
+	uint32_t		local[3];
+
+	meshlet.firstIndex = firstIndex;
+	meshlet.vertexOffset = static_cast<uint32_t>(vertices.size());
+	meshlet.triangleOffset = static_cast<uint32_t>(triangles.size());
+	for (uint32_t i = firstIndex; i + 2 < firstIndex + indexCount; i += 3) {
+		uint32_t	newVertices = 0;
+
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			uint32_t const*	meshletVertices = vertices.data() + meshlet.vertexOffset;
+			bool		found = std::find(meshletVertices, meshletVertices + meshlet.vertexCount, indices[i + corner])
+						!= meshletVertices + meshlet.vertexCount;
+
+			for (uint32_t previous = 0; previous < corner && !found; previous++) {
+				found = indices[i + previous] == indices[i + corner];
+			}
+			newVertices += found ? 0 : 1;
+		}
+		if (meshlet.vertexCount + newVertices > K3_MESHLET_MAX_VERTICES || meshlet.triangleCount == K3_MESHLET_MAX_TRIANGLES) {
+			computeBounds(meshlet, positions, flipNormals);
+			meshlets.push_back(meshlet);
+			meshlet = {};
+			meshlet.firstIndex = i;
+			meshlet.vertexOffset = static_cast<uint32_t>(vertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(triangles.size());
+		}
+		for (uint32_t corner = 0; corner < 3; corner++) {
+			uint32_t const*	meshletVertices = vertices.data() + meshlet.vertexOffset;
+
+			local[corner] = static_cast<uint32_t>(std::find(meshletVertices, meshletVertices + meshlet.vertexCount, indices[i + corner]) - meshletVertices);
+			if (local[corner] == meshlet.vertexCount) {
+				vertices.push_back(indices[i + corner]);
+				meshlet.vertexCount++;
+			}
+		}
+		triangles.push_back(local[0] | (local[1] << 8) | (local[2] << 16));
+		meshlet.triangleCount++;
+	}
+	if (meshlet.triangleCount > 0) {
+		computeBounds(meshlet, positions, flipNormals);
+		meshlets.push_back(meshlet);
+	}
+	return static_cast<uint32_t>(meshlets.size() - firstMeshlet);
+}
+
+/* The sphere is centered on the bounding box. The apex is moved back along the axis until
+** it lies behind every triangle's plane, which keeps the cone test conservative.
+*/
+
+void		K3MeshletMesh::computeBounds(K3Meshlet& meshlet, glm::vec3 const* positions, bool const flipNormals) const
+{
+	uint32_t const*		meshletVertices = vertices.data() + meshlet.vertexOffset;
+	uint32_t const*		meshletTriangles = triangles.data() + meshlet.triangleOffset;
+	glm::vec3		boxMin = positions[meshletVertices[0]];
+	glm::vec3		boxMax = boxMin;
+	glm::vec3		axis(0.0f);
+	float			minDot = 1.0f;
+	K3FrameVector<glm::vec3>	normals(meshlet.triangleCount);
+	K3FrameVector<glm::vec3>	corners(meshlet.triangleCount);
+
+	for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+		glm::vec3 const&	position = positions[meshletVertices[i]];
+
+		boxMin = glm::vec3(std::min(boxMin.x, position.x), std::min(boxMin.y, position.y), std::min(boxMin.z, position.z));
+		boxMax = glm::vec3(std::max(boxMax.x, position.x), std::max(boxMax.y, position.y), std::max(boxMax.z, position.z));
+	}
+	meshlet.center = (boxMin + boxMax) * 0.5f;
+	meshlet.radius = 0.0f;
+	for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+		meshlet.radius = std::max(meshlet.radius, glm::length(positions[meshletVertices[i]] - meshlet.center));
+	}
+
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+		glm::vec3 const&	p0 = positions[meshletVertices[meshletTriangles[t] & 0xFF]];
+		glm::vec3 const&	p1 = positions[meshletVertices[(meshletTriangles[t] >> 8) & 0xFF]];
+		glm::vec3 const&	p2 = positions[meshletVertices[(meshletTriangles[t] >> 16) & 0xFF]];
+		glm::vec3		normal = glm::cross(p1 - p0, p2 - p0);
+		float const		area = glm::length(normal);
+
+		// Degenerate triangles face nowhere, they take no part in the cone
+		normals[t] = area > 0.0f ? normal * ((flipNormals ? -1.0f : 1.0f) / area) : glm::vec3(0.0f);
+		corners[t] = p0;
+		axis += normals[t];
+	}
+	if (glm::length(axis) > 0.0f) {
+		axis = glm::normalize(axis);
+		for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+			if (glm::length(normals[t]) > 0.0f)
+				minDot = std::min(minDot, glm::dot(normals[t], axis));
+		}
+	}
+	else
+		minDot = -1.0f;
+	meshlet.coneApex = meshlet.center;
+	if (minDot <= K3_MESHLET_CONE_MIN_DOT) {
+		meshlet.coneAxis = glm::vec3(0.0f);
+		meshlet.coneCutoff = 1.0f;
+		return;
+	}
+
+	float		maxT = 0.0f;
+
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+		float const	dn = glm::dot(axis, normals[t]);
+
+		if (dn > 0.0f)
+			maxT = std::max(maxT, glm::dot(meshlet.center - corners[t], normals[t]) / dn);
+	}
+	meshlet.coneApex = meshlet.center - axis * maxT;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+void		K3MeshletMesh::save(std::ostream& out) const
+{
+	uint32_t const	header[5] = { K3_MESHLET_FILE_MAGIC, K3_MESHLET_FILE_VERSION, static_cast<uint32_t>(meshlets.size()),
+		static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(triangles.size()) };
+
+	out.write(reinterpret_cast<char const*>(header), sizeof(header));
+	out.write(reinterpret_cast<char const*>(meshlets.data()), meshlets.size() * sizeof(K3Meshlet));
+	out.write(reinterpret_cast<char const*>(vertices.data()), vertices.size() * sizeof(uint32_t));
+	out.write(reinterpret_cast<char const*>(triangles.data()), triangles.size() * sizeof(uint32_t));
+	if (!out)
+		throw std::runtime_error("Failed to write meshlets !");
+}
+
+void		K3MeshletMesh::load(void const* data, size_t const size)
+{
+	uint8_t const*	bytes = static_cast<uint8_t const*>(data);
+	uint32_t	header[5] = {};
+
+	if (size < sizeof(header))
+		throw std::runtime_error("Invalid meshlet file !");
+	std::memcpy(header, bytes, sizeof(header));
+	if (header[0] != K3_MESHLET_FILE_MAGIC || header[1] != K3_MESHLET_FILE_VERSION)
+		throw std::runtime_error("Invalid meshlet file !");
+	if (size < sizeof(header) + header[2] * sizeof(K3Meshlet) + (static_cast<size_t>(header[3]) + header[4]) * sizeof(uint32_t))
+		throw std::runtime_error("Truncated meshlet file !");
+	meshlets.resize(header[2]);
+	vertices.resize(header[3]);
+	triangles.resize(header[4]);
+	bytes += sizeof(header);
+	std::memcpy(meshlets.data(), bytes, meshlets.size() * sizeof(K3Meshlet));
+	bytes += meshlets.size() * sizeof(K3Meshlet);
+	std::memcpy(vertices.data(), bytes, vertices.size() * sizeof(uint32_t));
+	bytes += vertices.size() * sizeof(uint32_t);
+	std::memcpy(triangles.data(), bytes, triangles.size() * sizeof(uint32_t));
+	for (K3Meshlet const& meshlet : meshlets) {
+		if (meshlet.vertexCount > K3_MESHLET_MAX_VERTICES || meshlet.triangleCount > K3_MESHLET_MAX_TRIANGLES
+			|| static_cast<size_t>(meshlet.vertexOffset) + meshlet.vertexCount > vertices.size()
+			|| static_cast<size_t>(meshlet.triangleOffset) + meshlet.triangleCount > triangles.size())
+			throw std::runtime_error("Invalid meshlet file !");
+	}
+}
+
+std::vector<K3Meshlet> const&	K3MeshletMesh::getMeshlets() const
+{
+	return meshlets;
+}
+
+std::vector<uint32_t> const&	K3MeshletMesh::getVertices() const
+{
+	return vertices;
+}
+
+std::vector<uint32_t> const&	K3MeshletMesh::getTriangles() const
+{
+	return triangles;
+}
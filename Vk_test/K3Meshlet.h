@@ -0,0 +1,66 @@
+#pragma once
+
+# include "K3Vk.h"
+
+// Within the minimum mesh shader output limits, and local indices fit in 8 bits
+#define K3_MESHLET_MAX_VERTICES		64
+#define K3_MESHLET_MAX_TRIANGLES	124
+// Normal cones wider than this (minimum normal to axis cosine) never cull, the axis is zeroed
+#define K3_MESHLET_CONE_MIN_DOT		0.1f
+#define K3_MESHLET_FILE_MAGIC		0x4C4D334Bu
+#define K3_MESHLET_FILE_VERSION		1
+
+/* A cluster of at most K3_MESHLET_MAX_TRIANGLES triangles, laid out std430 for the culling
+** shaders. Its triangles are a contiguous range of the mesh index buffer (firstIndex, three
+** indices per triangle) for indexed draws, and a list of local vertices plus 8 bit local
+** triangles for mesh shaders.
+** The cone is meshoptimizer's : the cluster faces away from an eye at e when
+** dot(normalize(coneApex - e), coneAxis) >= coneCutoff, or for a view direction d when
+** dot(d, coneAxis) >= coneCutoff.
+*/
+
+struct K3Meshlet
+{
+	glm::vec3	center;
+	float		radius;
+	glm::vec3	coneApex;
+	float		coneCutoff;
+	glm::vec3	coneAxis;
+	uint32_t	firstIndex;
+	uint32_t	vertexOffset;
+	uint32_t	triangleOffset;
+	uint32_t	vertexCount;
+	uint32_t	triangleCount;
+};
+
+/* Meshlets of one or several index ranges of a mesh. vertices maps local vertices to the
+** mesh's, triangles packs three local indices per uint (bits 0, 8 and 16).
+** The binary format is a header (magic, version, the three counts) followed by the arrays.
+** load() reads it from memory, an asset archive entry or a whole file, and checks that every
+** meshlet's ranges are within the arrays.
+*/
+
+class K3MeshletMesh {
+
+public:
+
+	uint32_t			append(uint32_t const* indices, uint32_t const firstIndex, uint32_t const indexCount,
+						glm::vec3 const* positions, bool const flipNormals);
+	void				save(std::ostream& out) const;
+	void				load(void const* data, size_t const size);
+	std::vector<K3Meshlet> const&	getMeshlets() const;
+	std::vector<uint32_t> const&	getVertices() const;
+	std::vector<uint32_t> const&	getTriangles() const;
+
+	K3MeshletMesh() {}
+	~K3MeshletMesh() {}
+
+private:
+
+	void				computeBounds(K3Meshlet& meshlet, glm::vec3 const* positions, bool const flipNormals) const;
+
+	std::vector<K3Meshlet>		meshlets;
+	std::vector<uint32_t>		vertices;
+	std::vector<uint32_t>		triangles;
+
+};
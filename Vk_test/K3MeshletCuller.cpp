@@ -0,0 +1,678 @@
+#include "K3MeshletCuller.h"
+
+// Room for the draw counts ahead of the draw regions, keeps the regions at the largest storage offset alignment
+static VkDeviceSize const	countsSize = 256;
+
+// Bindings of the set, the same for the culling pass and the mesh shaders
+enum Binding
+{
+	BINDING_NODE_COMMANDS,
+	BINDING_WORLDS,
+	BINDING_MESHLETS,
+	BINDING_LEVELS,
+	BINDING_COUNTS,
+	BINDING_DRAWS,
+	BINDING_MESHLET_VERTICES,
+	BINDING_MESHLET_TRIANGLES,
+	BINDING_VERTICES,
+	BINDING_DEPTH_PYRAMID,
+	BINDING_COUNT
+};
+
+// The mesh shaders are only needed, and only checked, when the device has them
+bool		K3MeshletCuller::isSupported(bool const meshShaders, K3Archive const& assets)
+{
+	if (!assets.exists(K3_SHADER_DIR "meshlet_cull.comp.spv") || !assets.exists(K3_SHADER_DIR "hiz_reduce.comp.spv")
+		|| !assets.exists(K3_SHADER_DIR "hiz_reduce_ms.comp.spv"))
+		return false;
+	return !meshShaders || (assets.exists(K3_SHADER_DIR "meshlet.task.spv") && assets.exists(K3_SHADER_DIR "meshlet.mesh.spv"));
+}
+
+void		K3MeshletCuller::init(VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuDevice, K3MemoryBudget& memoryBudget, bool const meshShaders,
+				bool const drawIndirectCount, ShaderLoader const& loadShader)
+{
+	VkPhysicalDeviceProperties	properties;
+
+	device = gpuDevice;
+	budget = &memoryBudget;
+	vkGetPhysicalDeviceProperties(gpuPDevice, &properties);
+	maxDrawCount = std::min(properties.limits.maxDrawIndirectCount, static_cast<uint32_t>(K3_MAX_MESHLET_DRAWS));
+	if (drawIndirectCount)
+		drawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+	stages = VK_SHADER_STAGE_COMPUTE_BIT;
+	pyramidStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+#ifdef VK_EXT_mesh_shader
+	if (meshShaders) {
+		drawMeshTasks = (PFN_vkCmdDrawMeshTasksEXT)vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT");
+		stages |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+		pyramidStages |= VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT;
+	}
+#endif
+
+	VkDescriptorSetLayoutBinding	bindings[BINDING_COUNT] = {};
+	for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == BINDING_DEPTH_PYRAMID ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = stages;
+	}
+
+	VkDescriptorSetLayoutCreateInfo	setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = BINDING_COUNT;
+	setLayoutInfo.pBindings = bindings;
+	if (vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create meshlet descriptor set layout !");
+
+	VkPushConstantRange		pushRange = {};
+	pushRange.stageFlags = stages;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(Params);
+
+	VkPipelineLayoutCreateInfo	pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create meshlet pipeline layout !");
+
+	createPipeline(K3_SHADER_DIR "meshlet_cull.comp.spv", pipelineLayout, cullPipeline, loadShader);
+
+	// Sets are replaced whenever the buffers or the pyramid they point to are, the old ones are freed once retired
+	VkDescriptorPoolSize		poolSizes[2] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = (BINDING_COUNT - 1) * 16;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = 16;
+
+	VkDescriptorPoolCreateInfo	poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolInfo.maxSets = 16;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create meshlet descriptor pool !");
+
+	// Texels are fetched, never filtered
+	VkSamplerCreateInfo		samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &pyramidSampler) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth pyramid sampler !");
+
+	VkDescriptorSetLayoutBinding	pyramidBindings[2] = {};
+	pyramidBindings[0].binding = 0;
+	pyramidBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	pyramidBindings[0].descriptorCount = 1;
+	pyramidBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pyramidBindings[1].binding = 1;
+	pyramidBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	pyramidBindings[1].descriptorCount = 1;
+	pyramidBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	setLayoutInfo.bindingCount = 2;
+	setLayoutInfo.pBindings = pyramidBindings;
+	if (vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &pyramidSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth pyramid descriptor set layout !");
+
+	// The size of the level read, or of the part of the depth rendered to
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushRange.size = sizeof(VkExtent2D);
+	pipelineLayoutInfo.pSetLayouts = &pyramidSetLayout;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pyramidLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth pyramid pipeline layout !");
+	createPipeline(K3_SHADER_DIR "hiz_reduce.comp.spv", pyramidLayout, reducePipeline, loadShader);
+	createPipeline(K3_SHADER_DIR "hiz_reduce_ms.comp.spv", pyramidLayout, reduceMsPipeline, loadShader);
+}
+
+void		K3MeshletCuller::createPipeline(std::string const& shader, VkPipelineLayout const layout, VkPipeline& pipeline,
+				ShaderLoader const& loadShader)
+{
+	VkComputePipelineCreateInfo	pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = loadShader(shader);
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = layout;
+	VkResult const	result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+	vkDestroyShaderModule(device, pipelineInfo.stage.module, nullptr);
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to create meshlet culling pipeline !");
+}
+
+/* The meshlet data never changes once uploaded. Levels are matched on firstIndex, so each
+** level's meshlets must cover its index range and nothing else.
+*/
+
+void		K3MeshletCuller::uploadMeshlets(K3MeshletMesh const& mesh, std::vector<K3MeshletLevel> const& levels, Uploader const& upload)
+{
+	meshletData = mesh;
+	levelData = levels;
+	uploadInputs(upload);
+	levelCount = static_cast<uint32_t>(levels.size());
+	meshletCount = static_cast<uint32_t>(mesh.getMeshlets().size());
+	maxLevelMeshlets = 0;
+	for (K3MeshletLevel const& level : levels) {
+		maxLevelMeshlets = std::max(maxLevelMeshlets, level.meshletCount);
+	}
+}
+
+void		K3MeshletCuller::uploadInputs(Uploader const& upload)
+{
+	upload(meshletData.getMeshlets().data(), meshletData.getMeshlets().size() * sizeof(K3Meshlet), inputBuffers[INPUT_MESHLETS],
+		inputMemory[INPUT_MESHLETS]);
+	upload(levelData.data(), levelData.size() * sizeof(K3MeshletLevel), inputBuffers[INPUT_LEVELS], inputMemory[INPUT_LEVELS]);
+	upload(meshletData.getVertices().data(), meshletData.getVertices().size() * sizeof(uint32_t), inputBuffers[INPUT_VERTICES],
+		inputMemory[INPUT_VERTICES]);
+	upload(meshletData.getTriangles().data(), meshletData.getTriangles().size() * sizeof(uint32_t), inputBuffers[INPUT_TRIANGLES],
+		inputMemory[INPUT_TRIANGLES]);
+}
+
+/* The buffers go once the frames in flight are done with them. The set keeps pointing at
+** them, it must not be used again before reloadMeshlets() writes a new one : the command
+** buffers culling with it are to be recorded again without the culling.
+*/
+
+void		K3MeshletCuller::evictMeshlets(K3DeletionQueue& retired, uint64_t const frame)
+{
+	VkDevice const		gpuDevice = device;
+	K3MemoryBudget* const	memoryBudget = budget;
+
+	for (uint32_t i = 0; i < INPUT_COUNT; i++) {
+		VkBuffer const		oldBuffer = inputBuffers[i];
+		VkDeviceMemory const	oldMemory = inputMemory[i];
+
+		if (oldBuffer == VK_NULL_HANDLE)
+			continue;
+		retired.push(frame, [gpuDevice, memoryBudget, oldBuffer, oldMemory]() {
+			vkDestroyBuffer(gpuDevice, oldBuffer, nullptr);
+			memoryBudget->free(oldMemory);
+		});
+		inputBuffers[i] = VK_NULL_HANDLE;
+		inputMemory[i] = VK_NULL_HANDLE;
+	}
+}
+
+void		K3MeshletCuller::reloadMeshlets(Uploader const& upload, K3DeletionQueue& retired, uint64_t const frame)
+{
+	evictMeshlets(retired, frame);
+	uploadInputs(upload);
+	writeSet(retired, frame);
+}
+
+void		K3MeshletCuller::touchMeshlets() const
+{
+	for (uint32_t i = 0; i < INPUT_COUNT; i++) {
+		budget->touch(inputMemory[i]);
+	}
+}
+
+void		K3MeshletCuller::createDrawBuffer(uint32_t const regionCount)
+{
+	VkBufferCreateInfo		bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = countsSize + regionCount * K3_MAX_MESHLET_DRAWS * sizeof(VkDrawIndexedIndirectCommand);
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &drawBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create meshlet draw buffer !");
+
+	VkMemoryRequirements	memRequirements;
+	vkGetBufferMemoryRequirements(device, drawBuffer, &memRequirements);
+
+	drawMemory = budget->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, K3_MEMORY_NORMAL);
+	vkBindBufferMemory(device, drawBuffer, drawMemory, 0);
+	drawRegionCount = regionCount;
+}
+
+/* The node commands and world matrices are the renderer's per image regions, the vertices
+** its vertex buffer read as floats. Called again whenever one of them is replaced, the old
+** set and draw buffer go once the frames in flight are done with them.
+*/
+
+void		K3MeshletCuller::setInputs(VkBuffer const nodeCommands, VkBuffer const worlds, VkBuffer const vertices,
+				uint32_t const regionCount, K3DeletionQueue& retired, uint64_t const frame)
+{
+	VkDevice const		gpuDevice = device;
+	K3MemoryBudget* const	memoryBudget = budget;
+
+	if (regionCount * sizeof(uint32_t) > countsSize)
+		throw std::runtime_error("Too many swapchain images for the meshlet draw counts !");
+	if (regionCount > drawRegionCount) {
+		VkBuffer const		oldBuffer = drawBuffer;
+		VkDeviceMemory const	oldMemory = drawMemory;
+
+		if (oldBuffer != VK_NULL_HANDLE) {
+			retired.push(frame, [gpuDevice, memoryBudget, oldBuffer, oldMemory]() {
+				vkDestroyBuffer(gpuDevice, oldBuffer, nullptr);
+				memoryBudget->free(oldMemory);
+			});
+		}
+		createDrawBuffer(regionCount);
+	}
+	nodeCommandBuffer = nodeCommands;
+	worldBuffer = worlds;
+	vertexBuffer = vertices;
+	writeSet(retired, frame);
+}
+
+/* Replaces the set, the old one still bound by the frames in flight. The pyramid is only
+** written once there is one, the set is not used before. Nothing is written while the
+** meshlet data is evicted, reloadMeshlets() does it with the inputs of the time.
+*/
+
+void		K3MeshletCuller::writeSet(K3DeletionQueue& retired, uint64_t const frame)
+{
+	VkDevice const		gpuDevice = device;
+	VkDescriptorPool const	pool = descriptorPool;
+	VkDescriptorSet const	oldSet = set;
+
+	if (nodeCommandBuffer == VK_NULL_HANDLE || !isResident())
+		return;
+	if (oldSet != VK_NULL_HANDLE) {
+		retired.push(frame, [gpuDevice, pool, oldSet]() {
+			vkFreeDescriptorSets(gpuDevice, pool, 1, &oldSet);
+		});
+	}
+
+	VkDescriptorSetAllocateInfo	allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+	if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate meshlet descriptor set !");
+
+	VkDescriptorBufferInfo		infos[BINDING_COUNT] = {};
+	infos[BINDING_NODE_COMMANDS] = { nodeCommandBuffer, 0, VK_WHOLE_SIZE };
+	infos[BINDING_WORLDS] = { worldBuffer, 0, VK_WHOLE_SIZE };
+	infos[BINDING_MESHLETS] = { inputBuffers[INPUT_MESHLETS], 0, VK_WHOLE_SIZE };
+	infos[BINDING_LEVELS] = { inputBuffers[INPUT_LEVELS], 0, VK_WHOLE_SIZE };
+	infos[BINDING_COUNTS] = { drawBuffer, 0, countsSize };
+	infos[BINDING_DRAWS] = { drawBuffer, countsSize, VK_WHOLE_SIZE };
+	infos[BINDING_MESHLET_VERTICES] = { inputBuffers[INPUT_VERTICES], 0, VK_WHOLE_SIZE };
+	infos[BINDING_MESHLET_TRIANGLES] = { inputBuffers[INPUT_TRIANGLES], 0, VK_WHOLE_SIZE };
+	infos[BINDING_VERTICES] = { vertexBuffer, 0, VK_WHOLE_SIZE };
+
+	VkDescriptorImageInfo		pyramidInfo = { pyramidSampler, pyramid.view, VK_IMAGE_LAYOUT_GENERAL };
+	VkWriteDescriptorSet		writes[BINDING_COUNT] = {};
+	for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &infos[i];
+	}
+	writes[BINDING_DEPTH_PYRAMID].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[BINDING_DEPTH_PYRAMID].pBufferInfo = nullptr;
+	writes[BINDING_DEPTH_PYRAMID].pImageInfo = &pyramidInfo;
+	vkUpdateDescriptorSets(device, pyramid.view != VK_NULL_HANDLE ? BINDING_COUNT : BINDING_COUNT - 1, writes, 0, nullptr);
+}
+
+/* The pyramid of a new scene depth, called whenever the scene targets are created. The old
+** one goes once the frames in flight are done with it. The new one starts at the far plane,
+** the frames before its first build occlude nothing.
+*/
+
+void		K3MeshletCuller::setDepth(VkImageView const depthView, VkSampleCountFlagBits const depthSamples, VkExtent2D const extent,
+				Submitter const& submit, K3DeletionQueue& retired, uint64_t const frame)
+{
+	VkDevice const		gpuDevice = device;
+	K3MemoryBudget* const	memoryBudget = budget;
+	Pyramid const		oldPyramid = pyramid;
+
+	if (oldPyramid.image != VK_NULL_HANDLE) {
+		retired.push(frame, [gpuDevice, memoryBudget, oldPyramid]() {
+			destroyPyramid(gpuDevice, memoryBudget, oldPyramid);
+		});
+	}
+	createPyramid(depthView, depthSamples, extent);
+	submit([this](VkCommandBuffer const cmdBuffer) {
+		VkClearColorValue const		farPlane = { { 1.0f, 0.0f, 0.0f, 0.0f } };
+		VkImageMemoryBarrier		barrier = {};
+
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = pyramid.image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+		vkCmdClearColorImage(cmdBuffer, pyramid.image, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1, &barrier.subresourceRange);
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, pyramidStages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	});
+	writeSet(retired, frame);
+}
+
+void		K3MeshletCuller::createPyramid(VkImageView const depthView, VkSampleCountFlagBits const depthSamples, VkExtent2D const extent)
+{
+	uint32_t		levels = 1;
+
+	pyramid = Pyramid();
+	pyramid.extent = { 1, 1 };
+	pyramid.multisampled = depthSamples != VK_SAMPLE_COUNT_1_BIT;
+	if (depthView != VK_NULL_HANDLE) {
+		while (pyramid.extent.width * 2 <= extent.width)
+			pyramid.extent.width *= 2;
+		while (pyramid.extent.height * 2 <= extent.height)
+			pyramid.extent.height *= 2;
+		while ((1u << levels) <= std::max(pyramid.extent.width, pyramid.extent.height))
+			levels++;
+	}
+
+	VkImageCreateInfo	imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R32_SFLOAT;
+	imageInfo.extent = { pyramid.extent.width, pyramid.extent.height, 1 };
+	imageInfo.mipLevels = levels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if (vkCreateImage(device, &imageInfo, nullptr, &pyramid.image) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth pyramid !");
+
+	VkMemoryRequirements	memRequirements;
+	vkGetImageMemoryRequirements(device, pyramid.image, &memRequirements);
+	pyramid.memory = budget->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, K3_MEMORY_NORMAL);
+	vkBindImageMemory(device, pyramid.image, pyramid.memory, 0);
+
+	VkImageViewCreateInfo	viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = pyramid.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = VK_FORMAT_R32_SFLOAT;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+	if (vkCreateImageView(device, &viewInfo, nullptr, &pyramid.view) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth pyramid view !");
+	if (depthView == VK_NULL_HANDLE)
+		return;
+	pyramid.levelViews.resize(levels);
+	for (uint32_t level = 0; level < levels; level++) {
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+		if (vkCreateImageView(device, &viewInfo, nullptr, &pyramid.levelViews[level]) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create depth pyramid view !");
+	}
+
+	VkDescriptorPoolSize		poolSizes[2] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = levels;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = levels;
+
+	VkDescriptorPoolCreateInfo	poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = levels;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pyramid.pool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth pyramid descriptor pool !");
+
+	std::vector<VkDescriptorSetLayout> const	layouts(levels, pyramidSetLayout);
+	VkDescriptorSetAllocateInfo			allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = pyramid.pool;
+	allocInfo.descriptorSetCount = levels;
+	allocInfo.pSetLayouts = layouts.data();
+	pyramid.sets.resize(levels);
+	if (vkAllocateDescriptorSets(device, &allocInfo, pyramid.sets.data()) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate depth pyramid descriptor sets !");
+
+	// The first level reads the scene depth, every other the level above
+	for (uint32_t level = 0; level < levels; level++) {
+		VkDescriptorImageInfo	imageInfos[2] = {};
+		VkWriteDescriptorSet	writes[2] = {};
+
+		if (level == 0)
+			imageInfos[0] = { pyramidSampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+		else
+			imageInfos[0] = { pyramidSampler, pyramid.levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+		imageInfos[1] = { VK_NULL_HANDLE, pyramid.levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+		for (uint32_t i = 0; i < 2; i++) {
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = pyramid.sets[level];
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[i].pImageInfo = &imageInfos[i];
+		}
+		vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+	}
+}
+
+void		K3MeshletCuller::destroyPyramid(VkDevice const gpuDevice, K3MemoryBudget* const memoryBudget, Pyramid const& pyramid)
+{
+	if (pyramid.image == VK_NULL_HANDLE)
+		return;
+	vkDestroyDescriptorPool(gpuDevice, pyramid.pool, nullptr);
+	for (VkImageView view : pyramid.levelViews)
+		vkDestroyImageView(gpuDevice, view, nullptr);
+	vkDestroyImageView(gpuDevice, pyramid.view, nullptr);
+	vkDestroyImage(gpuDevice, pyramid.image, nullptr);
+	memoryBudget->free(pyramid.memory);
+}
+
+// Every node may pick its largest level, the draws of a region are bounded by that
+uint32_t	K3MeshletCuller::getDrawCapacity(uint32_t const nodeCount) const
+{
+	return static_cast<uint32_t>(std::min(static_cast<uint64_t>(nodeCount) * maxLevelMeshlets, static_cast<uint64_t>(maxDrawCount)));
+}
+
+K3MeshletCuller::Params	K3MeshletCuller::makeParams(uint32_t const imgIndex, uint32_t const nodeCount, K3MeshletView const& view) const
+{
+	Params		params = {};
+
+	params.viewProj = view.viewProj;
+	params.eye = glm::vec4(view.eye, view.perspective ? 1.0f : 0.0f);
+	params.direction = glm::vec4(view.direction, 0.0f);
+	params.nodeCount = nodeCount;
+	params.levelCount = levelCount;
+	params.nodeBase = imgIndex * K3_MAX_INSTANCES;
+	params.drawBase = imgIndex * K3_MAX_MESHLET_DRAWS;
+	params.drawCapacity = getDrawCapacity(nodeCount);
+	params.countIndex = imgIndex;
+	params.occlusion = pyramid.levelViews.empty() ? 0 : 1;
+	return params;
+}
+
+/* Outside of the render pass. The region's count is reset and, without draw indirect count,
+** every command it may hold, so the draws nothing was written to are empty ones.
+*/
+
+void		K3MeshletCuller::recordCull(VkCommandBuffer const cmdBuffer, uint32_t const imgIndex, uint32_t const nodeCount,
+				K3MeshletView const& view) const
+{
+	Params const	params = makeParams(imgIndex, nodeCount, view);
+
+	// The count is also what the shader takes its slots from
+	vkCmdFillBuffer(cmdBuffer, drawBuffer, imgIndex * sizeof(uint32_t), sizeof(uint32_t), 0);
+	if (!drawIndexedIndirectCount && params.drawCapacity > 0) {
+		vkCmdFillBuffer(cmdBuffer, drawBuffer, countsSize + static_cast<VkDeviceSize>(params.drawBase) * sizeof(VkDrawIndexedIndirectCommand),
+			params.drawCapacity * sizeof(VkDrawIndexedIndirectCommand), 0);
+	}
+
+	VkMemoryBarrier		barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(cmdBuffer, pipelineLayout, stages, 0, sizeof(Params), &params);
+	vkCmdDispatch(cmdBuffer, (nodeCount + K3_MESHLET_CULL_GROUP - 1) / K3_MESHLET_CULL_GROUP, 1, 1);
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+		1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// Inside the render pass, with the vertex, instance and index buffers bound as for the per node draws
+void		K3MeshletCuller::recordDraw(VkCommandBuffer const cmdBuffer, uint32_t const imgIndex, uint32_t const nodeCount) const
+{
+	uint32_t const		capacity = getDrawCapacity(nodeCount);
+	VkDeviceSize const	drawOffset = countsSize + static_cast<VkDeviceSize>(imgIndex) * K3_MAX_MESHLET_DRAWS * sizeof(VkDrawIndexedIndirectCommand);
+
+	if (capacity == 0)
+		return;
+	if (drawIndexedIndirectCount) {
+		drawIndexedIndirectCount(cmdBuffer, drawBuffer, drawOffset, drawBuffer, imgIndex * sizeof(uint32_t), capacity,
+			sizeof(VkDrawIndexedIndirectCommand));
+	}
+	else
+		vkCmdDrawIndexedIndirect(cmdBuffer, drawBuffer, drawOffset, capacity, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+/* Inside the render pass, with the mesh pipeline bound. One task workgroup per node and
+** K3_MESHLET_TASK_GROUP meshlets of its largest level, nodes are spread over y then z.
+*/
+
+void		K3MeshletCuller::recordMeshTasks(VkCommandBuffer const cmdBuffer, uint32_t const imgIndex, uint32_t const nodeCount,
+				K3MeshletView const& view) const
+{
+#ifdef VK_EXT_mesh_shader
+	Params const	params = makeParams(imgIndex, nodeCount, view);
+	uint32_t const	groupsX = (maxLevelMeshlets + K3_MESHLET_TASK_GROUP - 1) / K3_MESHLET_TASK_GROUP;
+	uint32_t const	groupsY = std::min(nodeCount, static_cast<uint32_t>(K3_MESHLET_TASK_ROW));
+	uint32_t const	groupsZ = (nodeCount + K3_MESHLET_TASK_ROW - 1) / K3_MESHLET_TASK_ROW;
+
+	if (nodeCount == 0 || !drawMeshTasks)
+		return;
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(cmdBuffer, pipelineLayout, stages, 0, sizeof(Params), &params);
+	drawMeshTasks(cmdBuffer, groupsX, groupsY, groupsZ);
+#endif
+}
+
+/* After the scene pass, whose dependency makes its depth writes visible to compute. This
+** frame's culling is done reading the pyramid first, then each level is built from the one
+** above, the first from the part of the depth the scene was rendered to. The barrier at
+** the end covers the culling of the frames after.
+*/
+
+void		K3MeshletCuller::recordPyramid(VkCommandBuffer const cmdBuffer, VkExtent2D const renderExtent) const
+{
+	uint32_t const		levels = static_cast<uint32_t>(pyramid.levelViews.size());
+	VkExtent2D		source = renderExtent;
+	VkMemoryBarrier		barrier = {};
+
+	if (levels == 0)
+		return;
+	vkCmdPipelineBarrier(cmdBuffer, pyramidStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	for (uint32_t level = 0; level < levels; level++) {
+		uint32_t const	width = std::max(pyramid.extent.width >> level, 1u);
+		uint32_t const	height = std::max(pyramid.extent.height >> level, 1u);
+
+		if (level > 0) {
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+				1, &barrier, 0, nullptr, 0, nullptr);
+		}
+		if (level == 0)
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramid.multisampled ? reduceMsPipeline : reducePipeline);
+		else if (level == 1 && pyramid.multisampled)
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidLayout, 0, 1, &pyramid.sets[level], 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, pyramidLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(source), &source);
+		vkCmdDispatch(cmdBuffer, (width + K3_HIZ_GROUP - 1) / K3_HIZ_GROUP, (height + K3_HIZ_GROUP - 1) / K3_HIZ_GROUP, 1);
+		source = { width, height };
+	}
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, pyramidStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// Only once the device is idle, the retired queue must have been flushed first
+void		K3MeshletCuller::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+		return;
+	for (uint32_t i = 0; i < INPUT_COUNT; i++) {
+		vkDestroyBuffer(device, inputBuffers[i], nullptr);
+		budget->free(inputMemory[i]);
+		inputBuffers[i] = VK_NULL_HANDLE;
+		inputMemory[i] = VK_NULL_HANDLE;
+	}
+	vkDestroyBuffer(device, drawBuffer, nullptr);
+	budget->free(drawMemory);
+	destroyPyramid(device, budget, pyramid);
+	pyramid = Pyramid();
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyPipeline(device, cullPipeline, nullptr);
+	vkDestroyPipeline(device, reducePipeline, nullptr);
+	vkDestroyPipeline(device, reduceMsPipeline, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyPipelineLayout(device, pyramidLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, pyramidSetLayout, nullptr);
+	vkDestroySampler(device, pyramidSampler, nullptr);
+	drawBuffer = VK_NULL_HANDLE;
+	drawMemory = VK_NULL_HANDLE;
+	drawRegionCount = 0;
+	descriptorPool = VK_NULL_HANDLE;
+	set = VK_NULL_HANDLE;
+	cullPipeline = VK_NULL_HANDLE;
+	reducePipeline = VK_NULL_HANDLE;
+	reduceMsPipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	pyramidLayout = VK_NULL_HANDLE;
+	setLayout = VK_NULL_HANDLE;
+	pyramidSetLayout = VK_NULL_HANDLE;
+	pyramidSampler = VK_NULL_HANDLE;
+	nodeCommandBuffer = VK_NULL_HANDLE;
+	worldBuffer = VK_NULL_HANDLE;
+	vertexBuffer = VK_NULL_HANDLE;
+	device = VK_NULL_HANDLE;
+}
+
+VkPipelineLayout const&		K3MeshletCuller::getPipelineLayout() const
+{
+	return pipelineLayout;
+}
+
+uint32_t	K3MeshletCuller::getMeshletCount() const
+{
+	return meshletCount;
+}
+
+bool		K3MeshletCuller::isResident() const
+{
+	for (uint32_t i = 0; i < INPUT_COUNT; i++) {
+		if (inputBuffers[i] == VK_NULL_HANDLE)
+			return false;
+	}
+	return true;
+}
+
+VkDeviceSize	K3MeshletCuller::getMeshletDataSize() const
+{
+	return meshletData.getMeshlets().size() * sizeof(K3Meshlet) + levelData.size() * sizeof(K3MeshletLevel)
+		+ (meshletData.getVertices().size() + meshletData.getTriangles().size()) * sizeof(uint32_t);
+}
+
+uint32_t	K3MeshletCuller::getPyramidLevels() const
+{
+	return static_cast<uint32_t>(pyramid.levelViews.size());
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+# include "K3Vk.h"
+# include "K3DeletionQueue.h"
+# include "K3MemoryBudget.h"
+# include "K3Meshlet.h"
+# include "K3Scene.h"
+# include "K3Archive.h"
+
+// Nodes one culling workgroup tests, one thread per node
+#define K3_MESHLET_CULL_GROUP	64
+// Meshlets one task workgroup tests, the local size of meshlet.task
+#define K3_MESHLET_TASK_GROUP	32
+// Nodes per row of the task dispatch, the minimum maxTaskWorkGroupCount, further rows go on z
+#define K3_MESHLET_TASK_ROW	65535
+// Meshlet draws a region holds, visible meshlets past it are dropped for the frame
+#define K3_MAX_MESHLET_DRAWS	(K3_MAX_INSTANCES * 4)
+// Side of the workgroups building the depth pyramid, the local size of hiz_reduce.comp
+#define K3_HIZ_GROUP		8
+
+// The meshlets of one level of detail, std430. Nodes find theirs from the firstIndex of their draw command
+struct K3MeshletLevel
+{
+	uint32_t	firstIndex;
+	uint32_t	firstMeshlet;
+	uint32_t	meshletCount;
+	uint32_t	padding;
+};
+
+// direction is the view direction, what the cone test uses without perspective
+struct K3MeshletView
+{
+	glm::mat4	viewProj;
+	glm::vec3	eye;
+	glm::vec3	direction;
+	bool		perspective;
+};
+
+/* GPU culling of meshlets, per node and per frame : frustum test of the bounding sphere and
+** backface test of the normal cone, in object space, then occlusion against the depth of
+** the previous frame. The level of detail stays the CPU's,
+** each node's indirect command (K3LodSelector) tells which level's meshlets are tested.
+** Any device takes the compute path : a pass before the render pass writes one indexed
+** draw per visible meshlet, compacted with an atomic counter, drawn with one indirect call
+** (and the count read from the buffer with VK_KHR_draw_indirect_count). With mesh shaders
+** the task shader culls and the mesh shader emits the surviving meshlets, nothing goes
+** through the index buffer or memory in between.
+** The depth pyramid is built after the scene pass from its depth (K3SceneTargets), each
+** level keeping the farthest depth of the texels below it. The next frame projects the
+** sphere's bounding box and reads the 2x2 texels of the level it fits in : a meshlet
+** behind all of them is occluded. The camera is fixed, only nodes that moved can be a
+** frame late to show up from behind an occluder. Without a sampled depth nothing is
+** tested for occlusion, the pyramid is then a single texel at the far plane.
+** The meshlet data can be evicted (evictMeshlets()), the renderer then draws nodes whole
+** until reloadMeshlets() uploads it again from the copy kept here.
+*/
+
+class K3MeshletCuller {
+
+public:
+
+	typedef std::function<VkShaderModule(std::string const&)>	ShaderLoader;
+	// Creates a device local storage buffer holding the data
+	typedef std::function<void(void const*, VkDeviceSize const, VkBuffer&, VkDeviceMemory&)>	Uploader;
+	// Records commands in a graphics command buffer and runs them, waiting for them to be done
+	typedef std::function<void(std::function<void(VkCommandBuffer const)> const&)>	Submitter;
+
+	// The shaders are looked for in the asset archive first
+	static bool			isSupported(bool const meshShaders, K3Archive const& assets);
+	void				init(VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuDevice, K3MemoryBudget& memoryBudget, bool const meshShaders,
+						bool const drawIndirectCount, ShaderLoader const& loadShader);
+	void				uploadMeshlets(K3MeshletMesh const& mesh, std::vector<K3MeshletLevel> const& levels, Uploader const& upload);
+	void				evictMeshlets(K3DeletionQueue& retired, uint64_t const frame);
+	void				reloadMeshlets(Uploader const& upload, K3DeletionQueue& retired, uint64_t const frame);
+	// Marks the meshlet data used this frame, for the budget's eviction order
+	void				touchMeshlets() const;
+	void				setInputs(VkBuffer const nodeCommands, VkBuffer const worlds, VkBuffer const vertices,
+						uint32_t const regionCount, K3DeletionQueue& retired, uint64_t const frame);
+	// The scene depth the pyramid is built from, VK_NULL_HANDLE when it can not be sampled
+	void				setDepth(VkImageView const depthView, VkSampleCountFlagBits const depthSamples, VkExtent2D const extent,
+						Submitter const& submit, K3DeletionQueue& retired, uint64_t const frame);
+	void				recordCull(VkCommandBuffer const cmdBuffer, uint32_t const imgIndex, uint32_t const nodeCount,
+						K3MeshletView const& view) const;
+	void				recordDraw(VkCommandBuffer const cmdBuffer, uint32_t const imgIndex, uint32_t const nodeCount) const;
+	void				recordMeshTasks(VkCommandBuffer const cmdBuffer, uint32_t const imgIndex, uint32_t const nodeCount,
+						K3MeshletView const& view) const;
+	void				recordPyramid(VkCommandBuffer const cmdBuffer, VkExtent2D const renderExtent) const;
+	void				destroy();
+	VkPipelineLayout const&		getPipelineLayout() const;
+	uint32_t			getMeshletCount() const;
+	// False once the meshlet data is evicted, nothing may be culled until it is reloaded
+	bool				isResident() const;
+	VkDeviceSize			getMeshletDataSize() const;
+	// 0 when occlusion is not tested
+	uint32_t			getPyramidLevels() const;
+
+	K3MeshletCuller() {}
+	~K3MeshletCuller() {}
+
+	K3MeshletCuller(K3MeshletCuller const&) = delete;
+	K3MeshletCuller&		operator=(K3MeshletCuller const&) = delete;
+
+private:
+
+	// Matches the push constant block of meshlet_cull.comp and meshlet.task, eye.w is 1 with perspective
+	struct Params
+	{
+		glm::mat4	viewProj;
+		glm::vec4	eye;
+		glm::vec4	direction;
+		uint32_t	nodeCount;
+		uint32_t	levelCount;
+		uint32_t	nodeBase;
+		uint32_t	drawBase;
+		uint32_t	drawCapacity;
+		uint32_t	countIndex;
+		uint32_t	occlusion;
+	};
+
+	// R32 float, the first level is the largest power of two within the scene extent in both directions
+	struct Pyramid
+	{
+		VkImage				image = VK_NULL_HANDLE;
+		VkDeviceMemory			memory = VK_NULL_HANDLE;
+		VkImageView			view = VK_NULL_HANDLE;
+		VkExtent2D			extent = {};
+		// One view, and one set writing it from the level above, per level
+		std::vector<VkImageView>	levelViews;
+		VkDescriptorPool		pool = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet>	sets;
+		bool				multisampled = false;
+	};
+
+	enum Input { INPUT_MESHLETS, INPUT_LEVELS, INPUT_VERTICES, INPUT_TRIANGLES, INPUT_COUNT };
+
+	Params				makeParams(uint32_t const imgIndex, uint32_t const nodeCount, K3MeshletView const& view) const;
+	uint32_t			getDrawCapacity(uint32_t const nodeCount) const;
+	void				createDrawBuffer(uint32_t const regionCount);
+	void				uploadInputs(Uploader const& upload);
+	void				createPipeline(std::string const& shader, VkPipelineLayout const layout, VkPipeline& pipeline,
+						ShaderLoader const& loadShader);
+	void				writeSet(K3DeletionQueue& retired, uint64_t const frame);
+	void				createPyramid(VkImageView const depthView, VkSampleCountFlagBits const depthSamples, VkExtent2D const extent);
+	static void			destroyPyramid(VkDevice const gpuDevice, K3MemoryBudget* const memoryBudget, Pyramid const& pyramid);
+
+	K3MemoryBudget*			budget = nullptr;
+	VkDevice			device = VK_NULL_HANDLE;
+	VkShaderStageFlags		stages = 0;
+	VkDescriptorSetLayout		setLayout = VK_NULL_HANDLE;
+	VkPipelineLayout		pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline			cullPipeline = VK_NULL_HANDLE;
+	VkDescriptorPool		descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet			set = VK_NULL_HANDLE;
+	// What the set was last written with
+	VkBuffer			nodeCommandBuffer = VK_NULL_HANDLE;
+	VkBuffer			worldBuffer = VK_NULL_HANDLE;
+	VkBuffer			vertexBuffer = VK_NULL_HANDLE;
+	// The pyramid build : the depth or the level above sampled, the level written as a storage image
+	VkSampler			pyramidSampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout		pyramidSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout		pyramidLayout = VK_NULL_HANDLE;
+	VkPipeline			reducePipeline = VK_NULL_HANDLE;
+	VkPipeline			reduceMsPipeline = VK_NULL_HANDLE;
+	Pyramid				pyramid;
+	// Where the pyramid is read, waited for before it is built again
+	VkPipelineStageFlags		pyramidStages = 0;
+	VkBuffer			inputBuffers[INPUT_COUNT] = {};
+	VkDeviceMemory			inputMemory[INPUT_COUNT] = {};
+	// What the input buffers are uploaded from, again after an eviction
+	K3MeshletMesh			meshletData;
+	std::vector<K3MeshletLevel>	levelData;
+	// Draw counts (one uint per region) then the draw regions, K3_MAX_MESHLET_DRAWS commands each
+	VkBuffer			drawBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory			drawMemory = VK_NULL_HANDLE;
+	uint32_t			drawRegionCount = 0;
+	uint32_t			levelCount = 0;
+	uint32_t			maxLevelMeshlets = 0;
+	uint32_t			meshletCount = 0;
+	uint32_t			maxDrawCount = 0;
+	PFN_vkCmdDrawIndexedIndirectCountKHR	drawIndexedIndirectCount = nullptr;
+#ifdef VK_EXT_mesh_shader
+	PFN_vkCmdDrawMeshTasksEXT	drawMeshTasks = nullptr;
+#endif
+
+};
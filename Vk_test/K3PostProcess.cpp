@@ -0,0 +1,562 @@
+#include "K3PostProcess.h"
+
+static char const*	shaderFiles[] = {
+	K3_SHADER_DIR "post_downsample.comp.spv",
+	K3_SHADER_DIR "post_upsample.comp.spv",
+	K3_SHADER_DIR "post_tonemap.comp.spv",
+	K3_SHADER_DIR "post_fxaa.comp.spv"
+};
+
+// Never below the size that still leaves room for every level, however small the window gets
+static VkExtent2D	getLevelExtent(VkExtent2D const extent, uint32_t const level)
+{
+	uint32_t const	minSize = 1u << (K3_BLOOM_LEVELS - 1 - level);
+
+	return { std::max(extent.width >> (level + 1), minSize), std::max(extent.height >> (level + 1), minSize) };
+}
+
+// Every pass reads what the previous one wrote
+static void		computeBarrier(VkCommandBuffer const cmdBuffer)
+{
+	VkMemoryBarrier		barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+static VkImageMemoryBarrier	makeImageBarrier(VkImage const image, VkImageLayout const oldLayout, VkImageLayout const newLayout,
+					VkAccessFlags const srcAccess, VkAccessFlags const dstAccess, uint32_t const levels = 1)
+{
+	VkImageMemoryBarrier	barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = levels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	return barrier;
+}
+
+/* The result is copied to the swapchain image, which has to take the copy as is (8 bits
+** per channel, RGBA or BGRA) and allow transfer writes. The HDR target is rendered to,
+** sampled with linear filtering and written by the bloom passes. The shaders may be missing
+** when they were neither compiled by the build nor prebuilt.
+*/
+
+bool		K3PostProcess::isSupported(VkPhysicalDevice const& gpuPDevice, VkFormat const scFormat, VkImageUsageFlags const scUsage,
+				K3Archive const& assets)
+{
+	VkFormatFeatureFlags const	hdrFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT
+						| VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	VkFormatFeatureFlags const	ldrFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	VkFormatProperties		hdrProperties;
+	VkFormatProperties		ldrProperties;
+
+	if (scFormat != VK_FORMAT_B8G8R8A8_UNORM && scFormat != VK_FORMAT_B8G8R8A8_SRGB
+		&& scFormat != VK_FORMAT_R8G8B8A8_UNORM && scFormat != VK_FORMAT_R8G8B8A8_SRGB)
+		return false;
+	if (!(scUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+		return false;
+	for (char const* file : shaderFiles) {
+		if (!assets.exists(file))
+			return false;
+	}
+	vkGetPhysicalDeviceFormatProperties(gpuPDevice, K3_POST_HDR_FORMAT, &hdrProperties);
+	vkGetPhysicalDeviceFormatProperties(gpuPDevice, VK_FORMAT_R8G8B8A8_UNORM, &ldrProperties);
+	return (hdrProperties.optimalTilingFeatures & hdrFeatures) == hdrFeatures
+		&& (ldrProperties.optimalTilingFeatures & ldrFeatures) == ldrFeatures;
+}
+
+void		K3PostProcess::init(K3MemoryBudget& memoryBudget, VkDevice const& gpuDevice, uint32_t const* queuesIndex,
+				VkCommandPool const computePool, ShaderLoader const& loadShader)
+{
+	budget = &memoryBudget;
+	device = gpuDevice;
+	gfxFamily = queuesIndex[1];
+	computeFamily = queuesIndex[2];
+	cmdPool = computePool;
+
+	VkSamplerCreateInfo		samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = 0.0f;
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create post processing sampler !");
+	createPipelines(loadShader);
+}
+
+/* The passes share one layout, reflected from the shaders : two sampled inputs and one
+** storage output, each pass uses what it needs.
+*/
+
+void		K3PostProcess::createPipelines(ShaderLoader const& loadShader)
+{
+	K3ShaderLayout			shaderLayout;
+	VkShaderModule			modules[PASS_COUNT];
+
+	for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+		modules[pass] = loadShader(shaderFiles[pass], &shaderLayout);
+
+	std::vector<VkDescriptorSetLayoutBinding> const	bindings = shaderLayout.getSetBindings(0);
+	VkDescriptorSetLayoutCreateInfo	setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	setLayoutInfo.pBindings = bindings.data();
+	if (vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create post processing descriptor set layout !");
+
+	VkPushConstantRange const	pushRange = shaderLayout.getPushConstantRange();
+	if (pushRange.size != sizeof(Params))
+		throw std::runtime_error("Post processing Params do not match the shaders !");
+
+	VkPipelineLayoutCreateInfo	pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create post processing pipeline layout !");
+
+	TonemapConstants const			tonemapConstants = { K3_BLOOM_INTENSITY };
+	K3Specialization<TonemapConstants> const	tonemapSpecialization(tonemapConstants);
+
+	for (uint32_t pass = 0; pass < PASS_FXAA; pass++) {
+		pipelines[pass] = createPipeline(modules[pass], pass == PASS_TONEMAP ? tonemapSpecialization.getInfo() : nullptr);
+		vkDestroyShaderModule(device, modules[pass], nullptr);
+		if (pipelines[pass] == VK_NULL_HANDLE)
+			throw std::runtime_error("Failed to create post processing pipelines !");
+	}
+	// The swapchain format is only known with the targets, FXAA variants are added there
+	fxaaModule = modules[PASS_FXAA];
+	fxaaVariants.init(device);
+}
+
+// VK_NULL_HANDLE on failure
+VkPipeline	K3PostProcess::createPipeline(VkShaderModule const module, VkSpecializationInfo const* specialization) const
+{
+	VkPipeline			pipeline = VK_NULL_HANDLE;
+
+	VkComputePipelineCreateInfo	pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = module;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.stage.pSpecializationInfo = specialization;
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.basePipelineIndex = -1;
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	return pipeline;
+}
+
+K3PostProcess::Target	K3PostProcess::createTarget(VkExtent2D const targetExtent, VkFormat const format, uint32_t const levels,
+					VkImageUsageFlags const usage)
+{
+	Target			target;
+
+	VkImageCreateInfo	imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = format;
+	imageInfo.extent = { targetExtent.width, targetExtent.height, 1 };
+	imageInfo.mipLevels = levels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = usage;
+	// Ownership moves between families with barriers, see recordRelease
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if (vkCreateImage(device, &imageInfo, nullptr, &target.image) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create post processing target !");
+
+	VkMemoryRequirements	memRequirements;
+	vkGetImageMemoryRequirements(device, target.image, &memRequirements);
+
+	target.memory = budget->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, K3_MEMORY_NORMAL);
+	vkBindImageMemory(device, target.image, target.memory, 0);
+
+	target.views.resize(levels);
+	for (uint32_t level = 0; level < levels; level++) {
+		VkImageViewCreateInfo	viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = target.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = level;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(device, &viewInfo, nullptr, &target.views[level]) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create post processing target view !");
+	}
+	return target;
+}
+
+void		K3PostProcess::destroyTarget(VkDevice const gpuDevice, K3MemoryBudget* const memoryBudget, Target const& target)
+{
+	for (VkImageView view : target.views)
+		vkDestroyImageView(gpuDevice, view, nullptr);
+	vkDestroyImage(gpuDevice, target.image, nullptr);
+	memoryBudget->free(target.memory);
+}
+
+/* One set of targets per swapchain image, the previous ones must have been retired.
+** renderPass is the scene pass, its output being the K3_POST_HDR_FORMAT scene target.
+*/
+
+void		K3PostProcess::createTargets(VkRenderPass const renderPass, K3SceneTargets const& sceneTargets, VkExtent2D const scExtent,
+				std::vector<VkImage> const& swapchainImages, VkFormat const swapchainFormat)
+{
+	uint32_t const		imgCount = static_cast<uint32_t>(swapchainImages.size());
+	uint32_t const		setsPerImage = 2 * K3_BLOOM_LEVELS + 1;
+
+	extent = scExtent;
+	renderExtent = scExtent;
+	scImages = swapchainImages;
+	scFormat = swapchainFormat;
+	images.resize(imgCount);
+	framebuffers.resize(imgCount);
+
+	VkDescriptorPoolSize		poolSizes[2] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = imgCount * setsPerImage * 2;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = imgCount * setsPerImage;
+
+	VkDescriptorPoolCreateInfo	poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = imgCount * setsPerImage;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create post processing descriptor pool !");
+	allocateCommandBuffers();
+
+	for (uint32_t i = 0; i < imgCount; i++) {
+		ImageTargets&		targets = images[i];
+
+		targets.scene = createTarget(extent, K3_POST_HDR_FORMAT, 1,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		targets.bloom = createTarget(getLevelExtent(extent, 0), K3_POST_HDR_FORMAT, K3_BLOOM_LEVELS,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		targets.ldr = createTarget(extent, VK_FORMAT_R8G8B8A8_UNORM, 1, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+		targets.output = createTarget(extent, VK_FORMAT_R8G8B8A8_UNORM, 1, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+		std::vector<VkImageView> const	attachments = sceneTargets.getAttachments(targets.scene.views[0]);
+
+		VkFramebufferCreateInfo		fbInfo = {};
+		fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		fbInfo.renderPass = renderPass;
+		fbInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		fbInfo.pAttachments = attachments.data();
+		fbInfo.width = extent.width;
+		fbInfo.height = extent.height;
+		fbInfo.layers = 1;
+		if (vkCreateFramebuffer(device, &fbInfo, nullptr, &framebuffers[i]) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create post processing framebuffer !");
+		targets.framebuffer = framebuffers[i];
+
+		writeSets(targets);
+		recordChain(i);
+	}
+}
+
+void		K3PostProcess::allocateCommandBuffers()
+{
+	cmdBuffers.resize(images.size());
+
+	VkCommandBufferAllocateInfo	cmdBuffInfo = {};
+	cmdBuffInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cmdBuffInfo.commandPool = cmdPool;
+	cmdBuffInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	cmdBuffInfo.commandBufferCount = static_cast<uint32_t>(cmdBuffers.size());
+	if (vkAllocateCommandBuffers(device, &cmdBuffInfo, cmdBuffers.data()) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate post processing command buffers !");
+}
+
+// Pending frames may still run the old chains, they go once those are done
+void		K3PostProcess::setRenderExtent(VkExtent2D const newExtent, K3DeletionQueue& retired, uint64_t const frame)
+{
+	VkDevice const			gpuDevice = device;
+	VkCommandPool const		pool = cmdPool;
+	std::vector<VkCommandBuffer>	oldCmdBuffers;
+
+	if (newExtent.width == renderExtent.width && newExtent.height == renderExtent.height)
+		return;
+	renderExtent = newExtent;
+	oldCmdBuffers.swap(cmdBuffers);
+	retired.push(frame, [gpuDevice, pool, oldCmdBuffers]() {
+		vkFreeCommandBuffers(gpuDevice, pool, static_cast<uint32_t>(oldCmdBuffers.size()), oldCmdBuffers.data());
+	});
+	allocateCommandBuffers();
+	for (uint32_t i = 0; i < images.size(); i++)
+		recordChain(i);
+}
+
+void		K3PostProcess::setTimer(K3GpuTimer const* const gpuTimer)
+{
+	timer = gpuTimer;
+}
+
+/* Sets 0 to K3_BLOOM_LEVELS - 1 downsample into each bloom level, the next ones upsample
+** into the levels 0 to K3_BLOOM_LEVELS - 2, the last two are the tonemap and FXAA.
+*/
+
+void		K3PostProcess::writeSets(ImageTargets& targets)
+{
+	uint32_t const				setCount = 2 * K3_BLOOM_LEVELS + 1;
+	K3FrameVector<VkDescriptorSetLayout>	layouts(setCount, setLayout);
+	K3FrameVector<VkDescriptorImageInfo>	infos;
+	K3FrameVector<VkWriteDescriptorSet>	writes;
+
+	targets.sets.resize(setCount);
+
+	VkDescriptorSetAllocateInfo	allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = setCount;
+	allocInfo.pSetLayouts = layouts.data();
+	if (vkAllocateDescriptorSets(device, &allocInfo, targets.sets.data()) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate post processing descriptor sets !");
+
+	// The writes point into infos, which must not reallocate
+	infos.reserve(setCount * 3);
+	auto	write = [&](VkDescriptorSet set, uint32_t binding, VkImageView view, VkImageLayout layout) {
+		VkDescriptorImageInfo	info = {};
+		info.sampler = binding < 2 ? sampler : VK_NULL_HANDLE;
+		info.imageView = view;
+		info.imageLayout = layout;
+		infos.push_back(info);
+
+		VkWriteDescriptorSet	descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = set;
+		descriptorWrite.dstBinding = binding;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.descriptorType = binding < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		descriptorWrite.pImageInfo = &infos.back();
+		writes.push_back(descriptorWrite);
+	};
+
+	std::vector<VkImageView> const&	bloom = targets.bloom.views;
+
+	for (uint32_t level = 0; level < K3_BLOOM_LEVELS; level++) {
+		if (level == 0)
+			write(targets.sets[level], 0, targets.scene.views[0], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		else
+			write(targets.sets[level], 0, bloom[level - 1], VK_IMAGE_LAYOUT_GENERAL);
+		write(targets.sets[level], 2, bloom[level], VK_IMAGE_LAYOUT_GENERAL);
+	}
+	for (uint32_t level = 0; level + 1 < K3_BLOOM_LEVELS; level++) {
+		write(targets.sets[K3_BLOOM_LEVELS + level], 0, bloom[level + 1], VK_IMAGE_LAYOUT_GENERAL);
+		write(targets.sets[K3_BLOOM_LEVELS + level], 2, bloom[level], VK_IMAGE_LAYOUT_GENERAL);
+	}
+	write(targets.sets[setCount - 2], 0, targets.scene.views[0], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	write(targets.sets[setCount - 2], 1, bloom[0], VK_IMAGE_LAYOUT_GENERAL);
+	write(targets.sets[setCount - 2], 2, targets.ldr.views[0], VK_IMAGE_LAYOUT_GENERAL);
+	write(targets.sets[setCount - 1], 0, targets.ldr.views[0], VK_IMAGE_LAYOUT_GENERAL);
+	write(targets.sets[setCount - 1], 2, targets.output.views[0], VK_IMAGE_LAYOUT_GENERAL);
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void		K3PostProcess::dispatch(VkCommandBuffer const cmdBuffer, VkPipeline const pipeline, VkDescriptorSet const set,
+				VkExtent2D const dstExtent, float const value, glm::vec2 const srcScale) const
+{
+	Params		params = {};
+
+	params.dstTexel = glm::vec2(1.0f / dstExtent.width, 1.0f / dstExtent.height);
+	params.value = value;
+	params.srcScale = srcScale;
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Params), &params);
+	// 8x8 work groups, the shaders skip what lies outside the target
+	vkCmdDispatch(cmdBuffer, (dstExtent.width + 7) / 8, (dstExtent.height + 7) / 8, 1);
+}
+
+/* The compute side of a frame, submitted once the graphics work and the image acquire are
+** signaled. The intermediates start UNDEFINED every frame, nothing is kept across frames.
+*/
+
+void		K3PostProcess::recordChain(uint32_t const imgIndex)
+{
+	VkCommandBuffer const		cmdBuffer = cmdBuffers[imgIndex];
+	ImageTargets const&		targets = images[imgIndex];
+	VkImage const			scImage = scImages[imgIndex];
+	glm::vec2 const			sceneScale(static_cast<float>(renderExtent.width) / extent.width,
+						static_cast<float>(renderExtent.height) / extent.height);
+	FxaaConstants			fxaaConstants = {};
+
+	// Built once per channel order, a later swapchain of the same order finds it in the cache
+	fxaaConstants.swapRedBlue = scFormat == VK_FORMAT_B8G8R8A8_UNORM || scFormat == VK_FORMAT_B8G8R8A8_SRGB;
+	fxaaConstants.contrast = K3_FXAA_CONTRAST;
+	VkPipeline const		fxaaPipeline = fxaaVariants.get(fxaaVariants.add(fxaaConstants,
+						[this](VkSpecializationInfo const* specialization) { return createPipeline(fxaaModule, specialization); }));
+
+	VkCommandBufferBeginInfo	beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+	if (timer)
+		timer->begin(cmdBuffer, imgIndex, K3_GPU_SPAN_POST);
+
+	VkImageMemoryBarrier		startBarriers[4] = {
+		makeImageBarrier(targets.bloom.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, 0,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, K3_BLOOM_LEVELS),
+		makeImageBarrier(targets.ldr.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, 0,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+		makeImageBarrier(targets.output.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, 0, VK_ACCESS_SHADER_WRITE_BIT),
+		// Acquire half of the ownership transfer, the same layout transition as the release
+		makeImageBarrier(targets.scene.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			0, VK_ACCESS_SHADER_READ_BIT)
+	};
+	startBarriers[3].srcQueueFamilyIndex = gfxFamily;
+	startBarriers[3].dstQueueFamilyIndex = computeFamily;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		0, nullptr, 0, nullptr, isQueueTransfer() ? 4 : 3, startBarriers);
+
+	// BLOOM
+	for (uint32_t level = 0; level < K3_BLOOM_LEVELS; level++) {
+		dispatch(cmdBuffer, pipelines[PASS_DOWNSAMPLE], targets.sets[level], getLevelExtent(extent, level),
+			level == 0 ? K3_BLOOM_THRESHOLD : 0.0f, level == 0 ? sceneScale : glm::vec2(1.0f));
+		computeBarrier(cmdBuffer);
+	}
+	for (uint32_t level = K3_BLOOM_LEVELS - 1; level-- > 0;) {
+		dispatch(cmdBuffer, pipelines[PASS_UPSAMPLE], targets.sets[K3_BLOOM_LEVELS + level], getLevelExtent(extent, level), 1.0f);
+		computeBarrier(cmdBuffer);
+	}
+
+	// TONEMAP AND ANTIALIASING
+	dispatch(cmdBuffer, pipelines[PASS_TONEMAP], targets.sets[2 * K3_BLOOM_LEVELS - 1], extent, 0.0f, sceneScale);
+	computeBarrier(cmdBuffer);
+	dispatch(cmdBuffer, fxaaPipeline, targets.sets[2 * K3_BLOOM_LEVELS], extent, 0.0f);
+
+	// COPY TO THE SWAPCHAIN
+	// The acquire semaphore is waited on at the transfer stage, the swapchain image transition follows it
+	VkImageMemoryBarrier		copyBarriers[2] = {
+		makeImageBarrier(targets.output.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+		makeImageBarrier(scImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT)
+	};
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 2, copyBarriers);
+
+	VkImageCopy			region = {};
+	region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.srcSubresource.layerCount = 1;
+	region.dstSubresource = region.srcSubresource;
+	region.extent = { extent.width, extent.height, 1 };
+	vkCmdCopyImage(cmdBuffer, targets.output.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, scImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &region);
+
+	VkImageMemoryBarrier		presentBarrier = makeImageBarrier(scImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &presentBarrier);
+	if (timer)
+		timer->end(cmdBuffer, imgIndex, K3_GPU_SPAN_POST);
+
+	if (vkEndCommandBuffer(cmdBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to record post processing command buffer !");
+}
+
+/* Recorded by the graphics side after the scene pass, which leaves the target as a color
+** attachment. Moves it to the layout the chain samples it in, and hands it over to the
+** compute family when it is another one.
+*/
+
+void		K3PostProcess::recordRelease(VkCommandBuffer const cmdBuffer, uint32_t const imgIndex) const
+{
+	VkImageMemoryBarrier	barrier = makeImageBarrier(images[imgIndex].scene.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0);
+
+	if (isQueueTransfer()) {
+		barrier.srcQueueFamilyIndex = gfxFamily;
+		barrier.dstQueueFamilyIndex = computeFamily;
+	}
+	// The semaphore the compute submission waits on makes the transition visible to it
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+bool		K3PostProcess::isQueueTransfer() const
+{
+	return gfxFamily != computeFamily;
+}
+
+// Pending frames may still run the chain, everything goes once they are done
+void		K3PostProcess::retireTargets(K3DeletionQueue& retired, uint64_t const frame)
+{
+	VkDevice const			gpuDevice = device;
+	VkCommandPool const		pool = cmdPool;
+	VkDescriptorPool const		setPool = descriptorPool;
+	std::vector<ImageTargets>	oldImages;
+	std::vector<VkCommandBuffer>	oldCmdBuffers;
+
+	if (descriptorPool == VK_NULL_HANDLE)
+		return;
+	oldImages.swap(images);
+	oldCmdBuffers.swap(cmdBuffers);
+	framebuffers.clear();
+	descriptorPool = VK_NULL_HANDLE;
+	K3MemoryBudget* const		memoryBudget = budget;
+
+	retired.push(frame, [gpuDevice, memoryBudget, pool, setPool, oldImages, oldCmdBuffers]() {
+		vkFreeCommandBuffers(gpuDevice, pool, static_cast<uint32_t>(oldCmdBuffers.size()), oldCmdBuffers.data());
+		vkDestroyDescriptorPool(gpuDevice, setPool, nullptr);
+		for (ImageTargets const& targets : oldImages) {
+			vkDestroyFramebuffer(gpuDevice, targets.framebuffer, nullptr);
+			destroyTarget(gpuDevice, memoryBudget, targets.scene);
+			destroyTarget(gpuDevice, memoryBudget, targets.bloom);
+			destroyTarget(gpuDevice, memoryBudget, targets.ldr);
+			destroyTarget(gpuDevice, memoryBudget, targets.output);
+		}
+	});
+}
+
+// Only once the device is idle and the retired targets are flushed
+void		K3PostProcess::destroy()
+{
+	K3DeletionQueue		remaining;
+
+	if (device == VK_NULL_HANDLE)
+		return;
+	retireTargets(remaining, 0);
+	remaining.flushAll();
+	for (VkPipeline pipeline : pipelines)
+		vkDestroyPipeline(device, pipeline, nullptr);
+	fxaaVariants.destroy();
+	vkDestroyShaderModule(device, fxaaModule, nullptr);
+	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	vkDestroySampler(device, sampler, nullptr);
+	device = VK_NULL_HANDLE;
+}
+
+std::vector<VkFramebuffer> const&	K3PostProcess::getFramebuffers() const
+{
+	return framebuffers;
+}
+
+VkCommandBuffer const&		K3PostProcess::getCommandBuffer(uint32_t const imgIndex) const
+{
+	return cmdBuffers[imgIndex];
+}
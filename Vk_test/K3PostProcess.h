@@ -0,0 +1,157 @@
+#pragma once
+
+# include "K3Vk.h"
+# include "K3DeletionQueue.h"
+# include "K3MemoryBudget.h"
+# include "K3Specialization.h"
+# include "K3ShaderLayout.h"
+# include "K3SceneTargets.h"
+# include "K3GpuTimer.h"
+# include "K3Archive.h"
+
+// Format the scene is rendered to when post processing is on
+#define K3_POST_HDR_FORMAT	VK_FORMAT_R16G16B16A16_SFLOAT
+// Half resolution and below, each level halves the previous one
+#define K3_BLOOM_LEVELS		5
+// Scene brightness above which a pixel contributes to the bloom
+#define K3_BLOOM_THRESHOLD	1.0f
+#define K3_BLOOM_INTENSITY	0.6f
+// Local contrast under which FXAA leaves a pixel alone
+#define K3_FXAA_CONTRAST	0.0312f
+
+/* Compute post processing chain : bloom downsample and upsample, tonemap, FXAA.
+** The scene is rendered to an HDR target per swapchain image, the chain runs on the
+** compute queue and copies its result to the swapchain image. Each image has its own
+** targets and pre-recorded command buffer, so the compute work of a frame overlaps the
+** graphics work of the next one, the only link between both queues being a semaphore.
+** When the graphics and compute families differ, the HDR target changes family through a
+** release barrier (recordRelease(), end of the graphics work) and an acquire barrier at
+** the start of the compute work. Its content is discarded every frame, nothing goes back.
+** The constants of the chain are specialization constants, FXAA has a variant per swapchain
+** channel order so a BGRA swapchain costs no per pixel test.
+** With dynamic resolution the scene only covers the top left renderExtent of its target,
+** the first bloom pass and the tonemap sample that part, the bilinear taps of the tonemap
+** being the upscale. Everything from there on is at the output size.
+*/
+
+class K3PostProcess {
+
+public:
+
+	// Adds the stage to the layout when given one
+	typedef std::function<VkShaderModule(std::string const&, K3ShaderLayout* const)>	ShaderLoader;
+
+	// The shaders are looked for in the asset archive first
+	static bool				isSupported(VkPhysicalDevice const& gpuPDevice, VkFormat const scFormat, VkImageUsageFlags const scUsage,
+							K3Archive const& assets);
+	void					init(K3MemoryBudget& memoryBudget, VkDevice const& gpuDevice, uint32_t const* queuesIndex,
+							VkCommandPool const computePool, ShaderLoader const& loadShader);
+	void					createTargets(VkRenderPass const renderPass, K3SceneTargets const& sceneTargets, VkExtent2D const extent,
+							std::vector<VkImage> const& scImages, VkFormat const scFormat);
+	void					retireTargets(K3DeletionQueue& retired, uint64_t const frame);
+	// Records the chains again when it changed, the previous command buffers are retired
+	void					setRenderExtent(VkExtent2D const renderExtent, K3DeletionQueue& retired, uint64_t const frame);
+	// Times the chains as K3_GPU_SPAN_POST from the next recording on, nullptr stops
+	void					setTimer(K3GpuTimer const* const gpuTimer);
+	void					destroy();
+	void					recordRelease(VkCommandBuffer const cmdBuffer, uint32_t const imgIndex) const;
+	std::vector<VkFramebuffer> const&	getFramebuffers() const;
+	VkCommandBuffer const&			getCommandBuffer(uint32_t const imgIndex) const;
+
+	K3PostProcess() {}
+	~K3PostProcess() {}
+
+	K3PostProcess(K3PostProcess const&) = delete;
+	K3PostProcess&				operator=(K3PostProcess const&) = delete;
+
+private:
+
+	enum Pass { PASS_DOWNSAMPLE, PASS_UPSAMPLE, PASS_TONEMAP, PASS_FXAA, PASS_COUNT };
+
+	// Matches the push constant block of the post_*.comp shaders
+	struct Params
+	{
+		glm::vec2		dstTexel;
+		float			value;
+		float			padding;
+		// Share of the source the passes reading the scene sample, (1, 1) for the others
+		glm::vec2		srcScale;
+	};
+
+	// Constant IDs of post_tonemap.comp
+	struct TonemapConstants
+	{
+		float			bloomIntensity;
+
+		static std::array<VkSpecializationMapEntry, 1>	getMapEntries() {
+			return { { { 0, offsetof(TonemapConstants, bloomIntensity), sizeof(float) } } };
+		}
+	};
+
+	// Constant IDs of post_fxaa.comp
+	struct FxaaConstants
+	{
+		VkBool32		swapRedBlue;
+		float			contrast;
+
+		static std::array<VkSpecializationMapEntry, 2>	getMapEntries() {
+			return { {
+				{ 0, offsetof(FxaaConstants, swapRedBlue), sizeof(VkBool32) },
+				{ 1, offsetof(FxaaConstants, contrast), sizeof(float) }
+			} };
+		}
+	};
+
+	// The views of a mip chain target are one per level
+	struct Target
+	{
+		VkImage			image = VK_NULL_HANDLE;
+		VkDeviceMemory		memory = VK_NULL_HANDLE;
+		std::vector<VkImageView>	views;
+	};
+
+	// Everything that depends on one swapchain image
+	struct ImageTargets
+	{
+		Target			scene;
+		Target			bloom;
+		Target			ldr;
+		Target			output;
+		VkFramebuffer		framebuffer = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet>	sets;
+	};
+
+	Target					createTarget(VkExtent2D const extent, VkFormat const format, uint32_t const levels, VkImageUsageFlags const usage);
+	static void				destroyTarget(VkDevice const gpuDevice, K3MemoryBudget* const memoryBudget, Target const& target);
+	void					createPipelines(ShaderLoader const& loadShader);
+	VkPipeline				createPipeline(VkShaderModule const module, VkSpecializationInfo const* specialization) const;
+	void					writeSets(ImageTargets& targets);
+	void					allocateCommandBuffers();
+	void					recordChain(uint32_t const imgIndex);
+	void					dispatch(VkCommandBuffer const cmdBuffer, VkPipeline const pipeline, VkDescriptorSet const set,
+							VkExtent2D const extent, float const value, glm::vec2 const srcScale = glm::vec2(1.0f)) const;
+	bool					isQueueTransfer() const;
+
+	K3MemoryBudget*				budget = nullptr;
+	VkDevice				device = VK_NULL_HANDLE;
+	uint32_t				gfxFamily = 0;
+	uint32_t				computeFamily = 0;
+	VkCommandPool				cmdPool = VK_NULL_HANDLE;
+	VkSampler				sampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout			setLayout = VK_NULL_HANDLE;
+	VkPipelineLayout			pipelineLayout = VK_NULL_HANDLE;
+	// FXAA has its variants instead, built from the module kept for them
+	VkPipeline				pipelines[PASS_FXAA] = {};
+	VkShaderModule				fxaaModule = VK_NULL_HANDLE;
+	K3PipelineVariants<FxaaConstants>	fxaaVariants;
+	VkDescriptorPool			descriptorPool = VK_NULL_HANDLE;
+	VkExtent2D				extent = {};
+	VkExtent2D				renderExtent = {};
+	std::vector<VkImage>			scImages;
+	VkFormat				scFormat = VK_FORMAT_UNDEFINED;
+	K3GpuTimer const*			timer = nullptr;
+	std::vector<ImageTargets>		images;
+	std::vector<VkFramebuffer>		framebuffers;
+	std::vector<VkCommandBuffer>		cmdBuffers;
+
+};
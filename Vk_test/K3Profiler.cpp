@@ -0,0 +1,100 @@
+#include "K3Profiler.h"
+
+K3Profiler::Counter&		K3Profiler::getCounter(char const* name)
+{
+	for (auto& counter : counters) {
+		if (counter.name == name)
+			return counter;
+	}
+	counters.push_back({ name, 0.0, 0.0, 0.0 });
+	return counters.back();
+}
+
+void		K3Profiler::setCounter(char const* name, double value)
+{
+	getCounter(name).value = value;
+}
+
+void		K3Profiler::addCounter(char const* name, double value)
+{
+	getCounter(name).value += value;
+}
+
+void		K3Profiler::reportAllocator(char const* name, K3AllocatorStats const& stats)
+{
+	for (auto& allocator : allocators) {
+		if (allocator.name == name) {
+			allocator.stats = stats;
+			allocator.heapFallbacks += stats.heapFallbacks;
+			return;
+		}
+	}
+	allocators.push_back({ name, stats, stats.heapFallbacks });
+}
+
+void		K3Profiler::beginFrame()
+{
+	frameStart = Clock::now();
+}
+
+void		K3Profiler::endFrame()
+{
+	lastFrameTime = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+	frameTimeTotal += lastFrameTime;
+	if (lastFrameTime > frameTimeMax)
+		frameTimeMax = lastFrameTime;
+	for (auto& counter : counters) {
+		counter.total += counter.value;
+		if (counter.value > counter.max)
+			counter.max = counter.value;
+		counter.value = 0.0;
+	}
+	frameCount++;
+	framesSinceReport++;
+	if (enableProfiling && reportInterval > 0 && framesSinceReport >= reportInterval) {
+		report(std::cerr);
+		resetCounters();
+	}
+}
+
+void		K3Profiler::resetCounters()
+{
+	for (auto& counter : counters) {
+		counter.total = 0.0;
+		counter.max = 0.0;
+	}
+	for (auto& allocator : allocators) {
+		allocator.heapFallbacks = 0;
+	}
+	framesSinceReport = 0;
+	frameTimeTotal = 0.0;
+	frameTimeMax = 0.0;
+}
+
+void		K3Profiler::report(std::ostream& os) const
+{
+	double	frames = framesSinceReport > 0 ? static_cast<double>(framesSinceReport) : 1.0;
+
+	os << "[K3 Profiler] frame " << frameCount << " : avg " << frameTimeTotal / frames
+		<< " ms, max " << frameTimeMax << " ms" << std::endl;
+	for (auto const& counter : counters) {
+		os << "  " << counter.name << " : avg " << counter.total / frames
+			<< ", max " << counter.max << std::endl;
+	}
+	for (auto const& allocator : allocators) {
+		os << "  " << allocator.name << " : " << allocator.stats.bytesUsed << " / "
+			<< allocator.stats.capacity << " bytes, peak " << allocator.stats.peakBytes
+			<< ", " << allocator.stats.allocCount << " allocs, "
+			<< allocator.heapFallbacks << " heap allocs" << std::endl;
+	}
+}
+
+uint64_t	K3Profiler::getFrameCount() const
+{
+	return frameCount;
+}
+
+double		K3Profiler::getLastFrameTime() const
+{
+	return lastFrameTime;
+}
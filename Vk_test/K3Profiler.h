@@ -0,0 +1,74 @@
+#pragma once
+
+# include <chrono>
+# include <iostream>
+# include <vector>
+# include "K3Allocator.h"
+
+#define K3_PROFILER_REPORT_INTERVAL	1000
+
+#ifdef K3_DISABLE_PROFILING
+const bool enableProfiling = false;
+#else
+const bool enableProfiling = true;
+#endif
+
+/* Per-frame instrumentation. Counters and allocators are identified by the address
+** of a string literal, so looking one up never allocates once it has been registered.
+** Counter values are per frame and cleared once the frame ends.
+** Every K3_PROFILER_REPORT_INTERVAL frames the averaged values are printed to stderr, allocator
+** heap hits are summed over the interval.
+*/
+
+class K3Profiler {
+
+public:
+
+	void				beginFrame();
+	void				endFrame();
+	void				setCounter(char const* name, double value);
+	void				addCounter(char const* name, double value);
+	void				reportAllocator(char const* name, K3AllocatorStats const& stats);
+	void				report(std::ostream& os) const;
+	uint64_t			getFrameCount() const;
+	double				getLastFrameTime() const;
+
+	K3Profiler(uint32_t reportInterval = K3_PROFILER_REPORT_INTERVAL) : reportInterval(reportInterval) {
+		counters.reserve(32);
+		allocators.reserve(8);
+	}
+	~K3Profiler() {}
+
+private:
+
+	struct Counter
+	{
+		char const*	name;
+		double		value;
+		double		total;
+		double		max;
+	};
+
+	struct AllocatorEntry
+	{
+		char const*		name;
+		K3AllocatorStats	stats;
+		size_t			heapFallbacks;
+	};
+
+	Counter&			getCounter(char const* name);
+	void				resetCounters();
+
+	typedef std::chrono::steady_clock	Clock;
+
+	std::vector<Counter>		counters;
+	std::vector<AllocatorEntry>	allocators;
+	Clock::time_point		frameStart;
+	uint64_t			frameCount = 0;
+	uint32_t			framesSinceReport = 0;
+	uint32_t			reportInterval;
+	double				lastFrameTime = 0.0;
+	double				frameTimeTotal = 0.0;
+	double				frameTimeMax = 0.0;
+
+};
@@ -0,0 +1,174 @@
+#include "K3RenderQueue.h"
+#include "K3JobSystem.h"
+
+#define K3_SORT_BUCKETS		(1u << K3_SORT_RADIX_BITS)
+
+uint64_t	K3RenderQueue::makeKey(uint32_t const pass, uint32_t const pipeline, uint32_t const material, float const depth)
+{
+	uint32_t	depthBits;
+	float const	positiveDepth = depth > 0.0f ? depth : 0.0f;
+
+	// Positive floats order like their bit patterns
+	memcpy(&depthBits, &positiveDepth, sizeof(depthBits));
+	return (static_cast<uint64_t>(pass & ((1u << K3_KEY_PASS_BITS) - 1)) << (K3_KEY_PIPELINE_BITS + K3_KEY_MATERIAL_BITS + K3_KEY_DEPTH_BITS))
+		| (static_cast<uint64_t>(pipeline & ((1u << K3_KEY_PIPELINE_BITS) - 1)) << (K3_KEY_MATERIAL_BITS + K3_KEY_DEPTH_BITS))
+		| (static_cast<uint64_t>(material & ((1u << K3_KEY_MATERIAL_BITS) - 1)) << K3_KEY_DEPTH_BITS)
+		| depthBits;
+}
+
+uint32_t	K3RenderQueue::getPass(uint64_t const key)
+{
+	return static_cast<uint32_t>(key >> (K3_KEY_PIPELINE_BITS + K3_KEY_MATERIAL_BITS + K3_KEY_DEPTH_BITS));
+}
+
+uint32_t	K3RenderQueue::getPipeline(uint64_t const key)
+{
+	return static_cast<uint32_t>(key >> (K3_KEY_MATERIAL_BITS + K3_KEY_DEPTH_BITS)) & ((1u << K3_KEY_PIPELINE_BITS) - 1);
+}
+
+uint32_t	K3RenderQueue::getMaterial(uint64_t const key)
+{
+	return static_cast<uint32_t>(key >> K3_KEY_DEPTH_BITS) & ((1u << K3_KEY_MATERIAL_BITS) - 1);
+}
+
+uint64_t	K3RenderQueue::getBucketKey(uint64_t const key)
+{
+	return key >> K3_KEY_DEPTH_BITS << K3_KEY_DEPTH_BITS;
+}
+
+void		K3RenderQueue::clear()
+{
+	entries.clear();
+}
+
+void		K3RenderQueue::reserve(uint32_t const drawCount)
+{
+	entries.reserve(drawCount);
+	scratch.reserve(drawCount);
+}
+
+void		K3RenderQueue::push(uint64_t const key, uint32_t const draw)
+{
+	entries.push_back({ key, draw });
+}
+
+/* Every chunk counts its digits, the offsets are then laid out digit major and chunk
+** minor so each chunk scatters to its own ranges, in order, which keeps the sort stable.
+*/
+
+void		K3RenderQueue::sort()
+{
+	K3JobSystem&		jobs = K3JobSystem::getInstance();
+	uint32_t const		count = static_cast<uint32_t>(entries.size());
+	uint32_t const		chunkCount = std::max(1u, std::min(jobs.getWorkerCount() + 1, count / K3_SORT_PARALLEL_MIN));
+	uint32_t const		chunkSize = (count + chunkCount - 1) / chunkCount;
+
+	if (count < 2)
+		return;
+	scratch.resize(count);
+	histograms.resize(chunkCount * K3_SORT_BUCKETS);
+	for (uint32_t shift = 0; shift < 64; shift += K3_SORT_RADIX_BITS) {
+		std::fill(histograms.begin(), histograms.end(), 0);
+		jobs.parallelFor(0, chunkCount, 1, [&](uint32_t first, uint32_t last) {
+			for (uint32_t chunk = first; chunk < last; chunk++) {
+				uint32_t*	histogram = histograms.data() + chunk * K3_SORT_BUCKETS;
+				uint32_t const	end = std::min(count, (chunk + 1) * chunkSize);
+
+				for (uint32_t i = chunk * chunkSize; i < end; i++) {
+					histogram[(entries[i].key >> shift) & (K3_SORT_BUCKETS - 1)]++;
+				}
+			}
+		});
+
+		bool		sameDigit = false;
+		uint32_t	offset = 0;
+
+		for (uint32_t digit = 0; digit < K3_SORT_BUCKETS && !sameDigit; digit++) {
+			uint32_t	total = 0;
+
+			for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+				uint32_t&	bucket = histograms[chunk * K3_SORT_BUCKETS + digit];
+				uint32_t const	bucketCount = bucket;
+
+				bucket = offset;
+				offset += bucketCount;
+				total += bucketCount;
+			}
+			sameDigit = total == count;
+		}
+		if (sameDigit)
+			continue;
+
+		jobs.parallelFor(0, chunkCount, 1, [&](uint32_t first, uint32_t last) {
+			for (uint32_t chunk = first; chunk < last; chunk++) {
+				uint32_t*	offsets = histograms.data() + chunk * K3_SORT_BUCKETS;
+				uint32_t const	end = std::min(count, (chunk + 1) * chunkSize);
+
+				for (uint32_t i = chunk * chunkSize; i < end; i++) {
+					scratch[offsets[(entries[i].key >> shift) & (K3_SORT_BUCKETS - 1)]++] = entries[i];
+				}
+			}
+		});
+		entries.swap(scratch);
+	}
+}
+
+uint32_t	K3RenderQueue::getSize() const
+{
+	return static_cast<uint32_t>(entries.size());
+}
+
+uint64_t	K3RenderQueue::getKey(uint32_t const index) const
+{
+	return entries[index].key;
+}
+
+uint32_t	K3RenderQueue::getDraw(uint32_t const index) const
+{
+	return entries[index].draw;
+}
+
+void		K3StateFilter::bindPipeline(VkPipelineBindPoint const bindPoint, VkPipeline const pipeline)
+{
+	// Graphics and compute are tracked, any other bind point is always recorded
+	if (bindPoint < 2 && pipelines[bindPoint] == pipeline)
+		return;
+	vkCmdBindPipeline(cmdBuffer, bindPoint, pipeline);
+	if (bindPoint < 2)
+		pipelines[bindPoint] = pipeline;
+	stats.pipelineBinds++;
+}
+
+void		K3StateFilter::bindVertexBuffers(uint32_t const firstBinding, uint32_t const bindingCount,
+					VkBuffer const* buffers, VkDeviceSize const* offsets)
+{
+	bool		bound = firstBinding + bindingCount <= K3_MAX_VERTEX_BINDINGS;
+
+	for (uint32_t i = 0; i < bindingCount && bound; i++) {
+		bound = vertexBuffers[firstBinding + i] == buffers[i] && vertexOffsets[firstBinding + i] == offsets[i];
+	}
+	if (bound)
+		return;
+	vkCmdBindVertexBuffers(cmdBuffer, firstBinding, bindingCount, buffers, offsets);
+	for (uint32_t i = 0; i < bindingCount && firstBinding + i < K3_MAX_VERTEX_BINDINGS; i++) {
+		vertexBuffers[firstBinding + i] = buffers[i];
+		vertexOffsets[firstBinding + i] = offsets[i];
+	}
+	stats.vertexBinds++;
+}
+
+void		K3StateFilter::bindIndexBuffer(VkBuffer const buffer, VkDeviceSize const offset, VkIndexType const type)
+{
+	if (indexBuffer == buffer && indexOffset == offset && indexType == type)
+		return;
+	vkCmdBindIndexBuffer(cmdBuffer, buffer, offset, type);
+	indexBuffer = buffer;
+	indexOffset = offset;
+	indexType = type;
+	stats.indexBinds++;
+}
+
+K3BindStats const&	K3StateFilter::getStats() const
+{
+	return stats;
+}
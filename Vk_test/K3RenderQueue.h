@@ -0,0 +1,96 @@
+#pragma once
+
+# include "K3Vk.h"
+
+// Draws under which the sort runs on the calling thread only
+#define K3_SORT_PARALLEL_MIN	16384
+#define K3_SORT_RADIX_BITS	8
+// Widths of the sort key fields, from the most significant one
+#define K3_KEY_PASS_BITS	4
+#define K3_KEY_PIPELINE_BITS	12
+#define K3_KEY_MATERIAL_BITS	16
+#define K3_KEY_DEPTH_BITS	32
+// Vertex bindings K3StateFilter keeps track of
+#define K3_MAX_VERTEX_BINDINGS	4
+
+/* Draws of a frame ordered by a 64 bit key : pass, pipeline, material, then depth.
+** Sorting on it groups the draws sharing state, the most expensive state to change
+** being the most significant. Depth is the distance to the eye, opaque draws go front to back.
+** Keys are sorted with an LSD radix sort, 8 bits per pass, the histograms and the scatter
+** of large queues cut in chunks over the job system. A pass is skipped when every key has
+** the same digit, which the mostly unused pass and pipeline bits make common.
+*/
+
+class K3RenderQueue {
+
+public:
+
+	static uint64_t			makeKey(uint32_t const pass, uint32_t const pipeline, uint32_t const material, float const depth);
+	static uint32_t			getPass(uint64_t const key);
+	static uint32_t			getPipeline(uint64_t const key);
+	static uint32_t			getMaterial(uint64_t const key);
+	// Pass, pipeline and material : the key without its depth, shared by draws of the same state
+	static uint64_t			getBucketKey(uint64_t const key);
+	void				clear();
+	void				reserve(uint32_t const drawCount);
+	void				push(uint64_t const key, uint32_t const draw);
+	void				sort();
+	uint32_t			getSize() const;
+	// In key order once sorted, draw is what was given to push()
+	uint64_t			getKey(uint32_t const index) const;
+	uint32_t			getDraw(uint32_t const index) const;
+
+	K3RenderQueue() {}
+	~K3RenderQueue() {}
+
+private:
+
+	struct Entry
+	{
+		uint64_t	key;
+		uint32_t	draw;
+	};
+
+	std::vector<Entry>		entries;
+	std::vector<Entry>		scratch;
+	std::vector<uint32_t>		histograms;
+
+};
+
+// Binds actually recorded
+struct K3BindStats
+{
+	uint32_t	pipelineBinds = 0;
+	uint32_t	vertexBinds = 0;
+	uint32_t	indexBinds = 0;
+};
+
+/* Records binds into one command buffer, dropping those that would bind what is already
+** bound. Only knows what went through it, one filter per command buffer and recording.
+*/
+
+class K3StateFilter {
+
+public:
+
+	void				bindPipeline(VkPipelineBindPoint const bindPoint, VkPipeline const pipeline);
+	void				bindVertexBuffers(uint32_t const firstBinding, uint32_t const bindingCount,
+						VkBuffer const* buffers, VkDeviceSize const* offsets);
+	void				bindIndexBuffer(VkBuffer const buffer, VkDeviceSize const offset, VkIndexType const type);
+	K3BindStats const&		getStats() const;
+
+	K3StateFilter(VkCommandBuffer const cmdBuffer) : cmdBuffer(cmdBuffer) {}
+	~K3StateFilter() {}
+
+private:
+
+	VkCommandBuffer			cmdBuffer;
+	VkPipeline			pipelines[2] = {};
+	VkBuffer			vertexBuffers[K3_MAX_VERTEX_BINDINGS] = {};
+	VkDeviceSize			vertexOffsets[K3_MAX_VERTEX_BINDINGS] = {};
+	VkBuffer			indexBuffer = VK_NULL_HANDLE;
+	VkDeviceSize			indexOffset = 0;
+	VkIndexType			indexType = VK_INDEX_TYPE_UINT16;
+	K3BindStats			stats;
+
+};
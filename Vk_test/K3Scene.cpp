@@ -0,0 +1,355 @@
+#include "K3Scene.h"
+#include "K3JobSystem.h"
+#include "K3StreamWrite.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+# define K3_SCENE_SSE
+# include <emmintrin.h>
+#endif
+
+/* Local TRS to matrix, then world = parentWorld * local.
+** Both matrices are affine so the last row of the local matrix is known to be (0, 0, 0, 1)
+** and the product only needs three multiply-adds per column.
+*/
+
+static inline void	composeLocal(glm::vec3 const& t, glm::quat const& q, glm::vec3 const& s, float* out)
+{
+	float const	xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float const	xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float const	wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+	out[0] = (1.0f - 2.0f * (yy + zz)) * s.x;
+	out[1] = 2.0f * (xy + wz) * s.x;
+	out[2] = 2.0f * (xz - wy) * s.x;
+	out[3] = 0.0f;
+	out[4] = 2.0f * (xy - wz) * s.y;
+	out[5] = (1.0f - 2.0f * (xx + zz)) * s.y;
+	out[6] = 2.0f * (yz + wx) * s.y;
+	out[7] = 0.0f;
+	out[8] = 2.0f * (xz + wy) * s.z;
+	out[9] = 2.0f * (yz - wx) * s.z;
+	out[10] = (1.0f - 2.0f * (xx + yy)) * s.z;
+	out[11] = 0.0f;
+	out[12] = t.x;
+	out[13] = t.y;
+	out[14] = t.z;
+	out[15] = 1.0f;
+}
+
+static inline void	mulAffine(float const* parent, float const* local, float* out)
+{
+#ifdef K3_SCENE_SSE
+	__m128 const	p0 = _mm_loadu_ps(parent);
+	__m128 const	p1 = _mm_loadu_ps(parent + 4);
+	__m128 const	p2 = _mm_loadu_ps(parent + 8);
+	__m128 const	p3 = _mm_loadu_ps(parent + 12);
+
+	for (int col = 0; col < 4; col++) {
+		float const*	l = local + col * 4;
+		__m128		r = _mm_mul_ps(p0, _mm_set1_ps(l[0]));
+
+		r = _mm_add_ps(r, _mm_mul_ps(p1, _mm_set1_ps(l[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(p2, _mm_set1_ps(l[2])));
+		if (col == 3)
+			r = _mm_add_ps(r, p3);
+		_mm_storeu_ps(out + col * 4, r);
+	}
+#else
+	for (int col = 0; col < 4; col++) {
+		float const*	l = local + col * 4;
+
+		for (int row = 0; row < 4; row++) {
+			out[col * 4 + row] = parent[row] * l[0] + parent[4 + row] * l[1] + parent[8 + row] * l[2]
+				+ (col == 3 ? parent[12 + row] : 0.0f);
+		}
+	}
+#endif
+}
+
+uint32_t		K3Scene::createNode(uint32_t const parent)
+{
+	uint32_t	node = static_cast<uint32_t>(parents.size());
+
+	if (parent != K3_NO_PARENT && parent >= node)
+		throw std::runtime_error("Scene node parent does not exist !");
+	parents.push_back(parent);
+	translations.push_back(glm::vec3(0.0f));
+	rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	scales.push_back(glm::vec3(1.0f));
+	worldMatrices.push_back(glm::mat4(1.0f));
+	flags.push_back(LOCAL_DIRTY);
+	versions.push_back(0);
+	materials.push_back(0);
+	materialVersion++;
+	drawGenerations.push_back(materialVersion);
+	dirty = true;
+	if (capture)
+		capture->createNode(parent);
+	return node;
+}
+
+void			K3Scene::reserve(uint32_t const nodeCount)
+{
+	parents.reserve(nodeCount);
+	translations.reserve(nodeCount);
+	rotations.reserve(nodeCount);
+	scales.reserve(nodeCount);
+	worldMatrices.reserve(nodeCount);
+	flags.reserve(nodeCount);
+	versions.reserve(nodeCount);
+	materials.reserve(nodeCount);
+	drawGenerations.reserve(nodeCount);
+}
+
+void			K3Scene::setTranslation(uint32_t const node, glm::vec3 const& translation)
+{
+	translations[node] = translation;
+	flags[node] |= LOCAL_DIRTY;
+	dirty = true;
+	if (capture)
+		capture->setTranslation(node, translation);
+}
+
+void			K3Scene::setRotation(uint32_t const node, glm::quat const& rotation)
+{
+	rotations[node] = rotation;
+	flags[node] |= LOCAL_DIRTY;
+	dirty = true;
+	if (capture)
+		capture->setRotation(node, rotation);
+}
+
+void			K3Scene::setScale(uint32_t const node, glm::vec3 const& scale)
+{
+	scales[node] = scale;
+	flags[node] |= LOCAL_DIRTY;
+	dirty = true;
+	if (capture)
+		capture->setScale(node, scale);
+}
+
+// The material is read by the shaders as is, an unknown one would index past the table
+void			K3Scene::setMaterial(uint32_t const node, uint32_t const material)
+{
+	if (material >= materialCount)
+		throw std::runtime_error("Node given a material that was never created !");
+	if (materials[node] == material)
+		return;
+	materials[node] = material;
+	materialVersion++;
+	drawGenerations[node] = materialVersion;
+	if (capture)
+		capture->setMaterial(node, material);
+}
+
+uint32_t		K3Scene::createLight(K3Light const& light)
+{
+	uint32_t const	index = static_cast<uint32_t>(lights.size());
+
+	lights.push_back(light);
+	lights.back().direction = glm::normalize(light.direction);
+	lightVersion++;
+	if (capture)
+		capture->setLight(index, lights.back());
+	return index;
+}
+
+void			K3Scene::setLight(uint32_t const light, K3Light const& value)
+{
+	lights[light] = value;
+	lights[light].direction = glm::normalize(value.direction);
+	lightVersion++;
+	if (capture)
+		capture->setLight(light, lights[light]);
+}
+
+void			K3Scene::setAmbientLight(glm::vec3 const& color)
+{
+	ambientLight = color;
+	lightVersion++;
+	if (capture)
+		capture->setAmbientLight(color);
+}
+
+void			K3Scene::setCapture(K3CaptureWriter* const writer)
+{
+	capture = writer;
+	if (!capture)
+		return;
+	for (uint32_t i = 0; i < getNodeCount(); i++) {
+		capture->createNode(parents[i]);
+		capture->setTranslation(i, translations[i]);
+		capture->setRotation(i, rotations[i]);
+		capture->setScale(i, scales[i]);
+		if (materials[i] != 0)
+			capture->setMaterial(i, materials[i]);
+	}
+	for (uint32_t i = 0; i < getLightCount(); i++)
+		capture->setLight(i, lights[i]);
+	if (ambientLight != glm::vec3(1.0f))
+		capture->setAmbientLight(ambientLight);
+}
+
+uint32_t		K3Scene::getMaterial(uint32_t const node) const
+{
+	return materials[node];
+}
+
+void			K3Scene::setMaterialCount(uint32_t const count)
+{
+	materialCount = count;
+}
+
+K3Light const&		K3Scene::getLight(uint32_t const light) const
+{
+	return lights[light];
+}
+
+uint32_t		K3Scene::getLightCount() const
+{
+	return static_cast<uint32_t>(lights.size());
+}
+
+glm::vec3 const&	K3Scene::getAmbientLight() const
+{
+	return ambientLight;
+}
+
+glm::vec3 const&	K3Scene::getTranslation(uint32_t const node) const
+{
+	return translations[node];
+}
+
+glm::mat4 const&	K3Scene::getWorldMatrix(uint32_t const node) const
+{
+	return worldMatrices[node];
+}
+
+uint32_t		K3Scene::getParent(uint32_t const node) const
+{
+	return parents[node];
+}
+
+uint32_t		K3Scene::getNodeCount() const
+{
+	return static_cast<uint32_t>(parents.size());
+}
+
+uint32_t		K3Scene::getUpdatedCount() const
+{
+	return updatedCount;
+}
+
+/* Recomputes the world matrices that changed and copies every matrix the given region
+** has not received yet. regionVersion is owned by the caller, one per region, and a
+** region starting at version 0 receives the whole scene. The region is ordinary cached
+** memory that is read back, the matrices go there with plain stores.
+*/
+
+void			K3Scene::updateTransforms(glm::mat4* region, uint32_t& regionVersion, uint32_t const regionCapacity)
+{
+	uint32_t const	nodeCount = getNodeCount();
+	float		local[16];
+
+	updatedCount = 0;
+	if (!dirty && regionVersion == currentVersion)
+		return;
+	if (dirty)
+		currentVersion++;
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		uint32_t const	parent = parents[i];
+		uint8_t		nodeFlags = flags[i];
+
+		if (dirty && ((nodeFlags & LOCAL_DIRTY) || (parent != K3_NO_PARENT && (flags[parent] & WORLD_CHANGED)))) {
+			float*	world = glm::value_ptr(worldMatrices[i]);
+
+			composeLocal(translations[i], rotations[i], scales[i], local);
+			if (parent == K3_NO_PARENT)
+				memcpy(world, local, sizeof(local));
+			else
+				mulAffine(glm::value_ptr(worldMatrices[parent]), local, world);
+			versions[i] = currentVersion;
+			nodeFlags = WORLD_CHANGED;
+			updatedCount++;
+		}
+		else
+			nodeFlags = 0;
+		flags[i] = nodeFlags;
+		if (region && i < regionCapacity && versions[i] > regionVersion)
+			region[i] = worldMatrices[i];
+	}
+	regionVersion = currentVersion;
+	dirty = false;
+}
+
+// Brings a snapshot slot up to date, only the nodes it has not seen yet are copied
+void			K3Scene::writeSnapshot(K3SceneSnapshot& snapshot)
+{
+	uint32_t const	nodeCount = getNodeCount();
+	uint32_t const	previousVersion = snapshot.version;
+
+	if (snapshot.worlds.size() < nodeCount) {
+		snapshot.worlds.resize(nodeCount);
+		snapshot.versions.resize(nodeCount, 0);
+	}
+	updateTransforms(snapshot.worlds.data(), snapshot.version, nodeCount);
+	if (snapshot.version != previousVersion) {
+		for (uint32_t i = 0; i < nodeCount; i++) {
+			if (versions[i] > previousVersion)
+				snapshot.versions[i] = versions[i];
+		}
+	}
+	// Materials rarely change, a plain copy of the array is enough
+	if (snapshot.materialVersion != materialVersion) {
+		snapshot.materials.assign(materials.begin(), materials.end());
+		snapshot.drawGenerations.assign(drawGenerations.begin(), drawGenerations.end());
+		snapshot.materialVersion = materialVersion;
+	}
+	if (snapshot.lightVersion != lightVersion) {
+		snapshot.lights.assign(lights.begin(), lights.end());
+		snapshot.ambientLight = ambientLight;
+		snapshot.lightVersion = lightVersion;
+	}
+	snapshot.nodeCount = nodeCount;
+	snapshot.updatedCount = updatedCount;
+	snapshot.publishTime = std::chrono::steady_clock::now();
+}
+
+void			K3SceneSnapshot::copyToRegion(glm::mat4* instanceRegion, uint32_t& regionVersion, uint32_t const regionCapacity) const
+{
+	uint32_t const	count = std::min(nodeCount, regionCapacity);
+
+	if (regionVersion == version)
+		return;
+	K3JobSystem::getInstance().parallelFor(0, count, K3_SCENE_COPY_GRAIN, [&](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; i++) {
+			if (versions[i] > regionVersion)
+				K3StreamWrite::store(&instanceRegion[i], worlds[i]);
+		}
+		// The region may be write combined memory, every job orders its own stores
+		K3StreamWrite::fence();
+	});
+	regionVersion = version;
+}
+
+void			K3SceneSnapshot::copyMaterialsToRegion(uint32_t* materialRegion, uint32_t& regionVersion, uint32_t const regionCapacity) const
+{
+	uint32_t const	count = std::min(nodeCount, regionCapacity);
+
+	if (regionVersion == materialVersion)
+		return;
+	K3StreamWrite::copy(materialRegion, materials.data(), count * sizeof(uint32_t));
+	K3StreamWrite::fence();
+	regionVersion = materialVersion;
+}
+
+void			K3SceneSnapshot::copyLightsToRegion(K3Light* lightRegion, uint32_t& regionVersion, uint32_t const regionCapacity) const
+{
+	size_t const	count = std::min(lights.size(), static_cast<size_t>(regionCapacity));
+
+	if (regionVersion == lightVersion)
+		return;
+	K3StreamWrite::copy(lightRegion, lights.data(), count * sizeof(K3Light));
+	K3StreamWrite::fence();
+	regionVersion = lightVersion;
+}
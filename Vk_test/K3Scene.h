@@ -0,0 +1,141 @@
+#pragma once
+
+#include "K3Vk.h"
+#include "K3Capture.h"
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <chrono>
+
+#define K3_NO_PARENT		0xFFFFFFFFu
+#define K3_MAX_INSTANCES	131072
+#define K3_SCENE_COPY_GRAIN	16384
+
+enum K3LightType : uint32_t
+{
+	K3_LIGHT_POINT = 0,
+	K3_LIGHT_SPOT = 1
+};
+
+/* A point or spot light in world space, std430 layout of the lighting shaders. Its influence
+** ends at radius, a spot's cone goes from full intensity inside innerCos to none past outerCos
+** (cosines of the half angles around direction).
+*/
+
+struct K3Light
+{
+	glm::vec3	position = glm::vec3(0.0f);
+	float		radius = 1.0f;
+	glm::vec3	color = glm::vec3(1.0f);
+	float		intensity = 1.0f;
+	glm::vec3	direction = glm::vec3(0.0f, 0.0f, 1.0f);
+	float		outerCos = 0.0f;
+	float		innerCos = 0.0f;
+	K3LightType	type = K3_LIGHT_POINT;
+	uint32_t	padding[2] = {};
+};
+
+/* World matrices of the whole scene as seen by the renderer, one per K3TripleBuffer slot.
+** Each slot is brought up to date incrementally by K3Scene::writeSnapshot(), versions
+** holding the scene version at which each node last changed.
+*/
+
+struct K3SceneSnapshot
+{
+	std::vector<glm::mat4>		worlds;
+	std::vector<uint32_t>		versions;
+	uint32_t			nodeCount = 0;
+	uint32_t			version = 0;
+	uint32_t			updatedCount = 0;
+	uint64_t			tick = 0;
+	std::chrono::steady_clock::time_point	publishTime;
+	// When the input this state reacted to was polled
+	std::chrono::steady_clock::time_point	inputTime;
+	// Material of every node, copied whole whenever one changes
+	std::vector<uint32_t>		materials;
+	uint32_t			materialVersion = 0;
+	// materialVersion at which each node was created or given another material, the draw generation
+	std::vector<uint32_t>		drawGenerations;
+	// Lights are copied whole too, lightVersion counting every change to them or to the ambient light
+	std::vector<K3Light>		lights;
+	glm::vec3			ambientLight = glm::vec3(1.0f);
+	uint32_t			lightVersion = 0;
+
+	void				copyToRegion(glm::mat4* instanceRegion, uint32_t& regionVersion, uint32_t const regionCapacity) const;
+	void				copyMaterialsToRegion(uint32_t* materialRegion, uint32_t& regionVersion, uint32_t const regionCapacity) const;
+	void				copyLightsToRegion(K3Light* lightRegion, uint32_t& regionVersion, uint32_t const regionCapacity) const;
+};
+
+/* Transform hierarchy stored as structure of arrays. A node is an index and nodes
+** are only ever appended, so a parent always comes before its children and the world
+** matrices are resolved in a single linear pass.
+** Only nodes whose local transform (or an ancestor's) changed are recomputed, and the
+** results are copied into one or several snapshots, each remembering the last version it
+** received. The render thread reads the snapshot back, so it is written with plain stores :
+** only K3SceneSnapshot::copyToRegion() streams into the mapped instance buffer.
+*/
+
+class K3Scene {
+
+public:
+
+	uint32_t			createNode(uint32_t const parent = K3_NO_PARENT);
+	void				setTranslation(uint32_t const node, glm::vec3 const& translation);
+	void				setRotation(uint32_t const node, glm::quat const& rotation);
+	void				setScale(uint32_t const node, glm::vec3 const& scale);
+	// Index in the renderer's material table (VkHandler::createMaterial), 0 by default
+	void				setMaterial(uint32_t const node, uint32_t const material);
+	uint32_t			getMaterial(uint32_t const node) const;
+	// Size of the material table setMaterial checks against, kept up to date by the renderer
+	void				setMaterialCount(uint32_t const count);
+	// Lights are only ever appended, the direction is normalized
+	uint32_t			createLight(K3Light const& light);
+	void				setLight(uint32_t const light, K3Light const& value);
+	K3Light const&			getLight(uint32_t const light) const;
+	uint32_t			getLightCount() const;
+	// Added to every light, white by default so that a scene without lights looks unlit
+	void				setAmbientLight(glm::vec3 const& color);
+	glm::vec3 const&		getAmbientLight() const;
+	glm::vec3 const&		getTranslation(uint32_t const node) const;
+	glm::mat4 const&		getWorldMatrix(uint32_t const node) const;
+	uint32_t			getParent(uint32_t const node) const;
+	uint32_t			getNodeCount() const;
+	uint32_t			getUpdatedCount() const;
+	void				reserve(uint32_t const nodeCount);
+	void				updateTransforms(glm::mat4* region, uint32_t& regionVersion, uint32_t const regionCapacity);
+	void				writeSnapshot(K3SceneSnapshot& snapshot);
+	/* Records every later change into writer, nullptr stops. The nodes already there are
+	** recorded first so the capture replays from an empty scene.
+	*/
+	void				setCapture(K3CaptureWriter* const writer);
+
+	K3Scene() {}
+	~K3Scene() {}
+
+private:
+
+	enum NodeFlags : uint8_t
+	{
+		LOCAL_DIRTY = 1,
+		WORLD_CHANGED = 2
+	};
+
+	std::vector<uint32_t>		parents;
+	std::vector<glm::vec3>		translations;
+	std::vector<glm::quat>		rotations;
+	std::vector<glm::vec3>		scales;
+	std::vector<glm::mat4>		worldMatrices;
+	std::vector<uint8_t>		flags;
+	std::vector<uint32_t>		versions;
+	std::vector<uint32_t>		materials;
+	std::vector<uint32_t>		drawGenerations;
+	uint32_t			materialVersion = 1;
+	uint32_t			materialCount = 1;
+	std::vector<K3Light>		lights;
+	glm::vec3			ambientLight = glm::vec3(1.0f);
+	uint32_t			lightVersion = 1;
+	uint32_t			currentVersion = 1;
+	uint32_t			updatedCount = 0;
+	bool				dirty = false;
+	K3CaptureWriter*		capture = nullptr;
+
+};
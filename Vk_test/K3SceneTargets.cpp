@@ -0,0 +1,216 @@
+#include "K3SceneTargets.h"
+
+VkSampleCountFlagBits	K3SceneTargets::getSupportedSamples(VkPhysicalDevice const& gpuPDevice, VkSampleCountFlagBits const requested)
+{
+	VkPhysicalDeviceProperties	properties;
+
+	vkGetPhysicalDeviceProperties(gpuPDevice, &properties);
+
+	VkSampleCountFlags const	supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+	VkSampleCountFlags		count = VK_SAMPLE_COUNT_64_BIT;
+
+	while (count > VK_SAMPLE_COUNT_1_BIT && (count > static_cast<VkSampleCountFlags>(requested) || !(supported & count)))
+		count >>= 1;
+	return static_cast<VkSampleCountFlagBits>(count);
+}
+
+// Picks the depth format, the first one the device can render to, and sample if asked to
+void		K3SceneTargets::init(K3MemoryBudget& memoryBudget, VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuDevice,
+				VkSampleCountFlagBits const sampleCount, bool const sampledDepth)
+{
+	VkFormat const			candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM };
+	VkFormat			sampledFormat = VK_FORMAT_UNDEFINED;
+	VkPhysicalDeviceProperties	deviceProperties;
+
+	vkGetPhysicalDeviceProperties(gpuPDevice, &deviceProperties);
+	budget = &memoryBudget;
+	device = gpuDevice;
+	samples = sampleCount;
+	depthFormat = VK_FORMAT_UNDEFINED;
+	for (VkFormat format : candidates) {
+		VkFormatProperties	properties;
+
+		vkGetPhysicalDeviceFormatProperties(gpuPDevice, format, &properties);
+		if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT))
+			continue;
+		if (depthFormat == VK_FORMAT_UNDEFINED)
+			depthFormat = format;
+		if (sampledFormat == VK_FORMAT_UNDEFINED && (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+			sampledFormat = format;
+	}
+	if (depthFormat == VK_FORMAT_UNDEFINED)
+		throw std::runtime_error("Failed to find a depth format !");
+	depthSampled = sampledDepth && sampledFormat != VK_FORMAT_UNDEFINED
+		&& (deviceProperties.limits.sampledImageDepthSampleCounts & samples);
+	if (depthSampled)
+		depthFormat = sampledFormat;
+}
+
+K3SceneTargets::Target	K3SceneTargets::createTarget(VkExtent2D const extent, VkFormat const format, VkImageUsageFlags const usage,
+					VkImageAspectFlags const aspect)
+{
+	Target			target;
+	bool const		transient = !(usage & VK_IMAGE_USAGE_SAMPLED_BIT);
+
+	VkImageCreateInfo	imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = format;
+	imageInfo.extent = { extent.width, extent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = samples;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = transient ? usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : usage;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if (vkCreateImage(device, &imageInfo, nullptr, &target.image) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create scene attachment !");
+
+	VkMemoryRequirements	memRequirements;
+	vkGetImageMemoryRequirements(device, target.image, &memRequirements);
+
+	// Nothing transient is ever stored, the lazily allocated memory is only there in case the tiles spill
+	if (transient) {
+		target.memory = budget->tryAllocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+			K3_MEMORY_CRITICAL);
+		lazy = target.memory != VK_NULL_HANDLE;
+	}
+	if (target.memory == VK_NULL_HANDLE)
+		target.memory = budget->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, K3_MEMORY_CRITICAL);
+	vkBindImageMemory(device, target.image, target.memory, 0);
+
+	VkImageViewCreateInfo	viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = target.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = aspect;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+	if (vkCreateImageView(device, &viewInfo, nullptr, &target.view) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create scene attachment view !");
+	return target;
+}
+
+void		K3SceneTargets::destroyTarget(VkDevice const gpuDevice, K3MemoryBudget* const memoryBudget, Target const& target)
+{
+	if (target.image == VK_NULL_HANDLE)
+		return;
+	vkDestroyImageView(gpuDevice, target.view, nullptr);
+	vkDestroyImage(gpuDevice, target.image, nullptr);
+	memoryBudget->free(target.memory);
+}
+
+// The previous targets must have been retired
+void		K3SceneTargets::create(VkExtent2D const extent, VkFormat const colorFormat)
+{
+	lazy = false;
+	if (samples != VK_SAMPLE_COUNT_1_BIT)
+		color = createTarget(extent, colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+	depth = createTarget(extent, depthFormat, depthSampled ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+		: VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+}
+
+void		K3SceneTargets::retire(K3DeletionQueue& retired, uint64_t const frame)
+{
+	VkDevice const		gpuDevice = device;
+	K3MemoryBudget* const	memoryBudget = budget;
+	Target const		oldColor = color;
+	Target const		oldDepth = depth;
+
+	if (depth.image == VK_NULL_HANDLE)
+		return;
+	retired.push(frame, [gpuDevice, memoryBudget, oldColor, oldDepth]() {
+		destroyTarget(gpuDevice, memoryBudget, oldColor);
+		destroyTarget(gpuDevice, memoryBudget, oldDepth);
+	});
+	color = Target();
+	depth = Target();
+}
+
+// Only once the device is idle
+void		K3SceneTargets::destroy()
+{
+	destroyTarget(device, budget, color);
+	destroyTarget(device, budget, depth);
+	color = Target();
+	depth = Target();
+}
+
+/* Every attachment but the output is cleared and discarded, the depth is stored when it is
+** sampled. With MSAA the output is only written by the resolve, its previous content is not
+** loaded.
+*/
+
+std::vector<VkAttachmentDescription>	K3SceneTargets::getAttachmentDescriptions(VkFormat const outputFormat, VkImageLayout const outputLayout) const
+{
+	std::vector<VkAttachmentDescription>	attachments(getAttachmentCount());
+
+	for (VkAttachmentDescription& attachment : attachments) {
+		attachment.samples = samples;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+	attachments[0].format = outputFormat;
+	attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	attachments[1].format = depthFormat;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	if (depthSampled) {
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	}
+
+	VkAttachmentDescription&		output = attachments[samples == VK_SAMPLE_COUNT_1_BIT ? 0 : 2];
+
+	if (samples != VK_SAMPLE_COUNT_1_BIT) {
+		output.format = outputFormat;
+		output.samples = VK_SAMPLE_COUNT_1_BIT;
+		output.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	}
+	output.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	output.finalLayout = outputLayout;
+	return attachments;
+}
+
+std::vector<VkImageView>	K3SceneTargets::getAttachments(VkImageView const output) const
+{
+	if (samples == VK_SAMPLE_COUNT_1_BIT)
+		return { output, depth.view };
+	return { color.view, depth.view, output };
+}
+
+uint32_t	K3SceneTargets::getAttachmentCount() const
+{
+	return samples == VK_SAMPLE_COUNT_1_BIT ? 2 : 3;
+}
+
+VkSampleCountFlagBits	K3SceneTargets::getSamples() const
+{
+	return samples;
+}
+
+VkFormat	K3SceneTargets::getDepthFormat() const
+{
+	return depthFormat;
+}
+
+VkImageView	K3SceneTargets::getDepthView() const
+{
+	return depth.view;
+}
+
+bool		K3SceneTargets::isDepthSampled() const
+{
+	return depthSampled;
+}
+
+bool		K3SceneTargets::isLazilyAllocated() const
+{
+	return lazy;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+# include "K3Vk.h"
+# include "K3DeletionQueue.h"
+# include "K3MemoryBudget.h"
+
+// Samples per pixel asked for by default, lowered to what the device supports
+#define K3_MSAA_SAMPLES		VK_SAMPLE_COUNT_4_BIT
+
+/* Attachments of the scene pass besides its output : the depth buffer and, with MSAA, the
+** multisampled color the output is resolved from. The resolve happens at the end of the
+** subpass (pResolveAttachments) so the color is never stored : it is a transient
+** attachment, in lazily allocated memory when the device has some, which tile based GPUs
+** keep in tile memory without ever backing it. The depth is too, unless it is sampled : the
+** meshlet culling builds its depth pyramid from it after the pass, it is then stored and
+** left read only. One set is shared by every framebuffer, the scene pass dependency orders
+** the frames that use it.
+** Attachments are, in render pass order : color (multisampled, or the output without MSAA),
+** depth, then the resolved output with MSAA.
+*/
+
+class K3SceneTargets {
+
+public:
+
+	// Highest supported count up to requested, for both color and depth
+	static VkSampleCountFlagBits		getSupportedSamples(VkPhysicalDevice const& gpuPDevice, VkSampleCountFlagBits const requested);
+	// A sampled depth is only had when the device can sample a depth format at that sample count
+	void					init(K3MemoryBudget& memoryBudget, VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuDevice,
+							VkSampleCountFlagBits const sampleCount, bool const sampledDepth);
+	// The color format is the output's, which the multisampled color resolves to
+	void					create(VkExtent2D const extent, VkFormat const colorFormat);
+	void					retire(K3DeletionQueue& retired, uint64_t const frame);
+	void					destroy();
+	// Render pass attachments around the output, which stays in the state the pass leaves it in
+	std::vector<VkAttachmentDescription>	getAttachmentDescriptions(VkFormat const outputFormat, VkImageLayout const outputLayout) const;
+	// The framebuffer attachments for one output view, in the same order
+	std::vector<VkImageView>		getAttachments(VkImageView const output) const;
+	uint32_t				getAttachmentCount() const;
+	VkSampleCountFlagBits			getSamples() const;
+	VkFormat				getDepthFormat() const;
+	// In VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL once the pass is over
+	VkImageView				getDepthView() const;
+	bool					isDepthSampled() const;
+	bool					isLazilyAllocated() const;
+
+	K3SceneTargets() {}
+	~K3SceneTargets() {}
+
+	K3SceneTargets(K3SceneTargets const&) = delete;
+	K3SceneTargets&				operator=(K3SceneTargets const&) = delete;
+
+private:
+
+	struct Target
+	{
+		VkImage			image = VK_NULL_HANDLE;
+		VkDeviceMemory		memory = VK_NULL_HANDLE;
+		VkImageView		view = VK_NULL_HANDLE;
+	};
+
+	Target					createTarget(VkExtent2D const extent, VkFormat const format, VkImageUsageFlags const usage,
+							VkImageAspectFlags const aspect);
+	static void				destroyTarget(VkDevice const gpuDevice, K3MemoryBudget* const memoryBudget, Target const& target);
+
+	K3MemoryBudget*				budget = nullptr;
+	VkDevice				device = VK_NULL_HANDLE;
+	VkSampleCountFlagBits			samples = VK_SAMPLE_COUNT_1_BIT;
+	VkFormat				depthFormat = VK_FORMAT_UNDEFINED;
+	bool					depthSampled = false;
+	// Whether the transient targets got lazily allocated memory
+	bool					lazy = false;
+	Target					color;
+	Target					depth;
+
+};
@@ -0,0 +1,357 @@
+#include "K3ShaderLayout.h"
+#include <unordered_map>
+
+// The few parts of the SPIR-V specification reflection needs
+#define K3_SPIRV_MAGIC			0x07230203u
+#define K3_SPIRV_HEADER_WORDS		5
+
+enum K3SpirvOp {
+	SPIRV_OP_ENTRY_POINT = 15,
+	SPIRV_OP_TYPE_BOOL = 20,
+	SPIRV_OP_TYPE_INT = 21,
+	SPIRV_OP_TYPE_FLOAT = 22,
+	SPIRV_OP_TYPE_VECTOR = 23,
+	SPIRV_OP_TYPE_MATRIX = 24,
+	SPIRV_OP_TYPE_IMAGE = 25,
+	SPIRV_OP_TYPE_SAMPLER = 26,
+	SPIRV_OP_TYPE_SAMPLED_IMAGE = 27,
+	SPIRV_OP_TYPE_ARRAY = 28,
+	SPIRV_OP_TYPE_RUNTIME_ARRAY = 29,
+	SPIRV_OP_TYPE_STRUCT = 30,
+	SPIRV_OP_TYPE_POINTER = 32,
+	SPIRV_OP_CONSTANT = 43,
+	SPIRV_OP_SPEC_CONSTANT_TRUE = 48,
+	SPIRV_OP_SPEC_CONSTANT_FALSE = 49,
+	SPIRV_OP_SPEC_CONSTANT = 50,
+	SPIRV_OP_SPEC_CONSTANT_COMPOSITE = 51,
+	SPIRV_OP_SPEC_CONSTANT_OP = 52,
+	SPIRV_OP_VARIABLE = 59,
+	SPIRV_OP_DECORATE = 71,
+	SPIRV_OP_MEMBER_DECORATE = 72
+};
+
+enum K3SpirvDecoration {
+	SPIRV_DECORATION_BUFFER_BLOCK = 3,
+	SPIRV_DECORATION_ARRAY_STRIDE = 6,
+	SPIRV_DECORATION_MATRIX_STRIDE = 7,
+	SPIRV_DECORATION_LOCATION = 30,
+	SPIRV_DECORATION_BINDING = 33,
+	SPIRV_DECORATION_DESCRIPTOR_SET = 34,
+	SPIRV_DECORATION_OFFSET = 35
+};
+
+enum K3SpirvStorage {
+	SPIRV_STORAGE_UNIFORM_CONSTANT = 0,
+	SPIRV_STORAGE_INPUT = 1,
+	SPIRV_STORAGE_UNIFORM = 2,
+	SPIRV_STORAGE_PUSH_CONSTANT = 9,
+	SPIRV_STORAGE_STORAGE_BUFFER = 12
+};
+
+#define K3_SPIRV_DIM_BUFFER		5
+
+// What one module declares, by result ID
+struct K3SpirvModule
+{
+	VkShaderStageFlags						stages = 0;
+	// Operands of the type and constant instructions, result ID removed
+	std::unordered_map<uint32_t, std::pair<uint32_t, std::vector<uint32_t>>>	types;
+	std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>>		decorations;
+	// Struct ID, then member index, then decoration
+	std::unordered_map<uint32_t, std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>>>	memberDecorations;
+	// Variable ID, its pointer type and storage class
+	std::vector<std::pair<uint32_t, std::pair<uint32_t, uint32_t>>>	variables;
+
+	std::pair<uint32_t, std::vector<uint32_t>> const&	getType(uint32_t const id) const {
+		auto	found = types.find(id);
+
+		if (found == types.end())
+			throw std::runtime_error("Shader references an unknown SPIR-V type !");
+		return found->second;
+	}
+
+	bool				getDecoration(uint32_t const id, uint32_t const decoration, uint32_t& value) const {
+		auto	found = decorations.find(id);
+
+		if (found == decorations.end() || found->second.count(decoration) == 0)
+			return false;
+		value = found->second.at(decoration);
+		return true;
+	}
+};
+
+static VkShaderStageFlags	getStage(uint32_t const executionModel)
+{
+	switch (executionModel) {
+		case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+		case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+#ifdef VK_EXT_mesh_shader
+		case 5364: return VK_SHADER_STAGE_TASK_BIT_EXT;
+		case 5365: return VK_SHADER_STAGE_MESH_BIT_EXT;
+#endif
+		default: throw std::runtime_error("Unsupported shader stage !");
+	}
+}
+
+// A length set by a specialization constant would change with the variant, when one layout serves them all
+static uint32_t		getArrayLength(K3SpirvModule const& module, uint32_t const lengthId)
+{
+	auto const&	constant = module.getType(lengthId);
+
+	if (constant.first >= SPIRV_OP_SPEC_CONSTANT_TRUE && constant.first <= SPIRV_OP_SPEC_CONSTANT_OP)
+		throw std::runtime_error("Shader sizes an array with a specialization constant !");
+	if (constant.first != SPIRV_OP_CONSTANT || constant.second.size() < 2)
+		throw std::runtime_error("Shader array length is not a constant !");
+	return constant.second[1];
+}
+
+// Bytes a push constant member takes from its offset, matrixStride from the member's decoration
+static uint32_t		getTypeSize(K3SpirvModule const& module, uint32_t const typeId, uint32_t const matrixStride = 0)
+{
+	auto const&	type = module.getType(typeId);
+	uint32_t	stride = 0;
+	uint32_t	size = 0;
+
+	switch (type.first) {
+		case SPIRV_OP_TYPE_BOOL:
+			return 4;
+		case SPIRV_OP_TYPE_INT:
+		case SPIRV_OP_TYPE_FLOAT:
+			return type.second[0] / 8;
+		case SPIRV_OP_TYPE_VECTOR:
+			return type.second[1] * getTypeSize(module, type.second[0]);
+		case SPIRV_OP_TYPE_MATRIX:
+			return type.second[1] * std::max(matrixStride, getTypeSize(module, type.second[0]));
+		case SPIRV_OP_TYPE_ARRAY:
+			if (!module.getDecoration(typeId, SPIRV_DECORATION_ARRAY_STRIDE, stride))
+				stride = getTypeSize(module, type.second[0], matrixStride);
+			return getArrayLength(module, type.second[1]) * stride;
+		case SPIRV_OP_TYPE_STRUCT:
+			for (uint32_t member = 0; member < type.second.size(); member++) {
+				auto const	found = module.memberDecorations.find(typeId);
+				uint32_t	offset = size;
+				uint32_t	memberStride = 0;
+
+				if (found != module.memberDecorations.end() && found->second.count(member)) {
+					auto const&	decorations = found->second.at(member);
+
+					if (decorations.count(SPIRV_DECORATION_OFFSET))
+						offset = decorations.at(SPIRV_DECORATION_OFFSET);
+					if (decorations.count(SPIRV_DECORATION_MATRIX_STRIDE))
+						memberStride = decorations.at(SPIRV_DECORATION_MATRIX_STRIDE);
+				}
+				size = std::max(size, offset + getTypeSize(module, type.second[member], memberStride));
+			}
+			return size;
+		default:
+			throw std::runtime_error("Unsupported type in a push constant block !");
+	}
+}
+
+// 32 bit components only, one location's worth
+static VkFormat		getInputFormat(K3SpirvModule const& module, uint32_t const typeId)
+{
+	static VkFormat const	floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+	static VkFormat const	sintFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+	static VkFormat const	uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+	auto const&		type = module.getType(typeId);
+	uint32_t const		count = type.first == SPIRV_OP_TYPE_VECTOR ? type.second[1] : 1;
+	auto const&		component = type.first == SPIRV_OP_TYPE_VECTOR ? module.getType(type.second[0]) : type;
+
+	if (count < 1 || count > 4 || component.second.empty() || component.second[0] != 32)
+		throw std::runtime_error("Unsupported vertex input type !");
+	if (component.first == SPIRV_OP_TYPE_FLOAT)
+		return floatFormats[count - 1];
+	if (component.first == SPIRV_OP_TYPE_INT)
+		return component.second[1] ? sintFormats[count - 1] : uintFormats[count - 1];
+	throw std::runtime_error("Unsupported vertex input type !");
+}
+
+static VkDescriptorType	getDescriptorType(K3SpirvModule const& module, uint32_t const typeId, uint32_t const storage)
+{
+	auto const&	type = module.getType(typeId);
+	uint32_t	unused;
+
+	if (storage == SPIRV_STORAGE_STORAGE_BUFFER)
+		return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	if (storage == SPIRV_STORAGE_UNIFORM && type.first == SPIRV_OP_TYPE_STRUCT)
+		return module.getDecoration(typeId, SPIRV_DECORATION_BUFFER_BLOCK, unused) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+			: VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	if (storage == SPIRV_STORAGE_UNIFORM_CONSTANT) {
+		switch (type.first) {
+			case SPIRV_OP_TYPE_SAMPLER:
+				return VK_DESCRIPTOR_TYPE_SAMPLER;
+			case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+				return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			// Sampled is 1 for an image used with a sampler, 2 for a storage image
+			case SPIRV_OP_TYPE_IMAGE:
+				if (type.second[1] == K3_SPIRV_DIM_BUFFER)
+					return type.second[5] == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				return type.second[5] == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		}
+	}
+	throw std::runtime_error("Unsupported descriptor type in shader !");
+}
+
+static K3SpirvModule	parseModule(uint32_t const* code, size_t const wordCount)
+{
+	K3SpirvModule		module;
+
+	if (wordCount < K3_SPIRV_HEADER_WORDS || code[0] != K3_SPIRV_MAGIC)
+		throw std::runtime_error("Shader is not SPIR-V !");
+	for (size_t word = K3_SPIRV_HEADER_WORDS; word < wordCount;) {
+		uint32_t const		op = code[word] & 0xFFFF;
+		uint32_t const		length = code[word] >> 16;
+		uint32_t const*		operands = code + word + 1;
+
+		if (length == 0 || word + length > wordCount)
+			throw std::runtime_error("Truncated SPIR-V instruction in shader !");
+		switch (op) {
+			case SPIRV_OP_ENTRY_POINT:
+				module.stages |= getStage(operands[0]);
+				break;
+			case SPIRV_OP_DECORATE:
+				if (length >= 3)
+					module.decorations[operands[0]][operands[1]] = length >= 4 ? operands[2] : 0;
+				break;
+			case SPIRV_OP_MEMBER_DECORATE:
+				if (length >= 4)
+					module.memberDecorations[operands[0]][operands[1]][operands[2]] = length >= 5 ? operands[3] : 0;
+				break;
+			case SPIRV_OP_VARIABLE:
+				module.variables.push_back({ operands[1], { operands[0], operands[2] } });
+				break;
+			// Constants have their result type first, it is kept as the first operand
+			case SPIRV_OP_CONSTANT:
+			case SPIRV_OP_SPEC_CONSTANT_TRUE:
+			case SPIRV_OP_SPEC_CONSTANT_FALSE:
+			case SPIRV_OP_SPEC_CONSTANT:
+			case SPIRV_OP_SPEC_CONSTANT_COMPOSITE:
+			case SPIRV_OP_SPEC_CONSTANT_OP:
+				module.types[operands[1]] = { op, std::vector<uint32_t>({ operands[0] }) };
+				module.types[operands[1]].second.insert(module.types[operands[1]].second.end(), operands + 2, code + word + length);
+				break;
+			default:
+				if (op >= SPIRV_OP_TYPE_BOOL && op <= SPIRV_OP_TYPE_POINTER && length >= 2)
+					module.types[operands[0]] = { op, std::vector<uint32_t>(operands + 1, code + word + length) };
+				break;
+		}
+		word += length;
+	}
+	return module;
+}
+
+/* Variables without a location or a binding are built-ins, those are left out. Vertex
+** inputs are only kept from a vertex stage, the other stages' inputs are fed by the stage
+** before them.
+*/
+
+void		K3ShaderLayout::addStage(uint32_t const* code, size_t const size)
+{
+	K3SpirvModule const	module = parseModule(code, size / sizeof(uint32_t));
+
+	stages |= module.stages;
+	for (auto const& variable : module.variables) {
+		uint32_t const	id = variable.first;
+		uint32_t const	storage = variable.second.second;
+		uint32_t	typeId = module.getType(variable.second.first).second[1];
+		uint32_t	location;
+		uint32_t	set;
+		uint32_t	binding;
+
+		if (storage == SPIRV_STORAGE_PUSH_CONSTANT) {
+			pushRange.stageFlags |= module.stages;
+			pushRange.size = std::max(pushRange.size, getTypeSize(module, typeId));
+		}
+		else if (storage == SPIRV_STORAGE_INPUT && (module.stages & VK_SHADER_STAGE_VERTEX_BIT)
+			&& module.getDecoration(id, SPIRV_DECORATION_LOCATION, location)) {
+			uint32_t	count = 1;
+
+			if (module.getType(typeId).first == SPIRV_OP_TYPE_ARRAY) {
+				count = getArrayLength(module, module.getType(typeId).second[1]);
+				typeId = module.getType(typeId).second[0];
+			}
+			if (module.getType(typeId).first == SPIRV_OP_TYPE_MATRIX) {
+				count *= module.getType(typeId).second[1];
+				typeId = module.getType(typeId).second[0];
+			}
+			for (uint32_t i = 0; i < count; i++)
+				inputs[location + i] = { getInputFormat(module, typeId), getTypeSize(module, typeId) };
+		}
+		else if (module.getDecoration(id, SPIRV_DECORATION_DESCRIPTOR_SET, set) && module.getDecoration(id, SPIRV_DECORATION_BINDING, binding)) {
+			VkDescriptorSetLayoutBinding	layoutBinding = {};
+
+			layoutBinding.binding = binding;
+			layoutBinding.descriptorCount = 1;
+			if (module.getType(typeId).first == SPIRV_OP_TYPE_ARRAY) {
+				layoutBinding.descriptorCount = getArrayLength(module, module.getType(typeId).second[1]);
+				typeId = module.getType(typeId).second[0];
+			}
+			else if (module.getType(typeId).first == SPIRV_OP_TYPE_RUNTIME_ARRAY) {
+				layoutBinding.descriptorCount = 0;
+				typeId = module.getType(typeId).second[0];
+			}
+			layoutBinding.descriptorType = getDescriptorType(module, typeId, storage);
+			layoutBinding.stageFlags = module.stages;
+
+			auto		found = sets[set].find(binding);
+
+			if (found == sets[set].end())
+				sets[set][binding] = layoutBinding;
+			else if (found->second.descriptorType != layoutBinding.descriptorType || found->second.descriptorCount != layoutBinding.descriptorCount)
+				throw std::runtime_error("Shader stages disagree on a descriptor binding !");
+			else
+				found->second.stageFlags |= module.stages;
+		}
+	}
+}
+
+VkShaderStageFlags	K3ShaderLayout::getStages() const
+{
+	return stages;
+}
+
+std::vector<VkVertexInputAttributeDescription>	K3ShaderLayout::getVertexAttributes(uint32_t const binding, uint32_t const stride,
+							uint32_t const firstLocation, uint32_t const endLocation) const
+{
+	std::vector<VkVertexInputAttributeDescription>	attributes;
+	uint32_t					offset = 0;
+
+	for (auto it = inputs.lower_bound(firstLocation); it != inputs.end() && it->first < endLocation; ++it) {
+		VkVertexInputAttributeDescription	attribute = {};
+
+		// Packing needs every location, a gap would shift all the offsets after it
+		if (it->first != firstLocation + attributes.size())
+			throw std::runtime_error("Vertex inputs of the shader are not contiguous !");
+		attribute.binding = binding;
+		attribute.location = it->first;
+		attribute.format = it->second.format;
+		attribute.offset = offset;
+		attributes.push_back(attribute);
+		offset += it->second.size;
+	}
+	if (!attributes.empty() && offset != stride)
+		throw std::runtime_error("Vertex layout does not match the shader inputs !");
+	return attributes;
+}
+
+std::vector<VkDescriptorSetLayoutBinding>	K3ShaderLayout::getSetBindings(uint32_t const set) const
+{
+	std::vector<VkDescriptorSetLayoutBinding>	bindings;
+	auto						found = sets.find(set);
+
+	if (found == sets.end())
+		return bindings;
+	for (auto const& binding : found->second)
+		bindings.push_back(binding.second);
+	return bindings;
+}
+
+VkPushConstantRange	K3ShaderLayout::getPushConstantRange() const
+{
+	return pushRange;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+# include "K3Vk.h"
+# include <map>
+
+/* Interface of a set of shader stages, reflected from their SPIR-V : vertex inputs,
+** descriptor bindings and push constants. Pipeline layouts and vertex attributes are built
+** from it, so they follow whatever binary is loaded instead of tables kept by hand next to
+** the GLSL. Stages are merged as they are added, a binding or push constant block shared
+** by several stages gets all of them in its stage flags.
+** Only what the engine's shaders use is understood : 32 bit scalars, vectors and matrices
+** as vertex inputs, images, samplers and buffers as descriptors.
+*/
+
+class K3ShaderLayout {
+
+public:
+
+	void						addStage(uint32_t const* code, size_t const size);
+	VkShaderStageFlags				getStages() const;
+	/* Attributes of one vertex binding, the inputs from firstLocation up to endLocation
+	** packed in location order. Throws unless the inputs found fill exactly stride bytes,
+	** no input in the range at all means the stages do not read the binding.
+	*/
+	std::vector<VkVertexInputAttributeDescription>	getVertexAttributes(uint32_t const binding, uint32_t const stride,
+								uint32_t const firstLocation, uint32_t const endLocation) const;
+	// Runtime sized arrays have a count of 0, it is up to the caller
+	std::vector<VkDescriptorSetLayoutBinding>	getSetBindings(uint32_t const set) const;
+	// Size 0 when no stage has push constants
+	VkPushConstantRange				getPushConstantRange() const;
+
+	K3ShaderLayout() {}
+	~K3ShaderLayout() {}
+
+private:
+
+	struct Input
+	{
+		VkFormat			format;
+		uint32_t			size;
+	};
+
+	VkShaderStageFlags				stages = 0;
+	// Vertex stage inputs by location, a matrix takes one location per column
+	std::map<uint32_t, Input>			inputs;
+	// By set then binding
+	std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>>	sets;
+	VkPushConstantRange				pushRange = {};
+
+};
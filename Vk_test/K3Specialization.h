@@ -0,0 +1,136 @@
+#pragma once
+
+# include "K3Vk.h"
+# include "K3DeletionQueue.h"
+# include <string>
+# include <type_traits>
+# include <unordered_map>
+
+// Variant that was never added
+#define K3_VARIANT_NONE		0xFFFFFFFFu
+
+/* Specialization constants of a pipeline given as a plain struct. T lists its constants
+** with a static getMapEntries(), one entry per member : constant_id, offsetof and sizeof.
+** Members are 32 bit (VkBool32, int32_t, uint32_t, float) so the struct has no padding.
+** The info points into the object, which is why it is neither copied nor moved.
+*/
+
+template <typename T>
+class K3Specialization {
+
+public:
+
+	explicit			K3Specialization(T const& values) : values(values), entries(T::getMapEntries()) {
+		static_assert(std::is_trivially_copyable<T>::value, "Specialization constants must be plain data");
+		info.mapEntryCount = static_cast<uint32_t>(entries.size());
+		info.pMapEntries = entries.data();
+		info.dataSize = sizeof(T);
+		info.pData = &this->values;
+	}
+
+	VkSpecializationInfo const*	getInfo() const {
+		return &info;
+	}
+
+	~K3Specialization() {}
+
+	K3Specialization(K3Specialization const&) = delete;
+	K3Specialization&		operator=(K3Specialization const&) = delete;
+
+private:
+
+	T				values;
+	decltype(T::getMapEntries())	entries;
+	VkSpecializationInfo		info = {};
+
+};
+
+/* Pipelines of one kind, one per set of specialization values. The driver folds the
+** constants in when building each of them, so a variant drops the branches its values
+** rule out instead of testing them per invocation. Variants are built on first add() and
+** keep their index until retired, small enough to go in the pipeline bits of a sort key.
+** Not thread safe, variants are meant to be added while the pipelines are created.
+*/
+
+template <typename T>
+class K3PipelineVariants {
+
+public:
+
+	// Builds the pipeline with the given constants, the info only lives for the call
+	typedef std::function<VkPipeline(VkSpecializationInfo const*)>	Builder;
+
+	void				init(VkDevice const& gpuDevice) {
+		device = gpuDevice;
+	}
+
+	// Index of the variant with these values, built by build unless already there
+	uint32_t			add(T const& values, Builder const& build) {
+		uint32_t const		index = find(values);
+
+		if (index != K3_VARIANT_NONE)
+			return index;
+
+		K3Specialization<T> const	specialization(values);
+		VkPipeline const		pipeline = build(specialization.getInfo());
+
+		if (pipeline == VK_NULL_HANDLE)
+			throw std::runtime_error("Failed to create pipeline variant !");
+		pipelines.push_back(pipeline);
+		indices.emplace(getKey(values), static_cast<uint32_t>(pipelines.size() - 1));
+		return static_cast<uint32_t>(pipelines.size() - 1);
+	}
+
+	uint32_t			find(T const& values) const {
+		auto		found = indices.find(getKey(values));
+
+		return found == indices.end() ? K3_VARIANT_NONE : found->second;
+	}
+
+	VkPipeline			get(uint32_t const index) const {
+		return pipelines[index];
+	}
+
+	uint32_t			getCount() const {
+		return static_cast<uint32_t>(pipelines.size());
+	}
+
+	// Variants added again afterwards in the same order get the same indices back
+	void				retire(K3DeletionQueue& retired, uint64_t const frame) {
+		VkDevice const			gpuDevice = device;
+		std::vector<VkPipeline> const	oldPipelines = pipelines;
+
+		retired.push(frame, [gpuDevice, oldPipelines]() {
+			for (VkPipeline pipeline : oldPipelines)
+				vkDestroyPipeline(gpuDevice, pipeline, nullptr);
+		});
+		pipelines.clear();
+		indices.clear();
+	}
+
+	// Only once the device is idle
+	void				destroy() {
+		for (VkPipeline pipeline : pipelines)
+			vkDestroyPipeline(device, pipeline, nullptr);
+		pipelines.clear();
+		indices.clear();
+	}
+
+	K3PipelineVariants() {}
+	~K3PipelineVariants() {}
+
+	K3PipelineVariants(K3PipelineVariants const&) = delete;
+	K3PipelineVariants&		operator=(K3PipelineVariants const&) = delete;
+
+private:
+
+	// The values byte for byte, T has no padding
+	static std::string		getKey(T const& values) {
+		return std::string(reinterpret_cast<char const*>(&values), sizeof(T));
+	}
+
+	VkDevice			device = VK_NULL_HANDLE;
+	std::vector<VkPipeline>		pipelines;
+	std::unordered_map<std::string, uint32_t>	indices;
+
+};
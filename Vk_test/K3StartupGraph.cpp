@@ -0,0 +1,241 @@
+#include "K3StartupGraph.h"
+#include "K3JobSystem.h"
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+uint32_t		K3StartupGraph::add(std::string const& stepName, std::function<void()> const& function,
+						std::initializer_list<uint32_t> dependencies, bool const ownerThread)
+{
+	uint32_t const		index = static_cast<uint32_t>(steps.size());
+	std::unique_ptr<Step>	step(new Step());
+
+	if (started)
+		throw std::runtime_error("Startup step added to a running graph !");
+	step->name = stepName;
+	step->function = function;
+	step->dependencyCount = static_cast<uint32_t>(dependencies.size());
+	step->remaining = step->dependencyCount;
+	step->ownerThread = ownerThread;
+	for (uint32_t dependency : dependencies) {
+		if (dependency >= index)
+			throw std::runtime_error("Startup step depends on a step added after it !");
+		steps[dependency]->dependents.push_back(index);
+	}
+	steps.push_back(std::move(step));
+	return index;
+}
+
+void			K3StartupGraph::start()
+{
+	std::vector<uint32_t>	ready;
+
+	{
+		std::lock_guard<std::mutex>	lock(mutex);
+
+		if (started)
+			return;
+		started = true;
+		startTime = Clock::now();
+		for (uint32_t step = 0; step < steps.size(); step++) {
+			if (steps[step]->dependencyCount == 0)
+				ready.push_back(step);
+		}
+		inFlight = static_cast<uint32_t>(ready.size());
+	}
+	dispatch(ready);
+}
+
+// inFlight already counts the steps, so that no waiter sees the graph done in between
+void			K3StartupGraph::dispatch(std::vector<uint32_t> const& ready)
+{
+	for (uint32_t step : ready) {
+		if (steps[step]->ownerThread) {
+			std::lock_guard<std::mutex>	lock(mutex);
+
+			ownerQueue.push_back(step);
+			condition.notify_all();
+		}
+		else
+			K3JobSystem::getInstance().run([this, step]() { execute(step); });
+	}
+}
+
+void			K3StartupGraph::execute(uint32_t const index)
+{
+	Step&			step = *steps[index];
+	std::vector<uint32_t>	ready;
+	std::exception_ptr	stepError;
+	bool			skipped;
+
+	{
+		std::lock_guard<std::mutex>	lock(mutex);
+
+		skipped = cancelled || error;
+	}
+	if (!skipped) {
+		Clock::time_point const	begin = Clock::now();
+
+		try {
+			step.function();
+		}
+		catch (...) {
+			stepError = std::current_exception();
+		}
+		step.start = std::chrono::duration<double, std::milli>(begin - startTime).count();
+		step.duration = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+	}
+
+	std::unique_lock<std::mutex>	lock(mutex);
+
+	step.ran = !skipped;
+	// Let go of the exception under the lock, the waiter rethrows and frees it
+	if (stepError && !error)
+		error = stepError;
+	stepError = nullptr;
+	doneCount++;
+	if (!skipped)
+		elapsed = std::max(elapsed, step.start + step.duration);
+	if (!cancelled && !error) {
+		for (uint32_t dependent : step.dependents) {
+			if (--steps[dependent]->remaining == 0)
+				ready.push_back(dependent);
+		}
+	}
+	inFlight += static_cast<uint32_t>(ready.size());
+	inFlight--;
+	condition.notify_all();
+	// The graph may be gone as soon as the last step lets go of the lock
+	lock.unlock();
+	if (!ready.empty())
+		dispatch(ready);
+}
+
+bool			K3StartupGraph::runOwnerStep(bool const wait)
+{
+	std::unique_lock<std::mutex>	lock(mutex);
+	uint32_t			step;
+
+	if (wait)
+		condition.wait(lock, [this]() { return !ownerQueue.empty() || inFlight == 0; });
+	if (ownerQueue.empty())
+		return false;
+	step = ownerQueue.front();
+	ownerQueue.erase(ownerQueue.begin());
+	lock.unlock();
+	execute(step);
+	return true;
+}
+
+void			K3StartupGraph::rethrow()
+{
+	std::exception_ptr	stepError;
+
+	{
+		std::lock_guard<std::mutex>	lock(mutex);
+
+		stepError = error;
+		error = nullptr;
+	}
+	if (stepError)
+		std::rethrow_exception(stepError);
+}
+
+bool			K3StartupGraph::poll()
+{
+	if (!started)
+		return false;
+	while (runOwnerStep(false))
+		;
+	if (!isDone())
+		return false;
+	rethrow();
+	return true;
+}
+
+void			K3StartupGraph::run()
+{
+	start();
+	while (runOwnerStep(true))
+		;
+	rethrow();
+}
+
+// Owner steps still queued are skipped from here, the job system ones are waited for
+void			K3StartupGraph::cancel()
+{
+	std::unique_lock<std::mutex>	lock(mutex);
+
+	if (!started)
+		return;
+	cancelled = true;
+	lock.unlock();
+	while (runOwnerStep(true))
+		;
+	lock.lock();
+	error = nullptr;
+}
+
+bool			K3StartupGraph::isStarted() const
+{
+	return started;
+}
+
+bool			K3StartupGraph::isDone() const
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	return started && inFlight == 0;
+}
+
+std::string const&	K3StartupGraph::getName() const
+{
+	return name;
+}
+
+uint32_t		K3StartupGraph::getStepCount() const
+{
+	return static_cast<uint32_t>(steps.size());
+}
+
+std::string const&	K3StartupGraph::getStepName(uint32_t const step) const
+{
+	return steps[step]->name;
+}
+
+double			K3StartupGraph::getStepStart(uint32_t const step) const
+{
+	return steps[step]->start;
+}
+
+double			K3StartupGraph::getStepDuration(uint32_t const step) const
+{
+	return steps[step]->duration;
+}
+
+double			K3StartupGraph::getElapsed() const
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	return elapsed;
+}
+
+// The step total over the elapsed time is how much ran concurrently
+void			K3StartupGraph::print(std::ostream& out) const
+{
+	std::lock_guard<std::mutex>	lock(mutex);
+	double				total = 0.0;
+
+	for (std::unique_ptr<Step> const& step : steps)
+		total += step->duration;
+	out << std::fixed << std::setprecision(1) << "Startup " << name << " : " << elapsed << " ms, " << total << " ms of steps" << std::endl;
+	for (std::unique_ptr<Step> const& step : steps) {
+		out << "  " << std::left << std::setw(20) << step->name << std::right;
+		if (step->ran)
+			out << std::setw(8) << step->start << " -> " << std::setw(8) << step->start + step->duration << " ms";
+		else
+			out << "     not run";
+		out << (step->ownerThread ? "  (owner thread)" : "") << std::endl;
+	}
+	out << std::defaultfloat << std::setprecision(6);
+}
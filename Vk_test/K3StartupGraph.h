@@ -0,0 +1,96 @@
+#pragma once
+
+# include <chrono>
+# include <condition_variable>
+# include <cstdint>
+# include <exception>
+# include <functional>
+# include <initializer_list>
+# include <memory>
+# include <mutex>
+# include <ostream>
+# include <string>
+# include <vector>
+
+/* Startup work as a graph of named steps, each started as soon as the steps it depends on
+** are done : independent steps run concurrently on the job system, while the steps tied to
+** a thread (the window system's) run on the owner thread, the one calling run() or poll().
+** Every step is timed from start(), so the report shows both what each step cost and how
+** much of it overlapped.
+** Once a step throws no other step starts, the first error is rethrown by run() or poll()
+** when the running ones are done.
+*/
+
+class K3StartupGraph {
+
+public:
+
+	// Dependencies are steps added before, the step runs on the owner thread when ownerThread
+	uint32_t			add(std::string const& stepName, std::function<void()> const& function,
+						std::initializer_list<uint32_t> dependencies = {}, bool const ownerThread = false);
+	// Starts the steps without dependencies, the others follow as theirs complete
+	void				start();
+	// Runs the owner thread steps that are ready without waiting for the others, true once every step is done
+	bool				poll();
+	// Starts the graph if needed, then runs the owner thread steps until every step is done
+	void				run();
+	// Starts no more steps, returns once the running ones are done. The error, if any, is dropped
+	void				cancel();
+	bool				isStarted() const;
+	bool				isDone() const;
+	std::string const&		getName() const;
+	uint32_t			getStepCount() const;
+	std::string const&		getStepName(uint32_t const step) const;
+	// In ms from start(), for the steps that ran
+	double				getStepStart(uint32_t const step) const;
+	double				getStepDuration(uint32_t const step) const;
+	// From start() to the end of the last step
+	double				getElapsed() const;
+	void				print(std::ostream& out) const;
+
+	explicit			K3StartupGraph(std::string const& name) : name(name) {}
+	~K3StartupGraph() {
+		cancel();
+	}
+
+	K3StartupGraph(K3StartupGraph const&) = delete;
+	K3StartupGraph&			operator=(K3StartupGraph const&) = delete;
+
+private:
+
+	typedef std::chrono::steady_clock	Clock;
+
+	struct Step
+	{
+		std::string		name;
+		std::function<void()>	function;
+		std::vector<uint32_t>	dependents;
+		uint32_t		dependencyCount;
+		uint32_t		remaining;
+		bool			ownerThread;
+		bool			ran = false;
+		double			start = 0.0;
+		double			duration = 0.0;
+	};
+
+	void				dispatch(std::vector<uint32_t> const& ready);
+	void				execute(uint32_t const step);
+	// Whether a step was taken from the owner queue, after waiting for one if wait
+	bool				runOwnerStep(bool const wait);
+	void				rethrow();
+
+	std::string			name;
+	std::vector<std::unique_ptr<Step>>	steps;
+	mutable std::mutex		mutex;
+	std::condition_variable		condition;
+	std::vector<uint32_t>		ownerQueue;
+	// Steps dispatched and not done yet, queued on the owner thread included
+	uint32_t			inFlight = 0;
+	uint32_t			doneCount = 0;
+	bool				started = false;
+	bool				cancelled = false;
+	std::exception_ptr		error;
+	Clock::time_point		startTime;
+	double				elapsed = 0.0;
+
+};
@@ -0,0 +1,46 @@
+#include "K3StreamWrite.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+# define K3_STREAM_SSE
+# include <emmintrin.h>
+#endif
+
+// Plain stores up to the first 16 byte boundary and after the last one, streamed in between
+void		K3StreamWrite::copy(void* dst, void const* src, size_t const size)
+{
+#ifdef K3_STREAM_SSE
+	uint8_t*	out = static_cast<uint8_t*>(dst);
+	uint8_t const*	in = static_cast<uint8_t const*>(src);
+	size_t const	head = std::min(size, static_cast<size_t>((16 - reinterpret_cast<uintptr_t>(out) % 16) % 16));
+	size_t		left = size - head;
+
+	memcpy(out, in, head);
+	out += head;
+	in += head;
+	// A cache line at a time, what the write combining buffers hold
+	for (; left >= 64; left -= 64, out += 64, in += 64) {
+		__m128i const	a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in));
+		__m128i const	b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + 16));
+		__m128i const	c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + 32));
+		__m128i const	d = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + 48));
+
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out), a);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out + 16), b);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out + 32), c);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out + 48), d);
+	}
+	for (; left >= 16; left -= 16, out += 16, in += 16)
+		_mm_stream_si128(reinterpret_cast<__m128i*>(out), _mm_loadu_si128(reinterpret_cast<__m128i const*>(in)));
+	memcpy(out, in, left);
+#else
+	memcpy(dst, src, size);
+#endif
+}
+
+void		K3StreamWrite::fence()
+{
+#ifdef K3_STREAM_SSE
+	_mm_sfence();
+#endif
+}
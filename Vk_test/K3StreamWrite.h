@@ -0,0 +1,27 @@
+#pragma once
+
+# include <cstddef>
+# include <cstdint>
+# include <cstring>
+
+/* Sequential writes to mapped GPU memory. Device local host visible memory is uncached
+** and write combined : reading it back stalls, and a partly written line goes out as
+** several small transfers. copy() writes in address order, whole 16 byte blocks with non
+** temporal stores wherever the destination allows, and never reads the destination.
+** The non temporal stores are only ordered once fence() ran on the thread that wrote,
+** which must happen before the GPU is given the memory.
+*/
+
+class K3StreamWrite {
+
+public:
+
+	static void			copy(void* dst, void const* src, size_t const size);
+	static void			fence();
+
+	template <typename T>
+	static void			store(T* dst, T const& value) {
+		copy(dst, &value, sizeof(T));
+	}
+
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+# include <atomic>
+# include <cstdint>
+
+/* Lock-free handoff of the latest state from one producer thread to one consumer thread.
+** The producer fills its private slot and publishes it, which swaps it with the shared
+** middle slot. The consumer swaps its own slot with the middle one only when a newer
+** state was published. Neither side ever waits for the other : the producer may
+** overwrite states that were never consumed and the consumer keeps the last state it got.
+** A slot handed back to the producer holds whatever state it had, so slot contents must
+** be updated incrementally or rewritten entirely before every publish().
+*/
+
+template <typename T>
+class K3TripleBuffer {
+
+public:
+
+	T&				getWriteSlot() {
+		return slots[writeIndex];
+	}
+
+	void				publish() {
+		uint8_t	previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+
+		writeIndex = previous & INDEX_MASK;
+	}
+
+	// Returns the most recent published state, or the previous one again if nothing new came
+	T const&			acquire() {
+		if (middle.load(std::memory_order_relaxed) & FRESH_BIT) {
+			uint8_t	previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+
+			readIndex = previous & INDEX_MASK;
+		}
+		return slots[readIndex];
+	}
+
+	T const&			getReadSlot() const {
+		return slots[readIndex];
+	}
+
+	bool				hasFreshState() const {
+		return (middle.load(std::memory_order_acquire) & FRESH_BIT) != 0;
+	}
+
+	K3TripleBuffer() {}
+	~K3TripleBuffer() {}
+
+	K3TripleBuffer(K3TripleBuffer const&) = delete;
+	K3TripleBuffer&			operator=(K3TripleBuffer const&) = delete;
+
+private:
+
+	static const uint8_t		INDEX_MASK = 0x3;
+	static const uint8_t		FRESH_BIT = 0x4;
+
+	T				slots[3];
+	// Producer and consumer indices on separate cache lines, the middle one is the only shared word
+	alignas(64) uint8_t		writeIndex = 0;
+	alignas(64) std::atomic<uint8_t>	middle { 1 };
+	alignas(64) uint8_t		readIndex = 2;
+
+};
@@ -1,46 +1,90 @@
-#pragma once
-
-# define VK_USE_PLATFORM_WIN32_KHR
-# include <vulkan/vulkan.h>
-# define GLFW_INCLUDE_VULKAN
-# define GLFW_EXPOSE_NATIVE_WIN32
-# include <GLFW/glfw3.h>
-# include <GLFW/glfw3native.h>
-# define GLM_FORCE_RADIANS
-# define GLM_FORCE_DEPTH_ZERO_TO_ONE
-# include <glm/glm.hpp>
-# include <glm/vec4.hpp>
-# include <glm/mat4x4.hpp>
-# include <stdexcept>
-# include <functional>
-# include <iostream>
-# include <vector>
-# include <set>
-# include <string>
-# include <algorithm>
-# include <fstream>
-# include <array>
-
-#define NB_QUEUES 4
-
-#ifdef NDEBUG
-const bool enableValidationLayers = false;
-#else
-const bool enableValidationLayers = true;
-#endif
-
-const std::vector<const char *>	validationLayers = {
-	"VK_LAYER_LUNARG_standard_validation",
-	"VK_LAYER_LUNARG_object_tracker"
-};
-
-const std::vector<const char *>	requiredExtensions = {
-	VK_KHR_SWAPCHAIN_EXTENSION_NAME
-};
-
-struct SwapChainSupportDetails
-{
-	VkSurfaceCapabilitiesKHR		capabilities;
-	std::vector<VkSurfaceFormatKHR>	formats;
-	std::vector<VkPresentModeKHR>	presentModes;
+#pragma once
+
+// Window system integration, the Linux backend is picked by the build (K3_PLATFORM_XCB / K3_PLATFORM_WAYLAND)
+#if defined(_WIN32)
+# define VK_USE_PLATFORM_WIN32_KHR
+#elif defined(K3_PLATFORM_WAYLAND)
+# define VK_USE_PLATFORM_WAYLAND_KHR
+#elif defined(K3_PLATFORM_XCB)
+# define VK_USE_PLATFORM_XCB_KHR
+#endif
+# include <vulkan/vulkan.h>
+# define GLFW_INCLUDE_VULKAN
+# include <GLFW/glfw3.h>
+#if defined(_WIN32)
+# define GLFW_EXPOSE_NATIVE_WIN32
+# include <GLFW/glfw3native.h>
+#endif
+# define GLM_FORCE_RADIANS
+# define GLM_FORCE_DEPTH_ZERO_TO_ONE
+# include <glm/glm.hpp>
+# include <glm/vec4.hpp>
+# include <glm/mat4x4.hpp>
+# include <stdexcept>
+# include <cstdlib>
+# include <cstring>
+# include <cstddef>
+# include <limits>
+# include <functional>
+# include <iostream>
+# include <vector>
+# include <set>
+# include <string>
+# include <algorithm>
+# include <fstream>
+# include <array>
+# include "K3Allocator.h"
+# include "K3Profiler.h"
+
+#define NB_QUEUES 4
+
+#ifndef K3_SHADER_DIR
+# define K3_SHADER_DIR "G:/Graphic_Projects/Vulkan/k3_engine/Vk_test/shaders/"
+#endif
+// Shaders packed by K3_pack, what it does not hold is loaded from the loose files
+#ifndef K3_ASSET_ARCHIVE
+# define K3_ASSET_ARCHIVE K3_SHADER_DIR "shaders.k3a"
+#endif
+// Meshlets K3_Engine --save-meshlets wrote, in the archive or loose, built at load time otherwise
+#ifndef K3_MESHLET_ASSET
+# define K3_MESHLET_ASSET K3_SHADER_DIR "meshlets.k3m"
+#endif
+
+#ifdef NDEBUG
+const bool enableValidationLayers = false;
+#else
+const bool enableValidationLayers = true;
+#endif
+
+const std::vector<const char *>	validationLayers = {
+	"VK_LAYER_LUNARG_standard_validation",
+	"VK_LAYER_LUNARG_object_tracker"
+};
+
+const std::vector<const char *>	requiredExtensions = {
+	VK_KHR_SWAPCHAIN_EXTENSION_NAME
+};
+
+// Enabled when the device has them, check VkGPU::isExtensionEnabled() before use
+const std::vector<const char *>	optionalExtensions = {
+#ifdef VK_KHR_present_wait
+	VK_KHR_PRESENT_ID_EXTENSION_NAME,
+	VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+#endif
+	VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+	VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+	VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+#ifdef VK_EXT_mesh_shader
+	// Mesh shaders need SPIR-V 1.4 on a Vulkan 1.1 device
+	VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME,
+	VK_KHR_SPIRV_1_4_EXTENSION_NAME,
+	VK_EXT_MESH_SHADER_EXTENSION_NAME,
+#endif
+};
+
+struct SwapChainSupportDetails
+{
+	VkSurfaceCapabilitiesKHR		capabilities;
+	K3FrameVector<VkSurfaceFormatKHR>	formats;
+	K3FrameVector<VkPresentModeKHR>		presentModes;
 };
\ No newline at end of file
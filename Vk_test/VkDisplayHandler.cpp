@@ -1,243 +1,410 @@
-#include "VkDisplayHandler.h"
-
-
-void				VkDisplayHandler::initWindow()
-{
-	glfwInit();
-
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-
-	window = glfwCreateWindow(windowWidth, windowHeight, "K3 Engine v0.0.1", nullptr, nullptr);
-}
-
-
-void				VkDisplayHandler::createSurface(VkInstance const& instance)
-{
-	if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create window surface !");
-	}
-}
-
-void VkDisplayHandler::destroySurface(VkInstance const & instance) const
-{
-	vkDestroySurfaceKHR(instance, surface, nullptr);
-}
-
-VkExtent2D			VkDisplayHandler::pickSCExtent(const VkSurfaceCapabilitiesKHR& capabilities)
-{
-	if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
-		return capabilities.currentExtent;
-	}
-	VkExtent2D	newExtent;
-
-	newExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, windowWidth));
-	newExtent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.width, windowHeight));
-
-	return newExtent;
-}
-
-VkPresentModeKHR	VkDisplayHandler::pickSCPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes)
-{
-	// Add configuration options for this in the future
-
-	return VK_PRESENT_MODE_IMMEDIATE_KHR;
-}
-
-VkSurfaceFormatKHR	VkDisplayHandler::pickSCSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats)
-{
-	VkSurfaceFormatKHR		preferredFormat = { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
-
-	if (availableFormats.size() == 1 && availableFormats[0].format == VK_FORMAT_UNDEFINED) {
-		return preferredFormat;
-	}
-	for (const auto& formats : availableFormats) {
-		if (formats.format == preferredFormat.format && formats.colorSpace == preferredFormat.colorSpace) {
-			return preferredFormat;
-		}
-	}
-
-	return availableFormats[0];
-}
-
-void				VkDisplayHandler::createSwapchain(VkSwapchainKHR oldSC, VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuLDevice)
-{
-	SwapChainSupportDetails scInfo = VkGPU::querySwapChainSupport(gpuPDevice, surface);
-	uint32_t				imgCount = scInfo.capabilities.minImageCount;
-	uint32_t				maxImgCount = scInfo.capabilities.maxImageCount;
-	VkSurfaceFormatKHR		scSurfaceFormat = pickSCSurfaceFormat(scInfo.formats);
-	VkPresentModeKHR		scPresent = pickSCPresentMode(scInfo.presentModes);
-
-	scExtent = pickSCExtent(scInfo.capabilities);
-	scImgFormat = scSurfaceFormat.format;
-
-	if (scPresent == VK_PRESENT_MODE_MAILBOX_KHR)
-		imgCount++;
-	if (maxImgCount > 0 && imgCount > maxImgCount)
-		imgCount = maxImgCount;
-
-	VkSwapchainCreateInfoKHR	createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-	createInfo.surface = surface;
-	createInfo.minImageCount = imgCount;
-	createInfo.imageFormat = scSurfaceFormat.format;
-	createInfo.imageColorSpace = scSurfaceFormat.colorSpace;
-	createInfo.imageExtent = scExtent;
-	createInfo.imageArrayLayers = 1;
-	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-	createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	// ^ I need to temporarily release ownership of my images to use them with another queue
-
-	createInfo.preTransform = scInfo.capabilities.currentTransform;
-	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-	createInfo.presentMode = scPresent;
-	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = oldSC;
-
-	if (vkCreateSwapchainKHR(gpuLDevice, &createInfo, nullptr, &swapchain) != VK_SUCCESS)
-		throw std::runtime_error("Swap Chain creation failed !");
-	if (oldSC != VK_NULL_HANDLE)
-		vkDestroySwapchainKHR(gpuLDevice, oldSC, nullptr);
-}
-
-void VkDisplayHandler::destroySwapchain(VkDevice const& gpuDev) const
-{
-	vkDestroySwapchainKHR(gpuDev, swapchain, nullptr);
-}
-
-
-void				VkDisplayHandler::createImgViews(VkDevice gpuDevice)
-{
-	uint32_t		imgCount;
-
-	vkGetSwapchainImagesKHR(gpuDevice, swapchain, &imgCount, nullptr);
-	scImages.resize(imgCount);
-	vkGetSwapchainImagesKHR(gpuDevice, swapchain, &imgCount, scImages.data());
-	scImgView.resize(scImages.size());
-
-	for (size_t i = 0; i < scImages.size(); i++) {
-		VkImageViewCreateInfo		createInfo = {};
-		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		createInfo.image = scImages[i];
-		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		createInfo.format = scImgFormat;
-		createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-		createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-		createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-		createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-		createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		createInfo.subresourceRange.baseMipLevel = 0;
-		createInfo.subresourceRange.levelCount = 1;
-		createInfo.subresourceRange.baseArrayLayer = 0;
-		createInfo.subresourceRange.layerCount = 1;
-
-		if (vkCreateImageView(gpuDevice, &createInfo, nullptr, &scImgView[i]))
-			throw std::runtime_error("Failed to create image view !");
-	}
-}
-
-void				VkDisplayHandler::createFrameBuffers(VkDevice gpuDevice, VkRenderPass renderPass)
-{
-	scFramebuffers.resize(scImgView.size());
-
-	for (size_t i = 0; i < scImgView.size(); i++) {
-		VkImageView		attachments[] = {
-			scImgView[i]
-		};
-
-		VkFramebufferCreateInfo		fbInfo = {};
-		fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		fbInfo.renderPass = renderPass;
-		fbInfo.attachmentCount = 1;
-		fbInfo.pAttachments = attachments;
-		fbInfo.width = scExtent.width;
-		fbInfo.height = scExtent.height;
-		fbInfo.layers = 1;
-
-		if (vkCreateFramebuffer(gpuDevice, &fbInfo, nullptr, &scFramebuffers[i]) != VK_SUCCESS)
-			throw std::runtime_error("failed to create framebuffer!");
-	}
-}
-
-VkSurfaceKHR const&	VkDisplayHandler::getSurface() const
-{
-	return surface;
-}
-
-VkFormat const&	VkDisplayHandler::getScImgFormat() const
-{
-	return scImgFormat;
-}
-
-VkExtent2D const&	VkDisplayHandler::getScExtent() const
-{
-	return scExtent;
-}
-
-GLFWwindow* const&	VkDisplayHandler::getWindow() const
-{
-	return window;
-}
-
-VkSwapchainKHR const&	VkDisplayHandler::getSwapchain() const
-{
-	return swapchain;
-}
-
-std::vector<VkFramebuffer> const&	VkDisplayHandler::getFramebuffers() const
-{
-	return scFramebuffers;
-}
-
-
-/* Sets the screen to the new sizes given as parameter, or sets the window to fullscreen
-** default monitor resolution if the fullscreen parameter is set to 1
-*/
-
-void VkDisplayHandler::resizeWindow(uint32_t const newSizeX, uint32_t const newSizeY, bool const fullscreen)
-{
-	if ((newSizeX < 1 || newSizeY < 1) && !fullscreen)
-		return;
-	if (!window) {
-		throw std::runtime_error("Window specified doesn't exist !");
-		return;
-	}
-	
-	GLFWmonitor*		monitor = glfwGetPrimaryMonitor();
-	const GLFWvidmode*	mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
-	
-	if (!mode)
-		throw std::runtime_error("An error occured while retrieving monitor information !");
-	if (fullscreen) {
-		windowWidth = mode->width;
-		windowHeight = mode->height;
-		glfwSetWindowMonitor(window, monitor, 0, 0, windowWidth, windowHeight, mode->refreshRate);
-		return;
-	}
-	glfwSetWindowSize(window, newSizeX, newSizeY);
-	glfwSetWindowPos(window, (mode->width - newSizeX) / 2, (mode->height - newSizeY) / 2);
-	windowWidth = newSizeX;
-	windowHeight = newSizeY;
-}
-
-void VkDisplayHandler::destroyImgViews(VkDevice const& gpuDev) const
-{
-	for (size_t i = 0; i < scImgView.size(); i++) {
-		vkDestroyImageView(gpuDev, scImgView[i], nullptr);
-	}
-}
-
-void VkDisplayHandler::destroyFramebuffers(VkDevice const & gpuDev) const
-{
-	for (size_t i = 0; i < scFramebuffers.size(); i++) {
-		vkDestroyFramebuffer(gpuDev, scFramebuffers[i], nullptr);
-	}
-}
-
-void				VkDisplayHandler::terminateWindow()
-{
-	if (window) {
-		glfwDestroyWindow(window);
-	}
-	glfwTerminate();
+#include "VkDisplayHandler.h"
+
+
+/* GLFW alone, which is all the instance needs (glfwGetRequiredInstanceExtensions), so the
+** instance can be created while the window opens. Nothing to do headless.
+*/
+
+void				VkDisplayHandler::initWindowSystem()
+{
+	if (headless)
+		return;
+	// GLFW 3.4 can run on X11 or Wayland, follow the backend the engine was built for
+#if defined(K3_PLATFORM_WAYLAND) && defined(GLFW_PLATFORM_WAYLAND)
+	glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_WAYLAND);
+#elif defined(K3_PLATFORM_XCB) && defined(GLFW_PLATFORM_X11)
+	glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_X11);
+#endif
+	if (glfwInit() != GLFW_TRUE)
+		throw std::runtime_error("Failed to initialize GLFW !");
+}
+
+void				VkDisplayHandler::initWindow()
+{
+	if (headless)
+		return;
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+
+	window = glfwCreateWindow(windowWidth, windowHeight, "K3 Engine v0.0.1", nullptr, nullptr);
+	if (!window)
+		throw std::runtime_error("Failed to create window !");
+
+	int		width;
+	int		height;
+
+	glfwGetFramebufferSize(window, &width, &height);
+	framebufferWidth = static_cast<uint32_t>(width);
+	framebufferHeight = static_cast<uint32_t>(height);
+	glfwSetWindowUserPointer(window, this);
+	glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+}
+
+// Called from glfwPollEvents, a minimized window reports a 0 x 0 framebuffer
+void				VkDisplayHandler::framebufferResizeCallback(GLFWwindow* window, int width, int height)
+{
+	VkDisplayHandler*	self = static_cast<VkDisplayHandler*>(glfwGetWindowUserPointer(window));
+
+	self->framebufferWidth = static_cast<uint32_t>(std::max(width, 0));
+	self->framebufferHeight = static_cast<uint32_t>(std::max(height, 0));
+	self->framebufferResized = true;
+}
+
+// True once per resize notification, the swapchain has to be rebuilt
+bool				VkDisplayHandler::consumeResize()
+{
+	return framebufferResized.exchange(false);
+}
+
+/* A swapchain can only be created with a non zero extent. The surface reports it, unless
+** the window system leaves the extent to the swapchain (Wayland), in which case the last
+** framebuffer size tells whether the window is minimized.
+*/
+
+bool				VkDisplayHandler::hasDrawableExtent(VkPhysicalDevice const& gpuPDevice) const
+{
+	VkSurfaceCapabilitiesKHR	capabilities;
+
+	if (vkGetPhysicalDeviceSurfaceCapabilitiesKHR(gpuPDevice, surface, &capabilities) != VK_SUCCESS)
+		return false;
+	if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
+		return capabilities.currentExtent.width > 0 && capabilities.currentExtent.height > 0;
+	if (headless)
+		return windowWidth > 0 && windowHeight > 0;
+	return framebufferWidth > 0 && framebufferHeight > 0;
+}
+
+
+void				VkDisplayHandler::createSurface(VkInstance const& instance)
+{
+	if (headless) {
+#ifdef VK_EXT_headless_surface
+		VkHeadlessSurfaceCreateInfoEXT	surfaceInfo = {};
+		surfaceInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+		auto func = (PFN_vkCreateHeadlessSurfaceEXT)
+			vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT");
+		if (func == nullptr || func(instance, &surfaceInfo, nullptr, &surface) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create headless surface !");
+		return;
+#else
+		throw std::runtime_error("Headless surfaces are not supported by this Vulkan SDK !");
+#endif
+	}
+	if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create window surface !");
+	}
+}
+
+void VkDisplayHandler::destroySurface(VkInstance const & instance) const
+{
+	vkDestroySurfaceKHR(instance, surface, nullptr);
+}
+
+VkExtent2D			VkDisplayHandler::pickSCExtent(const VkSurfaceCapabilitiesKHR& capabilities)
+{
+	if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
+		return capabilities.currentExtent;
+	}
+	VkExtent2D	newExtent;
+	// The framebuffer is in pixels, the window size is not on high density displays
+	uint32_t	width = headless ? windowWidth : framebufferWidth.load();
+	uint32_t	height = headless ? windowHeight : framebufferHeight.load();
+
+	newExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, width));
+	newExtent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, height));
+
+	return newExtent;
+}
+
+/* FIFO is the only mode the frame pacer can follow the vblank with, MAILBOX waits for it too
+** but drops frames, leaving no rhythm to pace to.
+*/
+
+VkPresentModeKHR	VkDisplayHandler::pickSCPresentMode(const K3FrameVector<VkPresentModeKHR> &availablePresentModes)
+{
+	if (presentSync)
+		return VK_PRESENT_MODE_FIFO_KHR;
+	for (const auto& mode : availablePresentModes) {
+		if (mode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+			return mode;
+	}
+	// FIFO is the only mode every implementation has to support
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+VkSurfaceFormatKHR	VkDisplayHandler::pickSCSurfaceFormat(const K3FrameVector<VkSurfaceFormatKHR> &availableFormats)
+{
+	VkSurfaceFormatKHR		preferredFormat = { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+
+	if (availableFormats.size() == 1 && availableFormats[0].format == VK_FORMAT_UNDEFINED) {
+		return preferredFormat;
+	}
+	for (const auto& formats : availableFormats) {
+		if (formats.format == preferredFormat.format && formats.colorSpace == preferredFormat.colorSpace) {
+			return preferredFormat;
+		}
+	}
+
+	return availableFormats[0];
+}
+
+/* The images are shared by the present, graphics and compute families (the post processing
+** copies its result into them), concurrently when those differ so no ownership moves per frame.
+*/
+
+void				VkDisplayHandler::createSwapchain(VkSwapchainKHR oldSC, VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuLDevice,
+						uint32_t const* queuesIndex)
+{
+	SwapChainSupportDetails scInfo = VkGPU::querySwapChainSupport(gpuPDevice, surface);
+	uint32_t				imgCount = scInfo.capabilities.minImageCount;
+	uint32_t				maxImgCount = scInfo.capabilities.maxImageCount;
+	VkSurfaceFormatKHR		scSurfaceFormat = pickSCSurfaceFormat(scInfo.formats);
+	VkPresentModeKHR		scPresent = pickSCPresentMode(scInfo.presentModes);
+
+	scExtent = pickSCExtent(scInfo.capabilities);
+	scImgFormat = scSurfaceFormat.format;
+	scPresentMode = scPresent;
+
+	if (scPresent == VK_PRESENT_MODE_MAILBOX_KHR)
+		imgCount++;
+	if (maxImgCount > 0 && imgCount > maxImgCount)
+		imgCount = maxImgCount;
+
+	VkSwapchainCreateInfoKHR	createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	createInfo.surface = surface;
+	createInfo.minImageCount = imgCount;
+	createInfo.imageFormat = scSurfaceFormat.format;
+	createInfo.imageColorSpace = scSurfaceFormat.colorSpace;
+	createInfo.imageExtent = scExtent;
+	createInfo.imageArrayLayers = 1;
+	scImgUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	if (scInfo.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+		scImgUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	createInfo.imageUsage = scImgUsage;
+
+	// The distinct families of the three queues, without a container : this runs on every resize
+	uint32_t			sharedFamilies[3];
+	uint32_t			familyCount = 0;
+	for (uint32_t i = 0; i < 3; i++) {
+		if (std::find(sharedFamilies, sharedFamilies + familyCount, queuesIndex[i]) == sharedFamilies + familyCount)
+			sharedFamilies[familyCount++] = queuesIndex[i];
+	}
+	if (familyCount > 1) {
+		createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+		createInfo.queueFamilyIndexCount = familyCount;
+		createInfo.pQueueFamilyIndices = sharedFamilies;
+	}
+	else
+		createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	createInfo.preTransform = scInfo.capabilities.currentTransform;
+	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	createInfo.presentMode = scPresent;
+	createInfo.clipped = VK_TRUE;
+	createInfo.oldSwapchain = oldSC;
+
+	// oldSC is retired by the call but stays alive, its images may still be presented (see VkHandler::recreateSwapChain)
+	if (vkCreateSwapchainKHR(gpuLDevice, &createInfo, nullptr, &swapchain) != VK_SUCCESS)
+		throw std::runtime_error("Swap Chain creation failed !");
+}
+
+void VkDisplayHandler::destroySwapchain(VkDevice const& gpuDev) const
+{
+	vkDestroySwapchainKHR(gpuDev, swapchain, nullptr);
+}
+
+
+void				VkDisplayHandler::createImgViews(VkDevice gpuDevice)
+{
+	uint32_t		imgCount;
+
+	vkGetSwapchainImagesKHR(gpuDevice, swapchain, &imgCount, nullptr);
+	scImages.resize(imgCount);
+	vkGetSwapchainImagesKHR(gpuDevice, swapchain, &imgCount, scImages.data());
+	scImgView.resize(scImages.size());
+
+	for (size_t i = 0; i < scImages.size(); i++) {
+		VkImageViewCreateInfo		createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		createInfo.image = scImages[i];
+		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		createInfo.format = scImgFormat;
+		createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		createInfo.subresourceRange.baseMipLevel = 0;
+		createInfo.subresourceRange.levelCount = 1;
+		createInfo.subresourceRange.baseArrayLayer = 0;
+		createInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(gpuDevice, &createInfo, nullptr, &scImgView[i]))
+			throw std::runtime_error("Failed to create image view !");
+	}
+}
+
+// The swapchain images are the output of the scene pass, the other attachments are shared
+void				VkDisplayHandler::createFrameBuffers(VkDevice gpuDevice, VkRenderPass renderPass, K3SceneTargets const& sceneTargets)
+{
+	scFramebuffers.resize(scImgView.size());
+
+	for (size_t i = 0; i < scImgView.size(); i++) {
+		std::vector<VkImageView> const	attachments = sceneTargets.getAttachments(scImgView[i]);
+
+		VkFramebufferCreateInfo		fbInfo = {};
+		fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		fbInfo.renderPass = renderPass;
+		fbInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		fbInfo.pAttachments = attachments.data();
+		fbInfo.width = scExtent.width;
+		fbInfo.height = scExtent.height;
+		fbInfo.layers = 1;
+
+		if (vkCreateFramebuffer(gpuDevice, &fbInfo, nullptr, &scFramebuffers[i]) != VK_SUCCESS)
+			throw std::runtime_error("failed to create framebuffer!");
+	}
+}
+
+VkSurfaceKHR const&	VkDisplayHandler::getSurface() const
+{
+	return surface;
+}
+
+VkFormat const&	VkDisplayHandler::getScImgFormat() const
+{
+	return scImgFormat;
+}
+
+VkExtent2D const&	VkDisplayHandler::getScExtent() const
+{
+	return scExtent;
+}
+
+GLFWwindow* const&	VkDisplayHandler::getWindow() const
+{
+	return window;
+}
+
+VkSwapchainKHR const&	VkDisplayHandler::getSwapchain() const
+{
+	return swapchain;
+}
+
+std::vector<VkFramebuffer> const&	VkDisplayHandler::getFramebuffers() const
+{
+	return scFramebuffers;
+}
+
+std::vector<VkImageView> const&		VkDisplayHandler::getImgViews() const
+{
+	return scImgView;
+}
+
+std::vector<VkImage> const&		VkDisplayHandler::getImages() const
+{
+	return scImages;
+}
+
+VkImageUsageFlags const&		VkDisplayHandler::getScImgUsage() const
+{
+	return scImgUsage;
+}
+
+bool				VkDisplayHandler::isHeadless() const
+{
+	return headless;
+}
+
+VkPresentModeKHR const&		VkDisplayHandler::getPresentMode() const
+{
+	return scPresentMode;
+}
+
+void				VkDisplayHandler::setPresentSync(bool const sync)
+{
+	presentSync = sync;
+}
+
+// Refresh rate of the monitor showing the window in Hz, 0 when unknown or headless
+double				VkDisplayHandler::getRefreshRate() const
+{
+	if (headless || !window)
+		return 0.0;
+
+	GLFWmonitor*		monitor = glfwGetWindowMonitor(window);
+
+	// A windowed window has no monitor, assume it sits on the primary one
+	if (!monitor)
+		monitor = glfwGetPrimaryMonitor();
+
+	const GLFWvidmode*	mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+
+	return mode ? static_cast<double>(mode->refreshRate) : 0.0;
+}
+
+
+/* Sets the screen to the new sizes given as parameter, or sets the window to fullscreen
+** default monitor resolution if the fullscreen parameter is set to 1
+** Fullscreen is ignored when running headless.
+*/
+
+void VkDisplayHandler::resizeWindow(uint32_t const newSizeX, uint32_t const newSizeY, bool const fullscreen)
+{
+	if ((newSizeX < 1 || newSizeY < 1) && !fullscreen)
+		return;
+	if (headless) {
+		// There is no window, the next swapchain simply takes the requested extent
+		if (newSizeX > 0 && newSizeY > 0) {
+			windowWidth = newSizeX;
+			windowHeight = newSizeY;
+		}
+		return;
+	}
+	if (!window) {
+		throw std::runtime_error("Window specified doesn't exist !");
+		return;
+	}
+	
+	GLFWmonitor*		monitor = glfwGetPrimaryMonitor();
+	const GLFWvidmode*	mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	
+	if (!mode)
+		throw std::runtime_error("An error occured while retrieving monitor information !");
+	if (fullscreen) {
+		windowWidth = mode->width;
+		windowHeight = mode->height;
+		glfwSetWindowMonitor(window, monitor, 0, 0, windowWidth, windowHeight, mode->refreshRate);
+		return;
+	}
+	glfwSetWindowSize(window, newSizeX, newSizeY);
+	glfwSetWindowPos(window, (mode->width - newSizeX) / 2, (mode->height - newSizeY) / 2);
+	windowWidth = newSizeX;
+	windowHeight = newSizeY;
+}
+
+void VkDisplayHandler::destroyImgViews(VkDevice const& gpuDev) const
+{
+	for (size_t i = 0; i < scImgView.size(); i++) {
+		vkDestroyImageView(gpuDev, scImgView[i], nullptr);
+	}
+}
+
+void VkDisplayHandler::destroyFramebuffers(VkDevice const & gpuDev) const
+{
+	for (size_t i = 0; i < scFramebuffers.size(); i++) {
+		vkDestroyFramebuffer(gpuDev, scFramebuffers[i], nullptr);
+	}
+}
+
+void				VkDisplayHandler::terminateWindow()
+{
+	if (headless)
+		return;
+	if (window) {
+		glfwDestroyWindow(window);
+	}
+	glfwTerminate();
 }
\ No newline at end of file
@@ -1,52 +1,74 @@
-#pragma once
-
-#include "K3Vk.h"
-#include "VkGPU.h"
-
-class VkDisplayHandler {
-
-public:
-
-	void					initWindow();
-	void					createSurface(VkInstance const& instance);
-	void					destroySurface(VkInstance const& instance) const;
-	void					terminateWindow();
-	void					createSwapchain(VkSwapchainKHR oldSC, VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuLDevice);
-	void					destroySwapchain(VkDevice const& gpuDev) const;
-	void					createImgViews(VkDevice gpuDevice);
-	void					destroyImgViews(VkDevice const& gpuDev) const;
-	void					createFrameBuffers(VkDevice gpuDevice, VkRenderPass renderPass);
-	void					destroyFramebuffers(VkDevice const& gpuDev) const;
-	VkSurfaceKHR const&			getSurface() const;
-	VkFormat const&				getScImgFormat() const;
-	VkExtent2D const&			getScExtent() const;
-	GLFWwindow* const&			getWindow() const;
-	VkSwapchainKHR const&			getSwapchain() const;
-	std::vector<VkFramebuffer> const&	getFramebuffers() const;
-	void					resizeWindow(uint32_t const newSizeX, uint32_t const newSizeY, bool const fullscreen);
-
-	VkDisplayHandler() {
-		initWindow();
-	}
-	
-	~VkDisplayHandler() {}
-
-private:
-
-	VkSurfaceFormatKHR			pickSCSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats);
-	VkPresentModeKHR			pickSCPresentMode(const std::vector<VkPresentModeKHR> availablePresentModes);
-	VkExtent2D				pickSCExtent(const VkSurfaceCapabilitiesKHR& capabilities);
-
-
-	uint32_t				windowWidth = 800;
-	uint32_t				windowHeight = 600;
-	GLFWwindow				*window;
-	VkSurfaceKHR				surface;
-	VkSwapchainKHR				swapchain;
-	std::vector<VkImage>			scImages;
-	std::vector<VkImageView>		scImgView;
-	VkFormat				scImgFormat;
-	VkExtent2D				scExtent;
-	std::vector<VkFramebuffer>		scFramebuffers;
-
-};
+#pragma once
+
+#include "K3Vk.h"
+#include "VkGPU.h"
+#include "K3SceneTargets.h"
+#include <atomic>
+
+class VkDisplayHandler {
+
+public:
+
+	void					initWindowSystem();
+	void					initWindow();
+	void					createSurface(VkInstance const& instance);
+	void					destroySurface(VkInstance const& instance) const;
+	void					terminateWindow();
+	void					createSwapchain(VkSwapchainKHR oldSC, VkPhysicalDevice const& gpuPDevice, VkDevice const& gpuLDevice,
+						uint32_t const* queuesIndex);
+	void					destroySwapchain(VkDevice const& gpuDev) const;
+	void					createImgViews(VkDevice gpuDevice);
+	void					destroyImgViews(VkDevice const& gpuDev) const;
+	void					createFrameBuffers(VkDevice gpuDevice, VkRenderPass renderPass, K3SceneTargets const& sceneTargets);
+	void					destroyFramebuffers(VkDevice const& gpuDev) const;
+	VkSurfaceKHR const&			getSurface() const;
+	VkFormat const&				getScImgFormat() const;
+	VkExtent2D const&			getScExtent() const;
+	GLFWwindow* const&			getWindow() const;
+	VkSwapchainKHR const&			getSwapchain() const;
+	std::vector<VkFramebuffer> const&	getFramebuffers() const;
+	std::vector<VkImageView> const&		getImgViews() const;
+	std::vector<VkImage> const&		getImages() const;
+	VkImageUsageFlags const&		getScImgUsage() const;
+	bool					hasDrawableExtent(VkPhysicalDevice const& gpuPDevice) const;
+	bool					consumeResize();
+	bool					isHeadless() const;
+	VkPresentModeKHR const&			getPresentMode() const;
+	// Presents locked to the vblank (FIFO) from the next swapchain on, rather than as soon as possible
+	void					setPresentSync(bool const sync);
+	double					getRefreshRate() const;
+	void					resizeWindow(uint32_t const newSizeX, uint32_t const newSizeY, bool const fullscreen);
+
+	// The window system and the window are set up by initWindowSystem() and initWindow(), on the main thread
+	VkDisplayHandler(bool const headless = false) : headless(headless) {}
+	
+	~VkDisplayHandler() {}
+
+private:
+
+	VkSurfaceFormatKHR			pickSCSurfaceFormat(const K3FrameVector<VkSurfaceFormatKHR> &availableFormats);
+	VkPresentModeKHR			pickSCPresentMode(const K3FrameVector<VkPresentModeKHR> &availablePresentModes);
+	VkExtent2D				pickSCExtent(const VkSurfaceCapabilitiesKHR& capabilities);
+	static void				framebufferResizeCallback(GLFWwindow* window, int width, int height);
+
+
+	uint32_t				windowWidth = 800;
+	uint32_t				windowHeight = 600;
+	GLFWwindow				*window = nullptr;
+	// Written by the GLFW callback on the main thread, read when the render thread rebuilds the swapchain
+	std::atomic<uint32_t>			framebufferWidth { 0 };
+	std::atomic<uint32_t>			framebufferHeight { 0 };
+	std::atomic<bool>			framebufferResized { false };
+	bool					headless;
+	VkSurfaceKHR				surface;
+	VkSwapchainKHR				swapchain;
+	std::vector<VkImage>			scImages;
+	std::vector<VkImageView>		scImgView;
+	VkFormat				scImgFormat;
+	VkImageUsageFlags			scImgUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	VkExtent2D				scExtent;
+	VkPresentModeKHR			scPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	bool					presentSync = false;
+	std::vector<VkFramebuffer>		scFramebuffers;
+
+};
@@ -1,221 +1,401 @@
-#include "VkGPU.h"
-
-
-void	VkGPU::init(VkInstance const& instance, VkSurfaceKHR const& surface)
-{
-	if (instance == VK_NULL_HANDLE || !surface)
-		throw std::exception("Objects needed for the creation of a VkGPU object are not valid !");
-	findPhysicalDevice(instance, surface);
-	createLogicalDevice();
-	getQueues();
-}
-
-void		VkGPU::findPhysicalDevice(VkInstance const& instance, VkSurfaceKHR const& surface)
-{
-	uint32_t	deviceCount = 0;
-
-	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
-	if (deviceCount == 0)
-		throw std::runtime_error("Failed to find any GPUs with Vulkan support !");
-	std::vector<VkPhysicalDevice> devices(deviceCount);
-	vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
-	for (const auto& dev : devices) {
-		if (isSuitableDevice(dev, surface)) {
-			physicalDevice = dev;
-			break;
-		}
-	}
-	if (physicalDevice == VK_NULL_HANDLE)
-		throw std::runtime_error("Failed to find a suitable GPU");
-}
-
-bool		VkGPU::checkExtensionSupport(VkPhysicalDevice device)
-{
-	uint32_t	extensionCount;
-
-	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-	if (extensionCount < 1)
-		return false;
-	std::vector<VkExtensionProperties>		deviceExtensions(extensionCount);
-	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, deviceExtensions.data());
-
-	std::set<std::string>	extensionList(requiredExtensions.begin(), requiredExtensions.end());
-	for (const auto& extension : deviceExtensions) {
-		extensionList.erase(extension.extensionName);
-	}
-	return (extensionList.empty());
-}
-
-SwapChainSupportDetails		VkGPU::querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR const& surface)
-{
-	uint32_t					formatCount;
-	uint32_t					presentModesCount;
-	SwapChainSupportDetails		scDetails;
-
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &scDetails.capabilities);
-
-	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
-	if (formatCount > 0) {
-		scDetails.formats.resize(formatCount);
-		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, scDetails.formats.data());
-	}
-
-	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModesCount, nullptr);
-	if (presentModesCount > 1) {
-		scDetails.presentModes.resize(presentModesCount);
-		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModesCount, scDetails.presentModes.data());
-	}
-
-	return scDetails;
-}
-
-VkDevice const & VkGPU::getLogicalDevice() const
-{
-	return logicalDevice;
-}
-
-VkPhysicalDevice const & VkGPU::getPhysicalDevice() const
-{
-	return physicalDevice;
-}
-
-VkQueue const & VkGPU::getGfxQueue() const
-{
-	return gfxQueue;
-}
-
-VkQueue const & VkGPU::getTransferQueue() const
-{
-	return transferQueue;
-}
-
-VkQueue const & VkGPU::getPresentQueue() const
-{
-	return presentQueue;
-}
-
-VkQueue const & VkGPU::getComputeQueue() const
-{
-	return computeQueue;
-}
-
-uint32_t const*		VkGPU::getQueuesIndex() const
-{
-	return queuesIndex;
-}
-
-bool		VkGPU::isSuitableDevice(VkPhysicalDevice device, VkSurfaceKHR const& surface)
-{
-	VkPhysicalDeviceProperties			deviceProperties;
-	VkPhysicalDeviceFeatures			deviceFeatures;
-	SwapChainSupportDetails				scDetails = {};
-
-	vkGetPhysicalDeviceProperties(device, &deviceProperties);
-	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-	scDetails = querySwapChainSupport(device, surface);
-	if (deviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU
-		|| !deviceFeatures.geometryShader || !findQueueFamilies(device, surface)
-		|| !checkExtensionSupport(device) || scDetails.formats.empty()
-		|| scDetails.presentModes.empty())
-		return false;
-	return true;
-}
-
-bool		VkGPU::findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR const& surface)
-{
-	uint32_t					queueCount;
-	bool						queueFound = false;
-	std::vector<VkQueueFlags>	queueFlags(3);
-	int							qidx = 1;
-	uint32_t					idx;
-
-	// Required queues flags ///////////////
-	queueFlags[0] = VK_QUEUE_GRAPHICS_BIT;
-	queueFlags[1] = VK_QUEUE_COMPUTE_BIT;
-	queueFlags[2] = VK_QUEUE_TRANSFER_BIT;
-
-	////////////////////////////////////////
-	memset(queuesIndex, -1, NB_QUEUES);
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueCount, nullptr);
-	if (!queueCount)
-		return false;
-	std::vector<VkQueueFamilyProperties>	deviceQueues(queueCount);
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueCount, deviceQueues.data());
-	for (const auto& flags : queueFlags) {
-		idx = 0;
-		for (const auto& queues : deviceQueues) {
-			if (queues.queueCount > 0 && queues.queueFlags & flags) {
-				if (!(flags == VK_QUEUE_TRANSFER_BIT && queues.queueFlags & VK_QUEUE_GRAPHICS_BIT))
-				{
-					queueFound = true;
-					queuesIndex[qidx] = idx;
-					break;
-				}
-			}
-			idx++;
-		}
-		if (!queueFound)
-			return false;
-		queueFound = false;
-		qidx++;
-	}
-
-	VkBool32					presentationSupport = false;
-
-	idx = 0;
-	for (const auto& queues : deviceQueues) {
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, idx, surface, &presentationSupport);
-		if (presentationSupport) {
-			queuesIndex[0] = idx;
-			break;
-		}
-		idx++;
-	}
-	if (!presentationSupport)
-		return false;
-	return true;
-}
-
-
-void		VkGPU::createLogicalDevice()
-{
-	std::vector<VkDeviceQueueCreateInfo> queuesInfo;
-	std::set<uint32_t>	queueFamilies = { queuesIndex[0], queuesIndex[1], queuesIndex[2], queuesIndex[3] };
-	float					queuePriority = 1.0f;
-
-	for (uint32_t currentQueueFam : queueFamilies) {
-		VkDeviceQueueCreateInfo		queueCreateInfo = {};
-		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queueCreateInfo.queueFamilyIndex = currentQueueFam;
-		queueCreateInfo.queueCount = 1;
-		queueCreateInfo.pQueuePriorities = &queuePriority;
-		queuesInfo.push_back(queueCreateInfo);
-	}
-	VkPhysicalDeviceFeatures deviceFeatures = {};
-	VkDeviceCreateInfo		deviceInfo = {};
-
-	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceInfo.queueCreateInfoCount = static_cast<uint32_t>(queuesInfo.size());
-	deviceInfo.pQueueCreateInfos = queuesInfo.data();
-	deviceInfo.pEnabledFeatures = &deviceFeatures;
-	deviceInfo.enabledExtensionCount = static_cast<uint32_t>(requiredExtensions.size());
-	deviceInfo.ppEnabledExtensionNames = requiredExtensions.data();
-
-	if (enableValidationLayers) {
-		deviceInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-		deviceInfo.ppEnabledLayerNames = validationLayers.data();
-	}
-	else
-		deviceInfo.enabledLayerCount = 0;
-
-	if (vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &logicalDevice) != VK_SUCCESS)
-		throw std::exception("Failed to create logical device");
-}
-
-void			VkGPU::getQueues()
-{
-	vkGetDeviceQueue(logicalDevice, queuesIndex[0], 0, &presentQueue);
-	vkGetDeviceQueue(logicalDevice, queuesIndex[1], 0, &gfxQueue);
-	vkGetDeviceQueue(logicalDevice, queuesIndex[2], 0, &computeQueue);
-	vkGetDeviceQueue(logicalDevice, queuesIndex[3], 0, &transferQueue);
+#include "VkGPU.h"
+
+
+void	VkGPU::init(VkInstance const& instance, VkSurfaceKHR const& surface)
+{
+	if (instance == VK_NULL_HANDLE || !surface)
+		throw std::runtime_error("Objects needed for the creation of a VkGPU object are not valid !");
+	findPhysicalDevice(instance, surface);
+	createLogicalDevice();
+	getQueues();
+}
+
+void		VkGPU::findPhysicalDevice(VkInstance const& instance, VkSurfaceKHR const& surface)
+{
+	uint32_t	deviceCount = 0;
+
+	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+	if (deviceCount == 0)
+		throw std::runtime_error("Failed to find any GPUs with Vulkan support !");
+	K3FrameVector<VkPhysicalDevice> devices(deviceCount);
+	vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+	// Discrete GPUs come first, anything else (integrated, software) is only a fallback
+	for (const auto& dev : devices) {
+		if (isSuitableDevice(dev, surface)) {
+			VkPhysicalDeviceProperties	deviceProperties;
+
+			vkGetPhysicalDeviceProperties(dev, &deviceProperties);
+			if (physicalDevice == VK_NULL_HANDLE || deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+				physicalDevice = dev;
+			if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+				break;
+		}
+	}
+	if (physicalDevice == VK_NULL_HANDLE)
+		throw std::runtime_error("Failed to find a suitable GPU");
+	findQueueFamilies(physicalDevice, surface);
+}
+
+bool		VkGPU::checkExtensionSupport(VkPhysicalDevice device)
+{
+	uint32_t	extensionCount;
+
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	if (extensionCount < 1)
+		return false;
+	K3FrameVector<VkExtensionProperties>	deviceExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, deviceExtensions.data());
+
+	for (const char* required : requiredExtensions) {
+		auto	found = std::find_if(deviceExtensions.begin(), deviceExtensions.end(),
+			[required](VkExtensionProperties const& extension) {
+				return strcmp(required, extension.extensionName) == 0;
+			});
+		if (found == deviceExtensions.end())
+			return false;
+	}
+	return true;
+}
+
+SwapChainSupportDetails		VkGPU::querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR const& surface)
+{
+	uint32_t					formatCount;
+	uint32_t					presentModesCount;
+	SwapChainSupportDetails		scDetails;
+
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &scDetails.capabilities);
+
+	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+	if (formatCount > 0) {
+		scDetails.formats.resize(formatCount);
+		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, scDetails.formats.data());
+	}
+
+	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModesCount, nullptr);
+	if (presentModesCount > 0) {
+		scDetails.presentModes.resize(presentModesCount);
+		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModesCount, scDetails.presentModes.data());
+	}
+
+	return scDetails;
+}
+
+VkDevice const & VkGPU::getLogicalDevice() const
+{
+	return logicalDevice;
+}
+
+VkPhysicalDevice const & VkGPU::getPhysicalDevice() const
+{
+	return physicalDevice;
+}
+
+VkQueue const & VkGPU::getGfxQueue() const
+{
+	return gfxQueue;
+}
+
+VkQueue const & VkGPU::getTransferQueue() const
+{
+	return transferQueue;
+}
+
+VkQueue const & VkGPU::getPresentQueue() const
+{
+	return presentQueue;
+}
+
+VkQueue const & VkGPU::getComputeQueue() const
+{
+	return computeQueue;
+}
+
+uint32_t const*		VkGPU::getQueuesIndex() const
+{
+	return queuesIndex;
+}
+
+VkPhysicalDeviceFeatures const&	VkGPU::getEnabledFeatures() const
+{
+	return enabledFeatures;
+}
+
+bool		VkGPU::isExtensionEnabled(char const* name) const
+{
+	for (const char* enabled : enabledExtensions) {
+		if (strcmp(name, enabled) == 0)
+			return true;
+	}
+	return false;
+}
+
+VkPhysicalDeviceDescriptorIndexingFeaturesEXT const&	VkGPU::getDescriptorIndexingFeatures() const
+{
+	return descriptorIndexing;
+}
+
+// Task and mesh shaders both, the meshlet renderer needs the two
+bool		VkGPU::hasMeshShaders() const
+{
+#ifdef VK_EXT_mesh_shader
+	return meshShader.taskShader && meshShader.meshShader;
+#else
+	return false;
+#endif
+}
+
+// Compute dispatches recorded with the draws, in the graphics queue's command buffers
+bool		VkGPU::hasGfxCompute() const
+{
+	uint32_t	familyCount;
+
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+	K3FrameVector<VkQueueFamilyProperties>	families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+	return queuesIndex[1] < familyCount && (families[queuesIndex[1]].queueFlags & VK_QUEUE_COMPUTE_BIT);
+}
+
+bool		VkGPU::isSuitableDevice(VkPhysicalDevice device, VkSurfaceKHR const& surface)
+{
+	SwapChainSupportDetails				scDetails = {};
+
+	scDetails = querySwapChainSupport(device, surface);
+	if (!findQueueFamilies(device, surface)
+		|| !checkExtensionSupport(device) || scDetails.formats.empty()
+		|| scDetails.presentModes.empty())
+		return false;
+	return true;
+}
+
+bool		VkGPU::findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR const& surface)
+{
+	uint32_t					queueCount;
+	bool						queueFound = false;
+	VkQueueFlags				queueFlags[3];
+	int							qidx = 1;
+	uint32_t					idx;
+
+	// Required queues flags ///////////////
+	queueFlags[0] = VK_QUEUE_GRAPHICS_BIT;
+	queueFlags[1] = VK_QUEUE_COMPUTE_BIT;
+	queueFlags[2] = VK_QUEUE_TRANSFER_BIT;
+
+	////////////////////////////////////////
+	memset(queuesIndex, -1, sizeof(queuesIndex));
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueCount, nullptr);
+	if (!queueCount)
+		return false;
+	K3FrameVector<VkQueueFamilyProperties>	deviceQueues(queueCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueCount, deviceQueues.data());
+	for (const auto& flags : queueFlags) {
+		idx = 0;
+		for (const auto& queues : deviceQueues) {
+			if (queues.queueCount > 0 && queues.queueFlags & flags) {
+				// Transfer and compute look for families of their own first, to run alongside graphics
+				if (!((flags == VK_QUEUE_TRANSFER_BIT || flags == VK_QUEUE_COMPUTE_BIT) && queues.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+				{
+					queueFound = true;
+					queuesIndex[qidx] = idx;
+					break;
+				}
+			}
+			idx++;
+		}
+		// Without a dedicated transfer family, transfers go through the graphics one
+		if (!queueFound && flags == VK_QUEUE_TRANSFER_BIT) {
+			queueFound = true;
+			queuesIndex[qidx] = queuesIndex[1];
+		}
+		// Without a compute only family, compute shares one with graphics
+		if (!queueFound && flags == VK_QUEUE_COMPUTE_BIT) {
+			idx = 0;
+			while (idx < queueCount && !(deviceQueues[idx].queueCount > 0 && deviceQueues[idx].queueFlags & flags))
+				idx++;
+			queueFound = idx < queueCount;
+			queuesIndex[qidx] = idx;
+		}
+		if (!queueFound)
+			return false;
+		queueFound = false;
+		qidx++;
+	}
+
+	VkBool32					presentationSupport = false;
+
+	idx = 0;
+	for (const auto& queues : deviceQueues) {
+		vkGetPhysicalDeviceSurfaceSupportKHR(device, idx, surface, &presentationSupport);
+		if (presentationSupport) {
+			queuesIndex[0] = idx;
+			break;
+		}
+		idx++;
+	}
+	if (!presentationSupport)
+		return false;
+	return true;
+}
+
+
+void		VkGPU::createLogicalDevice()
+{
+	std::vector<VkDeviceQueueCreateInfo> queuesInfo;
+	std::set<uint32_t>	queueFamilies = { queuesIndex[0], queuesIndex[1], queuesIndex[2], queuesIndex[3] };
+	float					queuePriority = 1.0f;
+
+	for (uint32_t currentQueueFam : queueFamilies) {
+		VkDeviceQueueCreateInfo		queueCreateInfo = {};
+		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfo.queueFamilyIndex = currentQueueFam;
+		queueCreateInfo.queueCount = 1;
+		queueCreateInfo.pQueuePriorities = &queuePriority;
+		queuesInfo.push_back(queueCreateInfo);
+	}
+	VkPhysicalDeviceFeatures	supportedFeatures;
+	VkDeviceCreateInfo		deviceInfo = {};
+
+	// Optional features, the renderer checks getEnabledFeatures() before relying on them
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+	enabledFeatures = {};
+	enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	enabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
+	uint32_t			extensionCount;
+
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+	K3FrameVector<VkExtensionProperties>	deviceExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, deviceExtensions.data());
+	enabledExtensions.assign(requiredExtensions.begin(), requiredExtensions.end());
+	for (const char* optional : optionalExtensions) {
+		for (const auto& extension : deviceExtensions) {
+			if (strcmp(optional, extension.extensionName) == 0) {
+				enabledExtensions.push_back(optional);
+				break;
+			}
+		}
+	}
+
+	// The optional extensions only count with their feature bits, which need Vulkan 1.1 to query
+	void*				featureChain = nullptr;
+	VkPhysicalDeviceProperties	deviceProperties;
+	VkPhysicalDeviceFeatures2	features2 = {};
+
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+#ifdef VK_KHR_present_wait
+	VkPhysicalDevicePresentIdFeaturesKHR	presentIdFeatures = {};
+	VkPhysicalDevicePresentWaitFeaturesKHR	presentWaitFeatures = {};
+
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	if (isExtensionEnabled(VK_KHR_PRESENT_WAIT_EXTENSION_NAME) && isExtensionEnabled(VK_KHR_PRESENT_ID_EXTENSION_NAME)) {
+		presentWaitFeatures.pNext = features2.pNext;
+		presentIdFeatures.pNext = &presentWaitFeatures;
+		features2.pNext = &presentIdFeatures;
+	}
+#endif
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT	indexingFeatures = {};
+
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	if (isExtensionEnabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+		indexingFeatures.pNext = features2.pNext;
+		features2.pNext = &indexingFeatures;
+	}
+#ifdef VK_EXT_mesh_shader
+	VkPhysicalDeviceMeshShaderFeaturesEXT	meshFeatures = {};
+
+	meshFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	if (isExtensionEnabled(VK_EXT_MESH_SHADER_EXTENSION_NAME) && isExtensionEnabled(VK_KHR_SPIRV_1_4_EXTENSION_NAME)
+		&& isExtensionEnabled(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME)) {
+		meshFeatures.pNext = features2.pNext;
+		features2.pNext = &meshFeatures;
+	}
+#endif
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	if (features2.pNext && deviceProperties.apiVersion >= VK_API_VERSION_1_1)
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+	// What is supported is chained again for the device, the rest is disabled
+#ifdef VK_KHR_present_wait
+	if (presentIdFeatures.presentId && presentWaitFeatures.presentWait) {
+		presentWaitFeatures.pNext = featureChain;
+		presentIdFeatures.pNext = &presentWaitFeatures;
+		featureChain = &presentIdFeatures;
+	}
+	else {
+		disableExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		disableExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+	}
+#endif
+	// Only what the bindless set needs, see K3Bindless
+	descriptorIndexing = {};
+	descriptorIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	if (indexingFeatures.runtimeDescriptorArray && indexingFeatures.descriptorBindingPartiallyBound
+		&& indexingFeatures.descriptorBindingSampledImageUpdateAfterBind && indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind
+		&& indexingFeatures.shaderSampledImageArrayNonUniformIndexing) {
+		descriptorIndexing.runtimeDescriptorArray = VK_TRUE;
+		descriptorIndexing.descriptorBindingPartiallyBound = VK_TRUE;
+		descriptorIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		descriptorIndexing.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		descriptorIndexing.descriptorBindingUpdateUnusedWhilePending = indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+		descriptorIndexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		descriptorIndexing.shaderStorageBufferArrayNonUniformIndexing = indexingFeatures.shaderStorageBufferArrayNonUniformIndexing;
+		descriptorIndexing.pNext = featureChain;
+		featureChain = &descriptorIndexing;
+	}
+	else
+		disableExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+#ifdef VK_EXT_mesh_shader
+	// Only task and mesh shaders, the multiview and shading rate variants are not used
+	meshShader = {};
+	meshShader.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	if (meshFeatures.taskShader && meshFeatures.meshShader) {
+		meshShader.taskShader = VK_TRUE;
+		meshShader.meshShader = VK_TRUE;
+		meshShader.pNext = featureChain;
+		featureChain = &meshShader;
+	}
+	else {
+		disableExtension(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+		disableExtension(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
+		disableExtension(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME);
+	}
+#endif
+
+	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceInfo.pNext = featureChain;
+	deviceInfo.queueCreateInfoCount = static_cast<uint32_t>(queuesInfo.size());
+	deviceInfo.pQueueCreateInfos = queuesInfo.data();
+	deviceInfo.pEnabledFeatures = &enabledFeatures;
+	deviceInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	deviceInfo.ppEnabledExtensionNames = enabledExtensions.data();
+
+	if (enableValidationLayers) {
+		deviceInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+		deviceInfo.ppEnabledLayerNames = validationLayers.data();
+	}
+	else
+		deviceInfo.enabledLayerCount = 0;
+
+	if (vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &logicalDevice) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create logical device");
+	// The rest of the chain lived on the stack
+	descriptorIndexing.pNext = nullptr;
+#ifdef VK_EXT_mesh_shader
+	meshShader.pNext = nullptr;
+#endif
+}
+
+void		VkGPU::disableExtension(char const* name)
+{
+	enabledExtensions.erase(std::remove_if(enabledExtensions.begin(), enabledExtensions.end(), [name](const char* enabled) {
+		return strcmp(name, enabled) == 0;
+	}), enabledExtensions.end());
+}
+
+void			VkGPU::getQueues()
+{
+	vkGetDeviceQueue(logicalDevice, queuesIndex[0], 0, &presentQueue);
+	vkGetDeviceQueue(logicalDevice, queuesIndex[1], 0, &gfxQueue);
+	vkGetDeviceQueue(logicalDevice, queuesIndex[2], 0, &computeQueue);
+	vkGetDeviceQueue(logicalDevice, queuesIndex[3], 0, &transferQueue);
 }
\ No newline at end of file
@@ -1,701 +1,2361 @@
-#include "VkHandler.h"
-
-static		VKAPI_ATTR VkBool32 VKAPI_CALL validationLayerCallback(
-	VkDebugReportFlagsEXT		Flags,
-	VkDebugReportObjectTypeEXT	objType,
-	uint64_t					obj,
-	size_t						location,
-	int32_t						code,
-	const char*					layerPrefix,
-	const char*					msg,
-	void*						userData)
-{
-	std::cerr << "Validation layer callback : " << msg << std::endl;
-	return VK_FALSE;
-}
-
-std::vector<const char *>	VkHandler::getGlfwRequiredExtensions()
-{
-	std::vector<const char *>	extensions;
-	unsigned int				glfwExtensionCount = 0;
-	const char					**glfwExtensions;
-
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-	
-	for (unsigned int i = 0; i < glfwExtensionCount; i++) {
-		extensions.push_back(glfwExtensions[i]);
-	}
-
-	if (enableValidationLayers) {
-		extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
-	}
-	return (extensions);
-}
-
-bool			VkHandler::checkValidationLayerSupport()
-{
-	uint32_t		layerCount;
-	bool			layerFound;
-
-	vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
-	std::vector<VkLayerProperties>	availableLayers(layerCount);
-	vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
-
-	std::cout << "Available validation layers :" << std::endl;
-	for (const auto &layers : availableLayers) {
-		std::cout << "-" << layers.layerName << std::endl;
-	}
-
-	for (const char* layerName : validationLayers) {
-		layerFound = false;
-		for (const auto &layerProperties : availableLayers) {
-			if (strcmp(layerName, layerProperties.layerName) == 0) {
-				layerFound = true;
-				break;
-			}
-		}
-		if (!layerFound)
-			return false;
-	}
-	return true;
-}
-
-void		VkHandler::initSubClasses()
-{
-	dispHandler = new VkDisplayHandler;
-	createInstance();
-	if (enableValidationLayers)
-		setupDebugCallback();
-	dispHandler->createSurface(instance);
-	gpu = new VkGPU(instance, dispHandler->getSurface());
-}
-
-void		VkHandler::run()
-{
-	initVulkan();
-	mainLoop();
-}
-
-void		VkHandler::terminate()
-{
-	dispHandler->terminateWindow();
-	terminateVulkan();
-}
-
-VkResult	VkHandler::CreateDebugReportCallbackEXT(
-	VkInstance									instance,
-	const VkDebugReportCallbackCreateInfoEXT*	pCreateInfo,
-	const VkAllocationCallbacks*				pAllocator,
-	VkDebugReportCallbackEXT*					pCallback)
-{
-	auto func = (PFN_vkCreateDebugReportCallbackEXT)
-		vkGetInstanceProcAddr(instance, "vkCreateDebugReportCallbackEXT");
-	if (func != nullptr)
-		return func(instance, pCreateInfo, pAllocator, pCallback);
-	else {
-		return VK_ERROR_EXTENSION_NOT_PRESENT;
-	}
-}
-
-void		VkHandler::DestroyDebugReportCallbackEXT(
-	VkInstance									instance,
-	VkDebugReportCallbackEXT					callback,
-	const VkAllocationCallbacks*				pAllocator)
-{
-	auto func = (PFN_vkDestroyDebugReportCallbackEXT)
-		vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
-	if (func != nullptr)
-		func(instance, callback, pAllocator);
-}
-
-void		VkHandler::setupDebugCallback()
-{
-	VkDebugReportCallbackCreateInfoEXT callbackInfo = {};
-	callbackInfo.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
-	callbackInfo.flags = VK_DEBUG_REPORT_DEBUG_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_ERROR_BIT_EXT;
-	callbackInfo.pfnCallback = validationLayerCallback;
-	if (CreateDebugReportCallbackEXT(instance, &callbackInfo, nullptr, &callback) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to set up validation layer callback function !");
-	}
-}
-
-void		VkHandler::createInstance()
-{
-	// Specify the instance parameters
-
-	if (enableValidationLayers && !checkValidationLayerSupport()) {
-		throw std::runtime_error("Validation layers requested are not supported !");
-	}
-
-	VkApplicationInfo appInfo = {};
-	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-	appInfo.pApplicationName = "Hello triangle";
-	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.pEngineName = "K3 Engine";
-	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
-
-	VkInstanceCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-	createInfo.pApplicationInfo = &appInfo;
-
-	// Get The extensions required to interface with the GLFW Window
-	auto glfwExtensions = getGlfwRequiredExtensions();
-
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(glfwExtensions.size());
-	createInfo.ppEnabledExtensionNames = glfwExtensions.data();
-
-	// Get the number of supported validation layers and specify them
-	if (enableValidationLayers) { // Number of validation layers wanted
-		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-		createInfo.ppEnabledLayerNames = validationLayers.data();
-	}
-	else {
-		createInfo.enabledLayerCount = 0;
-	}
-
-	// Create the instance with the specified parameters
-	if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create instance !");
-	}
-}
-
-char*	VkHandler::getMissingQueue(VkQueueFlags flag)
-{
-	switch (flag)
-	{
-	case (0x00000001):
-			return ("VK_QUEUE_GRAPHICS_BIT is missing !");
-	case (0x00000002):
-			return ("VK_QUEUE_COMPUTE_BIT is missing !");
-	case (0x00000004):
-		return ("VK_QUEUE_TRANSFER_BIT is missing !");
-	}
-	return ("VK_QUEUE_SPARSE_BINDING_BIT is missing !");
-}
-
-void			VkHandler::createRenderPass()
-{
-	VkAttachmentDescription		colorAttDes = {};
-	colorAttDes.format = dispHandler->getScImgFormat();
-	colorAttDes.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttDes.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttDes.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttDes.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttDes.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-	colorAttDes.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;	// Z-BUFFER ATTACHMENT CONFIGURATION
-	colorAttDes.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;	// Z-BUFFER ATTACHMENT CONFIGURATION
-
-	VkAttachmentReference		colorAttRef = {};
-	colorAttRef.attachment = 0;
-	colorAttRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	//SUBPASS CREATION
-	VkSubpassDescription		subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorAttRef;
-	subpass.pDepthStencilAttachment = nullptr; // Z BUFFER ATTACHMENTS
-
-	// SUBPASS DEPENDENCIES
-	VkSubpassDependency		dependency = {};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-
-	VkRenderPassCreateInfo		renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.pAttachments = &colorAttDes;
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
-
-	if (vkCreateRenderPass(gpu->getLogicalDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create render pass !");
-}
-
-void			VkHandler::createGFXPipeline()
-{
-	VkShaderModule	vertShaderModule = createShaderModuleFromSrc("G:/Graphic_Projects/Vulkan/k3_engine/Vk_test/shaders/shader.vert.spv");
-	VkShaderModule	fragShaderModule = createShaderModuleFromSrc("G:/Graphic_Projects/Vulkan/k3_engine/Vk_test/shaders/shader.frag.spv");
-
-	// VERTEX SHADER
-	VkPipelineShaderStageCreateInfo	vertStageInfo = {};
-	vertStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertStageInfo.module = vertShaderModule;
-	vertStageInfo.pName = "main";
-
-	// FRAGMENT SHADER
-	VkPipelineShaderStageCreateInfo	fragStageInfo = {};
-	fragStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragStageInfo.module = fragShaderModule;
-	fragStageInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo	shaderStages[] = {
-		vertStageInfo,
-		fragStageInfo
-	};
-
-	// VERTICES
-
-	auto	bindingDescription = Vertex::getBindingDescription();
-	auto	attributeDescriptions = Vertex::getAttributeDescriptions();
-
-	// VERTEX INPUT SHADER
-	VkPipelineVertexInputStateCreateInfo	vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-	// VERTEX ASSEMBLY SHADER
-	VkPipelineInputAssemblyStateCreateInfo	inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	// SCISSOR
-	VkRect2D		scissor = {};
-	scissor.offset = { 0, 0 };
-	scissor.extent = dispHandler->getScExtent();
-
-	// VIEWPORT
-	VkViewport		vp = {};
-	vp.x = 0.0f;
-	vp.y = 0.0f;
-	vp.width = static_cast<float>(scissor.extent.width);
-	vp.height = static_cast<float>(scissor.extent.height);
-	vp.minDepth = 0.0f;
-	vp.maxDepth = 1.0f;
-
-
-
-	// VIEWPORT AND SCISSOR STATE
-	VkPipelineViewportStateCreateInfo	vpState = {};
-	vpState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	vpState.viewportCount = 1;
-	vpState.pViewports = &vp;
-	vpState.scissorCount = 1;
-	vpState.pScissors = &scissor;
-
-	// RASTERIZER
-	VkPipelineRasterizationStateCreateInfo	rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-
-	// MULTISAMPLING
-	VkPipelineMultisampleStateCreateInfo	multisampling = {};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	multisampling.minSampleShading = 1.0f;
-
-	// Z-BUFFER (for later)
-	// VkPipelineDepthStencilStateCreateInfo
-
-	// COLOR BLENDING
-	VkPipelineColorBlendAttachmentState		colorBlendAttach = {};
-	colorBlendAttach.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-								VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttach.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo		colorBlendInfo = {};
-	colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlendInfo.logicOpEnable = VK_FALSE;
-	colorBlendInfo.attachmentCount = 1;
-	colorBlendInfo.pAttachments = &colorBlendAttach;
-
-	// DYNAMIC STATE
-	VkDynamicState		dSList[] = {
-		VK_DYNAMIC_STATE_LINE_WIDTH,
-		VK_DYNAMIC_STATE_VIEWPORT
-	};
-	VkPipelineDynamicStateCreateInfo	dynamicState = {};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = 2;
-	dynamicState.pDynamicStates = dSList;
-
-	// PIPELINE LAYOUT
-	VkPipelineLayoutCreateInfo		pipelineLayoutInfo = {};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 0;
-	pipelineLayoutInfo.pSetLayouts = nullptr;
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
-	pipelineLayoutInfo.pPushConstantRanges = 0;
-	if (vkCreatePipelineLayout(gpu->getLogicalDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create pipeline layout object !");
-
-	//CREATE GFX PIPELINE
-	VkGraphicsPipelineCreateInfo	gfxPipelineInfo = {};
-	gfxPipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	gfxPipelineInfo.stageCount = 2;
-	gfxPipelineInfo.pStages = shaderStages;
-	gfxPipelineInfo.pVertexInputState = &vertexInputInfo;
-	gfxPipelineInfo.pInputAssemblyState = &inputAssembly;
-	gfxPipelineInfo.pViewportState = &vpState;
-	gfxPipelineInfo.pRasterizationState = &rasterizer;
-	gfxPipelineInfo.pMultisampleState = &multisampling;
-	gfxPipelineInfo.pDepthStencilState = nullptr;
-	gfxPipelineInfo.pColorBlendState = &colorBlendInfo;
-	gfxPipelineInfo.pDynamicState = nullptr;
-	gfxPipelineInfo.layout = pipelineLayout;
-	gfxPipelineInfo.renderPass = renderPass;
-	gfxPipelineInfo.subpass = 0;
-	gfxPipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-	gfxPipelineInfo.basePipelineIndex = -1;
-
-	if (vkCreateGraphicsPipelines(gpu->getLogicalDevice(), VK_NULL_HANDLE, 1, &gfxPipelineInfo, nullptr, &gfxPipeline) != VK_SUCCESS)
-		throw std::runtime_error("failed to create graphics pipeline !");
-
-	// DESTROY SHADER MODULES
-	vkDestroyShaderModule(gpu->getLogicalDevice(), fragShaderModule, nullptr);
-	vkDestroyShaderModule(gpu->getLogicalDevice(), vertShaderModule, nullptr);
-}
-
-void			VkHandler::createCmdPool()
-{
-	uint32_t const*		queuesIndex = gpu->getQueuesIndex();
-
-	for (size_t id = 0; id < 4; id++) {
-		VkCommandPoolCreateInfo			poolInfo = {};
-		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		poolInfo.queueFamilyIndex = queuesIndex[id];
-		if (id == 3)
-			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-		if (vkCreateCommandPool(gpu->getLogicalDevice(), &poolInfo, nullptr, &cmdPools[id]) != VK_SUCCESS)
-			throw std::runtime_error("failed to create command pool !");
-	}
-}
-
-void			VkHandler::createCmdBuffers()
-{
-	std::vector<VkFramebuffer> const&	framebuffers = dispHandler->getFramebuffers();
-	cmdBuffers.resize(framebuffers.size());
-
-	VkCommandBufferAllocateInfo		cmdBuffInfo = {};
-	cmdBuffInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	cmdBuffInfo.commandPool = cmdPools[1];
-	cmdBuffInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	cmdBuffInfo.commandBufferCount = static_cast<uint32_t>(cmdBuffers.size());
-	if (vkAllocateCommandBuffers(gpu->getLogicalDevice(), &cmdBuffInfo, cmdBuffers.data()) != VK_SUCCESS)
-		throw std::runtime_error("failed to allocate command buffers");
-
-	for (size_t i = 0; i < cmdBuffers.size(); i++) {
-		VkCommandBufferBeginInfo		beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-
-		vkBeginCommandBuffer(cmdBuffers[i], &beginInfo);
-
-		VkRenderPassBeginInfo			rpBeginInfo = {};
-		rpBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		rpBeginInfo.renderPass = renderPass;
-		rpBeginInfo.framebuffer = framebuffers[i];
-		rpBeginInfo.renderArea.offset = { 0, 0 };
-		rpBeginInfo.renderArea.extent = dispHandler->getScExtent();
-		VkClearValue					clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
-		rpBeginInfo.clearValueCount = 1;
-		rpBeginInfo.pClearValues = &clearColor;
-
-		vkCmdBeginRenderPass(cmdBuffers[i], &rpBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipeline);
-		VkBuffer		vtxBuffs[] = { vertexBuffer };
-		VkDeviceSize	offsets[] = { 0 };
-		vkCmdBindVertexBuffers(cmdBuffers[i], 0, 1, vtxBuffs, offsets);
-		vkCmdBindIndexBuffer(cmdBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT16);
-		vkCmdDrawIndexed(cmdBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-		vkCmdEndRenderPass(cmdBuffers[i]);
-
-		if (vkEndCommandBuffer(cmdBuffers[i]) != VK_SUCCESS)
-			throw std::runtime_error("failed to record command buffer !");
-	}
-}
-
-VkShaderModule	VkHandler::createShaderModuleFromSrc(const std::string& filename)
-{
-	std::ifstream	shaderFile(filename, std::ios::ate | std::ios::binary);
-	if (!shaderFile.is_open())
-		throw std::runtime_error("failed to open shader file !");
-	size_t	filesize = static_cast<size_t>(shaderFile.tellg());
-	std::vector<char>	shaderCode(filesize);
-	shaderFile.seekg(0);
-	shaderFile.read(shaderCode.data(), filesize);
-	shaderFile.close();
-
-	VkShaderModuleCreateInfo	shaderInfo= {};
-	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	shaderInfo.codeSize = shaderCode.size();
-	shaderInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
-
-	VkShaderModule		shaderModule;
-	if (vkCreateShaderModule(gpu->getLogicalDevice(), &shaderInfo, nullptr, &shaderModule) != VK_SUCCESS)
-		throw std::runtime_error("failed to create shader module !");
-	shaderCode.clear();
-	return shaderModule;
-}
-
-
-void			VkHandler::initVulkan()
-{
-	VkDevice const&		gpuLDev = gpu->getLogicalDevice();
-
-	dispHandler->createSwapchain(VK_NULL_HANDLE, gpu->getPhysicalDevice(), gpuLDev);
-	dispHandler->createImgViews(gpuLDev);
-	createRenderPass();
-	createGFXPipeline();
-	dispHandler->createFrameBuffers(gpuLDev, renderPass);
-	createCmdPool();
-	createVertexBuffer();
-	createIndexBuffer();
-	createCmdBuffers();
-	createSemaphores();
-}
-
-void		VkHandler::createVertexBuffer()
-{
-	vertexObjectSize = static_cast<uint32_t>(vertices.size());
-	transferBufferToGpuStaged((void *)vertices.data(), sizeof(vertices[0]) * vertices.size(), vertexBuffer, vertexBufferMemory, 0, 0);
-}
-
-void VkHandler::transferBufferToGpuStaged(void const* bufferData, VkDeviceSize const bufferDataSize, VkBuffer& dstBuffer,
-											VkDeviceMemory& dstBufferMemory, int const copySrcOffst, int const copyDstOffst)
-{
-	VkBuffer			stagingBuffer;
-	VkDeviceMemory		stagingBufferMem;
-	VkDevice const&		gpuDev = gpu->getLogicalDevice();
-
-	createBuffer(bufferDataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMem);
-
-	void*		data;
-	vkMapMemory(gpuDev, stagingBufferMem, 0, bufferDataSize, 0, &data);
-	memcpy(data, bufferData, (size_t)bufferDataSize);
-	vkUnmapMemory(gpuDev, stagingBufferMem);
-
-	createBuffer(bufferDataSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, dstBuffer, dstBufferMemory);
-	
-	VkBufferCopy	copyInfo[1] = {};
-	copyInfo[0].srcOffset = copySrcOffst;
-	copyInfo[0].dstOffset = copyDstOffst;
-	copyInfo[0].size = bufferDataSize;
-
-	copyBuffer(stagingBuffer, dstBuffer, copyInfo, 1, VK_NULL_HANDLE);
-
-	vkDestroyBuffer(gpuDev, stagingBuffer, nullptr);
-	vkFreeMemory(gpuDev, stagingBufferMem, nullptr);
-}
-
-
-void VkHandler::createIndexBuffer()
-{
-	transferBufferToGpuStaged((void const*)indices.data(), sizeof(indices[0]) * indices.size(), indexBuffer, indexBufferMemory, 0, 0);
-}
-
-void		VkHandler::copyBuffer(VkBuffer src, VkBuffer dst, VkBufferCopy *copyInfo, uint32_t copyInfoSize, VkFence fence)
-{
-	VkDevice const&		gpuDev = gpu->getLogicalDevice();
-
-	VkCommandBufferAllocateInfo		allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = cmdPools[3];
-	allocInfo.commandBufferCount = 1;
-
-	VkCommandBuffer		cmdBuff;
-	vkAllocateCommandBuffers(gpuDev, &allocInfo, &cmdBuff);
-
-	VkCommandBufferBeginInfo		beginInfo = {};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	vkBeginCommandBuffer(cmdBuff, &beginInfo);
-	vkCmdCopyBuffer(cmdBuff, src, dst, copyInfoSize, copyInfo);
-	vkEndCommandBuffer(cmdBuff);
-
-	VkSubmitInfo	submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &cmdBuff;
-
-	VkQueue const&	transferQueue = gpu->getTransferQueue();
-	vkQueueSubmit(transferQueue, 1, &submitInfo, fence);
-	vkQueueWaitIdle(transferQueue);
-
-	vkFreeCommandBuffers(gpuDev, cmdPools[3], 1, &cmdBuff);
-}
-
-void		VkHandler::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
-			VkMemoryPropertyFlags memProperties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
-{
-	VkDevice const&		gpuDev = gpu->getLogicalDevice();
-	uint32_t const*		queuesIndex = gpu->getQueuesIndex();
-
-	VkBufferCreateInfo		bufferInfo = {};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size = size;
-	bufferInfo.usage = usage;
-
-	// Better have exlusivity then use a barrier in case of a staging buffer
-	if (queuesIndex[0] != queuesIndex[3]) {
-		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-		bufferInfo.pQueueFamilyIndices = queuesIndex;
-	}
-	else
-		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	//
-	if (vkCreateBuffer(gpuDev, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create vertex buffer");
-
-	VkMemoryRequirements	memRequirements;
-	vkGetBufferMemoryRequirements(gpuDev, buffer, &memRequirements);
-
-	VkMemoryAllocateInfo	allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(gpu->getPhysicalDevice(), memRequirements.memoryTypeBits, memProperties);
-	if (vkAllocateMemory(gpuDev, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate vertex buffer memory !");
-	}
-	vkBindBufferMemory(gpuDev, buffer, bufferMemory, 0);
-}
-uint32_t	VkHandler::findMemoryType(VkPhysicalDevice physicalGPU, uint32_t typeFilter, VkMemoryPropertyFlags properties)
-{
-	VkPhysicalDeviceMemoryProperties	memProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalGPU, &memProperties);
-
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-			return i;
-	}
-	throw std::runtime_error("Failed to find a suitable memory type for buffer memory allocation !");
-}
-
-void		VkHandler::mainLoop()
-{
-	while (!glfwWindowShouldClose(dispHandler->getWindow())) {
-		glfwPollEvents();
-		drawFrame();
-	}
-}
-
-void		VkHandler::createSemaphores()
-{
-	VkDevice const&	gpuDev = gpu->getLogicalDevice();
-
-	VkSemaphoreCreateInfo			semInfo = {};
-	semInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	if (vkCreateSemaphore(gpuDev, &semInfo, nullptr, &semImgAvailable) != VK_SUCCESS ||
-		vkCreateSemaphore(gpuDev, &semInfo, nullptr, &semRenderFinished) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create semaphores!");
-	}
-}
-
-void		VkHandler::drawFrame()
-{
-	uint32_t				imgIndex;
-	VkResult				scState;
-	VkSwapchainKHR const&	swapchain = dispHandler->getSwapchain();
-
-	scState = vkAcquireNextImageKHR(gpu->getLogicalDevice(), swapchain, std::numeric_limits<uint64_t>::max(),
-									semImgAvailable, VK_NULL_HANDLE, &imgIndex);
-
-	VkSubmitInfo	submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-	VkSemaphore				waitSem[] = { semImgAvailable };
-	VkPipelineStageFlags	waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSem;
-	submitInfo.pWaitDstStageMask = waitStages;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &cmdBuffers[imgIndex];
-	VkSemaphore				sigSem[] = { semRenderFinished };
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = sigSem;
-
-	if (vkQueueSubmit(gpu->getGfxQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
-		throw std::runtime_error("Failed to submit draw command buffer !");
-
-	// PRESENTATION
-	VkPresentInfoKHR		presentInfo = {};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = sigSem;
-	presentInfo.pImageIndices = &imgIndex;
-
-	VkSwapchainKHR			scPresent[] = { swapchain };
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = scPresent;
-
-	vkQueuePresentKHR(gpu->getPresentQueue(), &presentInfo);
-	vkQueueWaitIdle(gpu->getPresentQueue());
-}
-
-void		VkHandler::resizeWindow(const int newSizeX, const int newSizeY, const bool fullscreen)
-{
-	dispHandler->resizeWindow(newSizeX, newSizeY, fullscreen);
-	recreateSwapChain();
-}
-
-void		VkHandler::recreateSwapChain()
-{
-	VkDevice const&		gpuDev = gpu->getLogicalDevice();
-
-	cleanupSwapChainAssets();
-	dispHandler->createSwapchain(dispHandler->getSwapchain(), gpu->getPhysicalDevice(), gpuDev);
-	dispHandler->createImgViews(gpuDev);
-	createRenderPass();
-	createGFXPipeline();
-	dispHandler->createFrameBuffers(gpuDev, renderPass);
-	createCmdBuffers();
-}
-
-void		VkHandler::cleanupSwapChainAssets()
-{
-	VkDevice const&		gpuDev = gpu->getLogicalDevice();
-
-	dispHandler->destroyFramebuffers(gpuDev);
-	vkFreeCommandBuffers(gpuDev, cmdPools[1], static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
-	vkDestroyPipeline(gpuDev, gfxPipeline, nullptr);
-	vkDestroyPipelineLayout(gpuDev, pipelineLayout, nullptr);
-	vkDestroyRenderPass(gpuDev, renderPass, nullptr);
-	dispHandler->destroyImgViews(gpuDev);
-}
-
-void		VkHandler::terminateVulkan()
-{
-	VkDevice const&		gpuDev = gpu->getLogicalDevice();
-
-	cleanupSwapChainAssets();
-	dispHandler->destroySwapchain(gpuDev);
-	vkDestroyBuffer(gpuDev, vertexBuffer, nullptr);
-	vkFreeMemory(gpuDev, vertexBufferMemory, nullptr);
-	vkDestroyBuffer(gpuDev, indexBuffer, nullptr);
-	vkFreeMemory(gpuDev, indexBufferMemory, nullptr);
-	if (enableValidationLayers) {
-		DestroyDebugReportCallbackEXT(instance, callback, nullptr);
-	}
-	vkDestroySemaphore(gpuDev, semRenderFinished, nullptr);
-	vkDestroySemaphore(gpuDev, semImgAvailable, nullptr);
-	for (size_t i = 0; i < 4; i++) {
-		vkDestroyCommandPool(gpuDev, cmdPools[i], nullptr);
-	}
-	dispHandler->destroySurface(instance);
-	vkDestroyDevice(gpuDev, nullptr);
-	vkDestroyInstance(instance, nullptr);
+#include "VkHandler.h"
+#include "K3StreamWrite.h"
+
+static		VKAPI_ATTR VkBool32 VKAPI_CALL validationLayerCallback(
+	VkDebugReportFlagsEXT		Flags,
+	VkDebugReportObjectTypeEXT	objType,
+	uint64_t					obj,
+	size_t						location,
+	int32_t						code,
+	const char*					layerPrefix,
+	const char*					msg,
+	void*						userData)
+{
+	std::cerr << "Validation layer callback : " << msg << std::endl;
+	return VK_FALSE;
+}
+
+K3FrameVector<const char *>	VkHandler::getGlfwRequiredExtensions()
+{
+	K3FrameVector<const char *>	extensions;
+	unsigned int				glfwExtensionCount = 0;
+	const char					**glfwExtensions;
+
+	// Without a window there is no GLFW, the surface comes from VK_EXT_headless_surface
+	if (dispHandler->isHeadless()) {
+		extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+#ifdef VK_EXT_headless_surface
+		extensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+#endif
+	}
+	else {
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		extensions.reserve(glfwExtensionCount + 1);
+
+		for (unsigned int i = 0; i < glfwExtensionCount; i++) {
+			extensions.push_back(glfwExtensions[i]);
+		}
+	}
+
+	if (enableValidationLayers) {
+		extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+	}
+	return (extensions);
+}
+
+bool			VkHandler::checkValidationLayerSupport()
+{
+	uint32_t		layerCount;
+	bool			layerFound;
+
+	vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+	K3FrameVector<VkLayerProperties>	availableLayers(layerCount);
+	vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+
+	std::cout << "Available validation layers :" << std::endl;
+	for (const auto &layers : availableLayers) {
+		std::cout << "-" << layers.layerName << std::endl;
+	}
+
+	for (const char* layerName : validationLayers) {
+		layerFound = false;
+		for (const auto &layerProperties : availableLayers) {
+			if (strcmp(layerName, layerProperties.layerName) == 0) {
+				layerFound = true;
+				break;
+			}
+		}
+		if (!layerFound)
+			return false;
+	}
+	return true;
+}
+
+/* Device creation as a startup graph : GLFW first, then the instance on a worker while the
+** main thread opens the window, both needed by the surface and in turn the device. The asset
+** archive is read meanwhile, it only needs the job system.
+*/
+
+void		VkHandler::initSubClasses(bool const headless)
+{
+	K3StartupGraph&		graph = deviceStartup;
+
+	startupStart = std::chrono::steady_clock::now();
+	K3JobSystem::getInstance().start();
+	dispHandler = new VkDisplayHandler(headless);
+
+	uint32_t const	windowSystem = graph.add("window system", [this]() { dispHandler->initWindowSystem(); }, {}, true);
+	uint32_t const	vkInstance = graph.add("instance", [this]() {
+		createInstance();
+		if (enableValidationLayers)
+			setupDebugCallback();
+	}, { windowSystem });
+	uint32_t const	window = graph.add("window", [this]() { dispHandler->initWindow(); }, { windowSystem }, true);
+	uint32_t const	surface = graph.add("surface", [this]() { dispHandler->createSurface(instance); }, { vkInstance, window }, true);
+
+	graph.add("device", [this]() { gpu = new VkGPU(instance, dispHandler->getSurface()); }, { surface });
+	graph.add("asset archive", [this]() { loadAssets(); });
+	graph.run();
+	graph.print(std::cerr);
+}
+
+void		VkHandler::run()
+{
+	initVulkan();
+	mainLoop();
+}
+
+void		VkHandler::terminate()
+{
+	dispHandler->terminateWindow();
+	terminateVulkan();
+	K3JobSystem::getInstance().stop();
+}
+
+VkResult	VkHandler::CreateDebugReportCallbackEXT(
+	VkInstance									instance,
+	const VkDebugReportCallbackCreateInfoEXT*	pCreateInfo,
+	const VkAllocationCallbacks*				pAllocator,
+	VkDebugReportCallbackEXT*					pCallback)
+{
+	auto func = (PFN_vkCreateDebugReportCallbackEXT)
+		vkGetInstanceProcAddr(instance, "vkCreateDebugReportCallbackEXT");
+	if (func != nullptr)
+		return func(instance, pCreateInfo, pAllocator, pCallback);
+	else {
+		return VK_ERROR_EXTENSION_NOT_PRESENT;
+	}
+}
+
+void		VkHandler::DestroyDebugReportCallbackEXT(
+	VkInstance									instance,
+	VkDebugReportCallbackEXT					callback,
+	const VkAllocationCallbacks*				pAllocator)
+{
+	auto func = (PFN_vkDestroyDebugReportCallbackEXT)
+		vkGetInstanceProcAddr(instance, "vkDestroyDebugReportCallbackEXT");
+	if (func != nullptr)
+		func(instance, callback, pAllocator);
+}
+
+void		VkHandler::setupDebugCallback()
+{
+	VkDebugReportCallbackCreateInfoEXT callbackInfo = {};
+	callbackInfo.sType = VK_STRUCTURE_TYPE_DEBUG_REPORT_CALLBACK_CREATE_INFO_EXT;
+	callbackInfo.flags = VK_DEBUG_REPORT_DEBUG_BIT_EXT | VK_DEBUG_REPORT_WARNING_BIT_EXT | VK_DEBUG_REPORT_ERROR_BIT_EXT;
+	callbackInfo.pfnCallback = validationLayerCallback;
+	if (CreateDebugReportCallbackEXT(instance, &callbackInfo, nullptr, &callback) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to set up validation layer callback function !");
+	}
+}
+
+void		VkHandler::createInstance()
+{
+	// Specify the instance parameters
+
+	if (enableValidationLayers && !checkValidationLayerSupport()) {
+		throw std::runtime_error("Validation layers requested are not supported !");
+	}
+
+	VkApplicationInfo appInfo = {};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName = "Hello triangle";
+	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.pEngineName = "K3 Engine";
+	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.apiVersion = VK_API_VERSION_1_1;
+
+	VkInstanceCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	createInfo.pApplicationInfo = &appInfo;
+
+	// Get The extensions required to interface with the GLFW Window
+	auto glfwExtensions = getGlfwRequiredExtensions();
+
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(glfwExtensions.size());
+	createInfo.ppEnabledExtensionNames = glfwExtensions.data();
+
+	// Get the number of supported validation layers and specify them
+	if (enableValidationLayers) { // Number of validation layers wanted
+		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+		createInfo.ppEnabledLayerNames = validationLayers.data();
+	}
+	else {
+		createInfo.enabledLayerCount = 0;
+	}
+
+	// Create the instance with the specified parameters
+	if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create instance !");
+	}
+}
+
+const char*	VkHandler::getMissingQueue(VkQueueFlags flag)
+{
+	switch (flag)
+	{
+	case (0x00000001):
+			return ("VK_QUEUE_GRAPHICS_BIT is missing !");
+	case (0x00000002):
+			return ("VK_QUEUE_COMPUTE_BIT is missing !");
+	case (0x00000004):
+		return ("VK_QUEUE_TRANSFER_BIT is missing !");
+	}
+	return ("VK_QUEUE_SPARSE_BINDING_BIT is missing !");
+}
+
+/* With post processing the scene goes to an HDR target, which the post chain hands to the
+** compute queue. With MSAA the samples are resolved into it (or the swapchain image) as the
+** subpass ends, the multisampled color never leaves the pass. Neither does the depth, unless
+** the meshlet culling builds its depth pyramid from it once the pass is over.
+*/
+
+void			VkHandler::createRenderPass()
+{
+	std::vector<VkAttachmentDescription> const	attachments = sceneTargets.getAttachmentDescriptions(
+		postProcessing ? K3_POST_HDR_FORMAT : dispHandler->getScImgFormat(),
+		postProcessing ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+	VkAttachmentReference		colorAttRef = {};
+	colorAttRef.attachment = 0;
+	colorAttRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference		depthAttRef = {};
+	depthAttRef.attachment = 1;
+	depthAttRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference		resolveAttRef = {};
+	resolveAttRef.attachment = 2;
+	resolveAttRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	//SUBPASS CREATION
+	VkSubpassDescription		subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorAttRef;
+	subpass.pResolveAttachments = sceneTargets.getSamples() != VK_SAMPLE_COUNT_1_BIT ? &resolveAttRef : nullptr;
+	subpass.pDepthStencilAttachment = &depthAttRef;
+
+	// SUBPASS DEPENDENCIES
+	// The depth and multisampled color are shared by the frames in flight, the previous frame's writes and pyramid build come first
+	VkSubpassDependency		dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	// The depth pyramid is built from the stored depth right after the pass
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	if (sceneTargets.isDepthSampled())
+		dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+
+	VkRenderPassCreateInfo		renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	renderPassInfo.pAttachments = attachments.data();
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+	renderPassInfo.dependencyCount = sceneTargets.isDepthSampled() ? 2 : 1;
+	renderPassInfo.pDependencies = dependencies;
+
+	if (vkCreateRenderPass(gpu->getLogicalDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create render pass !");
+}
+
+void			VkHandler::createGFXPipeline()
+{
+	K3ShaderLayout	shaderLayout;
+
+	destroyGfxState();
+	gfxState.reset(new GfxPipelineState());
+
+	GfxPipelineState&	state = *gfxState;
+	VkShaderModule&		vertShaderModule = state.vertShaderModule;
+	VkShaderModule&		fragShaderModule = state.fragShaderModule;
+
+	vertShaderModule = createShaderModuleFromSrc(bindlessResources ? K3_SHADER_DIR "shader_bindless.vert.spv" : K3_SHADER_DIR "shader.vert.spv",
+				&shaderLayout);
+	fragShaderModule = createShaderModuleFromSrc(bindlessResources ? K3_SHADER_DIR "shader_bindless.frag.spv" : K3_SHADER_DIR "shader.frag.spv",
+				&shaderLayout);
+
+	// VERTEX SHADER
+	VkPipelineShaderStageCreateInfo&	vertStageInfo = state.shaderStages[0];
+	vertStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertStageInfo.module = vertShaderModule;
+	vertStageInfo.pName = "main";
+
+	// FRAGMENT SHADER
+	VkPipelineShaderStageCreateInfo&	fragStageInfo = state.shaderStages[1];
+	fragStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragStageInfo.module = fragShaderModule;
+	fragStageInfo.pName = "main";
+
+	// VERTICES
+
+	VkVertexInputBindingDescription*	bindingDescriptions = state.bindingDescriptions;
+	bindingDescriptions[0] = Vertex::getBindingDescription();
+	bindingDescriptions[1] = InstanceData::getBindingDescription();
+	std::vector<VkVertexInputAttributeDescription>&	attributeDescriptions = state.attributeDescriptions;
+	attributeDescriptions = shaderLayout.getVertexAttributes(0, sizeof(Vertex),
+								Vertex::firstLocation, Vertex::endLocation);
+	std::vector<VkVertexInputAttributeDescription> const	instanceAttributes = shaderLayout.getVertexAttributes(1, sizeof(InstanceData),
+								InstanceData::firstLocation, InstanceData::endLocation);
+	attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+
+	// VERTEX INPUT SHADER
+	VkPipelineVertexInputStateCreateInfo&	vertexInputInfo = state.vertexInputInfo;
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = 2;
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+	// VERTEX ASSEMBLY SHADER
+	VkPipelineInputAssemblyStateCreateInfo&	inputAssembly = state.inputAssembly;
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	// VIEWPORT AND SCISSOR STATE
+	// Both are dynamic and set when recording, the pipeline does not depend on the swapchain extent
+	VkPipelineViewportStateCreateInfo&	vpState = state.vpState;
+	vpState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	vpState.viewportCount = 1;
+	vpState.pViewports = nullptr;
+	vpState.scissorCount = 1;
+	vpState.pScissors = nullptr;
+
+	// RASTERIZER
+	VkPipelineRasterizationStateCreateInfo&	rasterizer = state.rasterizer;
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	// MULTISAMPLING
+	VkPipelineMultisampleStateCreateInfo&	multisampling = state.multisampling;
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = sceneTargets.getSamples();
+	multisampling.minSampleShading = 1.0f;
+
+	// Z-BUFFER
+	// The draws go front to back within a bucket, hidden fragments fail the early test
+	VkPipelineDepthStencilStateCreateInfo&	depthStencil = state.depthStencil;
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_TRUE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	depthStencil.depthBoundsTestEnable = VK_FALSE;
+	depthStencil.stencilTestEnable = VK_FALSE;
+
+	// COLOR BLENDING
+	VkPipelineColorBlendAttachmentState&	colorBlendAttach = state.colorBlendAttach;
+	colorBlendAttach.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+								VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttach.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo&	colorBlendInfo = state.colorBlendInfo;
+	colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendInfo.logicOpEnable = VK_FALSE;
+	colorBlendInfo.attachmentCount = 1;
+	colorBlendInfo.pAttachments = &colorBlendAttach;
+
+	// DYNAMIC STATE
+	VkDynamicState*		dSList = state.dSList;
+	dSList[0] = VK_DYNAMIC_STATE_VIEWPORT;
+	dSList[1] = VK_DYNAMIC_STATE_SCISSOR;
+	VkPipelineDynamicStateCreateInfo&	dynamicState = state.dynamicState;
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dSList;
+
+	// PIPELINE LAYOUT
+	// Bindless draws only need the global set and the slots of their buffers, the set is K3Bindless's own
+	VkPushConstantRange const		pushRange = shaderLayout.getPushConstantRange();
+	if (bindlessResources && pushRange.size != sizeof(DrawConstants))
+		throw std::runtime_error("DrawConstants do not match the bindless shaders !");
+	VkPipelineLayoutCreateInfo		pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = bindlessResources ? 1 : 0;
+	pipelineLayoutInfo.pSetLayouts = bindlessResources ? &bindless.getSetLayout() : nullptr;
+	pipelineLayoutInfo.pushConstantRangeCount = pushRange.size > 0 ? 1 : 0;
+	pipelineLayoutInfo.pPushConstantRanges = pushRange.size > 0 ? &pushRange : nullptr;
+	if (vkCreatePipelineLayout(gpu->getLogicalDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create pipeline layout object !");
+
+	//CREATE GFX PIPELINE
+	VkGraphicsPipelineCreateInfo&	gfxPipelineInfo = state.gfxPipelineInfo;
+	gfxPipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	gfxPipelineInfo.stageCount = 2;
+	gfxPipelineInfo.pStages = state.shaderStages;
+	gfxPipelineInfo.pVertexInputState = &vertexInputInfo;
+	gfxPipelineInfo.pInputAssemblyState = &inputAssembly;
+	gfxPipelineInfo.pViewportState = &vpState;
+	gfxPipelineInfo.pRasterizationState = &rasterizer;
+	gfxPipelineInfo.pMultisampleState = &multisampling;
+	gfxPipelineInfo.pDepthStencilState = &depthStencil;
+	gfxPipelineInfo.pColorBlendState = &colorBlendInfo;
+	gfxPipelineInfo.pDynamicState = &dynamicState;
+	gfxPipelineInfo.layout = pipelineLayout;
+	gfxPipelineInfo.renderPass = renderPass;
+	gfxPipelineInfo.subpass = 0;
+	gfxPipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	gfxPipelineInfo.basePipelineIndex = -1;
+
+	/* Only the bindless fragment shader has constants, the plain one needs a single variant.
+	** The variant that draws any material comes first, the specialized ones are only faster :
+	** they are compiled after the first frame, unless it is already out (swapchain rebuilds).
+	*/
+	auto		buildVariant = [this](VkSpecializationInfo const* specialization) { return buildGfxVariant(specialization); };
+	gfxVariants.init(gpu->getLogicalDevice());
+	gfxPipeline = gfxVariants.get(gfxVariants.add({ VK_TRUE }, buildVariant));
+	deferredVariants.clear();
+	if (bindlessResources && frameNumber == 0)
+		deferredVariants.push_back({ VK_FALSE });
+	else if (bindlessResources)
+		gfxVariants.add({ VK_FALSE }, buildVariant);
+
+#ifdef VK_EXT_mesh_shader
+	// Same state without vertex input and assembly, the mesh shaders read the vertex buffer themselves
+	if (meshShading) {
+		VkGraphicsPipelineCreateInfo	meshPipelineInfo = gfxPipelineInfo;
+		VkShaderModule	taskShaderModule = createShaderModuleFromSrc(K3_SHADER_DIR "meshlet.task.spv");
+		VkShaderModule	meshShaderModule = createShaderModuleFromSrc(K3_SHADER_DIR "meshlet.mesh.spv");
+
+		VkPipelineShaderStageCreateInfo	meshStages[3] = { {}, {}, fragStageInfo };
+		meshStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		meshStages[0].stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+		meshStages[0].module = taskShaderModule;
+		meshStages[0].pName = "main";
+		meshStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		meshStages[1].stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+		meshStages[1].module = meshShaderModule;
+		meshStages[1].pName = "main";
+		meshPipelineInfo.stageCount = 3;
+		meshPipelineInfo.pStages = meshStages;
+		meshPipelineInfo.pVertexInputState = nullptr;
+		meshPipelineInfo.pInputAssemblyState = nullptr;
+		meshPipelineInfo.layout = culler.getPipelineLayout();
+		VkResult const	result = vkCreateGraphicsPipelines(gpu->getLogicalDevice(), VK_NULL_HANDLE, 1, &meshPipelineInfo, nullptr, &meshPipeline);
+		vkDestroyShaderModule(gpu->getLogicalDevice(), meshShaderModule, nullptr);
+		vkDestroyShaderModule(gpu->getLogicalDevice(), taskShaderModule, nullptr);
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("failed to create mesh shading pipeline !");
+	}
+#endif
+
+	// DESTROY SHADER MODULES, unless the deferred variants still need them
+	if (deferredVariants.empty())
+		destroyGfxState();
+}
+
+// Works on copies of the stages and the create info, variants may be compiled on several threads at once
+VkPipeline		VkHandler::buildGfxVariant(VkSpecializationInfo const* specialization) const
+{
+	VkPipelineShaderStageCreateInfo	stages[2] = { gfxState->shaderStages[0], gfxState->shaderStages[1] };
+	VkGraphicsPipelineCreateInfo	pipelineInfo = gfxState->gfxPipelineInfo;
+	VkPipeline			pipeline = VK_NULL_HANDLE;
+
+	stages[1].pSpecializationInfo = specialization;
+	pipelineInfo.pStages = stages;
+	if (vkCreateGraphicsPipelines(gpu->getLogicalDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+	return pipeline;
+}
+
+void			VkHandler::destroyGfxState()
+{
+	if (!gfxState)
+		return;
+	vkDestroyShaderModule(gpu->getLogicalDevice(), gfxState->fragShaderModule, nullptr);
+	vkDestroyShaderModule(gpu->getLogicalDevice(), gfxState->vertShaderModule, nullptr);
+	gfxState.reset();
+}
+
+
+void			VkHandler::createCmdPool()
+{
+	uint32_t const*		queuesIndex = gpu->getQueuesIndex();
+
+	for (size_t id = 0; id < 4; id++) {
+		VkCommandPoolCreateInfo			poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queuesIndex[id];
+		if (id == 3)
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		if (vkCreateCommandPool(gpu->getLogicalDevice(), &poolInfo, nullptr, &cmdPools[id]) != VK_SUCCESS)
+			throw std::runtime_error("failed to create command pool !");
+	}
+
+	// Command pools are externally synchronized, every job thread records from its own graphics pool
+	threadCmdPools.resize(K3JobSystem::getInstance().getThreadCount());
+	for (VkCommandPool& pool : threadCmdPools) {
+		VkCommandPoolCreateInfo			poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queuesIndex[1];
+		if (vkCreateCommandPool(gpu->getLogicalDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create command pool !");
+	}
+}
+
+// Pool 0 belongs to the main thread, the render thread registers for one of its own
+VkCommandPool		VkHandler::getThreadCmdPool() const
+{
+	uint32_t const	threadIndex = K3JobSystem::getThreadIndex();
+
+	if (threadIndex >= threadCmdPools.size())
+		throw std::runtime_error("Recording from a thread without a command pool !");
+	return threadCmdPools[threadIndex];
+}
+
+void			VkHandler::freeCmdBuffers()
+{
+	for (size_t i = 0; i < cmdBuffers.size(); i++) {
+		vkFreeCommandBuffers(gpu->getLogicalDevice(), cmdBufferPools[i], 1, &cmdBuffers[i]);
+	}
+	cmdBuffers.clear();
+	cmdBufferPools.clear();
+	cmdCache.destroy();
+}
+
+std::vector<VkFramebuffer> const&	VkHandler::getSceneFramebuffers() const
+{
+	return postProcessing ? post.getFramebuffers() : dispHandler->getFramebuffers();
+}
+
+// Top left part of the scene targets the scene pass renders to
+VkExtent2D	VkHandler::getRenderExtent() const
+{
+	VkExtent2D const	extent = dispHandler->getScExtent();
+	double const		scale = postProcessing ? dynamicResolution.getScale() : 1.0;
+
+	return { std::max(static_cast<uint32_t>(extent.width * scale), 1u), std::max(static_cast<uint32_t>(extent.height * scale), 1u) };
+}
+
+/* Reads the GPU time of the slot's previous frame, done now that its fence was waited on.
+** The scene span scales with the render resolution, the post processing span does not. A
+** new scale records the scene buckets (viewport) and primaries (render area) again, and
+** the post processing chains (the part of the scene they sample).
+*/
+
+void		VkHandler::updateRenderScale(uint32_t const frameSlot)
+{
+	uint32_t const		image = slotImages[frameSlot];
+	double			sceneMs = 0.0;
+	double			postMs = 0.0;
+
+	if (image == K3_NO_IMAGE || !gpuTimer.read(image, K3_GPU_SPAN_SCENE, sceneMs))
+		return;
+	if (postProcessing && !gpuTimer.read(image, K3_GPU_SPAN_POST, postMs))
+		return;
+	gpuFrameMs = sceneMs + postMs;
+	profiler.setCounter("gpu scene ms", sceneMs);
+	profiler.setCounter("gpu post ms", postMs);
+	if (postProcessing && dynamicResolution.update(sceneMs, postMs)) {
+		cmdCache.invalidateAll();
+		post.setRenderExtent(getRenderExtent(), retired, frameNumber);
+	}
+	profiler.setCounter("render scale", postProcessing ? dynamicResolution.getScale() : 1.0);
+}
+
+// The culling runs while its meshlet data is resident, nodes are drawn whole from their indirect commands otherwise
+bool			VkHandler::isCullingMeshlets() const
+{
+	return meshletCulling && culler.isResident();
+}
+
+/* The meshlet data is what the budget may stream out : evicted when its heap is short, it
+** comes back once the heap has the room again under the eviction target, looked for every
+** K3_MESHLET_RELOAD_FRAMES. Either way the command buffers are recorded again, with or
+** without the culling. Resident, it is touched every frame it is culled with.
+*/
+
+void			VkHandler::updateMeshletResidency()
+{
+	if (!meshletCulling)
+		return;
+	if (culler.isResident()) {
+		if (!meshletEviction.exchange(false)) {
+			culler.touchMeshlets();
+			return;
+		}
+		culler.evictMeshlets(retired, frameNumber);
+		std::cerr << "Meshlets evicted, nodes are drawn whole until they fit again" << std::endl;
+	}
+	else {
+		if (frameNumber % K3_MESHLET_RELOAD_FRAMES != 0 || !budget.hasRoom(culler.getMeshletDataSize(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+			return;
+		meshletEviction = false;
+		culler.reloadMeshlets([this](void const* data, VkDeviceSize const size, VkBuffer& buffer, VkDeviceMemory& memory) {
+			uploadMeshletBuffer(data, size, buffer, memory);
+		}, retired, frameNumber);
+		std::cerr << "Meshlets reloaded" << std::endl;
+	}
+	cmdCache.invalidateAll();
+}
+
+// Every node has a draw of its own in its bucket, the other paths draw all nodes at once
+bool			VkHandler::isDrawnPerNode() const
+{
+	return !meshletCulling && !(indirectDraws && gpu->getEnabledFeatures().multiDrawIndirect);
+}
+
+/* Invalidates the buckets whose draws changed since they were recorded. Nodes created or
+** given another material (the scene's draw generation) move to the bucket of their state,
+** and without indirect draws a node whose level of detail changed has it baked in. Drawing
+** all nodes at once, the only bucket depends on the node count alone.
+*/
+
+void			VkHandler::updateBuckets()
+{
+	K3SceneSnapshot const&	snapshot = sceneSnapshots.getReadSlot();
+	uint32_t const		nodeCount = std::min(snapshot.nodeCount, static_cast<uint32_t>(K3_MAX_INSTANCES));
+
+	if (!isDrawnPerNode()) {
+		if (nodeCount != recordedInstanceCount)
+			cmdCache.invalidate(cmdCache.getBucket(0));
+	}
+	else {
+		nodeBuckets.resize(nodeCount, K3_BUCKET_NONE);
+		for (uint32_t node = 0; node < nodeCount; node++) {
+			if (snapshot.drawGenerations[node] > recordedMaterialVersion || nodeBuckets[node] == K3_BUCKET_NONE) {
+				uint32_t const	material = snapshot.materials[node];
+				uint32_t const	bucket = cmdCache.getBucket(K3RenderQueue::getBucketKey(K3RenderQueue::makeKey(0, getMaterialPipeline(material), material, 0.0f)));
+
+				cmdCache.invalidate(nodeBuckets[node]);
+				cmdCache.invalidate(bucket);
+				nodeBuckets[node] = bucket;
+			}
+			else if (!indirectDraws && lods.getNodeVersion(node) > recordedLodVersion)
+				cmdCache.invalidate(nodeBuckets[node]);
+		}
+	}
+	recordedInstanceCount = nodeCount;
+	recordedMaterialVersion = snapshot.materialVersion;
+	recordedLodVersion = lods.getVersion();
+}
+
+// Untextured materials get the variant without the texture fetch, once it is compiled
+uint32_t		VkHandler::getMaterialPipeline(uint32_t const material) const
+{
+	if (!bindlessResources)
+		return 0;
+
+	uint32_t const	variant = gfxVariants.find(materialConstants[material]);
+
+	return variant != K3_VARIANT_NONE ? variant : 0;
+}
+
+/* One draw per node of the stale buckets, keyed on its pipeline and material. Once sorted
+** the draws of a bucket are contiguous. The keys have no depth : the buckets are replayed
+** for many frames, an order from the eye taken when they were recorded would go stale as
+** soon as the nodes moved. Drawing all nodes at once, the indirect region is in node order
+** and there is nothing to sort.
+** Also counts the pipeline binds the nodes would take drawn in node order, what the
+** buckets save is measured against it.
+*/
+
+void			VkHandler::buildRenderQueue()
+{
+	K3SceneSnapshot const&	snapshot = sceneSnapshots.getReadSlot();
+	uint32_t		previousPipeline = K3_VARIANT_NONE;
+
+	renderQueue.clear();
+	nodeOrderPipelineBinds = 0;
+	if (!isDrawnPerNode()) {
+		cmdCache.setDrawCount(cmdCache.getBucket(0), recordedInstanceCount);
+		return;
+	}
+	for (uint32_t node = 0; node < recordedInstanceCount; node++) {
+		uint32_t const		material = snapshot.materials[node];
+		uint32_t const		pipeline = getMaterialPipeline(material);
+
+		if (pipeline != previousPipeline)
+			nodeOrderPipelineBinds++;
+		previousPipeline = pipeline;
+		if (cmdCache.isStale(nodeBuckets[node]))
+			renderQueue.push(K3RenderQueue::makeKey(0, pipeline, material, 0.0f), node);
+	}
+	renderQueue.sort();
+	// A stale bucket left without nodes is not recorded
+	bucketFirstDraws.resize(cmdCache.getBucketCount(), 0);
+	for (uint32_t bucket = 0; bucket < cmdCache.getBucketCount(); bucket++) {
+		if (cmdCache.isStale(bucket))
+			cmdCache.setDrawCount(bucket, 0);
+	}
+	for (uint32_t queued = 0; queued < renderQueue.getSize();) {
+		uint32_t const	bucket = nodeBuckets[renderQueue.getDraw(queued)];
+		uint32_t	last = queued + 1;
+
+		while (last < renderQueue.getSize() && nodeBuckets[renderQueue.getDraw(last)] == bucket)
+			last++;
+		bucketFirstDraws[bucket] = queued;
+		cmdCache.setDrawCount(bucket, last - queued);
+		queued = last;
+	}
+}
+
+/* The draws of one bucket for one framebuffer, into a secondary command buffer : nothing
+** is inherited from the primary but the render pass, the dynamic state and the global set
+** are bound again.
+*/
+
+K3BindStats		VkHandler::recordBucket(VkCommandBuffer const cmdBuffer, uint32_t const image, uint32_t const bucket,
+				K3MeshletView const& meshletView)
+{
+	uint32_t const		firstDraw = bucketFirstDraws.empty() ? 0 : bucketFirstDraws[bucket];
+	uint32_t const		bucketDraws = cmdCache.getDrawCount(bucket);
+	K3StateFilter		filter(cmdBuffer);
+
+	VkRect2D		scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = getRenderExtent();
+	VkViewport		vp = {};
+	vp.width = static_cast<float>(scissor.extent.width);
+	vp.height = static_cast<float>(scissor.extent.height);
+	vp.minDepth = 0.0f;
+	vp.maxDepth = 1.0f;
+	vkCmdSetViewport(cmdBuffer, 0, 1, &vp);
+	vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+	// The global set stays bound for the whole bucket, draws find their material through the node ID buffer
+	if (bindlessResources) {
+		DrawConstants	constants = {};
+		constants.materialIds = materialIdSlot;
+		constants.materialIdBase = static_cast<uint32_t>(image * K3_MAX_INSTANCES);
+		constants.materialTable = materialTableSlot;
+		constants.lights = lightClusters.getSlots().lights;
+		constants.lightParams = lightClusters.getSlots().params;
+		constants.lightGrid = lightClusters.getSlots().grid;
+		constants.lightIndices = lightClusters.getSlots().indices;
+		constants.lightRegion = image;
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &bindless.getSet(), 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			0, sizeof(DrawConstants), &constants);
+	}
+	// Each framebuffer reads the world matrices from its own region of the instance buffer
+	VkBuffer		vtxBuffs[] = { vertexBuffer, instanceBuffer };
+	VkDeviceSize	offsets[] = { 0, image * K3_MAX_INSTANCES * sizeof(InstanceData) };
+	// One command per node, its level of detail is picked every frame by the LOD selector
+	VkDeviceSize	cmdOffset = image * K3_MAX_INSTANCES * sizeof(VkDrawIndexedIndirectCommand);
+	for (uint32_t draw = 0; draw < drawCount; draw++) {
+		if (isCullingMeshlets() && meshShading) {
+			filter.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
+			culler.recordMeshTasks(cmdBuffer, image, recordedInstanceCount, meshletView);
+			continue;
+		}
+		// One draw per visible meshlet, still reading the node's world matrix through firstInstance
+		if (isCullingMeshlets()) {
+			filter.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipeline);
+			filter.bindVertexBuffers(0, 2, vtxBuffs, offsets);
+			filter.bindIndexBuffer(indexBuffer, 0, meshIndexType);
+			culler.recordDraw(cmdBuffer, image, recordedInstanceCount);
+			continue;
+		}
+		if (!isDrawnPerNode()) {
+			// The indirect region is in node order, all nodes share the one pipeline
+			filter.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, gfxPipeline);
+			filter.bindVertexBuffers(0, 2, vtxBuffs, offsets);
+			filter.bindIndexBuffer(indexBuffer, 0, meshIndexType);
+			vkCmdDrawIndexedIndirect(cmdBuffer, indirectBuffer, cmdOffset, recordedInstanceCount,
+				sizeof(VkDrawIndexedIndirectCommand));
+			continue;
+		}
+		// The draws of a bucket share their pipeline, it and the buffers are bound once
+		if (bucketDraws > 0) {
+			filter.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, gfxVariants.get(K3RenderQueue::getPipeline(renderQueue.getKey(firstDraw))));
+			filter.bindVertexBuffers(0, 2, vtxBuffs, offsets);
+			filter.bindIndexBuffer(indexBuffer, 0, meshIndexType);
+		}
+		for (uint32_t queued = firstDraw; queued < firstDraw + bucketDraws; queued++) {
+			uint32_t const	node = renderQueue.getDraw(queued);
+
+			if (indirectDraws) {
+				vkCmdDrawIndexedIndirect(cmdBuffer, indirectBuffer, cmdOffset + node * sizeof(VkDrawIndexedIndirectCommand),
+					1, sizeof(VkDrawIndexedIndirectCommand));
+			}
+			else {
+				// Without drawIndirectFirstInstance the selection is baked in, see updateBuckets
+				VkDrawIndexedIndirectCommand	command = lods.getCommand(node);
+
+				vkCmdDrawIndexed(cmdBuffer, command.indexCount, 1, command.firstIndex, command.vertexOffset, command.firstInstance);
+			}
+		}
+	}
+	return filter.getStats();
+}
+
+/* Records the stale buckets, then a primary command buffer per framebuffer executing every
+** bucket. The primaries only hold the culling pass, the render pass and the post processing
+** handoff, recording them again is cheap next to the draws.
+*/
+
+void			VkHandler::createCmdBuffers()
+{
+	std::vector<VkFramebuffer> const&	framebuffers = getSceneFramebuffers();
+	K3MeshletView const			meshletView = getMeshletView();
+
+	cmdBuffers.resize(framebuffers.size());
+	cmdBufferPools.resize(framebuffers.size());
+	buildRenderQueue();
+	recordedBuckets = cmdCache.record(renderPass, framebuffers, threadCmdPools,
+		[this, &meshletView](VkCommandBuffer const cmdBuffer, uint32_t const image, uint32_t const bucket) {
+			return recordBucket(cmdBuffer, image, bucket, meshletView);
+		}, retired, frameNumber);
+	recordedBinds = cmdCache.getBindStats();
+
+	for (size_t i = 0; i < framebuffers.size(); i++) {
+		VkCommandBufferAllocateInfo		cmdBuffInfo = {};
+		cmdBuffInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cmdBuffInfo.commandPool = getThreadCmdPool();
+		cmdBuffInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cmdBuffInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(gpu->getLogicalDevice(), &cmdBuffInfo, &cmdBuffers[i]) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate command buffers");
+		cmdBufferPools[i] = cmdBuffInfo.commandPool;
+
+		VkCommandBufferBeginInfo		beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+
+		vkBeginCommandBuffer(cmdBuffers[i], &beginInfo);
+		gpuTimer.begin(cmdBuffers[i], static_cast<uint32_t>(i), K3_GPU_SPAN_SCENE);
+		// The draws of the compute path are written before the pass, mesh shaders cull as they draw
+		if (isCullingMeshlets() && !meshShading)
+			culler.recordCull(cmdBuffers[i], static_cast<uint32_t>(i), recordedInstanceCount, meshletView);
+		if (clusteredLighting)
+			lightClusters.recordBinning(cmdBuffers[i], static_cast<uint32_t>(i));
+
+		VkRenderPassBeginInfo			rpBeginInfo = {};
+		rpBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		rpBeginInfo.renderPass = renderPass;
+		rpBeginInfo.framebuffer = framebuffers[i];
+		rpBeginInfo.renderArea.offset = { 0, 0 };
+		rpBeginInfo.renderArea.extent = getRenderExtent();
+		// Indexed by attachment, the MSAA resolve target comes last and is not cleared
+		VkClearValue					clearValues[2] = {};
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+		rpBeginInfo.clearValueCount = 2;
+		rpBeginInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(cmdBuffers[i], &rpBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		cmdCache.execute(cmdBuffers[i], static_cast<uint32_t>(i));
+		vkCmdEndRenderPass(cmdBuffers[i]);
+		if (meshletCulling)
+			culler.recordPyramid(cmdBuffers[i], getRenderExtent());
+		gpuTimer.end(cmdBuffers[i], static_cast<uint32_t>(i), K3_GPU_SPAN_SCENE);
+		if (postProcessing)
+			post.recordRelease(cmdBuffers[i], static_cast<uint32_t>(i));
+
+		if (vkEndCommandBuffer(cmdBuffers[i]) != VK_SUCCESS)
+			throw std::runtime_error("failed to record command buffer !");
+	}
+}
+
+VkShaderModule	VkHandler::createShaderModuleFromSrc(const std::string& filename, K3ShaderLayout* const layout)
+{
+	uint32_t const	entry = assets.find(filename);
+	// SPIR-V is read as words so the code is correctly aligned for pCode
+	K3FrameVector<uint32_t>	shaderCode;
+	uint32_t const*	code;
+	size_t		filesize;
+
+	if (entry != K3_ARCHIVE_NONE) {
+		code = assetData.data() + assetOffsets[entry];
+		filesize = static_cast<size_t>(assets.getSize(entry));
+	}
+	else {
+		std::ifstream	shaderFile(filename, std::ios::ate | std::ios::binary);
+		if (!shaderFile.is_open())
+			throw std::runtime_error("failed to open shader file !");
+		filesize = static_cast<size_t>(shaderFile.tellg());
+		shaderCode.resize((filesize + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+		shaderFile.seekg(0);
+		shaderFile.read(reinterpret_cast<char*>(shaderCode.data()), filesize);
+		shaderFile.close();
+		code = shaderCode.data();
+	}
+	if (layout)
+		layout->addStage(code, filesize);
+
+	VkShaderModuleCreateInfo	shaderInfo= {};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.codeSize = filesize;
+	shaderInfo.pCode = code;
+
+	VkShaderModule		shaderModule;
+	if (vkCreateShaderModule(gpu->getLogicalDevice(), &shaderInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		throw std::runtime_error("failed to create shader module !");
+	shaderCode.clear();
+	return shaderModule;
+}
+
+
+/* One open and one batch of reads for every shader, instead of an open and a read each. On
+** a network mount the per file latency is most of the start time. The contents stay in
+** memory, they are small and the swapchain rebuilds may need them again.
+*/
+
+void			VkHandler::loadAssets()
+{
+	std::chrono::steady_clock::time_point const	start = std::chrono::steady_clock::now();
+	std::vector<K3ArchiveRequest>			requests;
+	size_t						words = 0;
+
+	if (!assets.open(K3_ASSET_ARCHIVE, K3_SHADER_DIR))
+		return;
+	assetOffsets.resize(assets.getEntryCount());
+	for (uint32_t entry = 0; entry < assets.getEntryCount(); entry++) {
+		assetOffsets[entry] = words;
+		words += static_cast<size_t>((assets.getSize(entry) + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+	}
+	assetData.assign(words, 0);
+	for (uint32_t entry = 0; entry < assets.getEntryCount(); entry++)
+		requests.push_back({ entry, assetData.data() + assetOffsets[entry] });
+	assets.load(requests.data(), static_cast<uint32_t>(requests.size()));
+	std::cerr << "Asset archive : " << assets.getEntryCount() << " entries in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms ("
+		<< (assets.getFile().isUsingIoUring() ? "io_uring" : "job system reads") << (assets.getFile().isDirect() ? ", direct I/O" : "")
+		<< ")" << std::endl;
+}
+
+/* The renderer as a startup graph, three chains that only meet to record the command
+** buffers : the swapchain and the targets drawn to, the pipelines (the scene's, culling and
+** post processing compile side by side), and the meshes, built on the CPU then uploaded
+** while the pipelines compile. The swapchain and the final recording stay on the main thread.
+*/
+
+void			VkHandler::initVulkan()
+{
+	K3StartupGraph&		graph = rendererStartup;
+
+	uint32_t const	memory = graph.add("memory budget", [this]() {
+		budget.init(gpu->getPhysicalDevice(), gpu->getLogicalDevice(), gpu->isExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
+	});
+	uint32_t const	swapchain = graph.add("swapchain", [this]() {
+		dispHandler->createSwapchain(VK_NULL_HANDLE, gpu->getPhysicalDevice(), gpu->getLogicalDevice(), gpu->getQueuesIndex());
+		dispHandler->createImgViews(gpu->getLogicalDevice());
+		postProcessing = K3PostProcess::isSupported(gpu->getPhysicalDevice(), dispHandler->getScImgFormat(), dispHandler->getScImgUsage(), assets);
+	}, {}, true);
+	// Without the extension, or the compiled bindless shaders, nodes are drawn with their vertex colors only
+	uint32_t const	bindlessSet = graph.add("bindless", [this]() {
+		bindlessResources = K3Bindless::isSupported(gpu->getDescriptorIndexingFeatures())
+			&& assets.exists(K3_SHADER_DIR "shader_bindless.vert.spv") && assets.exists(K3_SHADER_DIR "shader_bindless.frag.spv");
+		if (bindlessResources)
+			bindless.init(gpu->getPhysicalDevice(), gpu->getLogicalDevice());
+	});
+	// Culling records on the graphics queue ahead of the draws, the bindless shaders have no mesh shading variant
+	uint32_t const	culling = graph.add("meshlet culler", [this]() {
+		meshShading = gpu->hasMeshShaders() && !bindlessResources;
+		meshletCulling = gpu->getEnabledFeatures().drawIndirectFirstInstance && gpu->getEnabledFeatures().multiDrawIndirect
+			&& gpu->hasGfxCompute() && K3MeshletCuller::isSupported(meshShading, assets);
+		meshShading = meshShading && meshletCulling;
+		if (meshletCulling) {
+			culler.init(gpu->getPhysicalDevice(), gpu->getLogicalDevice(), budget, meshShading, gpu->isExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME),
+				[this](std::string const& filename) { return createShaderModuleFromSrc(filename); });
+		}
+	}, { memory, bindlessSet });
+	// The depth is sampled for the culling's depth pyramid
+	uint32_t const	targets = graph.add("scene targets", [this]() {
+		sceneTargets.init(budget, gpu->getPhysicalDevice(), gpu->getLogicalDevice(), K3SceneTargets::getSupportedSamples(gpu->getPhysicalDevice(), msaaSamples),
+			meshletCulling);
+		sceneTargets.create(dispHandler->getScExtent(), postProcessing ? K3_POST_HDR_FORMAT : dispHandler->getScImgFormat());
+	}, { memory, swapchain, culling });
+	// The lights are read through the global set, the binning records on the graphics queue like the culling
+	uint32_t const	lighting = graph.add("light clusters", [this]() {
+		clusteredLighting = bindlessResources && gpu->hasGfxCompute() && K3LightClusters::isSupported(assets);
+		if (clusteredLighting) {
+			lightClusters.init(gpu->getLogicalDevice(), budget, bindless,
+				[this](std::string const& filename) { return createShaderModuleFromSrc(filename); });
+		}
+	}, { memory, bindlessSet });
+	uint32_t const	pass = graph.add("render pass", [this]() { createRenderPass(); }, { swapchain, targets });
+	uint32_t const	pipelines = graph.add("scene pipelines", [this]() { createGFXPipeline(); }, { pass, bindlessSet, culling });
+	uint32_t const	pools = graph.add("command pools", [this]() { createCmdPool(); });
+	uint32_t const	timer = graph.add("gpu timer", [this]() {
+		if (K3GpuTimer::isSupported(gpu->getPhysicalDevice())) {
+			gpuTimer.init(gpu->getPhysicalDevice(), gpu->getLogicalDevice());
+			gpuTimer.create(static_cast<uint32_t>(dispHandler->getImgViews().size()));
+			post.setTimer(&gpuTimer);
+		}
+		std::fill(std::begin(slotImages), std::end(slotImages), K3_NO_IMAGE);
+	}, { swapchain });
+	uint32_t const	postPipelines = graph.add("post pipelines", [this]() {
+		if (postProcessing) {
+			post.init(budget, gpu->getLogicalDevice(), gpu->getQueuesIndex(), cmdPools[2],
+				[this](std::string const& filename, K3ShaderLayout* const layout) { return createShaderModuleFromSrc(filename, layout); });
+		}
+	}, { memory, pools, timer });
+	uint32_t const	framebuffers = graph.add("framebuffers", [this]() {
+		if (postProcessing)
+			post.createTargets(renderPass, sceneTargets, dispHandler->getScExtent(), dispHandler->getImages(), dispHandler->getScImgFormat());
+		else
+			dispHandler->createFrameBuffers(gpu->getLogicalDevice(), renderPass, sceneTargets);
+	}, { pass, postPipelines });
+	uint32_t const	meshes = graph.add("meshes", [this]() { createLodMeshes(); });
+	// The transfer command pool and queue are this chain's alone
+	uint32_t const	uploads = graph.add("mesh uploads", [this]() {
+		createVertexBuffer();
+		createIndexBuffer();
+		if (meshletCulling)
+			createMeshlets();
+	}, { meshes, memory, pools, culling });
+	uint32_t const	sceneBuffers = graph.add("scene buffers", [this]() {
+		// Nothing would be drawn without at least one node, the default one sits at the origin
+		if (scene.getNodeCount() == 0)
+			scene.createNode();
+		createInstanceBuffer();
+		createIndirectBuffer();
+		if (meshletCulling) {
+			culler.setInputs(indirectBuffer, instanceBuffer, vertexBuffer, static_cast<uint32_t>(dispHandler->getImgViews().size()),
+				retired, frameNumber);
+		}
+		createMaterialBuffers();
+		if (clusteredLighting)
+			lightClusters.setRegionCount(static_cast<uint32_t>(dispHandler->getImgViews().size()), retired, frameNumber);
+	}, { swapchain, uploads, bindlessSet, lighting });
+
+	graph.add("command buffers", [this]() {
+		VkDevice const&		gpuLDev = gpu->getLogicalDevice();
+
+		std::cerr << "Direct device memory writes : " << (budget.getDirectMemory() == K3_DIRECT_UMA ? "unified memory"
+			: budget.getDirectMemory() == K3_DIRECT_REBAR ? "resizable BAR" : budget.getDirectMemory() == K3_DIRECT_BAR ? "BAR window only" : "none")
+			<< std::endl;
+		std::cerr << "MSAA : " << sceneTargets.getSamples() << "x, scene attachments "
+			<< (sceneTargets.isLazilyAllocated() ? "lazily allocated" : "in device memory") << std::endl;
+		if (meshletCulling) {
+			setCullingDepth();
+			std::cerr << "Occlusion culling : " << (culler.getPyramidLevels() > 0 ? "depth pyramid of " + std::to_string(culler.getPyramidLevels())
+				+ " levels" : "off, the depth can not be sampled") << std::endl;
+		}
+		// The fallback path bakes the selection in the command buffers, it needs one up front
+		publishScene();
+		K3SceneSnapshot const&	snapshot = sceneSnapshots.acquire();
+		lods.select(snapshot.worlds.data(), snapshot.nodeCount, getLodView());
+		cmdCache.init(gpuLDev);
+		updateBuckets();
+		createCmdBuffers();
+		createSyncObjects();
+		createImageSemaphores();
+#ifdef VK_KHR_present_wait
+		if (gpu->isExtensionEnabled(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+			vkWaitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(gpuLDev, "vkWaitForPresentKHR");
+#endif
+		// Only the vblank locked modes have a display rhythm to follow, GLFW has to be asked from here
+		if (dispHandler->getPresentMode() == VK_PRESENT_MODE_FIFO_KHR || dispHandler->getPresentMode() == VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+			pacer.setRefreshRate(dispHandler->getRefreshRate());
+		else
+			pacer.setRefreshRate(0.0);
+	}, { pipelines, framebuffers, timer, sceneBuffers }, true);
+	graph.run();
+	graph.print(std::cerr);
+}
+
+/* Time to first frame is from the construction of the handler to the first present,
+** queued rather than on screen. What the first frame could do without starts from here.
+*/
+
+void			VkHandler::firstFramePresented()
+{
+	firstFrameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count();
+	std::cerr << "Time to first frame : " << firstFrameMs << " ms" << std::endl;
+	startLazyInit();
+}
+
+/* The specialized material variants, compiled on the job system. The render thread puts
+** them in between two frames (drawFrame polls the graph), until then every material draws
+** with the variant that draws any.
+*/
+
+void			VkHandler::startLazyInit()
+{
+	K3StartupGraph&		graph = lazyStartup;
+
+	if (deferredVariants.empty())
+		return;
+	pendingVariants.assign(deferredVariants.size(), VK_NULL_HANDLE);
+
+	uint32_t const	variants = graph.add("material variants", [this]() {
+		K3JobSystem::getInstance().parallelFor(0, static_cast<uint32_t>(deferredVariants.size()), 1, [this](uint32_t first, uint32_t last) {
+			for (uint32_t variant = first; variant < last; variant++) {
+				K3Specialization<MaterialConstants> const	specialization(deferredVariants[variant]);
+
+				pendingVariants[variant] = buildGfxVariant(specialization.getInfo());
+			}
+		});
+	});
+	graph.add("install variants", [this]() { installDeferredVariants(); }, { variants }, true);
+	graph.start();
+}
+
+// In the order they were deferred, so a swapchain rebuild adding them all again gives the same indices
+void			VkHandler::installDeferredVariants()
+{
+	for (size_t variant = 0; variant < deferredVariants.size(); variant++) {
+		VkPipeline const	pipeline = pendingVariants[variant];
+
+		pendingVariants[variant] = VK_NULL_HANDLE;
+		gfxVariants.add(deferredVariants[variant], [pipeline](VkSpecializationInfo const*) { return pipeline; });
+	}
+	deferredVariants.clear();
+	pendingVariants.clear();
+	destroyGfxState();
+	// Every node goes through its material's bucket again, the recorded ones drew with the variant that draws any
+	recordedMaterialVersion = 0;
+}
+
+void		VkHandler::createVertexBuffer()
+{
+	vertexObjectSize = static_cast<uint32_t>(meshVertices.size());
+	// Also read as plain floats by the mesh shaders
+	transferBufferToGpuStaged((void *)meshVertices.data(), sizeof(meshVertices[0]) * meshVertices.size(), vertexBuffer, vertexBufferMemory, 0, 0,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, K3_MEMORY_CRITICAL);
+}
+
+/* The quad and its subdivided versions share one vertex and one index buffer.
+** The corners come first and draw the coarsest level with the original indices, the finer
+** levels index a grid of the finest subdivision, colors being interpolated from the corners.
+*/
+
+void		VkHandler::createLodMeshes()
+{
+	uint32_t const	gridSize = lodGridSubdivisions[0];
+	uint32_t const	levelCount = sizeof(lodGridSubdivisions) / sizeof(lodGridSubdivisions[0]) + 1;
+	K3LodMesh	mesh = {};
+
+	meshVertices.assign(vertices.begin(), vertices.end());
+	meshIndices.clear();
+	for (uint32_t y = 0; y <= gridSize; y++) {
+		for (uint32_t x = 0; x <= gridSize; x++) {
+			float	u = static_cast<float>(x) / gridSize;
+			float	v = static_cast<float>(y) / gridSize;
+			Vertex	vertex;
+
+			vertex.pos = glm::mix(glm::mix(vertices[0].pos, vertices[1].pos, u), glm::mix(vertices[3].pos, vertices[2].pos, u), v);
+			vertex.color = glm::mix(glm::mix(vertices[0].color, vertices[1].color, u), glm::mix(vertices[3].color, vertices[2].color, u), v);
+			meshVertices.push_back(vertex);
+		}
+	}
+
+	for (uint32_t level = 0; level + 1 < levelCount; level++) {
+		uint32_t const	cells = lodGridSubdivisions[level];
+		uint32_t const	step = gridSize / cells;
+
+		mesh.levels[level].firstIndex = static_cast<uint32_t>(meshIndices.size());
+		for (uint32_t y = 0; y < gridSize; y += step) {
+			for (uint32_t x = 0; x < gridSize; x += step) {
+				uint32_t	i0 = static_cast<uint32_t>(vertices.size() + y * (gridSize + 1) + x);
+				uint32_t	i1 = i0 + step;
+				uint32_t	i2 = i1 + step * (gridSize + 1);
+				uint32_t	i3 = i0 + step * (gridSize + 1);
+
+				meshIndices.insert(meshIndices.end(), { i0, i1, i2, i2, i3, i0 });
+			}
+		}
+		mesh.levels[level].indexCount = static_cast<uint32_t>(meshIndices.size()) - mesh.levels[level].firstIndex;
+		// Flat geometry, the cell size stands for the error so coarse levels win on small quads
+		mesh.levels[level].error = level == 0 ? 0.0f : 1.0f / cells;
+	}
+	mesh.levels[levelCount - 1].firstIndex = static_cast<uint32_t>(meshIndices.size());
+	mesh.levels[levelCount - 1].indexCount = static_cast<uint32_t>(indices.size());
+	mesh.levels[levelCount - 1].error = 1.0f;
+	meshIndices.insert(meshIndices.end(), indices.begin(), indices.end());
+	mesh.levelCount = levelCount;
+	mesh.vertexOffset = 0;
+	mesh.boundingRadius = 0.7071f;
+	optimizeMeshes(mesh);
+	lods.addMesh(mesh);
+}
+
+/* Every level is drawn on its own, each range is ordered for the vertex cache then for
+** overdraw. The vertices are then renumbered in order of first use over the whole index
+** buffer, which changes no range. The cache figures are for the whole buffer.
+*/
+
+void		VkHandler::optimizeMeshes(K3LodMesh const& mesh)
+{
+	uint32_t const		vertexCount = static_cast<uint32_t>(meshVertices.size());
+	std::vector<glm::vec3>	positions(vertexCount);
+	std::vector<uint32_t>	remap;
+	K3VertexCacheStats	before = K3MeshOptimizer::analyzeVertexCache(meshIndices.data(), meshIndices.size(), vertexCount);
+
+	for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+		positions[vertex] = glm::vec3(meshVertices[vertex].pos.x, meshVertices[vertex].pos.y, 0.0f);
+	}
+	for (uint32_t level = 0; level < mesh.levelCount; level++) {
+		uint32_t* const		levelIndices = meshIndices.data() + mesh.levels[level].firstIndex;
+
+		K3MeshOptimizer::optimizeVertexCache(levelIndices, mesh.levels[level].indexCount, vertexCount);
+		K3MeshOptimizer::optimizeOverdraw(levelIndices, mesh.levels[level].indexCount, positions.data(), vertexCount);
+	}
+	K3MeshOptimizer::optimizeVertexFetch(remap, meshIndices.data(), meshIndices.size(), vertexCount);
+	K3MeshOptimizer::remapVertices(meshVertices, remap);
+	meshIndexType = K3MeshOptimizer::packIndices(meshIndexData, meshIndices.data(), meshIndices.size(), vertexCount);
+
+	K3VertexCacheStats	after = K3MeshOptimizer::analyzeVertexCache(meshIndices.data(), meshIndices.size(), vertexCount);
+	std::cerr << "Mesh optimization : ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr
+		<< ", " << (meshIndexType == VK_INDEX_TYPE_UINT16 ? 16 : 32) << " bit indices" << std::endl;
+}
+
+/* Meshlets of every level of detail, from the final index buffer : each level's meshlets
+** are contiguous ranges of its cache optimized indices, which the culling draws as they are.
+** The front faces are clockwise, the cones use the opposite winding. Stored meshlets that
+** still match the index buffer are used instead of building them.
+*/
+
+void		VkHandler::createMeshlets()
+{
+	K3LodMesh const&		mesh = lods.getMesh(0);
+	std::vector<K3MeshletLevel>	levels(mesh.levelCount);
+	K3MeshletMesh			meshletMesh;
+	bool const			loaded = loadMeshlets(meshletMesh, levels);
+
+	if (!loaded) {
+		std::vector<glm::vec3>		positions(meshVertices.size());
+
+		meshletMesh = K3MeshletMesh();
+		for (size_t vertex = 0; vertex < meshVertices.size(); vertex++) {
+			positions[vertex] = glm::vec3(meshVertices[vertex].pos.x, meshVertices[vertex].pos.y, 0.0f);
+		}
+		for (uint32_t level = 0; level < mesh.levelCount; level++) {
+			levels[level].firstIndex = mesh.levels[level].firstIndex;
+			levels[level].firstMeshlet = static_cast<uint32_t>(meshletMesh.getMeshlets().size());
+			levels[level].meshletCount = meshletMesh.append(meshIndices.data(), mesh.levels[level].firstIndex, mesh.levels[level].indexCount,
+				positions.data(), true);
+		}
+	}
+	if (!meshletSavePath.empty()) {
+		std::ofstream	file(meshletSavePath, std::ios::binary);
+
+		if (!file.is_open())
+			throw std::runtime_error("Failed to open " + meshletSavePath + " !");
+		meshletMesh.save(file);
+	}
+	culler.uploadMeshlets(meshletMesh, levels, [this](void const* data, VkDeviceSize const size, VkBuffer& buffer, VkDeviceMemory& memory) {
+		uploadMeshletBuffer(data, size, buffer, memory);
+	});
+	std::cerr << "Meshlet culling : " << culler.getMeshletCount() << " meshlets " << (loaded ? "loaded" : "built") << ", "
+		<< (meshShading ? "mesh shaders" : "compute and indirect draws") << std::endl;
+}
+
+/* Streaming priority, the first to go when a heap is short. The evictor may run on any
+** thread allocating, it only tells the render thread to evict all of the meshlet data.
+*/
+
+void		VkHandler::uploadMeshletBuffer(void const* data, VkDeviceSize const size, VkBuffer& buffer, VkDeviceMemory& memory)
+{
+	transferBufferToGpuStaged(data, size, buffer, memory, 0, 0, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, K3_MEMORY_STREAMING, [this]() {
+		meshletEviction = true;
+	});
+}
+
+/* K3_MESHLET_ASSET from the archive, or as a loose file. Each level's meshlets must cover its
+** index range in order and their local triangles give back the same indices, which leaves
+** out files saved from other meshes. The bounds are taken as they are. False when there is
+** no file or it does not match, the levels are then to be filled by the caller.
+*/
+
+bool		VkHandler::loadMeshlets(K3MeshletMesh& meshletMesh, std::vector<K3MeshletLevel>& levels) const
+{
+	K3LodMesh const&	mesh = lods.getMesh(0);
+	uint32_t const		entry = assets.find(K3_MESHLET_ASSET);
+	std::vector<char>	fileData;
+
+	if (entry != K3_ARCHIVE_NONE)
+		meshletMesh.load(assetData.data() + assetOffsets[entry], static_cast<size_t>(assets.getSize(entry)));
+	else {
+		std::ifstream	file(K3_MESHLET_ASSET, std::ios::ate | std::ios::binary);
+
+		if (!file.is_open())
+			return false;
+		fileData.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(fileData.data(), static_cast<std::streamsize>(fileData.size()));
+		meshletMesh.load(fileData.data(), fileData.size());
+	}
+
+	std::vector<K3Meshlet> const&	meshlets = meshletMesh.getMeshlets();
+	std::vector<uint32_t> const&	meshletVertices = meshletMesh.getVertices();
+	std::vector<uint32_t> const&	meshletTriangles = meshletMesh.getTriangles();
+	uint32_t			next = 0;
+	bool				matching = true;
+
+	for (uint32_t level = 0; level < mesh.levelCount && matching; level++) {
+		uint32_t	index = mesh.levels[level].firstIndex;
+		uint32_t const	end = index + mesh.levels[level].indexCount;
+
+		levels[level].firstIndex = index;
+		levels[level].firstMeshlet = next;
+		while (matching && index < end && next < meshlets.size() && meshlets[next].firstIndex == index) {
+			K3Meshlet const&	meshlet = meshlets[next];
+
+			matching = meshlet.triangleCount > 0 && meshlet.triangleCount * 3 <= end - index;
+			for (uint32_t triangle = 0; matching && triangle < meshlet.triangleCount; triangle++) {
+				uint32_t const	packed = meshletTriangles[meshlet.triangleOffset + triangle];
+
+				for (uint32_t corner = 0; matching && corner < 3; corner++) {
+					uint32_t const	local = (packed >> (corner * 8)) & 0xFF;
+
+					matching = local < meshlet.vertexCount
+						&& meshletVertices[meshlet.vertexOffset + local] == meshIndices[index + triangle * 3 + corner];
+				}
+			}
+			index += meshlet.triangleCount * 3;
+			next++;
+		}
+		matching = matching && index == end;
+		levels[level].meshletCount = next - levels[level].firstMeshlet;
+	}
+	if (matching && next == meshlets.size())
+		return true;
+	std::cerr << "Stored meshlets do not match the meshes, building them again" << std::endl;
+	return false;
+}
+
+// Orthographic for now, one mesh unit at scale 1 covers half the swapchain height
+K3LodView	VkHandler::getLodView() const
+{
+	K3LodView	view;
+
+	view.eye = glm::vec3(0.0f);
+	view.projScale = dispHandler->getScExtent().height * 0.5f;
+	view.perspective = false;
+	return view;
+}
+
+// Clip space is world space until there is a camera, the view looks down +z
+K3MeshletView	VkHandler::getMeshletView() const
+{
+	K3LodView const	lodView = getLodView();
+	K3MeshletView	view;
+
+	view.viewProj = glm::mat4(1.0f);
+	view.eye = lodView.eye;
+	view.direction = glm::vec3(0.0f, 0.0f, 1.0f);
+	view.perspective = lodView.perspective;
+	return view;
+}
+
+// The meshlets' view, the slices cover the clip space depth range
+K3LightView	VkHandler::getLightView() const
+{
+	K3LightView	view;
+
+	view.view = glm::mat4(1.0f);
+	view.proj = glm::mat4(1.0f);
+	view.zNear = 0.0f;
+	view.zFar = 1.0f;
+	view.perspective = false;
+	return view;
+}
+
+void VkHandler::transferBufferToGpuStaged(void const* bufferData, VkDeviceSize const bufferDataSize, VkBuffer& dstBuffer,
+											VkDeviceMemory& dstBufferMemory, int const copySrcOffst, int const copyDstOffst,
+											VkBufferUsageFlags const usage, K3MemoryPriority const priority, K3MemoryBudget::Evictor const& evict)
+{
+	VkBuffer			stagingBuffer;
+	VkDeviceMemory		stagingBufferMem;
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+	VkMemoryRequirements	memRequirements;
+	void*				data;
+
+	createBufferHandle(bufferDataSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, dstBuffer);
+	vkGetBufferMemoryRequirements(gpuDev, dstBuffer, &memRequirements);
+	// When the CPU can write all of the device memory the data goes in place, no staging copy nor submission
+	dstBufferMemory = VK_NULL_HANDLE;
+	if (budget.getDirectMemory() >= K3_DIRECT_REBAR)
+		dstBufferMemory = budget.tryAllocate(memRequirements, K3_MEMORY_DIRECT, priority, evict);
+	if (dstBufferMemory != VK_NULL_HANDLE) {
+		vkBindBufferMemory(gpuDev, dstBuffer, dstBufferMemory, 0);
+		if (vkMapMemory(gpuDev, dstBufferMemory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+			throw std::runtime_error("Failed to map buffer memory !");
+		K3StreamWrite::copy(static_cast<char*>(data) + copyDstOffst, static_cast<char const*>(bufferData) + copySrcOffst, bufferDataSize);
+		K3StreamWrite::fence();
+		vkUnmapMemory(gpuDev, dstBufferMemory);
+		return;
+	}
+	dstBufferMemory = budget.allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, priority, evict);
+	vkBindBufferMemory(gpuDev, dstBuffer, dstBufferMemory, 0);
+
+	createBuffer(bufferDataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMem);
+
+	vkMapMemory(gpuDev, stagingBufferMem, 0, bufferDataSize, 0, &data);
+	memcpy(data, bufferData, (size_t)bufferDataSize);
+	vkUnmapMemory(gpuDev, stagingBufferMem);
+	
+	VkBufferCopy	copyInfo[1] = {};
+	copyInfo[0].srcOffset = copySrcOffst;
+	copyInfo[0].dstOffset = copyDstOffst;
+	copyInfo[0].size = bufferDataSize;
+
+	copyBuffer(stagingBuffer, dstBuffer, copyInfo, 1, VK_NULL_HANDLE);
+
+	vkDestroyBuffer(gpuDev, stagingBuffer, nullptr);
+	budget.free(stagingBufferMem);
+}
+
+
+void VkHandler::createIndexBuffer()
+{
+	transferBufferToGpuStaged((void const*)meshIndexData.data(), meshIndexData.size(), indexBuffer, indexBufferMemory, 0, 0,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT, K3_MEMORY_CRITICAL);
+}
+
+/* One region of K3_MAX_INSTANCES world matrices per swapchain image, persistently mapped.
+** The scene streams its dirty matrices straight into the region of the acquired image.
+*/
+
+void		VkHandler::createInstanceBuffer()
+{
+	uint32_t		regionCount = static_cast<uint32_t>(dispHandler->getImgViews().size());
+	VkDeviceSize		regionSize = K3_MAX_INSTANCES * sizeof(InstanceData);
+
+	instanceData = static_cast<glm::mat4*>(createMappedBuffer(regionSize * regionCount,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instanceBuffer, instanceBufferMemory));
+	// Fresh regions have received nothing yet, the next update copies the whole scene in
+	instanceRegionVersions.assign(regionCount, 0);
+}
+
+void		VkHandler::destroyInstanceBuffer()
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+
+	if (instanceBuffer == VK_NULL_HANDLE)
+		return;
+	vkUnmapMemory(gpuDev, instanceBufferMemory);
+	vkDestroyBuffer(gpuDev, instanceBuffer, nullptr);
+	budget.free(instanceBufferMemory);
+	instanceBuffer = VK_NULL_HANDLE;
+	instanceBufferMemory = VK_NULL_HANDLE;
+	instanceData = nullptr;
+}
+
+/* Indirect draw commands, laid out like the instance buffer : one region per swapchain image.
+** firstInstance selects the node's world matrix, which needs drawIndirectFirstInstance.
+*/
+
+void		VkHandler::createIndirectBuffer()
+{
+	uint32_t		regionCount = static_cast<uint32_t>(dispHandler->getImgViews().size());
+	VkDeviceSize		regionSize = K3_MAX_INSTANCES * sizeof(VkDrawIndexedIndirectCommand);
+
+	indirectDraws = gpu->getEnabledFeatures().drawIndirectFirstInstance == VK_TRUE;
+	if (!indirectDraws)
+		return;
+	indirectData = static_cast<VkDrawIndexedIndirectCommand*>(createMappedBuffer(regionSize * regionCount,
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, indirectBuffer, indirectBufferMemory));
+	indirectRegionVersions.assign(regionCount, 0);
+}
+
+void		VkHandler::destroyIndirectBuffer()
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+
+	indirectRegionVersions.clear();
+	if (indirectBuffer == VK_NULL_HANDLE)
+		return;
+	vkUnmapMemory(gpuDev, indirectBufferMemory);
+	vkDestroyBuffer(gpuDev, indirectBuffer, nullptr);
+	budget.free(indirectBufferMemory);
+	indirectBuffer = VK_NULL_HANDLE;
+	indirectBufferMemory = VK_NULL_HANDLE;
+	indirectData = nullptr;
+}
+
+/* The material table is a single host visible array, entries are only ever appended so the
+** frames in flight never see one change. Material IDs follow the instance buffer layout,
+** one uint per node in a region per swapchain image. Both are reached through bindless slots.
+*/
+
+void		VkHandler::createMaterialBuffers()
+{
+	VkDeviceSize		tableSize = K3_MAX_MATERIALS * sizeof(MaterialData);
+
+	if (!bindlessResources)
+		return;
+	materialTableData = static_cast<MaterialData*>(createMappedBuffer(tableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		materialTableBuffer, materialTableMemory));
+	K3StreamWrite::copy(materialTableData, materials.data(), materials.size() * sizeof(MaterialData));
+	K3StreamWrite::fence();
+	materialTableSlot = bindless.addBuffer(materialTableBuffer);
+	createMaterialIdBuffer();
+}
+
+void		VkHandler::createMaterialIdBuffer()
+{
+	uint32_t		regionCount = static_cast<uint32_t>(dispHandler->getImgViews().size());
+	VkDeviceSize		regionSize = K3_MAX_INSTANCES * sizeof(uint32_t);
+
+	materialIdData = static_cast<uint32_t*>(createMappedBuffer(regionSize * regionCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		materialIdBuffer, materialIdMemory));
+	materialIdSlot = bindless.addBuffer(materialIdBuffer);
+	materialRegionVersions.assign(regionCount, 0);
+}
+
+void		VkHandler::destroyMaterialBuffers()
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+
+	materialRegionVersions.clear();
+	if (materialTableBuffer == VK_NULL_HANDLE)
+		return;
+	vkUnmapMemory(gpuDev, materialTableMemory);
+	vkDestroyBuffer(gpuDev, materialTableBuffer, nullptr);
+	budget.free(materialTableMemory);
+	vkUnmapMemory(gpuDev, materialIdMemory);
+	vkDestroyBuffer(gpuDev, materialIdBuffer, nullptr);
+	budget.free(materialIdMemory);
+	materialTableBuffer = VK_NULL_HANDLE;
+	materialTableMemory = VK_NULL_HANDLE;
+	materialTableData = nullptr;
+	materialIdBuffer = VK_NULL_HANDLE;
+	materialIdMemory = VK_NULL_HANDLE;
+	materialIdData = nullptr;
+}
+
+void		VkHandler::copyBuffer(VkBuffer src, VkBuffer dst, VkBufferCopy *copyInfo, uint32_t copyInfoSize, VkFence fence)
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+
+	VkCommandBufferAllocateInfo		allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = cmdPools[3];
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer		cmdBuff;
+	vkAllocateCommandBuffers(gpuDev, &allocInfo, &cmdBuff);
+
+	VkCommandBufferBeginInfo		beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(cmdBuff, &beginInfo);
+	vkCmdCopyBuffer(cmdBuff, src, dst, copyInfoSize, copyInfo);
+	vkEndCommandBuffer(cmdBuff);
+
+	VkSubmitInfo	submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuff;
+
+	VkQueue const&	transferQueue = gpu->getTransferQueue();
+	vkQueueSubmit(transferQueue, 1, &submitInfo, fence);
+	vkQueueWaitIdle(transferQueue);
+
+	vkFreeCommandBuffers(gpuDev, cmdPools[3], 1, &cmdBuff);
+}
+
+// From the calling thread's pool, on the graphics queue, which only the render thread submits to once it runs
+void		VkHandler::submitGfxCommands(std::function<void(VkCommandBuffer const)> const& record)
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+	VkCommandPool const	pool = getThreadCmdPool();
+
+	VkCommandBufferAllocateInfo		allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = pool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer		cmdBuff;
+	if (vkAllocateCommandBuffers(gpuDev, &allocInfo, &cmdBuff) != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate command buffers");
+
+	VkCommandBufferBeginInfo		beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(cmdBuff, &beginInfo);
+	record(cmdBuff);
+	vkEndCommandBuffer(cmdBuff);
+
+	VkSubmitInfo	submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuff;
+
+	VkQueue const&	gfxQueue = gpu->getGfxQueue();
+	if (vkQueueSubmit(gfxQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		throw std::runtime_error("Failed to submit graphics commands !");
+	vkQueueWaitIdle(gfxQueue);
+
+	vkFreeCommandBuffers(gpuDev, pool, 1, &cmdBuff);
+}
+
+// A new depth pyramid for the scene targets just created
+void		VkHandler::setCullingDepth()
+{
+	culler.setDepth(sceneTargets.isDepthSampled() ? sceneTargets.getDepthView() : VK_NULL_HANDLE, sceneTargets.getSamples(),
+		dispHandler->getScExtent(), [this](std::function<void(VkCommandBuffer const)> const& record) {
+			submitGfxCommands(record);
+		}, retired, frameNumber);
+}
+
+/* Without an evictor the buffer stays until its owner frees it, whatever its priority.
+** An evictor must get rid of the buffer and give the memory back through budget.free().
+*/
+
+void		VkHandler::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+			VkMemoryPropertyFlags memProperties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+			K3MemoryPriority const priority, K3MemoryBudget::Evictor const& evict)
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+
+	createBufferHandle(size, usage, buffer);
+
+	VkMemoryRequirements	memRequirements;
+	vkGetBufferMemoryRequirements(gpuDev, buffer, &memRequirements);
+
+	bufferMemory = budget.allocate(memRequirements, memProperties, priority, evict);
+	vkBindBufferMemory(gpuDev, buffer, bufferMemory, 0);
+}
+
+/* Persistently mapped buffer for what the CPU rewrites every frame, written in place with
+** K3StreamWrite. Device local when the CPU can reach it and the heap has the room (ReBAR,
+** the BAR window, integrated devices), host memory the GPU reads over the bus otherwise.
+*/
+
+void*		VkHandler::createMappedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+	VkMemoryRequirements	memRequirements;
+	void*			data;
+
+	createBufferHandle(size, usage, buffer);
+	vkGetBufferMemoryRequirements(gpuDev, buffer, &memRequirements);
+	bufferMemory = budget.tryAllocate(memRequirements, K3_MEMORY_DIRECT, K3_MEMORY_NORMAL);
+	if (bufferMemory == VK_NULL_HANDLE) {
+		bufferMemory = budget.allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			K3_MEMORY_NORMAL);
+	}
+	vkBindBufferMemory(gpuDev, buffer, bufferMemory, 0);
+	if (vkMapMemory(gpuDev, bufferMemory, 0, size, 0, &data) != VK_SUCCESS)
+		throw std::runtime_error("Failed to map dynamic buffer memory !");
+	return data;
+}
+
+void		VkHandler::createBufferHandle(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer)
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+	uint32_t const*		queuesIndex = gpu->getQueuesIndex();
+
+	VkBufferCreateInfo		bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+
+	// Better have exlusivity then use a barrier in case of a staging buffer
+	uint32_t			sharedFamilies[] = { queuesIndex[1], queuesIndex[3] };
+	if (queuesIndex[1] != queuesIndex[3]) {
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = 2;
+		bufferInfo.pQueueFamilyIndices = sharedFamilies;
+	}
+	else
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	//
+	if (vkCreateBuffer(gpuDev, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create vertex buffer");
+}
+
+void		VkHandler::setSimulation(std::function<void(K3Scene&, double)> const& update, double const timestep)
+{
+	simulation = update;
+	simTimestep = timestep;
+}
+
+// fps <= 0 removes the cap, safe to call while running
+void		VkHandler::setFrameCap(double const fps)
+{
+	pacer.setFrameCap(fps);
+}
+
+K3LatencyStats	VkHandler::getLatencyStats() const
+{
+	return pacer.getStats();
+}
+
+/* Returns the index K3Scene::setMaterial takes. Before run() or from the simulation only,
+** the material is ignored unless the renderer ended up bindless (isBindless()).
+*/
+
+uint32_t	VkHandler::createMaterial(glm::vec4 const& color, uint32_t const texture)
+{
+	MaterialData	material = {};
+
+	if (materials.size() >= K3_MAX_MATERIALS)
+		throw std::runtime_error("Too many materials !");
+	material.color = color;
+	material.texture = texture;
+	materials.push_back(material);
+	materialConstants[materials.size() - 1].textured = texture != K3_BINDLESS_NONE ? VK_TRUE : VK_FALSE;
+	scene.setMaterialCount(static_cast<uint32_t>(materials.size()));
+	if (capture.isOpen())
+		capture.createMaterial(color, texture != K3_BINDLESS_NONE);
+	if (materialTableData) {
+		K3StreamWrite::store(&materialTableData[materials.size() - 1], material);
+		K3StreamWrite::fence();
+	}
+	return static_cast<uint32_t>(materials.size() - 1);
+}
+
+// Textures for the materials are registered here, the slot goes in createMaterial
+K3Bindless&	VkHandler::getBindless()
+{
+	return bindless;
+}
+
+// Per heap budget and usage, also reported to the profiler every frame
+K3MemoryBudget&	VkHandler::getMemoryBudget()
+{
+	return budget;
+}
+
+bool		VkHandler::isBindless() const
+{
+	return bindlessResources;
+}
+
+// Before run(), lowered to what the device supports, VK_SAMPLE_COUNT_1_BIT turns MSAA off
+void		VkHandler::setMsaaSamples(VkSampleCountFlagBits const samples)
+{
+	msaaSamples = samples;
+}
+
+/* GPU frame time (ms) the scene resolution is scaled to stay under, 0 renders at the output
+** size. Before run() only. Needs post processing, which upscales the scene, and timestamps.
+*/
+
+void		VkHandler::setDynamicResolution(double const targetMs)
+{
+	dynamicResolution.setTarget(targetMs);
+}
+
+/* Presents locked to the display's vblank, which the frame pacer then starts the frames
+** against. Without it the swapchain presents immediately when it can and the pacer only
+** caps the rate. Before run() only.
+*/
+
+void		VkHandler::setDisplaySync(bool const sync)
+{
+	dispHandler->setPresentSync(sync);
+}
+
+/* Records what the simulation does to the scene and the materials, one capture frame per
+** publication, for K3_bench --replay. Same rules as createMaterial : before run() or from
+** the simulation. The current materials and scene are recorded first.
+*/
+
+void		VkHandler::startCapture(std::string const& path)
+{
+	stopCapture();
+	capture.open(path);
+	for (size_t i = 1; i < materials.size(); i++)
+		capture.createMaterial(materials[i].color, materials[i].texture != K3_BINDLESS_NONE);
+	scene.setCapture(&capture);
+}
+
+void		VkHandler::stopCapture()
+{
+	scene.setCapture(nullptr);
+	capture.close();
+}
+
+void		VkHandler::saveMeshlets(std::string const& path)
+{
+	meshletSavePath = path;
+}
+
+void		VkHandler::simulate(double const dt)
+{
+	if (simulation)
+		simulation(scene, dt);
+	simTick++;
+}
+
+// Simulation side of the handoff, the scene itself never leaves the simulation thread
+void		VkHandler::publishScene()
+{
+	K3SceneSnapshot&	snapshot = sceneSnapshots.getWriteSlot();
+
+	scene.writeSnapshot(snapshot);
+	snapshot.tick = simTick;
+	// Nothing polled yet (benchmarks drive the scene directly), the state is as fresh as its publication
+	snapshot.inputTime = lastInputTime != std::chrono::steady_clock::time_point() ? lastInputTime : snapshot.publishTime;
+	sceneSnapshots.publish();
+	if (capture.isOpen())
+		capture.frame();
+}
+
+/* The main thread owns GLFW, the input and the simulation, the render thread only sees
+** the scene through the snapshots. Events are polled right before every step so each
+** step works with the freshest input, and the thread sleeps in glfwWaitEventsTimeout
+** until the next step is due.
+*/
+
+void		VkHandler::mainLoop()
+{
+	typedef std::chrono::steady_clock	Clock;
+
+	K3FrameArena&		frameArena = K3FrameArena::getThreadArena();
+	Clock::time_point	previous = Clock::now();
+	double			accumulator = 0.0;
+
+	// Everything allocated from the arena during initialization dies here
+	frameArena.reset();
+	running = true;
+	std::thread		renderThread(&VkHandler::renderLoop, this);
+
+	while (running && !glfwWindowShouldClose(dispHandler->getWindow())) {
+		Clock::time_point	now = Clock::now();
+		double			elapsed = std::chrono::duration<double>(now - previous).count();
+
+		uint32_t		steps = 0;
+
+		previous = now;
+		if (simTimestep <= 0.0) {
+			glfwPollEvents();
+			lastInputTime = Clock::now();
+			simulate(elapsed);
+			steps++;
+		}
+		else {
+			accumulator += elapsed;
+			while (accumulator >= simTimestep && steps < K3_SIM_MAX_STEPS) {
+				glfwPollEvents();
+				lastInputTime = Clock::now();
+				simulate(simTimestep);
+				accumulator -= simTimestep;
+				steps++;
+			}
+			if (steps == K3_SIM_MAX_STEPS)
+				accumulator = 0.0;
+		}
+		if (steps > 0)
+			publishScene();
+		frameArena.reset();
+		if (simTimestep > 0.0 && accumulator < simTimestep)
+			glfwWaitEventsTimeout(simTimestep - accumulator);
+	}
+	running = false;
+	renderThread.join();
+	if (renderError)
+		std::rethrow_exception(renderError);
+}
+
+void		VkHandler::renderLoop()
+{
+	K3FrameArena&		frameArena = K3FrameArena::getThreadArena();
+
+	try {
+		K3JobSystem::getInstance().registerThread();
+		while (running) {
+			profiler.beginFrame();
+			drawFrame();
+			profiler.reportAllocator("render frame arena", frameArena.getStats());
+			frameArena.reset();
+			profiler.endFrame();
+		}
+		vkDeviceWaitIdle(gpu->getLogicalDevice());
+	}
+	catch (...) {
+		renderError = std::current_exception();
+		running = false;
+	}
+}
+
+void		VkHandler::createSyncObjects()
+{
+	VkDevice const&	gpuDev = gpu->getLogicalDevice();
+
+	VkSemaphoreCreateInfo			semInfo = {};
+	semInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	// Signaled from the start, the first wait on every slot returns right away
+	VkFenceCreateInfo			fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	for (uint32_t i = 0; i < K3_MAX_FRAMES_IN_FLIGHT; i++) {
+		if (vkCreateSemaphore(gpuDev, &semInfo, nullptr, &semImgAvailable[i]) != VK_SUCCESS ||
+			vkCreateSemaphore(gpuDev, &semInfo, nullptr, &semSceneDone[i]) != VK_SUCCESS ||
+			vkCreateFence(gpuDev, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create frame synchronization objects !");
+		}
+	}
+}
+
+void		VkHandler::createImageSemaphores()
+{
+	VkDevice const&	gpuDev = gpu->getLogicalDevice();
+	size_t const	imgCount = dispHandler->getImgViews().size();
+
+	VkSemaphoreCreateInfo			semInfo = {};
+	semInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semRenderFinished.resize(imgCount);
+	for (size_t i = 0; i < imgCount; i++) {
+		if (vkCreateSemaphore(gpuDev, &semInfo, nullptr, &semRenderFinished[i]) != VK_SUCCESS)
+			throw std::runtime_error("failed to create semaphores!");
+	}
+	imagesInFlight.assign(imgCount, VK_NULL_HANDLE);
+}
+
+/* Up to K3_MAX_FRAMES_IN_FLIGHT frames are recorded ahead of the GPU, each slot having its
+** own fence and acquire semaphore. With post processing a frame is two submissions : the
+** scene on the graphics queue, then the post chain on the compute queue, which runs while
+** the graphics queue already renders the next frame. Objects a pending frame may still use (old swapchains,
+** command buffers, buffers) go through the retired queue instead of idling the device.
+** The swapchain is rebuilt at the start of a frame once it was reported out of date or
+** suboptimal, or the window was resized. A minimized window skips frames.
+*/
+
+void		VkHandler::drawFrame()
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+	uint32_t const		frameSlot = static_cast<uint32_t>(frameNumber % K3_MAX_FRAMES_IN_FLIGHT);
+	uint32_t		imgIndex;
+	VkResult		scState;
+
+	if (dispHandler->consumeResize() || resizeRequested.exchange(false))
+		swapchainOutdated = true;
+	if (swapchainOutdated && !recreateSwapChain()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(K3_MINIMIZED_POLL_MS));
+		return;
+	}
+
+	// The slot's previous frame is done, and with it every frame before
+	vkWaitForFences(gpuDev, 1, &inFlightFences[frameSlot], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	completeFrame(frameSlot, false);
+	retired.flush(frameNumber + 1 >= K3_MAX_FRAMES_IN_FLIGHT ? frameNumber + 1 - K3_MAX_FRAMES_IN_FLIGHT : 0);
+	profiler.setCounter("retired objects", static_cast<double>(retired.getPendingCount()));
+	updateRenderScale(frameSlot);
+	// Lazy startup steps tied to the render thread run here, between two frames
+	if (lazyStartup.poll() && !lazyStartupReported) {
+		lazyStartupReported = true;
+		lazyStartup.print(std::cerr);
+	}
+	// After the flush, memory retired a frame ago is back in the budget
+	budget.update(frameNumber);
+	budget.report(profiler);
+	profiler.setCounter("memory evictions", budget.getEvictedCount());
+	updateMeshletResidency();
+	if (bindlessResources) {
+		profiler.setCounter("bindless textures", bindless.getUsedCount(K3_BINDLESS_TEXTURE));
+		profiler.setCounter("bindless buffers", bindless.getUsedCount(K3_BINDLESS_BUFFER));
+	}
+
+	// Sleeps until the latest start that still makes the next vblank, or the frame cap allows
+	pacer.beginFrame();
+	profiler.setCounter("pacing sleep ms", pacer.getLastFrame().sleep);
+	scState = vkAcquireNextImageKHR(gpuDev, dispHandler->getSwapchain(), std::numeric_limits<uint64_t>::max(),
+									semImgAvailable[frameSlot], VK_NULL_HANDLE, &imgIndex);
+	if (scState == VK_ERROR_OUT_OF_DATE_KHR) {
+		swapchainOutdated = true;
+		return;
+	}
+	if (scState != VK_SUCCESS && scState != VK_SUBOPTIMAL_KHR)
+		throw std::runtime_error("Failed to acquire swapchain image !");
+	// A suboptimal image is still acquired and its semaphore signaled, it is drawn before rebuilding
+	if (scState == VK_SUBOPTIMAL_KHR)
+		swapchainOutdated = true;
+	// The other slot may still be rendering to this image
+	if (imagesInFlight[imgIndex] != VK_NULL_HANDLE)
+		vkWaitForFences(gpuDev, 1, &imagesInFlight[imgIndex], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	imagesInFlight[imgIndex] = inFlightFences[frameSlot];
+
+	// Latched after the acquire returned, the frame shows the newest simulation state possible
+	K3SceneSnapshot const&	snapshot = sceneSnapshots.acquire();
+
+	snapshot.copyToRegion(instanceData + imgIndex * K3_MAX_INSTANCES, instanceRegionVersions[imgIndex], K3_MAX_INSTANCES);
+	if (bindlessResources)
+		snapshot.copyMaterialsToRegion(materialIdData + imgIndex * K3_MAX_INSTANCES, materialRegionVersions[imgIndex], K3_MAX_INSTANCES);
+	if (clusteredLighting) {
+		lightClusters.update(imgIndex, snapshot, getLightView(), getRenderExtent());
+		profiler.setCounter("lights", lightClusters.getLightCount());
+	}
+	profiler.setCounter("transforms updated", snapshot.updatedCount);
+	profiler.setCounter("sim steps", static_cast<double>(snapshot.tick - renderedTick));
+	profiler.setCounter("snapshot age ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - snapshot.publishTime).count());
+	renderedTick = snapshot.tick;
+	lods.select(snapshot.worlds.data(), snapshot.nodeCount, getLodView());
+	profiler.setCounter("lod changes", lods.getChangedCount());
+	profiler.setCounter("triangles", static_cast<double>(lods.getTriangleCount()));
+
+	// Nodes were added or given another material since the buckets were recorded, or a baked selection is stale
+	if (std::min(snapshot.nodeCount, static_cast<uint32_t>(K3_MAX_INSTANCES)) != recordedInstanceCount
+		|| (!indirectDraws && lods.getChangedCount() > 0) || snapshot.materialVersion != recordedMaterialVersion)
+		updateBuckets();
+	recordedBuckets = 0;
+	if (cmdCache.isStale()) {
+		retireCmdBuffers();
+		createCmdBuffers();
+	}
+	profiler.setCounter("buckets recorded", recordedBuckets);
+	profiler.setCounter("pipeline binds", recordedBinds.pipelineBinds);
+	profiler.setCounter("vertex buffer binds", recordedBinds.vertexBinds);
+	profiler.setCounter("index buffer binds", recordedBinds.indexBinds);
+	profiler.setCounter("pipeline binds in node order", nodeOrderPipelineBinds);
+	if (indirectDraws)
+		lods.writeCommands(indirectData + imgIndex * K3_MAX_INSTANCES, indirectRegionVersions[imgIndex], K3_MAX_INSTANCES);
+
+	VkSubmitInfo	submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+	VkSemaphore				waitSem[] = { semImgAvailable[frameSlot] };
+	VkPipelineStageFlags	waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.pWaitSemaphores = waitSem;
+	submitInfo.pWaitDstStageMask = waitStages;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuffers[imgIndex];
+	VkSemaphore				sigSem[] = { semRenderFinished[imgIndex] };
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = sigSem;
+
+	vkResetFences(gpuDev, 1, &inFlightFences[frameSlot]);
+	slotImages[frameSlot] = imgIndex;
+	if (postProcessing) {
+		// The scene pass never touches the swapchain image, only the final copy waits for the acquire
+		VkSemaphore				computeWaitSem[] = { semSceneDone[frameSlot], semImgAvailable[frameSlot] };
+		VkPipelineStageFlags	computeWaitStages[] = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT };
+		VkSubmitInfo			computeInfo = {};
+
+		submitInfo.waitSemaphoreCount = 0;
+		submitInfo.pSignalSemaphores = &semSceneDone[frameSlot];
+		if (vkQueueSubmit(gpu->getGfxQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+			throw std::runtime_error("Failed to submit draw command buffer !");
+		// The fence covers the graphics work too, the compute work waits on it
+		computeInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		computeInfo.waitSemaphoreCount = 2;
+		computeInfo.pWaitSemaphores = computeWaitSem;
+		computeInfo.pWaitDstStageMask = computeWaitStages;
+		computeInfo.commandBufferCount = 1;
+		computeInfo.pCommandBuffers = &post.getCommandBuffer(imgIndex);
+		computeInfo.signalSemaphoreCount = 1;
+		computeInfo.pSignalSemaphores = sigSem;
+		if (vkQueueSubmit(gpu->getComputeQueue(), 1, &computeInfo, inFlightFences[frameSlot]) != VK_SUCCESS)
+			throw std::runtime_error("Failed to submit post processing command buffer !");
+	}
+	else if (vkQueueSubmit(gpu->getGfxQueue(), 1, &submitInfo, inFlightFences[frameSlot]) != VK_SUCCESS)
+		throw std::runtime_error("Failed to submit draw command buffer !");
+
+	// PRESENTATION
+	VkPresentInfoKHR		presentInfo = {};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = sigSem;
+	presentInfo.pImageIndices = &imgIndex;
+
+	VkSwapchainKHR			scPresent[] = { dispHandler->getSwapchain() };
+	presentInfo.swapchainCount = 1;
+	presentInfo.pSwapchains = scPresent;
+
+	presentId++;
+#ifdef VK_KHR_present_wait
+	VkPresentIdKHR			presentIdInfo = {};
+
+	if (vkWaitForPresent) {
+		presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		presentIdInfo.swapchainCount = 1;
+		presentIdInfo.pPresentIds = &presentId;
+		presentInfo.pNext = &presentIdInfo;
+	}
+#endif
+	pacer.frameSubmitted(presentId, snapshot.inputTime);
+	scState = vkQueuePresentKHR(gpu->getPresentQueue(), &presentInfo);
+	framePresentIds[frameSlot] = presentId;
+	frameNumber++;
+	if (scState == VK_ERROR_OUT_OF_DATE_KHR || scState == VK_SUBOPTIMAL_KHR)
+		swapchainOutdated = true;
+	else if (scState != VK_SUCCESS)
+		throw std::runtime_error("Failed to present swapchain image !");
+	if (scState != VK_ERROR_OUT_OF_DATE_KHR)
+		completeFrame(frameSlot, true);
+	if (frameNumber == 1)
+		firstFramePresented();
+}
+
+/* Reports a frame to the pacer once its GPU work is done. With present wait, and while the
+** pacer has a cap or a display period to start frames against, the frame is waited for
+** right after its present : a single frame in flight is what keeps the input latency down.
+** Otherwise it is reported when its slot comes around again, the end of the GPU work
+** standing in for the present, and frames in flight overlap.
+*/
+
+void		VkHandler::completeFrame(uint32_t const frameSlot, bool const waitPresent)
+{
+	uint64_t const	id = framePresentIds[frameSlot];
+	bool		presentWait = false;
+	bool		measured = false;
+
+#ifdef VK_KHR_present_wait
+	presentWait = waitPresent && vkWaitForPresent && pacer.isPacing();
+#endif
+	if (id == 0 || waitPresent != presentWait)
+		return;
+	framePresentIds[frameSlot] = 0;
+	vkWaitForFences(gpu->getLogicalDevice(), 1, &inFlightFences[frameSlot], VK_TRUE, std::numeric_limits<uint64_t>::max());
+	pacer.frameWorkDone(id, std::chrono::steady_clock::now());
+#ifdef VK_KHR_present_wait
+	if (presentWait) {
+		VkResult	result = vkWaitForPresent(gpu->getLogicalDevice(), dispHandler->getSwapchain(), id, K3_PRESENT_WAIT_TIMEOUT);
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+			swapchainOutdated = true;
+		measured = result == VK_SUCCESS;
+	}
+#endif
+	pacer.framePresented(id, std::chrono::steady_clock::now(), measured);
+
+	K3FrameTiming const&	timing = pacer.getLastFrame();
+
+	profiler.setCounter("input latency ms", timing.inputToPresent);
+	profiler.setCounter("frame latency ms", timing.startToPresent);
+}
+
+// Picked up by the render thread at its next frame, or applied right away when nothing renders
+void		VkHandler::resizeWindow(const int newSizeX, const int newSizeY, const bool fullscreen)
+{
+	dispHandler->resizeWindow(newSizeX, newSizeY, fullscreen);
+	if (running)
+		resizeRequested = true;
+	else
+		recreateSwapChain();
+}
+
+/* Builds the new swapchain from the old one, which lets the implementation hand over its
+** resources, then retires the old one with everything that referenced its images. The
+** pipeline uses a dynamic viewport and survives the resize, the render pass is only
+** rebuilt if the surface format changed, or if the post processing can no longer write to
+** the new images : the scene is then drawn to them directly from this frame on. Returns
+** false while there is nothing to draw to.
+*/
+
+bool		VkHandler::recreateSwapChain()
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+	VkSwapchainKHR const	oldSwapchain = dispHandler->getSwapchain();
+	VkFormat const		oldFormat = dispHandler->getScImgFormat();
+
+	if (!dispHandler->hasDrawableExtent(gpu->getPhysicalDevice())) {
+		swapchainOutdated = true;
+		return false;
+	}
+	dispHandler->createSwapchain(oldSwapchain, gpu->getPhysicalDevice(), gpuDev, gpu->getQueuesIndex());
+	retireSwapChainAssets(oldSwapchain);
+	dispHandler->createImgViews(gpuDev);
+	bool const		postLost = postProcessing
+		&& !K3PostProcess::isSupported(gpu->getPhysicalDevice(), dispHandler->getScImgFormat(), dispHandler->getScImgUsage(), assets);
+
+	if (postLost) {
+		std::cerr << "New swapchain does not support post processing, drawing to it directly" << std::endl;
+		postProcessing = false;
+	}
+	// The post processing scene target keeps its format whatever the swapchain's
+	if (postLost || (!postProcessing && dispHandler->getScImgFormat() != oldFormat)) {
+		VkRenderPass		oldRenderPass = renderPass;
+		VkPipeline		oldMeshPipeline = meshPipeline;
+		VkPipelineLayout	oldLayout = pipelineLayout;
+
+		// The deferred variants are built from the state about to be replaced, they go in first
+		if (lazyStartup.isStarted())
+			lazyStartup.run();
+		// Added again in the same order, the sort keys keep their pipeline bits
+		gfxVariants.retire(retired, frameNumber);
+		retired.push(frameNumber, [gpuDev, oldRenderPass, oldMeshPipeline, oldLayout]() {
+			vkDestroyPipeline(gpuDev, oldMeshPipeline, nullptr);
+			vkDestroyPipelineLayout(gpuDev, oldLayout, nullptr);
+			vkDestroyRenderPass(gpuDev, oldRenderPass, nullptr);
+		});
+		createRenderPass();
+		createGFXPipeline();
+	}
+	sceneTargets.create(dispHandler->getScExtent(), postProcessing ? K3_POST_HDR_FORMAT : dispHandler->getScImgFormat());
+	if (meshletCulling)
+		setCullingDepth();
+	if (K3GpuTimer::isSupported(gpu->getPhysicalDevice()))
+		gpuTimer.create(static_cast<uint32_t>(dispHandler->getImgViews().size()));
+	std::fill(std::begin(slotImages), std::end(slotImages), K3_NO_IMAGE);
+	// The render scale carries over, applied to the new extent
+	if (postProcessing) {
+		post.createTargets(renderPass, sceneTargets, dispHandler->getScExtent(), dispHandler->getImages(), dispHandler->getScImgFormat());
+		post.setRenderExtent(getRenderExtent(), retired, frameNumber);
+	}
+	else
+		dispHandler->createFrameBuffers(gpuDev, renderPass, sceneTargets);
+	// Regions are per image, a larger swapchain needs larger buffers, a smaller one leaves some unused
+	if (dispHandler->getImgViews().size() > instanceRegionVersions.size()) {
+		retireBuffer(instanceBuffer, instanceBufferMemory);
+		instanceData = nullptr;
+		createInstanceBuffer();
+		retireBuffer(indirectBuffer, indirectBufferMemory);
+		indirectData = nullptr;
+		createIndirectBuffer();
+		if (meshletCulling) {
+			culler.setInputs(indirectBuffer, instanceBuffer, vertexBuffer, static_cast<uint32_t>(dispHandler->getImgViews().size()),
+				retired, frameNumber);
+		}
+		if (bindlessResources) {
+			bindless.release(K3_BINDLESS_BUFFER, materialIdSlot, retired, frameNumber);
+			retireBuffer(materialIdBuffer, materialIdMemory);
+			materialIdData = nullptr;
+			createMaterialIdBuffer();
+		}
+		if (clusteredLighting)
+			lightClusters.setRegionCount(static_cast<uint32_t>(dispHandler->getImgViews().size()), retired, frameNumber);
+	}
+	createImageSemaphores();
+	createCmdBuffers();
+	swapchainOutdated = false;
+	return true;
+}
+
+/* Hands the old swapchain's framebuffers, views, post processing targets and command
+** buffers to the retired queue, they are free once the frames in flight are done. The
+** present semaphores go with the swapchain itself which, with present wait, also waits for
+** its last present to reach the screen. Without it the frames in flight are the only bound.
+*/
+
+void		VkHandler::retireSwapChainAssets(VkSwapchainKHR const oldSwapchain)
+{
+	VkDevice const				gpuDev = gpu->getLogicalDevice();
+	std::vector<VkFramebuffer>		framebuffers = dispHandler->getFramebuffers();
+	std::vector<VkImageView>		views = dispHandler->getImgViews();
+	std::vector<VkSemaphore>		semaphores;
+	std::function<bool()>			presented;
+
+	semaphores.swap(semRenderFinished);
+	retired.push(frameNumber, [gpuDev, framebuffers, views]() {
+		for (VkFramebuffer framebuffer : framebuffers)
+			vkDestroyFramebuffer(gpuDev, framebuffer, nullptr);
+		for (VkImageView view : views)
+			vkDestroyImageView(gpuDev, view, nullptr);
+	});
+	post.retireTargets(retired, frameNumber);
+	sceneTargets.retire(retired, frameNumber);
+	gpuTimer.retire(retired, frameNumber);
+	retireCmdBuffers();
+	cmdCache.retire(retired, frameNumber);
+#ifdef VK_KHR_present_wait
+	if (vkWaitForPresent && presentId > 0) {
+		PFN_vkWaitForPresentKHR		waitForPresent = vkWaitForPresent;
+		uint64_t const			lastPresent = presentId;
+
+		presented = [gpuDev, oldSwapchain, waitForPresent, lastPresent]() {
+			return waitForPresent(gpuDev, oldSwapchain, lastPresent, 0) != VK_TIMEOUT;
+		};
+	}
+#endif
+	retired.push(frameNumber, [gpuDev, oldSwapchain, semaphores]() {
+		for (VkSemaphore semaphore : semaphores)
+			vkDestroySemaphore(gpuDev, semaphore, nullptr);
+		vkDestroySwapchainKHR(gpuDev, oldSwapchain, nullptr);
+	}, presented);
+}
+
+void		VkHandler::retireCmdBuffers()
+{
+	VkDevice const			gpuDev = gpu->getLogicalDevice();
+	std::vector<VkCommandBuffer>	buffers;
+	std::vector<VkCommandPool>	pools;
+
+	buffers.swap(cmdBuffers);
+	pools.swap(cmdBufferPools);
+	retired.push(frameNumber, [gpuDev, buffers, pools]() {
+		for (size_t i = 0; i < buffers.size(); i++)
+			vkFreeCommandBuffers(gpuDev, pools[i], 1, &buffers[i]);
+	});
+}
+
+void		VkHandler::retireBuffer(VkBuffer& buffer, VkDeviceMemory& memory)
+{
+	VkDevice const		gpuDev = gpu->getLogicalDevice();
+	VkBuffer const		oldBuffer = buffer;
+	VkDeviceMemory const	oldMemory = memory;
+
+	if (buffer == VK_NULL_HANDLE)
+		return;
+	retired.push(frameNumber, [this, gpuDev, oldBuffer, oldMemory]() {
+		vkUnmapMemory(gpuDev, oldMemory);
+		vkDestroyBuffer(gpuDev, oldBuffer, nullptr);
+		budget.free(oldMemory);
+	});
+	buffer = VK_NULL_HANDLE;
+	memory = VK_NULL_HANDLE;
+}
+
+void		VkHandler::cleanupSwapChainAssets()
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+
+	dispHandler->destroyFramebuffers(gpuDev);
+	sceneTargets.destroy();
+	freeCmdBuffers();
+	gfxVariants.destroy();
+	vkDestroyPipeline(gpuDev, meshPipeline, nullptr);
+	vkDestroyPipelineLayout(gpuDev, pipelineLayout, nullptr);
+	vkDestroyRenderPass(gpuDev, renderPass, nullptr);
+	dispHandler->destroyImgViews(gpuDev);
+}
+
+void		VkHandler::terminateVulkan()
+{
+	VkDevice const&		gpuDev = gpu->getLogicalDevice();
+
+	// Lazy startup steps may still be compiling, what they left uninstalled goes with them
+	lazyStartup.cancel();
+	for (VkPipeline pipeline : pendingVariants)
+		vkDestroyPipeline(gpuDev, pipeline, nullptr);
+	pendingVariants.clear();
+	destroyGfxState();
+	// The device is idle by now, whatever was retired can go
+	retired.flushAll();
+	post.destroy();
+	gpuTimer.destroy();
+	cleanupSwapChainAssets();
+	culler.destroy();
+	dispHandler->destroySwapchain(gpuDev);
+	vkDestroyBuffer(gpuDev, vertexBuffer, nullptr);
+	budget.free(vertexBufferMemory);
+	vkDestroyBuffer(gpuDev, indexBuffer, nullptr);
+	budget.free(indexBufferMemory);
+	destroyInstanceBuffer();
+	destroyIndirectBuffer();
+	destroyMaterialBuffers();
+	lightClusters.destroy();
+	bindless.destroy();
+	assets.close();
+	if (enableValidationLayers) {
+		DestroyDebugReportCallbackEXT(instance, callback, nullptr);
+	}
+	for (VkSemaphore semaphore : semRenderFinished) {
+		vkDestroySemaphore(gpuDev, semaphore, nullptr);
+	}
+	for (uint32_t i = 0; i < K3_MAX_FRAMES_IN_FLIGHT; i++) {
+		vkDestroySemaphore(gpuDev, semImgAvailable[i], nullptr);
+		vkDestroySemaphore(gpuDev, semSceneDone[i], nullptr);
+		vkDestroyFence(gpuDev, inFlightFences[i], nullptr);
+	}
+	for (size_t i = 0; i < 4; i++) {
+		vkDestroyCommandPool(gpuDev, cmdPools[i], nullptr);
+	}
+	for (VkCommandPool pool : threadCmdPools) {
+		vkDestroyCommandPool(gpuDev, pool, nullptr);
+	}
+	dispHandler->destroySurface(instance);
+	vkDestroyDevice(gpuDev, nullptr);
+	vkDestroyInstance(instance, nullptr);
 }
\ No newline at end of file
@@ -1,115 +1,409 @@
-#pragma once
-
-#include "K3Vk.h"
-#include "VkGPU.h"
-#include "VkDisplayHandler.h"
-#define NB_QUEUES 4
-
-struct Vertex
-{
-	glm::vec2	pos;
-	glm::vec3	color;
-
-	static		VkVertexInputBindingDescription		getBindingDescription() {
-		VkVertexInputBindingDescription	bindingDescription = {};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return bindingDescription;
-	}
-
-	static		std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
-		
-		std::array<VkVertexInputAttributeDescription, 2>		attributeDescriptions = {};
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-		return attributeDescriptions;
-	}
-};
-
-const std::vector<Vertex> vertices = {
-	{ { -0.5f, -0.5f },{ 1.0f, 0.0f, 0.0f } },
-	{ { 0.5f, -0.5f },{ 0.0f, 1.0f, 0.0f } },
-	{ { 0.5f, 0.5f },{ 0.0f, 0.0f, 1.0f } },
-	{ { -0.5f, 0.5f },{ 1.0f, 1.0f, 1.0f } }
-};
-
-const std::vector<uint16_t>		indices = {
-	0, 1, 2, 2, 3, 0
-};
-
-class VkHandler {
-	friend class VkGPU;
-
-public:
-	void				run();
-	void				terminate();
-	void				resizeWindow(const int newSizeX, const int newSizeY, const bool fullscreen);
-	static uint32_t			findMemoryType(VkPhysicalDevice physicalGPU, uint32_t typeFilter, VkMemoryPropertyFlags properties);
-
-	VkHandler() {
-		initSubClasses();
-	}
-	~VkHandler() {
-		delete dispHandler;
-		delete gpu;
-	}
-
-private:
-	
-	void				initSubClasses();
-	void				initVulkan();
-	void				mainLoop();
-	void				createInstance();
-	bool				checkValidationLayerSupport();
-	std::vector<const char *>	getGlfwRequiredExtensions();
-	void				setupDebugCallback();
-	void				terminateVulkan();
-	char*				getMissingQueue(VkQueueFlags);
-	void				createRenderPass();
-	void				createGFXPipeline();
-	void				createCmdPool();
-	void				createCmdBuffers();
-	void				createSemaphores();
-	void				createVertexBuffer();
-	void				createIndexBuffer();
-	void				copyBuffer(VkBuffer src, VkBuffer dst, VkBufferCopy *copyInfo, uint32_t copyInfoSize, VkFence fence);
-	void				createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProperties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-	void				recreateSwapChain();
-	void				cleanupSwapChainAssets();
-	void				drawFrame();
-	VkShaderModule			createShaderModuleFromSrc(const std::string& filename);
-	void				DestroyDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackEXT callback, const VkAllocationCallbacks* pAllocator);
-	VkResult			CreateDebugReportCallbackEXT(VkInstance instance, const VkDebugReportCallbackCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugReportCallbackEXT* pCallback);
-	void				transferBufferToGpuStaged(void const* bufferDataVkBuffer, VkDeviceSize const bufferDataSize, VkBuffer& dstBuffer, VkDeviceMemory& dstBufferMemory, int const copySrcOffst, int const copyDstOffst);
-	
-	////////////////////////////////////
-	// VARIABLES
-	////////////////////////////////////
-
-
-	VkInstance			instance;
-	VkDebugReportCallbackEXT	callback;
-	VkDisplayHandler		*dispHandler;
-	VkGPU				*gpu;
-	VkRenderPass			renderPass;
-	VkPipelineLayout		pipelineLayout;
-	VkPipeline			gfxPipeline;
-	VkCommandPool			cmdPools[4];
-	std::vector<VkCommandBuffer>	cmdBuffers;
-	VkSemaphore			semImgAvailable;
-	VkSemaphore			semRenderFinished;
-	VkBuffer			vertexBuffer;
-	VkDeviceMemory			vertexBufferMemory;
-	uint32_t			vertexObjectSize;
-	VkBuffer			indexBuffer;
-	VkDeviceMemory			indexBufferMemory;
-
-};
+#pragma once
+
+#include "K3Vk.h"
+#include "VkGPU.h"
+#include "VkDisplayHandler.h"
+#include "K3Scene.h"
+#include "K3Lod.h"
+#include "K3TripleBuffer.h"
+#include "K3JobSystem.h"
+#include "K3FramePacer.h"
+#include "K3DeletionQueue.h"
+#include "K3PostProcess.h"
+#include "K3Bindless.h"
+#include "K3RenderQueue.h"
+#include "K3MeshOptimizer.h"
+#include "K3MeshletCuller.h"
+#include "K3LightClusters.h"
+#include "K3MemoryBudget.h"
+#include "K3CommandCache.h"
+#include "K3Specialization.h"
+#include "K3ShaderLayout.h"
+#include "K3SceneTargets.h"
+#include "K3GpuTimer.h"
+#include "K3DynamicResolution.h"
+#include "K3Archive.h"
+#include "K3StartupGraph.h"
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <memory>
+#define NB_QUEUES 4
+
+// Simulation rate, 0 runs one variable length update per loop instead of fixed steps
+#define K3_SIM_TIMESTEP		(1.0 / 120.0)
+// Steps run at most per loop, a slower simulation drops time rather than falling further behind
+#define K3_SIM_MAX_STEPS	8
+// Frames the CPU may record ahead of the GPU
+#define K3_MAX_FRAMES_IN_FLIGHT	2
+// Render thread sleep while the window has no drawable area
+#define K3_MINIMIZED_POLL_MS	16
+// Longest wait for a present to reach the screen (ns) before the frame counts as unmeasured
+#define K3_PRESENT_WAIT_TIMEOUT	100000000ull
+// Entries of the material table read by the bindless shaders
+#define K3_MAX_MATERIALS	4096
+// No swapchain image, for the slots without a frame to read the timestamps of
+#define K3_NO_IMAGE		0xFFFFFFFFu
+// Frames between two looks for room to reload evicted meshlets
+#define K3_MESHLET_RELOAD_FRAMES	60
+
+/* The vertex streams, their attributes are reflected from the vertex shader's inputs
+** (K3ShaderLayout::getVertexAttributes) : members in location order, tightly packed.
+*/
+
+struct Vertex
+{
+	glm::vec2	pos;
+	glm::vec3	color;
+
+	// Shader locations of the stream, from first up to end
+	static const uint32_t	firstLocation = 0;
+	static const uint32_t	endLocation = 2;
+
+	static		VkVertexInputBindingDescription		getBindingDescription() {
+		VkVertexInputBindingDescription	bindingDescription = {};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(Vertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescription;
+	}
+};
+
+// Per-instance vertex stream, one world matrix per scene node
+struct InstanceData
+{
+	glm::mat4	world;
+
+	// A mat4 input takes one location per column
+	static const uint32_t	firstLocation = 2;
+	static const uint32_t	endLocation = 6;
+
+	static		VkVertexInputBindingDescription		getBindingDescription() {
+		VkVertexInputBindingDescription	bindingDescription = {};
+		bindingDescription.binding = 1;
+		bindingDescription.stride = sizeof(InstanceData);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		return bindingDescription;
+	}
+};
+
+// One entry of the material table, std430 layout of shader_bindless.frag
+struct MaterialData
+{
+	glm::vec4	color;
+	// Bindless texture slot, K3_BINDLESS_NONE for a plain color
+	uint32_t	texture;
+	uint32_t	padding[3];
+};
+
+// Push constants of the bindless shaders, the buffers are given as bindless slots
+struct DrawConstants
+{
+	uint32_t	materialIds;
+	// Start of the recorded image's region in the material ID buffer
+	uint32_t	materialIdBase;
+	uint32_t	materialTable;
+	// Slots of K3LightClusters, K3_BINDLESS_NONE leaves the nodes unlit
+	uint32_t	lights;
+	uint32_t	lightParams;
+	uint32_t	lightGrid;
+	uint32_t	lightIndices;
+	// The recorded image, whose region of the light buffers is read
+	uint32_t	lightRegion;
+};
+
+// Specialization constants of shader_bindless.frag, a pipeline variant per material kind
+struct MaterialConstants
+{
+	// Off for materials without a texture, the variant has no texture fetch at all
+	VkBool32	textured;
+
+	static		std::array<VkSpecializationMapEntry, 1> getMapEntries() {
+		return { { { 0, offsetof(MaterialConstants, textured), sizeof(VkBool32) } } };
+	}
+};
+
+const std::vector<Vertex> vertices = {
+	{ { -0.5f, -0.5f },{ 1.0f, 0.0f, 0.0f } },
+	{ { 0.5f, -0.5f },{ 0.0f, 1.0f, 0.0f } },
+	{ { 0.5f, 0.5f },{ 0.0f, 0.0f, 1.0f } },
+	{ { -0.5f, 0.5f },{ 1.0f, 1.0f, 1.0f } }
+};
+
+const std::vector<uint16_t>		indices = {
+	0, 1, 2, 2, 3, 0
+};
+
+// Subdivisions of the finer levels of detail of the quad, the coarsest level is the quad itself
+const uint32_t		lodGridSubdivisions[] = { 16, 8, 4 };
+
+class VkHandler {
+	friend class VkGPU;
+	friend class K3Benchmark;
+
+public:
+	void				run();
+	void				terminate();
+	void				resizeWindow(const int newSizeX, const int newSizeY, const bool fullscreen);
+	void				setSimulation(std::function<void(K3Scene&, double)> const& update, double const timestep = K3_SIM_TIMESTEP);
+	void				setFrameCap(double const fps);
+	K3LatencyStats			getLatencyStats() const;
+	uint32_t			createMaterial(glm::vec4 const& color, uint32_t const texture = K3_BINDLESS_NONE);
+	K3Bindless&			getBindless();
+	bool				isBindless() const;
+	K3MemoryBudget&			getMemoryBudget();
+	void				setMsaaSamples(VkSampleCountFlagBits const samples);
+	void				setDynamicResolution(double const targetMs);
+	void				setDisplaySync(bool const sync);
+	void				startCapture(std::string const& path);
+	void				stopCapture();
+	// Writes the meshlets to path once they are built or loaded, for K3_pack to store them
+	void				saveMeshlets(std::string const& path);
+
+	VkHandler(bool const headless = false) {
+		initSubClasses(headless);
+	}
+	~VkHandler() {
+		delete dispHandler;
+		delete gpu;
+	}
+
+private:
+
+	/* Everything the scene pipelines are created from but their specialization, kept from
+	** createGFXPipeline() until the variants compiled after the first frame are built. The
+	** create info points into it, which is why it is only ever held by pointer.
+	*/
+	struct GfxPipelineState
+	{
+		VkShaderModule					vertShaderModule;
+		VkShaderModule					fragShaderModule;
+		VkPipelineShaderStageCreateInfo			shaderStages[2];
+		VkVertexInputBindingDescription			bindingDescriptions[2];
+		std::vector<VkVertexInputAttributeDescription>	attributeDescriptions;
+		VkPipelineVertexInputStateCreateInfo		vertexInputInfo;
+		VkPipelineInputAssemblyStateCreateInfo		inputAssembly;
+		VkPipelineViewportStateCreateInfo		vpState;
+		VkPipelineRasterizationStateCreateInfo		rasterizer;
+		VkPipelineMultisampleStateCreateInfo		multisampling;
+		VkPipelineDepthStencilStateCreateInfo		depthStencil;
+		VkPipelineColorBlendAttachmentState		colorBlendAttach;
+		VkPipelineColorBlendStateCreateInfo		colorBlendInfo;
+		VkDynamicState					dSList[2];
+		VkPipelineDynamicStateCreateInfo		dynamicState;
+		VkGraphicsPipelineCreateInfo			gfxPipelineInfo;
+	};
+
+	void				initSubClasses(bool const headless);
+	void				initVulkan();
+	void				loadAssets();
+	void				firstFramePresented();
+	void				startLazyInit();
+	void				installDeferredVariants();
+	void				mainLoop();
+	void				renderLoop();
+	void				simulate(double const dt);
+	void				publishScene();
+	void				createInstance();
+	bool				checkValidationLayerSupport();
+	K3FrameVector<const char *>	getGlfwRequiredExtensions();
+	void				setupDebugCallback();
+	void				terminateVulkan();
+	const char*			getMissingQueue(VkQueueFlags);
+	void				createRenderPass();
+	void				createGFXPipeline();
+	VkPipeline			buildGfxVariant(VkSpecializationInfo const* specialization) const;
+	void				destroyGfxState();
+	void				createCmdPool();
+	void				createCmdBuffers();
+	bool				isDrawnPerNode() const;
+	void				updateBuckets();
+	uint32_t			getMaterialPipeline(uint32_t const material) const;
+	void				buildRenderQueue();
+	K3BindStats			recordBucket(VkCommandBuffer const cmdBuffer, uint32_t const image, uint32_t const bucket,
+						K3MeshletView const& meshletView);
+	std::vector<VkFramebuffer> const&	getSceneFramebuffers() const;
+	VkExtent2D			getRenderExtent() const;
+	void				updateRenderScale(uint32_t const frameSlot);
+	void				freeCmdBuffers();
+	VkCommandPool			getThreadCmdPool() const;
+	void				createSyncObjects();
+	void				createImageSemaphores();
+	void				createVertexBuffer();
+	void				createIndexBuffer();
+	void				createLodMeshes();
+	void				optimizeMeshes(K3LodMesh const& mesh);
+	void				createMeshlets();
+	bool				loadMeshlets(K3MeshletMesh& meshletMesh, std::vector<K3MeshletLevel>& levels) const;
+	void				uploadMeshletBuffer(void const* data, VkDeviceSize const size, VkBuffer& buffer, VkDeviceMemory& memory);
+	void				updateMeshletResidency();
+	bool				isCullingMeshlets() const;
+	void				createIndirectBuffer();
+	void				createMaterialBuffers();
+	void				createMaterialIdBuffer();
+	void				destroyMaterialBuffers();
+	void				destroyIndirectBuffer();
+	K3LodView			getLodView() const;
+	K3MeshletView			getMeshletView() const;
+	K3LightView			getLightView() const;
+	void				createInstanceBuffer();
+	void				destroyInstanceBuffer();
+	void				copyBuffer(VkBuffer src, VkBuffer dst, VkBufferCopy *copyInfo, uint32_t copyInfoSize, VkFence fence);
+	void				submitGfxCommands(std::function<void(VkCommandBuffer const)> const& record);
+	void				setCullingDepth();
+	void				createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProperties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+						K3MemoryPriority const priority = K3_MEMORY_NORMAL, K3MemoryBudget::Evictor const& evict = nullptr);
+	void				createBufferHandle(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer);
+	void*				createMappedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	bool				recreateSwapChain();
+	void				retireSwapChainAssets(VkSwapchainKHR const oldSwapchain);
+	void				retireCmdBuffers();
+	void				retireBuffer(VkBuffer& buffer, VkDeviceMemory& memory);
+	void				cleanupSwapChainAssets();
+	void				drawFrame();
+	void				completeFrame(uint32_t const frameSlot, bool const waitPresent);
+	VkShaderModule			createShaderModuleFromSrc(const std::string& filename, K3ShaderLayout* const layout = nullptr);
+	void				DestroyDebugReportCallbackEXT(VkInstance instance, VkDebugReportCallbackEXT callback, const VkAllocationCallbacks* pAllocator);
+	VkResult			CreateDebugReportCallbackEXT(VkInstance instance, const VkDebugReportCallbackCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugReportCallbackEXT* pCallback);
+	void				transferBufferToGpuStaged(void const* bufferDataVkBuffer, VkDeviceSize const bufferDataSize, VkBuffer& dstBuffer, VkDeviceMemory& dstBufferMemory, int const copySrcOffst, int const copyDstOffst, VkBufferUsageFlags const usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+						K3MemoryPriority const priority = K3_MEMORY_NORMAL, K3MemoryBudget::Evictor const& evict = nullptr);
+	
+	////////////////////////////////////
+	// VARIABLES
+	////////////////////////////////////
+
+
+	// Device creation, then the renderer, each a graph of concurrent steps, and what waits for the first frame
+	K3StartupGraph			deviceStartup { "device" };
+	K3StartupGraph			rendererStartup { "renderer" };
+	K3StartupGraph			lazyStartup { "lazy" };
+	bool				lazyStartupReported = false;
+	std::chrono::steady_clock::time_point	startupStart;
+	// From the construction of the handler to the first present, 0 until then
+	double				firstFrameMs = 0.0;
+	VkInstance			instance;
+	VkDebugReportCallbackEXT	callback;
+	// Everything in it is loaded at start in one batch, the entries at assetOffsets (in words)
+	K3Archive			assets;
+	std::vector<uint32_t>		assetData;
+	std::vector<size_t>		assetOffsets;
+	VkDisplayHandler		*dispHandler;
+	VkGPU				*gpu;
+	VkRenderPass			renderPass;
+	VkPipelineLayout		pipelineLayout;
+	// Graphics pipelines by their specialization, the index goes in the pipeline bits of the sort keys
+	K3PipelineVariants<MaterialConstants>	gfxVariants;
+	// The variant that draws any material, the first one, for the draws not sorted by material
+	VkPipeline			gfxPipeline;
+	// Variants left for after the first frame, compiled from gfxState into pendingVariants
+	std::unique_ptr<GfxPipelineState>	gfxState;
+	std::vector<MaterialConstants>	deferredVariants;
+	std::vector<VkPipeline>		pendingVariants;
+	// Task and mesh shaders in place of the vertex input, when meshShading
+	VkPipeline			meshPipeline = VK_NULL_HANDLE;
+	VkCommandPool			cmdPools[4];
+	std::vector<VkCommandBuffer>	cmdBuffers;
+	std::vector<VkCommandPool>	cmdBufferPools;
+	std::vector<VkCommandPool>	threadCmdPools;
+	VkSemaphore			semImgAvailable[K3_MAX_FRAMES_IN_FLIGHT];
+	VkFence				inFlightFences[K3_MAX_FRAMES_IN_FLIGHT];
+	// Graphics to compute handoff of each frame when post processing is on
+	VkSemaphore			semSceneDone[K3_MAX_FRAMES_IN_FLIGHT];
+	uint64_t			framePresentIds[K3_MAX_FRAMES_IN_FLIGHT] = {};
+	// One per swapchain image, a present may still wait on it until the image is acquired again
+	std::vector<VkSemaphore>	semRenderFinished;
+	std::vector<VkFence>		imagesInFlight;
+	uint64_t			frameNumber = 0;
+	bool				swapchainOutdated = false;
+	std::atomic<bool>		resizeRequested { false };
+	K3DeletionQueue			retired;
+	// Every device memory allocation of the renderer goes through it
+	K3MemoryBudget			budget;
+	K3PostProcess			post;
+	bool				postProcessing = false;
+	// Depth and multisampled color of the scene pass, msaaSamples is only what was asked for
+	K3SceneTargets			sceneTargets;
+	VkSampleCountFlagBits		msaaSamples = K3_MSAA_SAMPLES;
+	// Timestamps of the scene and post spans, disabled on devices without them
+	K3GpuTimer			gpuTimer;
+	// Scale of the scene pass, only ever below 1 with post processing to upscale it
+	K3DynamicResolution		dynamicResolution;
+	// Swapchain image each frame slot last submitted, K3_NO_IMAGE when its timestamps are gone
+	uint32_t			slotImages[K3_MAX_FRAMES_IN_FLIGHT];
+	// GPU time of the last frame measured, scene and post processing
+	double				gpuFrameMs = 0.0;
+	K3Bindless			bindless;
+	bool				bindlessResources = false;
+	// Material 0 is the default one every node starts with
+	std::vector<MaterialData>	materials = { { glm::vec4(1.0f), K3_BINDLESS_NONE, {} } };
+	// Fixed size, read by the render thread while the simulation creates materials
+	std::array<MaterialConstants, K3_MAX_MATERIALS>	materialConstants = {};
+	VkBuffer			materialTableBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory			materialTableMemory = VK_NULL_HANDLE;
+	MaterialData*			materialTableData = nullptr;
+	uint32_t			materialTableSlot = K3_BINDLESS_NONE;
+	VkBuffer			materialIdBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory			materialIdMemory = VK_NULL_HANDLE;
+	uint32_t*			materialIdData = nullptr;
+	uint32_t			materialIdSlot = K3_BINDLESS_NONE;
+	std::vector<uint32_t>		materialRegionVersions;
+	// Lights binned every frame ahead of the draws, on the bindless path only
+	K3LightClusters			lightClusters;
+	bool				clusteredLighting = false;
+	K3MeshletCuller			culler;
+	bool				meshletCulling = false;
+	bool				meshShading = false;
+	std::string			meshletSavePath;
+	// Set by the budget's evictor from any thread, the render thread evicts the meshlets between two frames
+	std::atomic<bool>		meshletEviction { false };
+	VkBuffer			vertexBuffer;
+	VkDeviceMemory			vertexBufferMemory;
+	uint32_t			vertexObjectSize;
+	VkBuffer			indexBuffer;
+	VkDeviceMemory			indexBufferMemory;
+	uint32_t			drawCount = 1;
+	K3Scene				scene;
+	K3CaptureWriter			capture;
+	VkBuffer			instanceBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory			instanceBufferMemory = VK_NULL_HANDLE;
+	glm::mat4*			instanceData = nullptr;
+	std::vector<uint32_t>		instanceRegionVersions;
+	uint32_t			recordedInstanceCount = 0;
+	uint32_t			recordedMaterialVersion = 0;
+	uint32_t			recordedLodVersion = 0;
+	// Draws of the stale buckets only, each bucket's first one in bucketFirstDraws
+	K3RenderQueue			renderQueue;
+	K3CommandCache			cmdCache;
+	std::vector<uint32_t>		nodeBuckets;
+	std::vector<uint32_t>		bucketFirstDraws;
+	uint32_t			recordedBuckets = 0;
+	// Binds recorded in one image's buckets, replayed every frame, and the pipeline binds of the same draws in node order
+	K3BindStats			recordedBinds;
+	uint32_t			nodeOrderPipelineBinds = 0;
+	K3TripleBuffer<K3SceneSnapshot>	sceneSnapshots;
+	std::function<void(K3Scene&, double)>	simulation;
+	double				simTimestep = K3_SIM_TIMESTEP;
+	uint64_t			simTick = 0;
+	uint64_t			renderedTick = 0;
+	std::atomic<bool>		running { false };
+	std::exception_ptr		renderError;
+	K3LodSelector			lods;
+	std::vector<Vertex>		meshVertices;
+	std::vector<uint32_t>		meshIndices;
+	// meshIndices as uploaded, 16 bit whenever the vertex count allows it
+	std::vector<uint8_t>		meshIndexData;
+	VkIndexType			meshIndexType = VK_INDEX_TYPE_UINT16;
+	bool				indirectDraws = false;
+	VkBuffer			indirectBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory			indirectBufferMemory = VK_NULL_HANDLE;
+	VkDrawIndexedIndirectCommand*	indirectData = nullptr;
+	std::vector<uint32_t>		indirectRegionVersions;
+	K3Profiler			profiler;
+	K3FramePacer			pacer;
+	uint64_t			presentId = 0;
+#ifdef VK_KHR_present_wait
+	PFN_vkWaitForPresentKHR		vkWaitForPresent = nullptr;
+#endif
+	std::chrono::steady_clock::time_point	lastInputTime;
+
+};
@@ -1,6 +1,6 @@
-#pragma once
-
-# define ENGINE_H
-#include "VkGPU.h"
-#include "VkHandler.h"
-#include "VkDisplayHandler.h"
+#pragma once
+
+# define ENGINE_H
+#include "VkGPU.h"
+#include "VkHandler.h"
+#include "VkDisplayHandler.h"
@@ -1,15 +1,36 @@
-#include "engine.h"
-
-int			main()
-{
-	VkHandler		k3Handler;
-
-	try {
-		k3Handler.run();
-	}
-	catch (const std::runtime_error &e) {
-		std::cerr << e.what() << std::endl;
-		k3Handler.terminate();
-	}
-	return EXIT_SUCCESS;
+#include "engine.h"
+
+/* usage: K3_Engine [--capture file] [--vsync] [--fps-cap N] [--save-meshlets file]
+** --vsync presents in FIFO mode and lets the frame pacer start the frames against the vblank.
+** --save-meshlets writes the meshlets to file, K3_pack stores it next to the shaders.
+*/
+
+int			main(int argc, char** argv)
+{
+	VkHandler		k3Handler;
+
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string const	option = argv[i];
+
+			if (option == "--capture" && i + 1 < argc)
+				k3Handler.startCapture(argv[++i]);
+			else if (option == "--vsync")
+				k3Handler.setDisplaySync(true);
+			else if (option == "--fps-cap" && i + 1 < argc)
+				k3Handler.setFrameCap(std::stod(argv[++i]));
+			else if (option == "--save-meshlets" && i + 1 < argc)
+				k3Handler.saveMeshlets(argv[++i]);
+			else {
+				std::cerr << "usage: " << argv[0] << " [--capture file] [--vsync] [--fps-cap N] [--save-meshlets file]" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		k3Handler.run();
+	}
+	catch (const std::runtime_error &e) {
+		std::cerr << e.what() << std::endl;
+		k3Handler.terminate();
+	}
+	return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+# Build options shared by every K3 target : window system, LTO and profile guided optimization
+
+option(K3_BUILD_BENCHMARKS "Build the K3_bench benchmark executable" ON)
+option(K3_ENABLE_LTO "Enable link time optimization" OFF)
+option(K3_NATIVE_ARCH "Optimize for the build machine CPU (-march=native)" OFF)
+option(K3_DISABLE_PROFILING "Compile out the per-frame profiler report" OFF)
+option(K3_OPTIMIZE_SHADERS "Run the SPIR-V performance passes on the compiled shaders" ON)
+option(K3_PACK_SHADERS "Pack the compiled shaders into the archive the engine loads them from (K3_pack)" ON)
+set(K3_PGO "OFF" CACHE STRING "Profile guided optimization phase : OFF, GENERATE or USE")
+set_property(CACHE K3_PGO PROPERTY STRINGS OFF GENERATE USE)
+set(K3_PGO_DIR "${CMAKE_BINARY_DIR}/pgo" CACHE PATH "Directory where PGO profiles are written and read")
+
+if(UNIX AND NOT APPLE)
+	set(K3_LINUX_WSI "XCB" CACHE STRING "Linux window system : XCB or WAYLAND")
+	set_property(CACHE K3_LINUX_WSI PROPERTY STRINGS XCB WAYLAND)
+endif()
+
+if(K3_ENABLE_LTO)
+	include(CheckIPOSupported)
+	check_ipo_supported(RESULT K3_LTO_SUPPORTED OUTPUT K3_LTO_ERROR LANGUAGES CXX)
+	if(NOT K3_LTO_SUPPORTED)
+		message(WARNING "LTO is not supported by this toolchain : ${K3_LTO_ERROR}")
+	endif()
+endif()
+
+if(NOT K3_PGO STREQUAL "OFF")
+	file(MAKE_DIRECTORY "${K3_PGO_DIR}")
+endif()
+
+function(k3_configure_target target)
+	if(MSVC)
+		target_compile_options(${target} PRIVATE /W3 $<$<CONFIG:Release>:/O2 /Oi /Gy>)
+	else()
+		target_compile_options(${target} PRIVATE -Wall -Wextra -Wno-unused-parameter $<$<CONFIG:Release>:-O3>)
+		if(K3_NATIVE_ARCH)
+			target_compile_options(${target} PRIVATE -march=native)
+		endif()
+	endif()
+
+	if(K3_DISABLE_PROFILING)
+		target_compile_definitions(${target} PRIVATE K3_DISABLE_PROFILING)
+	endif()
+
+	if(UNIX AND NOT APPLE)
+		if(K3_LINUX_WSI STREQUAL "WAYLAND")
+			target_compile_definitions(${target} PRIVATE K3_PLATFORM_WAYLAND)
+		else()
+			target_compile_definitions(${target} PRIVATE K3_PLATFORM_XCB)
+		endif()
+	endif()
+
+	if(K3_ENABLE_LTO AND K3_LTO_SUPPORTED)
+		set_property(TARGET ${target} PROPERTY INTERPROCEDURAL_OPTIMIZATION TRUE)
+	endif()
+
+	# Run the GENERATE build on a representative workload (K3_bench), then rebuild with USE
+	if(K3_PGO STREQUAL "GENERATE")
+		if(MSVC)
+			target_compile_options(${target} PRIVATE /GL)
+			target_link_options(${target} PRIVATE /LTCG /GENPROFILE:PGD=${K3_PGO_DIR}/${target}.pgd)
+		else()
+			target_compile_options(${target} PRIVATE -fprofile-generate=${K3_PGO_DIR})
+			target_link_options(${target} PRIVATE -fprofile-generate=${K3_PGO_DIR})
+		endif()
+	elseif(K3_PGO STREQUAL "USE")
+		if(MSVC)
+			target_compile_options(${target} PRIVATE /GL)
+			target_link_options(${target} PRIVATE /LTCG /USEPROFILE:PGD=${K3_PGO_DIR}/${target}.pgd)
+		elseif(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+			target_compile_options(${target} PRIVATE -fprofile-use=${K3_PGO_DIR} -fprofile-correction -Wno-missing-profile)
+			target_link_options(${target} PRIVATE -fprofile-use=${K3_PGO_DIR})
+		else()
+			# Clang needs the raw profiles merged first : llvm-profdata merge -o <dir>/default.profdata <dir>
+			target_compile_options(${target} PRIVATE -fprofile-use=${K3_PGO_DIR}/default.profdata -Wno-profile-instr-unprofiled)
+			target_link_options(${target} PRIVATE -fprofile-use=${K3_PGO_DIR}/default.profdata)
+		endif()
+	endif()
+endfunction()
@@ -0,0 +1,89 @@
+# SPIR-V compilation of the GLSL sources in shaders/
+#
+# When glslc or glslangValidator is available the shaders are compiled into the build tree
+# and the engine loads them from there, otherwise the prebuilt .spv next to the sources are used.
+# With K3_OPTIMIZE_SHADERS the SPIR-V goes through the spirv-opt performance passes (glslc -O,
+# or spirv-opt -O after glslangValidator). Warnings are errors with glslc. The Visual Studio
+# project passes the same glslc flags (K3GlslcFlags). Descriptor layouts, push constants and
+# vertex inputs are reflected from the SPIR-V when it is loaded (K3ShaderLayout), in both builds,
+# rather than into generated headers : the engine may load the prebuilt .spv, the build tree's
+# or the archive's, and reflects the one it got.
+
+find_program(K3_GLSLC glslc HINTS "$ENV{VULKAN_SDK}/bin" "$ENV{VULKAN_SDK}/Bin")
+if(NOT K3_GLSLC)
+	find_program(K3_GLSLANG_VALIDATOR glslangValidator HINTS "$ENV{VULKAN_SDK}/bin" "$ENV{VULKAN_SDK}/Bin")
+	find_program(K3_SPIRV_OPT spirv-opt HINTS "$ENV{VULKAN_SDK}/bin" "$ENV{VULKAN_SDK}/Bin")
+endif()
+
+function(k3_add_shaders target)
+	if(NOT K3_GLSLC AND NOT K3_GLSLANG_VALIDATOR)
+		message(WARNING "No GLSL compiler found, ${target} uses the prebuilt SPIR-V in shaders/")
+		target_compile_definitions(${target} PUBLIC K3_SHADER_DIR="${CMAKE_CURRENT_SOURCE_DIR}/shaders/")
+		return()
+	endif()
+
+	set(outputDir "${CMAKE_BINARY_DIR}/shaders")
+	set(outputs "")
+	set(glslcFlags -Werror)
+	if(K3_OPTIMIZE_SHADERS)
+		list(APPEND glslcFlags -O)
+		if(K3_GLSLANG_VALIDATOR AND NOT K3_SPIRV_OPT)
+			message(WARNING "spirv-opt not found, ${target} shaders are not optimized")
+		endif()
+	endif()
+	foreach(shader ${ARGN})
+		get_filename_component(name "${shader}" NAME)
+		set(source "${CMAKE_CURRENT_SOURCE_DIR}/${shader}")
+		set(output "${outputDir}/${name}.spv")
+		# Task and mesh shaders need SPIR-V 1.4
+		set(optimize "")
+		if(K3_GLSLC AND name MATCHES "\\.(task|mesh)$")
+			set(command "${K3_GLSLC}" ${glslcFlags} --target-env=vulkan1.1spv1.4 "${source}" -o "${output}")
+		elseif(K3_GLSLC)
+			set(command "${K3_GLSLC}" ${glslcFlags} "${source}" -o "${output}")
+		elseif(name MATCHES "\\.(task|mesh)$")
+			set(command "${K3_GLSLANG_VALIDATOR}" -V --target-env spirv1.4 "${source}" -o "${output}")
+		else()
+			set(command "${K3_GLSLANG_VALIDATOR}" -V "${source}" -o "${output}")
+		endif()
+		# glslc optimizes by itself, glslangValidator output goes through spirv-opt in place
+		if(K3_OPTIMIZE_SHADERS AND NOT K3_GLSLC AND K3_SPIRV_OPT)
+			set(optimize COMMAND "${K3_SPIRV_OPT}" -O "${output}" -o "${output}")
+		endif()
+		add_custom_command(
+			OUTPUT "${output}"
+			COMMAND ${CMAKE_COMMAND} -E make_directory "${outputDir}"
+			COMMAND ${command}
+			${optimize}
+			DEPENDS "${source}"
+			COMMENT "Compiling ${name}"
+			VERBATIM
+		)
+		list(APPEND outputs "${output}")
+	endforeach()
+
+	add_custom_target(${target}_shaders ALL DEPENDS ${outputs})
+	add_dependencies(${target} ${target}_shaders)
+	target_compile_definitions(${target} PUBLIC K3_SHADER_DIR="${outputDir}/")
+	# For k3_pack_shaders, the prebuilt SPIR-V is never packed into the source tree
+	set(K3_SHADER_OUTPUTS "${outputs}" PARENT_SCOPE)
+	set(K3_SHADER_OUTPUT_DIR "${outputDir}" PARENT_SCOPE)
+endfunction()
+
+# Packs the shaders k3_add_shaders compiled into shaders.k3a next to them (K3_ASSET_ARCHIVE),
+# entries named relative to the shader directory so the engine finds them under their usual path
+function(k3_pack_shaders packer)
+	if(NOT K3_PACK_SHADERS OR NOT K3_SHADER_OUTPUTS)
+		return()
+	endif()
+
+	set(archive "${K3_SHADER_OUTPUT_DIR}/shaders.k3a")
+	add_custom_command(
+		OUTPUT "${archive}"
+		COMMAND ${packer} --root "${K3_SHADER_OUTPUT_DIR}/" "${archive}" ${K3_SHADER_OUTPUTS}
+		DEPENDS ${packer} ${K3_SHADER_OUTPUTS}
+		COMMENT "Packing shaders.k3a"
+		VERBATIM
+	)
+	add_custom_target(k3_shader_archive ALL DEPENDS "${archive}")
+endfunction()
@@ -1,17 +1,18 @@
-#version 450
-#extension GL_ARB_seperate_shader_objects : enable
-
-layout(location = 0) in vec2	inPosition;
-layout(location = 1) in vec3	inColor;
-
-layout(location = 0) out vec3	fragColor;
-
-out gl_PerVertex {
-	vec4 gl_Position;
-};
-
-void main ()
-{
-	gl_Position = vec4(inPosition, 0.0, 1.0);
-	fragColor = inColor;
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2	inPosition;
+layout(location = 1) in vec3	inColor;
+layout(location = 2) in mat4	inWorld;
+
+layout(location = 0) out vec3	fragColor;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+
+void main ()
+{
+	gl_Position = inWorld * vec4(inPosition, 0.0, 1.0);
+	fragColor = inColor;
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+#define BINDLESS_NONE	0xFFFFFFFFu
+// K3_LIGHT_GRID_* of K3LightClusters.h
+#define GRID_X		16
+#define GRID_Y		9
+#define GRID_Z		24
+#define LIGHT_SPOT	1u
+
+layout(location = 0) in		vec3	fragColor;
+layout(location = 1) in		vec2	fragUv;
+layout(location = 2) flat in	uint	fragMaterial;
+layout(location = 3) in		vec3	fragPosition;
+layout(location = 4) in		vec3	fragNormal;
+
+layout(location = 0) out	vec4	outColor;
+
+struct Material
+{
+	vec4	color;
+	uint	texture;
+};
+
+// K3Light
+struct Light
+{
+	vec3	position;
+	float	radius;
+	vec3	color;
+	float	intensity;
+	vec3	direction;
+	float	outerCos;
+	float	innerCos;
+	uint	type;
+	uint	padding0;
+	uint	padding1;
+};
+
+// The parameters of light_cluster.comp, one per region
+struct ClusterParams
+{
+	mat4	view;
+	mat4	invProj;
+	vec4	ambient;
+	vec2	invExtent;
+	float	sliceScale;
+	float	sliceBias;
+	float	zNear;
+	float	zFar;
+	uint	lightCount;
+	uint	perspective;
+	uint	lightBase;
+	uint	clusterBase;
+	uint	indexBase;
+	uint	indexCapacity;
+};
+
+// Binding 0 holds every texture, binding 1 every storage buffer, see K3Bindless
+layout(set = 0, binding = 0) uniform sampler2D	textures[];
+layout(set = 0, binding = 1, std430) readonly buffer Materials {
+	Material	materials[];
+} materialTables[];
+layout(set = 0, binding = 1, std430) readonly buffer Lights {
+	Light	lights[];
+} lightBuffers[];
+layout(set = 0, binding = 1, std430) readonly buffer LightParams {
+	ClusterParams	params[];
+} lightParams[];
+layout(set = 0, binding = 1, std430) readonly buffer LightGrid {
+	uvec2	clusters[];
+} lightGrids[];
+layout(set = 0, binding = 1, std430) readonly buffer LightIndices {
+	uint	indices[];
+} lightIndices[];
+
+layout(push_constant) uniform DrawConstants {
+	uint	materialIds;
+	uint	materialIdBase;
+	uint	materialTable;
+	uint	lights;
+	uint	lightParams;
+	uint	lightGrid;
+	uint	lightIndices;
+	uint	lightRegion;
+} pc;
+
+// Specialization constant, see MaterialConstants : off in the variant for untextured materials
+layout(constant_id = 0) const bool	TEXTURED = true;
+
+/* Lambert from the lights of the fragment's cluster only, the cluster found from the position
+** on screen and the view depth. The falloff reaches 0 at the radius, so that the lights
+** binned out of a cluster are exactly those that do not reach it.
+*/
+
+vec3	shade(vec3 position, vec3 normal)
+{
+	if (pc.lightGrid == BINDLESS_NONE)
+		return vec3(1.0);
+
+	ClusterParams	p = lightParams[pc.lightParams].params[pc.lightRegion];
+	float		depth = (p.view * vec4(position, 1.0)).z;
+	float		slice = (p.perspective != 0u ? log(max(depth, p.zNear)) : depth) * p.sliceScale + p.sliceBias;
+	ivec3		id = clamp(ivec3(ivec2(gl_FragCoord.xy * p.invExtent * vec2(GRID_X, GRID_Y)), int(floor(slice))),
+				ivec3(0), ivec3(GRID_X - 1, GRID_Y - 1, GRID_Z - 1));
+	uvec2		cluster = lightGrids[pc.lightGrid].clusters[p.clusterBase + uint(id.x + GRID_X * (id.y + GRID_Y * id.z))];
+	vec3		result = p.ambient.rgb;
+
+	for (uint i = 0; i < cluster.y; i++) {
+		Light	light = lightBuffers[pc.lights].lights[p.lightBase + lightIndices[pc.lightIndices].indices[p.indexBase + cluster.x + i]];
+		vec3	toLight = light.position - position;
+		float	lightDistance = length(toLight);
+		vec3	l = toLight / max(lightDistance, 1e-5);
+		float	ratio = lightDistance / light.radius;
+		float	falloff = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+		float	attenuation = falloff * falloff;
+
+		if (light.type == LIGHT_SPOT)
+			attenuation *= smoothstep(light.outerCos, max(light.innerCos, light.outerCos + 1e-4), dot(-l, light.direction));
+		result += light.color * light.intensity * max(dot(normal, l), 0.0) * attenuation;
+	}
+	return result;
+}
+
+void	main()
+{
+	Material	material = materialTables[pc.materialTable].materials[fragMaterial];
+
+	outColor = vec4(fragColor, 1.0) * material.color;
+	// Neighbouring fragments may belong to different nodes, the index is not uniform
+	if (TEXTURED && material.texture != BINDLESS_NONE)
+		outColor *= texture(textures[nonuniformEXT(material.texture)], fragUv);
+	outColor.rgb *= shade(fragPosition, normalize(fragNormal));
+}
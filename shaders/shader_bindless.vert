@@ -0,0 +1,48 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Bindless variant of shader.vert, the node's material comes from the global set, the world position and normal go to the lighting
+
+layout(location = 0) in vec2	inPosition;
+layout(location = 1) in vec3	inColor;
+layout(location = 2) in mat4	inWorld;
+
+layout(location = 0) out vec3		fragColor;
+layout(location = 1) out vec2		fragUv;
+layout(location = 2) flat out uint	fragMaterial;
+layout(location = 3) out vec3		fragPosition;
+layout(location = 4) out vec3		fragNormal;
+
+// Every storage buffer of the renderer, see K3Bindless
+layout(set = 0, binding = 1, std430) readonly buffer MaterialIds {
+	uint	ids[];
+} materialIds[];
+
+layout(push_constant) uniform DrawConstants {
+	uint	materialIds;
+	uint	materialIdBase;
+	uint	materialTable;
+	uint	lights;
+	uint	lightParams;
+	uint	lightGrid;
+	uint	lightIndices;
+	uint	lightRegion;
+} pc;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+};
+
+void main ()
+{
+	vec4	world = inWorld * vec4(inPosition, 0.0, 1.0);
+
+	// Clip space is world space until there is a camera
+	gl_Position = world;
+	fragPosition = world.xyz;
+	// The meshes are flat in the xy plane, facing the view (-z)
+	fragNormal = normalize(mat3(inWorld) * vec3(0.0, 0.0, -1.0));
+	fragColor = inColor;
+	fragUv = inPosition + 0.5;
+	fragMaterial = materialIds[pc.materialIds].ids[pc.materialIdBase + gl_InstanceIndex];
+}